@@ -0,0 +1,750 @@
+/*
+** nw_bench.cpp
+**
+** command line tool
+** profiles the DSP cores of the LowkeyNW objects outside of Max, reporting the
+** cost of each in nanoseconds per output sample
+**
+** usage: nw_bench [-v vectorsizes] [-r samplerates] [-s seconds]
+**		vectorsizes and samplerates are comma separated lists, e.g.
+**		nw_bench -v 32,64,512 -r 44100,96000 -s 5
+**
+** Copyright © 2015 by Nathan Wolek
+** License: http://opensource.org/licenses/BSD-3-Clause
+**
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+
+#include "nw_grainvoice.h"
+#include "cppan_dsp.h"
+#include "gateplus_dsp.h"
+#include "gverb_dsp.h"
+#include "phasorshift_dsp.h"
+#include "recordplus_dsp.h"
+#include "trainshift_dsp.h"
+
+#define BENCH_LIST_MAX		16			// most vector sizes or sample rates
+#define BENCH_SND_SECONDS	4			// length of the synthetic sound buffer
+#define BENCH_WIN_FRAMES	1024		// length of the synthetic window buffer
+#define BENCH_VOICES		32			// grain voices in the pool
+#define BENCH_TRAINS		8			// outlets for the phasor and train cores
+#define BENCH_OUTLETS		64			// outlets for the wide phasor core
+#define BENCH_BANK			256			// phasors in one multichannel bank, and output signals
+
+/* one benchmark run, all engines see the same settings */
+typedef struct _bench_run
+{
+	long vectorsize;
+	double samplerate;
+	long vectors;						// vectors to process
+	std::vector<double> in[2];			// one second of input signals
+	std::vector<double> out[BENCH_BANK];	// output signals
+	double *outs[BENCH_BANK];
+} t_bench_run;
+
+typedef void (*t_bench_engine)(t_bench_run *r);
+
+// sound and window tables shared by the grain engine
+static std::vector<float> snd_table;
+static std::vector<float> win_table;
+static NwPyramid snd_pyramid;			// levels of snd_table, built with it
+
+// keeps the optimiser from dropping the results
+static volatile double bench_sink;
+
+// set by an engine whose output fails a check
+static bool bench_failed = false;
+
+/********************************************************************************
+long bench_parseList(const char *s, double *list)
+
+inputs:			s		-- comma separated numbers
+				list	-- receives up to BENCH_LIST_MAX values
+description:	parses a command line list
+returns:		number of values parsed
+********************************************************************************/
+long bench_parseList(const char *s, double *list)
+{
+	long count = 0;
+	char *end;
+
+	while (*s && count < BENCH_LIST_MAX) {
+		list[count] = strtod(s, &end);
+		if (end == s || list[count] <= 0.) break;
+		++count;
+		s = (*end == ',') ? end + 1 : end;
+	}
+
+	return count;
+}
+
+/********************************************************************************
+void bench_fillTables(double samplerate)
+
+inputs:			samplerate	-- rate of the synthetic sound buffer
+description:	fills a stereo test tone for the sound buffer and a hann window,
+		and builds the pyramid of the sound up front so that it is not timed
+returns:		nothing
+********************************************************************************/
+void bench_fillTables(double samplerate)
+{
+	long frames = (long)(samplerate * BENCH_SND_SECONDS);
+	long i;
+
+	snd_table.assign((frames + NW_INTERP_PAD * 2) * 2, 0.f);
+	for (i = 0; i < frames; i++) {
+		snd_table[i * 2] = (float)sin(i * 0.031);
+		snd_table[i * 2 + 1] = (float)sin(i * 0.017);
+	}
+
+	win_table.assign(BENCH_WIN_FRAMES, 0.f);
+	for (i = 0; i < BENCH_WIN_FRAMES; i++) {
+		win_table[i] = (float)(0.5 - 0.5 * cos(2.0 * 3.14159265358979 * i / BENCH_WIN_FRAMES));
+	}
+
+	snd_pyramid.check(snd_table.data(), frames, 2, (long)samplerate);
+	while (snd_pyramid.update(snd_table.data(), frames, 2, (long)samplerate))
+		;
+}
+
+/********************************************************************************
+void bench_fillInputs(t_bench_run *r)
+
+inputs:			r		-- run settings and signals
+description:	writes one second of an audio rate test tone and a slow ramp to
+		the inputs, so that the engines are not timed generating them
+returns:		nothing
+********************************************************************************/
+void bench_fillInputs(t_bench_run *r)
+{
+	long frames = (long)r->samplerate + r->vectorsize;
+	long i;
+
+	r->in[0].resize(frames);
+	r->in[1].resize(frames);
+
+	for (i = 0; i < frames; i++) {
+		r->in[0][i] = sin(i * 0.05);
+		r->in[1][i] = (double)i / (double)frames;
+	}
+}
+
+/********************************************************************************
+const double *bench_input(t_bench_run *r, long k, long v)
+
+inputs:			r		-- run settings and signals
+				k		-- input number
+				v		-- number of the vector about to be processed
+description:	finds the input vector for a vector, cycling through the second
+returns:		pointer to vectorsize input samples
+********************************************************************************/
+const double *bench_input(t_bench_run *r, long k, long v)
+{
+	return r->in[k].data() + (v * r->vectorsize) % (long)r->samplerate;
+}
+
+/********************************************************************************
+void bench_grainPool(t_bench_run *r, const t_nw_window *window, short interp_s,
+		const t_nw_sinc *sinc, double pitch, NwPyramid *pyramid)
+
+inputs:			r		-- run settings and signals
+				window	-- analytic window shape, or NULL to read the window table
+				interp_s	-- interpolation used reading the sound
+				sinc	-- sinc tables for NW_INTERP_SINC, or NULL
+				pitch	-- scales the pitch of every grain
+				pyramid	-- levels built from the sound table, or NULL
+description:	a pool of overlapping GrainVoices reading a stereo buffer, each
+		voice rendering the run between grain starts in one call, as
+		nw.grainpulse~ does between pulses
+returns:		nothing
+********************************************************************************/
+void bench_grainPool(t_bench_run *r, const t_nw_window *window, short interp_s, const t_nw_sinc *sinc,
+	double pitch, NwPyramid *pyramid)
+{
+	GrainVoice voices[BENCH_VOICES];
+	const t_nw_grain_kernels *kernels = nw_grain_kernels(interp_s, NW_INTERP_LINEAR);
+	bool active[BENCH_VOICES];
+	long size_s = (long)snd_table.size() / 2 - NW_INTERP_PAD * 2;
+	long size_w = window ? NW_WINDOW_FRAMES : BENCH_WIN_FRAMES;
+	double msr = r->samplerate * 0.001;
+	long interval = (long)(r->samplerate * 0.1 / BENCH_VOICES);	// keeps the pool full
+	long next_start = 0;
+	long count = 0;
+	long v, i, k, end;
+
+	for (k = 0; k < BENCH_VOICES; k++) active[k] = false;
+
+	for (v = 0; v < r->vectors; v++) {
+		for (i = 0; i < r->vectorsize; i++)
+			r->outs[0][i] = r->outs[1][i] = 0.;
+
+		for (i = 0; i < r->vectorsize; i = end) {
+			if (count >= next_start) {
+				for (k = 0; k < BENCH_VOICES; k++) {
+					if (!active[k]) {
+						voices[k].start((count % 3000) * 1.0, 100., (0.5 + (k % 5) * 0.25) * pitch, 0.5,
+							k % 2 ? NW_GRAIN_REVERSE : NW_GRAIN_FORWARD,
+							r->samplerate, msr, size_s, size_w, r->samplerate);
+						if (pyramid)
+							voices[k].useLevel(pyramid, msr);
+						voices[k].useSinc(sinc);
+						voices[k].useKernels(kernels, 2);
+						if (window)
+							voices[k].startWindow(window, size_w);
+						active[k] = true;
+						break;
+					}
+				}
+				next_start = count + interval;
+			}
+
+			// the run goes on to the next grain start
+			end = i + (next_start - count);
+			if (end > r->vectorsize) end = r->vectorsize;
+			for (k = 0; k < BENCH_VOICES; k++) {
+				if (active[k])
+					active[k] = voices[k].play(snd_table.data(), size_s, 2, win_table.data(), size_w,
+						r->outs[0] + i, r->outs[1] + i, end - i);
+			}
+			count += end - i;
+		}
+	}
+
+	bench_sink = r->outs[0][0];
+}
+
+/********************************************************************************
+void bench_grains(t_bench_run *r)
+
+inputs:			r		-- run settings and signals
+description:	grain pool reading its window from a buffer
+returns:		nothing
+********************************************************************************/
+void bench_grains(t_bench_run *r)
+{
+	bench_grainPool(r, NULL, NW_INTERP_LINEAR, NULL, 1., NULL);
+}
+
+/********************************************************************************
+void bench_grainsHanning(t_bench_run *r)
+
+inputs:			r		-- run settings and signals
+description:	grain pool computing a hanning window as it goes
+returns:		nothing
+********************************************************************************/
+void bench_grainsHanning(t_bench_run *r)
+{
+	t_nw_window w;
+
+	nw_window_set(&w, "hanning", false, 0.);
+	bench_grainPool(r, &w, NW_INTERP_LINEAR, NULL, 1., NULL);
+}
+
+/********************************************************************************
+void bench_grainsSinc(t_bench_run *r)
+
+inputs:			r		-- run settings and signals
+description:	grain pool reading the sound through the windowed sinc kernel
+returns:		nothing
+********************************************************************************/
+void bench_grainsSinc(t_bench_run *r)
+{
+	bench_grainPool(r, NULL, NW_INTERP_SINC, nw_sinc_get(NW_SINC_PHASES), 1., NULL);
+}
+
+/********************************************************************************
+void bench_grainsHigh(t_bench_run *r)
+
+inputs:			r		-- run settings and signals
+description:	grain pool pitched up 8x, striding through the sound table
+returns:		nothing
+********************************************************************************/
+void bench_grainsHigh(t_bench_run *r)
+{
+	bench_grainPool(r, NULL, NW_INTERP_LINEAR, NULL, 8., NULL);
+}
+
+/********************************************************************************
+void bench_grainsPyramid(t_bench_run *r)
+
+inputs:			r		-- run settings and signals
+description:	grain pool pitched up 8x, reading levels of the pyramid of the
+		sound table
+returns:		nothing
+********************************************************************************/
+void bench_grainsPyramid(t_bench_run *r)
+{
+	bench_grainPool(r, NULL, NW_INTERP_LINEAR, NULL, 8., &snd_pyramid);
+}
+
+/********************************************************************************
+void bench_gverb(t_bench_run *r)
+
+inputs:			r		-- run settings and signals
+description:	the Griesinger network of nw.gverb~ with a fixed decay
+returns:		nothing
+********************************************************************************/
+void bench_gverb(t_bench_run *r)
+{
+	GverbEngine verb;
+	long v;
+
+	verb.init(2500., r->samplerate);
+	verb.setSampleRate(r->samplerate);
+
+	for (v = 0; v < r->vectors; v++) {
+		verb.process(bench_input(r, 0, v), bench_input(r, 1, v), r->outs[0], r->outs[1], r->vectorsize);
+	}
+
+	verb.free();
+	bench_sink = r->outs[0][0];
+}
+
+/********************************************************************************
+void bench_cppanControl(t_bench_run *r)
+
+inputs:			r		-- run settings and signals
+description:	nw.cppan~ with the position set by a float
+returns:		nothing
+********************************************************************************/
+void bench_cppanControl(t_bench_run *r)
+{
+	static CpPan pan;
+	long v;
+
+	pan.init(0.3);
+	pan.setSampleRate(r->samplerate);
+
+	for (v = 0; v < r->vectors; v++) {
+		pan.processControl(bench_input(r, 0, v), r->outs[0], r->outs[1], r->vectorsize);
+	}
+
+	bench_sink = r->outs[0][0];
+}
+
+/********************************************************************************
+void bench_cppanAudio(t_bench_run *r)
+
+inputs:			r		-- run settings and signals
+description:	nw.cppan~ with the position read from a signal
+returns:		nothing
+********************************************************************************/
+void bench_cppanAudio(t_bench_run *r)
+{
+	static CpPan pan;
+	long v;
+
+	pan.init(0.3);
+	pan.setSampleRate(r->samplerate);
+
+	for (v = 0; v < r->vectors; v++) {
+		pan.processAudio(bench_input(r, 0, v), bench_input(r, 1, v), r->outs[0], r->outs[1], r->vectorsize);
+	}
+
+	bench_sink = r->outs[0][0];
+}
+
+/********************************************************************************
+void bench_cppanRing(t_bench_run *r)
+
+inputs:			r		-- run settings and signals
+description:	nw.cppan~ @speakers 8 with the position read from a signal
+returns:		nothing
+********************************************************************************/
+void bench_cppanRing(t_bench_run *r)
+{
+	static CpPan pan;
+	long v;
+
+	pan.init(0.3);
+	pan.setSpeakers(BENCH_TRAINS);
+	pan.setSampleRate(r->samplerate);
+
+	for (v = 0; v < r->vectors; v++) {
+		pan.processRingAudio(bench_input(r, 0, v), bench_input(r, 1, v), r->outs, r->vectorsize);
+	}
+
+	bench_sink = r->outs[0][0];
+}
+
+/********************************************************************************
+void bench_gateplus(t_bench_run *r)
+
+inputs:			r		-- run settings and signals
+description:	nw.gateplus~ with the control toggling every few vectors
+returns:		nothing
+********************************************************************************/
+void bench_gateplus(t_bench_run *r)
+{
+	GatePlus gate;
+	std::vector<double> ctrl(r->vectorsize);
+	long v;
+
+	gate.init();
+
+	for (v = 0; v < r->vectors; v++) {
+		ctrl.assign(r->vectorsize, (v / 8) % 2 ? 1. : 0.);
+		gate.process(ctrl.data(), bench_input(r, 0, v), r->outs[0], r->outs[1], r->vectorsize);
+	}
+
+	bench_sink = r->outs[0][0];
+}
+
+/********************************************************************************
+void bench_recordplus(t_bench_run *r)
+
+inputs:			r		-- run settings and signals
+description:	nw.recordplus~ recording into a one second buffer
+returns:		nothing
+********************************************************************************/
+void bench_recordplus(t_bench_run *r)
+{
+	RecordPlus rec;
+	long frames = (long)r->samplerate;
+	std::vector<float> tab(frames);
+	std::vector<double> ctrl(r->vectorsize, 1.);
+	long v;
+
+	rec.init();
+	rec.reset(1.0 / frames);
+
+	for (v = 0; v < r->vectors; v++) {
+		rec.process(ctrl.data(), bench_input(r, 0, v), r->outs[0], r->vectorsize,
+			tab.data(), frames, false);
+	}
+
+	bench_sink = tab[frames / 2];
+}
+
+/********************************************************************************
+void bench_phasorshift(t_bench_run *r)
+
+inputs:			r		-- run settings and signals
+description:	nw.phasorshift~ with BENCH_TRAINS outlets
+returns:		nothing
+********************************************************************************/
+void bench_phasorshift(t_bench_run *r)
+{
+	PhasorShift ps;
+	long v;
+
+	ps.init(BENCH_TRAINS);
+	ps.ps_samp_rate = r->samplerate;
+
+	for (v = 0; v < r->vectors; v++) {
+		ps.process(20.0, r->outs, BENCH_TRAINS, r->vectorsize);
+	}
+
+	ps.free();
+	bench_sink = r->outs[BENCH_TRAINS - 1][0];
+}
+
+/********************************************************************************
+void bench_phasorshiftWide(t_bench_run *r)
+
+inputs:			r		-- run settings and signals
+description:	nw.phasorshift~ with BENCH_OUTLETS outlets, as when driving a
+		bank of grain objects
+returns:		nothing
+********************************************************************************/
+void bench_phasorshiftWide(t_bench_run *r)
+{
+	PhasorShift ps;
+	long v;
+
+	ps.init(BENCH_OUTLETS);
+	ps.ps_samp_rate = r->samplerate;
+
+	for (v = 0; v < r->vectors; v++) {
+		ps.process(20.0, r->outs, BENCH_OUTLETS, r->vectorsize);
+	}
+
+	ps.free();
+	bench_sink = r->outs[BENCH_OUTLETS - 1][0];
+}
+
+/********************************************************************************
+void bench_phasorshiftBank(t_bench_run *r)
+
+inputs:			r		-- run settings and signals
+description:	nw.phasorshift~ @multichannel 1 with BENCH_BANK phasors
+returns:		nothing
+********************************************************************************/
+void bench_phasorshiftBank(t_bench_run *r)
+{
+	PhasorShift ps;
+	long v;
+
+	ps.init(BENCH_BANK);
+	ps.ps_samp_rate = r->samplerate;
+
+	for (v = 0; v < r->vectors; v++) {
+		ps.process(20.0, r->outs, BENCH_BANK, r->vectorsize);
+	}
+
+	ps.free();
+	bench_sink = r->outs[BENCH_BANK - 1][0];
+}
+
+/********************************************************************************
+void bench_phasorshiftAudio(t_bench_run *r)
+
+inputs:			r		-- run settings and signals
+description:	nw.phasorshift~ with BENCH_TRAINS outlets and the frequency
+		read from a signal
+returns:		nothing
+********************************************************************************/
+void bench_phasorshiftAudio(t_bench_run *r)
+{
+	PhasorShift ps;
+	std::vector<double> freq(r->vectorsize);
+	const double *in;
+	long v, k;
+
+	ps.init(BENCH_TRAINS);
+	ps.ps_samp_rate = r->samplerate;
+
+	for (v = 0; v < r->vectors; v++) {
+		in = bench_input(r, 0, v);
+		for (k = 0; k < r->vectorsize; k++)
+			freq[k] = 20.0 + 10.0 * in[k];
+		ps.processAudio(freq.data(), r->outs, BENCH_TRAINS, r->vectorsize);
+	}
+
+	ps.free();
+	bench_sink = r->outs[BENCH_TRAINS - 1][0];
+}
+
+/********************************************************************************
+void bench_phasorshiftClock(t_bench_run *r)
+
+inputs:			r		-- run settings and signals
+description:	nw.phasorshift~ and nw.trainshift~ with BENCH_TRAINS outlets
+		each, following one clock; halfway through, two more nw.phasorshift~
+		join it, one before and one after the first in the signal chain, and
+		every vector after that each must match the first sample for sample
+returns:		nothing
+********************************************************************************/
+void bench_phasorshiftClock(t_bench_run *r)
+{
+	t_nw_clock clock;
+	PhasorShift ps, before, after;
+	TrainShift ts;
+	double **outs = r->outs;
+	long joined = r->vectors / 2;
+	long v, m, k;
+
+	nw_clock_init(&clock);
+	ps.init(BENCH_TRAINS);
+	before.init(BENCH_TRAINS);
+	after.init(BENCH_TRAINS);
+	ts.init(BENCH_TRAINS, r->samplerate);
+	ps.ps_samp_rate = before.ps_samp_rate = after.ps_samp_rate = r->samplerate;
+
+	// as dsp64 does, every object in the chain is told which chain it is in
+	ps.ps_clock.reset(r);
+	before.ps_clock.reset(r);
+	after.ps_clock.reset(r);
+	ts.ts_clock.reset(r);
+	ps.ps_clock.ask(&clock);
+	ts.ts_clock.ask(&clock);
+
+	for (v = 0; v < r->vectors; v++) {
+		if (v == joined) {
+			before.ps_clock.ask(&clock);
+			after.ps_clock.ask(&clock);
+		}
+		before.process(20.0, outs + BENCH_TRAINS * 2, BENCH_TRAINS, r->vectorsize);
+		ps.process(20.0, outs, BENCH_TRAINS, r->vectorsize);
+		ts.process(50.0, 0.5, outs + BENCH_TRAINS, BENCH_TRAINS, r->vectorsize);
+		after.process(20.0, outs + BENCH_TRAINS * 3, BENCH_TRAINS, r->vectorsize);
+
+		if (v < joined) continue;
+		for (m = 0; m < BENCH_TRAINS; m++) {
+			for (k = 0; k < r->vectorsize; k++) {
+				if (outs[BENCH_TRAINS * 2 + m][k] != outs[m][k]
+					|| outs[BENCH_TRAINS * 3 + m][k] != outs[m][k]) {
+					fprintf(stderr, "shift clock: members out of step at vector %ld\n", v);
+					bench_failed = true;
+					v = r->vectors;
+					m = BENCH_TRAINS;
+					break;
+				}
+			}
+		}
+	}
+
+	ps.free();
+	before.free();
+	after.free();
+	ts.free();
+	bench_sink = outs[BENCH_TRAINS - 1][0] + outs[2 * BENCH_TRAINS - 1][0];
+}
+
+/********************************************************************************
+void bench_trainshift(t_bench_run *r)
+
+inputs:			r		-- run settings and signals
+description:	nw.trainshift~ with BENCH_TRAINS outlets
+returns:		nothing
+********************************************************************************/
+void bench_trainshift(t_bench_run *r)
+{
+	TrainShift ts;
+	long v;
+
+	ts.init(BENCH_TRAINS, r->samplerate);
+
+	for (v = 0; v < r->vectors; v++) {
+		ts.process(50.0, 0.5, r->outs, BENCH_TRAINS, r->vectorsize);
+	}
+
+	ts.free();
+	bench_sink = r->outs[BENCH_TRAINS - 1][0];
+}
+
+/********************************************************************************
+void bench_trainshiftBlep(t_bench_run *r)
+
+inputs:			r		-- run settings and signals
+description:	nw.trainshift~ with BENCH_TRAINS outlets and band-limited edges
+returns:		nothing
+********************************************************************************/
+void bench_trainshiftBlep(t_bench_run *r)
+{
+	TrainShift ts;
+	long v;
+
+	ts.init(BENCH_TRAINS, r->samplerate);
+	ts.ts_blep = true;
+
+	for (v = 0; v < r->vectors; v++) {
+		ts.process(50.0, 0.5, r->outs, BENCH_TRAINS, r->vectorsize);
+	}
+
+	ts.free();
+	bench_sink = r->outs[BENCH_TRAINS - 1][0];
+}
+
+/********************************************************************************
+void bench_trainshiftAudio(t_bench_run *r)
+
+inputs:			r		-- run settings and signals
+description:	nw.trainshift~ with BENCH_TRAINS outlets and the interval and
+		width read from signals
+returns:		nothing
+********************************************************************************/
+void bench_trainshiftAudio(t_bench_run *r)
+{
+	TrainShift ts;
+	std::vector<double> length(r->vectorsize);
+	std::vector<double> width(r->vectorsize);
+	const double *in;
+	long v, k;
+
+	ts.init(BENCH_TRAINS, r->samplerate);
+
+	for (v = 0; v < r->vectors; v++) {
+		in = bench_input(r, 0, v);
+		for (k = 0; k < r->vectorsize; k++) {
+			length[k] = 50.0 + 20.0 * in[k];
+			width[k] = 0.5 + 0.25 * in[k];
+		}
+		ts.processAudio(length.data(), width.data(), r->outs, BENCH_TRAINS, r->vectorsize);
+	}
+
+	ts.free();
+	bench_sink = r->outs[BENCH_TRAINS - 1][0];
+}
+
+/********************************************************************************
+int main(int argc, char **argv)
+
+inputs:			argc, argv	-- see usage at the top of this file
+description:	runs every engine at every vector size and sample rate
+returns:		0, or 1 on a bad argument or a failed check
+********************************************************************************/
+int main(int argc, char **argv)
+{
+	static const struct { const char *name; t_bench_engine fn; } engines[] = {
+		{ "grainvoice x32",		bench_grains },
+		{ "hanning grains x32",	bench_grainsHanning },
+		{ "sinc grains x32",	bench_grainsSinc },
+		{ "8x grains x32",		bench_grainsHigh },
+		{ "pyramid grains x32",	bench_grainsPyramid },
+		{ "gverb",				bench_gverb },
+		{ "cppan control",		bench_cppanControl },
+		{ "cppan audio",		bench_cppanAudio },
+		{ "cppan ring x8",		bench_cppanRing },
+		{ "gateplus",			bench_gateplus },
+		{ "recordplus",			bench_recordplus },
+		{ "phasorshift x8",		bench_phasorshift },
+		{ "phasorshift x64",	bench_phasorshiftWide },
+		{ "phasorshift x256",	bench_phasorshiftBank },
+		{ "phasorshift fm x8",	bench_phasorshiftAudio },
+		{ "shift clock x8",	bench_phasorshiftClock },
+		{ "trainshift x8",		bench_trainshift },
+		{ "trainshift blep x8",	bench_trainshiftBlep },
+		{ "trainshift fm x8",	bench_trainshiftAudio },
+	};
+	double vectorsizes[BENCH_LIST_MAX] = { 64 };
+	double samplerates[BENCH_LIST_MAX] = { 44100 };
+	long vs_count = 1, sr_count = 1;
+	double seconds = 2.;
+	long a, s, e, m, k;
+
+	for (a = 1; a < argc; a++) {
+		if (!strcmp(argv[a], "-v") && a + 1 < argc) {
+			vs_count = bench_parseList(argv[++a], vectorsizes);
+		} else if (!strcmp(argv[a], "-r") && a + 1 < argc) {
+			sr_count = bench_parseList(argv[++a], samplerates);
+		} else if (!strcmp(argv[a], "-s") && a + 1 < argc) {
+			seconds = strtod(argv[++a], NULL);
+		} else {
+			vs_count = 0;
+		}
+
+		if (vs_count == 0 || sr_count == 0 || !(seconds > 0.)) {
+			fprintf(stderr, "usage: %s [-v vectorsizes] [-r samplerates] [-s seconds]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	printf("%-18s %8s %6s %12s\n", "engine", "sr", "vs", "ns/sample");
+	snd_pyramid.init();
+
+	for (s = 0; s < sr_count; s++) {
+		bench_fillTables(samplerates[s]);
+
+		for (m = 0; m < vs_count; m++) {
+			t_bench_run r;
+
+			r.vectorsize = (long)vectorsizes[m];
+			r.samplerate = samplerates[s];
+			r.vectors = (long)(seconds * r.samplerate / r.vectorsize) + 1;
+			bench_fillInputs(&r);
+			for (k = 0; k < BENCH_BANK; k++) {
+				r.out[k].assign(r.vectorsize, 0.);
+				r.outs[k] = r.out[k].data();
+			}
+
+			for (e = 0; e < (long)(sizeof(engines) / sizeof(engines[0])); e++) {
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				engines[e].fn(&r);
+				std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+				printf("%-18s %8.0f %6ld %12.3f\n", engines[e].name, r.samplerate, r.vectorsize,
+					elapsed.count() / ((double)r.vectors * r.vectorsize));
+			}
+		}
+	}
+
+	snd_pyramid.free();
+	return bench_failed ? 1 : 0;
+}
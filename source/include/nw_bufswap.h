@@ -0,0 +1,144 @@
+/*
+** nw_bufswap.h
+**
+** header file
+** hands a newly linked buffer~ from the message thread to the perform routine
+** without a lock, together with the values the perform routine would
+** otherwise ask the buffer~ for at every grain; the same swap hands over any
+** other small value set by a message, like a window shape
+**
+** the buffer reference is carried as a plain pointer so that this header
+** stays free of any Max API calls; the owner fills in the values
+**
+** Max allocates objects without running constructors, so a swap held in an
+** object struct is emptied by init() rather than by a constructor
+**
+** Copyright © 2015 by Nathan Wolek
+** License: http://opensource.org/licenses/BSD-3-Clause
+**
+*/
+
+#ifndef __NW_BUFSWAP
+#define __NW_BUFSWAP
+
+#include <atomic>
+
+#define NW_BUFSWAP_FRESH	4		// set on the shared slot until it is taken
+
+/* what an object knows about one buffer~; ref is NULL until one is linked */
+typedef struct _nw_bufinfo
+{
+	void *ref;			// t_buffer_ref of the owning object
+	long frames;
+	long chans;
+	double sr;			// samples per second
+	double msr;			// samples per millisecond
+	long modtime;		// buffer~ modification time the values were read at
+} t_nw_bufinfo;
+
+/********************************************************************************
+void nw_bufinfo_set(t_nw_bufinfo *info, void *ref, long frames, long chans,
+		double sr, long modtime)
+
+inputs:			info		-- values to fill in
+				ref			-- buffer reference the values belong to
+				frames		-- frames in the buffer~
+				chans		-- channels in the buffer~
+				sr			-- sample rate of the buffer~
+				modtime		-- modification time of the buffer~
+description:	fills in info, working out the values derived from the others
+returns:		nothing
+********************************************************************************/
+inline void nw_bufinfo_set(t_nw_bufinfo *info, void *ref, long frames, long chans, double sr, long modtime)
+{
+	info->ref = ref;
+	info->frames = frames;
+	info->chans = chans;
+	info->sr = sr;
+	info->msr = sr * 0.001;
+	info->modtime = modtime;
+}
+
+/********************************************************************************
+template <class T> class NwSwap
+
+description:	a single pending value passed from one message thread to the
+		perform routine; three slots are shared so that neither side ever
+		waits: the poster fills its own slot and exchanges it for the shared
+		one with a release, the perform routine exchanges its own slot for the
+		shared one with an acquire when the shared one is marked fresh; a
+		value posted twice before the perform routine looks is only seen
+		once, as the later of the two; T is copied by assignment
+********************************************************************************/
+template <class T>
+class NwSwap
+{
+public:
+	void init(void);
+	// message thread
+	void post(const T &value);
+	// perform routine
+	bool take(T *value);
+
+private:
+	T slots[3];
+	std::atomic<long> shared;	// slot index, plus NW_BUFSWAP_FRESH
+	long back;					// slot filled by post()
+	long front;					// slot last read by take()
+};
+
+/* a linked buffer~ and the values read from it */
+typedef NwSwap<t_nw_bufinfo> NwBufSwap;
+
+/********************************************************************************
+void NwSwap::init(void)
+
+inputs:			nothing
+description:	empties the swap; only call while neither side is running
+returns:		nothing
+********************************************************************************/
+template <class T>
+inline void NwSwap<T>::init(void)
+{
+	long a;
+
+	for (a = 0; a < 3; a++)
+		slots[a] = T();
+	back = 0;
+	shared.store(1, std::memory_order_relaxed);
+	front = 2;
+}
+
+/********************************************************************************
+void NwSwap::post(const T &value)
+
+inputs:			value		-- value for the perform routine to take
+description:	message thread side; replaces any value not taken yet
+returns:		nothing
+********************************************************************************/
+template <class T>
+inline void NwSwap<T>::post(const T &value)
+{
+	slots[back] = value;
+	back = shared.exchange(back | NW_BUFSWAP_FRESH, std::memory_order_acq_rel) & ~NW_BUFSWAP_FRESH;
+}
+
+/********************************************************************************
+bool NwSwap::take(T *value)
+
+inputs:			value		-- receives the value posted last
+description:	perform routine side; takes the value posted since the last call
+returns:		true if one was posted, otherwise value is left alone
+********************************************************************************/
+template <class T>
+inline bool NwSwap<T>::take(T *value)
+{
+	if (!(shared.load(std::memory_order_relaxed) & NW_BUFSWAP_FRESH))
+		return false;
+
+	front = shared.exchange(front, std::memory_order_acq_rel) & ~NW_BUFSWAP_FRESH;
+	*value = slots[front];
+	return true;
+}
+
+#endif /* __NW_BUFSWAP */
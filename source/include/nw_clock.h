@@ -0,0 +1,313 @@
+/*
+** nw_clock.h
+**
+** header file
+** a shared count of samples that several objects can derive their phases
+** from, so that phasors and pulse trains in different objects, or in
+** different externals, stay exactly together however long they run
+**
+** the clock is a count of samples, moved on once per signal vector by
+** whichever member starts that vector first; each member then works out its
+** phase from the count instead of adding up steps, so nothing builds up over
+** days of running
+**
+** every member counts the vectors it has started since its signal chain was
+** built, so members of one chain agree on which vector they are in; the clock
+** keeps the number of the vector it was last moved on for in the same word
+** as the count, so a member knows whether this vector has moved it yet
+** wherever it sits in the chain, and one that joins late lines up at once
+**
+** this header stays free of any Max API calls; the owner finds a clock by
+** name through nw_clockreg_find() in nw_clockreg.h, which every external
+** loaded shares; clocks are never freed, so the perform routine can hold on
+** to one without reference counting
+**
+** members must run in the same signal chain, at the same vector size; one
+** that misses vectors (muted, or in a poly~ that is switched off) falls back
+** in with the clock's vector when it comes back, but if it sits before the
+** member moving the clock it stays a vector behind until the chain is built
+** again
+**
+** Max allocates objects without running constructors, so a member held in
+** an object struct is emptied by init() rather than by a constructor
+**
+** Copyright © 2015 by Nathan Wolek
+** License: http://opensource.org/licenses/BSD-3-Clause
+**
+*/
+
+#ifndef __NW_CLOCK
+#define __NW_CLOCK
+
+#include <math.h>
+#include <atomic>
+
+#define NW_CLOCK_MAGIC		0x6e77636dL		// set in every clock, bumped if its layout changes
+
+#define NW_CLOCK_COUNT_BITS	48				// count of samples, over 20 years at 384 kHz
+#define NW_CLOCK_COUNT_MASK	((1LL << NW_CLOCK_COUNT_BITS) - 1)
+#define NW_CLOCK_VECTOR_MASK	0xffffL		// vectors are told apart by their low 16 bits
+
+/* one clock, shared by every member following it */
+typedef struct _nw_clock
+{
+	long magic;							// NW_CLOCK_MAGIC
+	std::atomic<long long> state;		// vector it was last moved on for, above the count
+	std::atomic<void *> chain;			// signal chain of the members moving it on
+} t_nw_clock;
+
+/********************************************************************************
+long long nw_clock_count(long long state)
+
+inputs:			state		-- state of a clock
+description:	takes the count of samples out of a clock's state
+returns:		the count the latest vector started at
+********************************************************************************/
+inline long long nw_clock_count(long long state)
+{
+	return state & NW_CLOCK_COUNT_MASK;
+}
+
+/********************************************************************************
+long nw_clock_vector(long long state)
+
+inputs:			state		-- state of a clock
+description:	takes the vector number out of a clock's state
+returns:		the vector the clock was last moved on for
+********************************************************************************/
+inline long nw_clock_vector(long long state)
+{
+	return (long)((unsigned long long)state >> NW_CLOCK_COUNT_BITS);
+}
+
+/********************************************************************************
+long long nw_clock_state(long vector, long long count)
+
+inputs:			vector		-- vector number, of which the low 16 bits are kept
+				count		-- count of samples
+description:	packs a clock's state
+returns:		the state
+********************************************************************************/
+inline long long nw_clock_state(long vector, long long count)
+{
+	return (long long)(((unsigned long long)(vector & NW_CLOCK_VECTOR_MASK) << NW_CLOCK_COUNT_BITS)
+		| (unsigned long long)(count & NW_CLOCK_COUNT_MASK));
+}
+
+/********************************************************************************
+void nw_clock_init(t_nw_clock *clock)
+
+inputs:			clock		-- memory for a new clock
+description:	marks a clock as one and starts its count at zero, followed by no
+		signal chain
+returns:		nothing
+********************************************************************************/
+inline void nw_clock_init(t_nw_clock *clock)
+{
+	clock->magic = NW_CLOCK_MAGIC;
+	clock->chain.store(0, std::memory_order_relaxed);
+	clock->state.store(0, std::memory_order_release);
+}
+
+/********************************************************************************
+double nw_clock_frac(double x)
+
+inputs:			x		-- phase
+description:	wraps a phase into 0 to 1; a tiny negative phase whose fraction
+		rounds up to 1 is taken as 0
+returns:		the wrapped phase
+********************************************************************************/
+inline double nw_clock_frac(double x)
+{
+	x -= floor(x);
+	return (x < 1.0) ? x : 0.0;
+}
+
+/********************************************************************************
+class NwClockMember
+
+description:	what one object keeps about the clock it follows; the owner
+		asks for a clock from the message thread and the perform routine takes
+		it at the start of its next vector; the phase travelled is anchored at
+		the count where the step last changed, so a member given the same steps
+		as another from the same count is at exactly the same phase
+********************************************************************************/
+class NwClockMember
+{
+public:
+	void init(void);
+	// message thread
+	void ask(t_nw_clock *clock);
+	// dsp64, while the perform routine is not running
+	void reset(void *chain);
+	// perform routine
+	bool start(long n, long long *t);
+	double phase(double step, long long t);
+	void move(long long t, double base, double step);
+
+private:
+	std::atomic<t_nw_clock *> m_ask;	// clock asked for, NULL to run free
+	std::atomic<long> m_asked;			// bumped each time one is asked for
+	long m_seen;						// m_asked when it was last taken
+	t_nw_clock *m_clock;				// clock followed by the perform routine
+	void *m_chain;						// signal chain this member was last built into
+	long m_vector;						// vectors started since then, low 16 bits
+	long long m_anchor;					// count m_base was taken at
+	double m_base;						// phase travelled at m_anchor
+	double m_step;						// phase per sample since m_anchor
+	bool m_fresh;						// m_step is set by the next phase()
+};
+
+/********************************************************************************
+void NwClockMember::init(void)
+
+inputs:			nothing
+description:	empties the member, following no clock
+returns:		nothing
+********************************************************************************/
+inline void NwClockMember::init(void)
+{
+	m_ask.store(0, std::memory_order_relaxed);
+	m_asked.store(0, std::memory_order_release);
+	m_seen = 0;
+	m_clock = 0;
+	reset(0);
+}
+
+/********************************************************************************
+void NwClockMember::ask(t_nw_clock *clock)
+
+inputs:			clock		-- clock to follow, or NULL to run free
+description:	hands a clock to the perform routine; asking for the clock
+		already followed joins it again, back in step with its origin
+returns:		nothing
+********************************************************************************/
+inline void NwClockMember::ask(t_nw_clock *clock)
+{
+	m_ask.store(clock, std::memory_order_relaxed);
+	m_asked.fetch_add(1, std::memory_order_release);
+}
+
+/********************************************************************************
+void NwClockMember::reset(void *chain)
+
+inputs:			chain		-- signal chain being built, the same for every member
+						built with it
+description:	starts counting vectors for a new signal chain and takes the
+		phase from the clock's origin again, so that members in step with it
+		when audio is turned on start from its origin together
+returns:		nothing
+********************************************************************************/
+inline void NwClockMember::reset(void *chain)
+{
+	m_chain = chain;
+	m_vector = 0;
+	m_anchor = 0;
+	m_base = 0.0;
+	m_step = 0.0;
+	m_fresh = true;
+}
+
+/********************************************************************************
+bool NwClockMember::start(long n, long long *t)
+
+inputs:			n		-- samples in the vector about to be rendered
+				t		-- where to put the count the vector starts at
+description:	takes a clock asked for since the last vector; the first member
+		to start a vector moves the clock on by n and marks it with the vector,
+		the others find it marked and start where it was moved to; the first
+		member of a newly built signal chain takes the clock over, and a member
+		out of step with the clock's vector falls in with it
+returns:		false if no clock is followed
+********************************************************************************/
+inline bool NwClockMember::start(long n, long long *t)
+{
+	long asked = m_asked.load(std::memory_order_acquire);
+	long long state, next;
+	long vector, marked;
+	void *chain;
+
+	// every vector is counted, so that a member joining later agrees on it
+	vector = m_vector = (m_vector + 1) & NW_CLOCK_VECTOR_MASK;
+
+	if (asked != m_seen) {
+		m_seen = asked;
+		m_clock = m_ask.load(std::memory_order_relaxed);
+		m_anchor = 0;
+		m_base = 0.0;
+		m_step = 0.0;
+		m_fresh = true;
+	}
+	if (!m_clock)
+		return false;
+
+	state = m_clock->state.load(std::memory_order_acquire);
+
+	// the chain was built again, or this member is the first of another
+	chain = m_clock->chain.load(std::memory_order_acquire);
+	if (chain != m_chain
+		&& m_clock->chain.compare_exchange_strong(chain, m_chain, std::memory_order_acq_rel)) {
+		do {
+			next = nw_clock_state(vector, nw_clock_count(state) + n);
+		} while (!m_clock->state.compare_exchange_weak(state, next, std::memory_order_acq_rel));
+		*t = nw_clock_count(next);
+		return true;
+	}
+
+	for (;;) {
+		marked = nw_clock_vector(state);
+		if (marked == vector)
+			break;								// already moved on for this vector
+		if (marked != ((vector - 1) & NW_CLOCK_VECTOR_MASK)) {
+			m_vector = marked;					// out of step, fall in with the clock
+			break;
+		}
+		// a failed exchange leaves state where another member moved it
+		next = nw_clock_state(vector, nw_clock_count(state) + n);
+		if (m_clock->state.compare_exchange_weak(state, next, std::memory_order_acq_rel)) {
+			state = next;
+			break;
+		}
+	}
+	*t = nw_clock_count(state);
+	return true;
+}
+
+/********************************************************************************
+double NwClockMember::phase(double step, long long t)
+
+inputs:			step	-- phase per sample from t on
+				t		-- count
+description:	works out the phase travelled at t from the clock's count; a
+		new step is anchored at t, the first step after joining at the origin
+returns:		the phase travelled, 0 to 1
+********************************************************************************/
+inline double NwClockMember::phase(double step, long long t)
+{
+	if (m_fresh) {
+		m_step = step;
+		m_fresh = false;
+	} else if (step != m_step) {
+		move(t, m_base + m_step * (double)(t - m_anchor), step);
+	}
+	return nw_clock_frac(m_base + m_step * (double)(t - m_anchor));
+}
+
+/********************************************************************************
+void NwClockMember::move(long long t, double base, double step)
+
+inputs:			t		-- count to anchor at
+				base	-- phase travelled at t
+				step	-- phase per sample from t on
+description:	anchors the phase where a signal leaves the step it was at
+returns:		nothing
+********************************************************************************/
+inline void NwClockMember::move(long long t, double base, double step)
+{
+	m_anchor = t;
+	m_base = nw_clock_frac(base);
+	m_step = step;
+	m_fresh = false;
+}
+
+#endif /* __NW_CLOCK */
@@ -0,0 +1,111 @@
+/*
+** nw_clockreg.h
+**
+** header file
+** the Max side of nw_clock.h, shared by nw.phasorshift~ and nw.trainshift~;
+** unlike the other headers here it calls the Max API, so include it after
+** c74_msp.h
+**
+** each clock lives in a small nobox object of class NW_CLOCKREG_CLASS,
+** registered with Max under NW_CLOCKREG_NAMESPACE by the name of the clock,
+** so every external loaded finds the same one; the first external to ask
+** makes the class and the rest find it by name; clocks are never freed, so
+** the perform routine can hold on to one without reference counting
+**
+** Copyright © 2015 by Nathan Wolek
+** License: http://opensource.org/licenses/BSD-3-Clause
+**
+*/
+
+#ifndef __NW_CLOCKREG
+#define __NW_CLOCKREG
+
+#include "nw_clock.h"
+
+#define NW_CLOCKREG_CLASS		"nw.clock"		// nobox class holding one clock
+#define NW_CLOCKREG_NAMESPACE	"nw.clock"		// registry namespace clocks are named in
+
+/* the object a clock is registered as */
+typedef struct _nw_clockreg
+{
+	c74::max::t_object	cr_obj;
+	t_nw_clock			cr_clock;
+} t_nw_clockreg;
+
+/********************************************************************************
+void *nw_clockreg_new(void)
+
+inputs:			nothing
+description:	called by object_new() for each clock made
+returns:		the clock object, or NULL if it could not be allocated
+********************************************************************************/
+inline void *nw_clockreg_new(void)
+{
+	using namespace c74::max;
+	t_nw_clockreg *x;
+
+	x = (t_nw_clockreg *)object_alloc(class_findbyname(CLASS_NOBOX, gensym(NW_CLOCKREG_CLASS)));
+	if (x)
+		nw_clock_init(&x->cr_clock);
+	return x;
+}
+
+/********************************************************************************
+bool nw_clockreg_setup(void)
+
+inputs:			nothing
+description:	makes and registers the clock class, unless an external loaded
+		before has already done so
+returns:		false if the class could not be made
+********************************************************************************/
+inline bool nw_clockreg_setup(void)
+{
+	using namespace c74::max;
+	t_class *c;
+
+	if (class_findbyname(CLASS_NOBOX, gensym(NW_CLOCKREG_CLASS)))
+		return true;
+
+	c = class_new(NW_CLOCKREG_CLASS, (method)nw_clockreg_new, (method)NULL, sizeof(t_nw_clockreg), 0L, 0);
+	if (!c)
+		return false;
+	class_register(CLASS_NOBOX, c);
+	return true;
+}
+
+/********************************************************************************
+t_nw_clock *nw_clockreg_find(t_symbol *name)
+
+inputs:			name	-- name of the clock
+description:	finds the clock registered under the name, making it the first
+		time it is asked for; an object registered under the name by some
+		other class, or by an external with a different clock layout, is not
+		a clock
+returns:		the clock, or NULL if it could not be found or made
+********************************************************************************/
+inline t_nw_clock *nw_clockreg_find(c74::max::t_symbol *name)
+{
+	using namespace c74::max;
+	t_symbol *space = gensym(NW_CLOCKREG_NAMESPACE);
+	t_object *o;
+	t_nw_clockreg *x;
+
+	o = (t_object *)object_findregistered(space, name);
+	if (!o) {
+		if (!nw_clockreg_setup())
+			return NULL;
+		o = (t_object *)object_new(CLASS_NOBOX, gensym(NW_CLOCKREG_CLASS));
+		if (!o)
+			return NULL;
+		o = (t_object *)object_register(space, name, o);	// may hand back another object
+		if (!o)
+			return NULL;
+	}
+
+	if (object_classname(o) != gensym(NW_CLOCKREG_CLASS))
+		return NULL;
+	x = (t_nw_clockreg *)o;
+	return (x->cr_clock.magic == NW_CLOCK_MAGIC) ? &x->cr_clock : NULL;
+}
+
+#endif /* __NW_CLOCKREG */
@@ -0,0 +1,513 @@
+/*
+** nw_grainvoice.h
+**
+** header file
+** a single grain voice, free of any Max API calls, shared by the grain objects
+** that start whole grains on a trigger (nw.grainbang~, nw.grainpulse~) and by
+** the nw_bench profiling target
+**
+** Max allocates objects without running constructors, so a GrainVoice held
+** in an object struct is set up by start() rather than by a constructor
+**
+** each voice plays through a kernel instantiated for its interpolation modes,
+** direction and sound channels; a kernel renders a run of samples, and picks
+** the loop for where the window is read from and whether sound reads wrap once
+** for the whole run, so the per-sample loop tests none of them; the owner keeps
+** the kernels for its modes from nw_grain_kernels() and hands them to each
+** voice it starts
+**
+** Copyright © 2002,2015 by Nathan Wolek
+** License: http://opensource.org/licenses/BSD-3-Clause
+**
+*/
+
+#ifndef __NW_GRAINVOICE
+#define __NW_GRAINVOICE
+
+#include "nw_interp.h"
+#include "nw_pyramid.h"
+#include "nw_window.h"
+
+/* for direction flag */
+#define NW_GRAIN_FORWARD		0
+#define NW_GRAIN_REVERSE		1
+
+/* where a voice reads its window, fixed for a run of samples */
+#define NW_GRAIN_WIN_BUFFER		0	// interpolates the window buffer
+#define NW_GRAIN_WIN_TABLE		1	// window resampled to the grain length
+#define NW_GRAIN_WIN_COSINE		2	// analytic window of each family, see NwWindowGen
+#define NW_GRAIN_WIN_GAUSS		3
+#define NW_GRAIN_WIN_RAMP		4
+
+/* run() for one set of options, see nw_grain_kernel() */
+class GrainVoice;
+typedef bool (*t_nw_grain_kernel)(GrainVoice *v, const float *tab_s, long size_s, long chan_s,
+	const float *tab_w, long size_w, double *out1, double *out2, long len);
+
+/* the kernels for one pair of interpolation modes */
+typedef struct _nw_grain_kernels
+{
+	t_nw_grain_kernel kernel[2][2];		// by grain direction, then mono or stereo
+} t_nw_grain_kernels;
+
+class GrainVoice
+{
+public:
+	// current grain info
+	double grain_pos_start;	// in samples
+	double grain_length;	// in milliseconds
+	double grain_pitch;		// as multiplier
+	double grain_gain;		// linear gain mult
+	double grain_sound_length;	// in milliseconds
+	double win_step_size;	// in samples
+	double snd_step_size;	// in samples
+	double snd_step_unit;	// snd_step_size at a pitch of 1
+	double curr_win_pos;	// in samples
+	double curr_snd_pos;	// in samples
+	short grain_direction;	// forward or reverse
+	short snd_wraps;		// grain reads near the ends of the sound buffer
+	short modulated;		// gain and pitch follow the inlets, see setPitch()
+	const t_nw_sinc_filter *snd_sinc;	// filter for the sinc kernel, see nw_sinc.h
+	// decimated sound, see nw_pyramid.h; positions and step are in its frames
+	const float *snd_tab;
+	long snd_tab_frames;
+	long snd_level;
+	// window resampled to the grain length, see nw_wincache.h
+	const float *win_table;
+	long win_table_length;
+	long win_table_index;
+	// analytic window, see nw_window.h; reads the window buffer if NW_WINDOW_BUFFER
+	NwWindowGen win_gen;
+	// grain tracking info
+	long curr_count_samp;
+	t_nw_grain_kernel kernel;	// kernel playing, see useKernels()
+
+	void start(double pos_start, double length, double pitch, double gain, short direction,
+		double snd_sr, double snd_msr, long snd_frames, long win_frames, double output_sr);
+	void useLevel(NwPyramid *pyramid, double snd_msr);
+	void dropLevel(void);
+	void useSinc(const t_nw_sinc *sinc);
+	NW_FORCEINLINE void setPitch(double pitch);
+	void useTable(const float *table, long length, long win_frames);
+	void startWindow(const t_nw_window *w, long win_frames);
+	void useKernels(const t_nw_grain_kernels *kernels, long chan_s);
+	NW_FORCEINLINE bool play(const float *tab_s, long size_s, long chan_s, const float *tab_w,
+		long size_w, double *out1, double *out2, long len);
+	template <int InterpS, int InterpW, short Direction, int Chans, class Wrap, int Window>
+	bool run(const float *tab_s, long size_s, long chan_s, const float *tab_w,
+		long size_w, double *out1, double *out2, long len);
+};
+
+/********************************************************************************
+void GrainVoice::start(double pos_start, double length, double pitch, double gain,
+		short direction, double snd_sr, double snd_msr, long snd_frames,
+		long win_frames, double output_sr)
+
+inputs:			pos_start		-- offset within sound buffer, in milliseconds
+				length			-- length of grain, in milliseconds
+				pitch			-- sample playback speed, 1 = normal
+				gain			-- scales gain output, 1 = no change
+				direction		-- NW_GRAIN_FORWARD or NW_GRAIN_REVERSE
+				snd_sr			-- sample rate of the sound buffer
+				snd_msr			-- samples per millisecond of the sound buffer
+				snd_frames		-- frames in the sound buffer
+				win_frames		-- frames in the window buffer
+				output_sr		-- output sample rate
+description:	computes step sizes and start positions for a new grain; the
+		first sample played moves onto the first sample of the grain;
+		call useKernels() before the grain is played
+returns:		nothing
+********************************************************************************/
+inline void GrainVoice::start(double pos_start, double length, double pitch, double gain, short direction,
+	double snd_sr, double snd_msr, long snd_frames, long win_frames, double output_sr)
+{
+	grain_length = length;
+	grain_pitch = pitch;
+	grain_gain = gain;
+
+	// compute amount of sound file for grain
+	grain_sound_length = grain_length * grain_pitch;
+	if (grain_sound_length < 0.) grain_sound_length *= -1.; // needs to be positive to prevent buffer overruns
+
+	// compute window buffer step size per vector sample
+	win_step_size = (double)win_frames / (grain_length * output_sr * 0.001);
+	if (win_step_size < 0.) win_step_size *= -1.; // needs to be positive to prevent buffer overruns
+
+	// compute sound buffer step size per vector sample
+	snd_step_size = grain_pitch * snd_sr * (1.0 / output_sr);
+	snd_step_unit = snd_sr * (1.0 / output_sr);
+
+	grain_direction = direction;
+
+	if (grain_direction == NW_GRAIN_FORWARD) {	// if forward...
+		grain_pos_start = pos_start * snd_msr;
+		curr_snd_pos = grain_pos_start - snd_step_size;
+	} else {	// if reverse...
+		grain_pos_start = (pos_start + grain_sound_length) * snd_msr;
+		curr_snd_pos = grain_pos_start + snd_step_size;
+	}
+
+	// grains that stay clear of the buffer ends can skip wrapping in the interpolator
+	snd_wraps = nw_interp_wraps(curr_snd_pos - grain_sound_length * snd_msr,
+		curr_snd_pos + grain_sound_length * snd_msr, snd_frames);
+
+	curr_win_pos = 0.0;
+	modulated = false;
+	snd_sinc = 0;
+	snd_tab = 0;
+	snd_level = 0;
+	win_table = 0;
+	win_gen.type = NW_WINDOW_BUFFER;
+
+	// reset history
+	curr_count_samp = -1;
+}
+
+/********************************************************************************
+void GrainVoice::useLevel(NwPyramid *pyramid, double snd_msr)
+
+inputs:			pyramid			-- decimated copies of the sound
+				snd_msr			-- samples per millisecond of the sound buffer
+description:	moves a grain just started onto the level of the pyramid that
+		brings its sound step down to NW_PYRAMID_STEP, if one is ready; call
+		before useSinc(), so the filter is picked for the reduced step
+returns:		nothing
+********************************************************************************/
+inline void GrainVoice::useLevel(NwPyramid *pyramid, double snd_msr)
+{
+	const t_nw_pyramid_level *level;
+	double scale, span;
+	long k = pyramid->choose(snd_step_size);
+
+	if (!k)
+		return;
+
+	level = pyramid->level(k);
+	scale = 1.0 / (double)(1L << k);
+	curr_snd_pos *= scale;
+	snd_step_size *= scale;
+	snd_step_unit *= scale;
+	snd_tab = level->samples;
+	snd_tab_frames = level->frames;
+	snd_level = k;
+
+	span = grain_sound_length * snd_msr * scale;
+	snd_wraps = nw_interp_wraps(curr_snd_pos - span, curr_snd_pos + span, snd_tab_frames);
+}
+
+/********************************************************************************
+void GrainVoice::dropLevel(void)
+
+inputs:			nothing
+description:	moves a grain back from a level of the pyramid onto the sound
+		buffer itself, at the same place; called when the levels are retired
+returns:		nothing
+********************************************************************************/
+inline void GrainVoice::dropLevel(void)
+{
+	double scale;
+
+	if (!snd_tab)
+		return;
+
+	scale = (double)(1L << snd_level);
+	curr_snd_pos *= scale;
+	snd_step_size *= scale;
+	snd_step_unit *= scale;
+	snd_tab = 0;
+	snd_level = 0;
+	snd_wraps = true;
+}
+
+/********************************************************************************
+void GrainVoice::useSinc(const t_nw_sinc *sinc)
+
+inputs:			sinc			-- sinc tables of the owner, may be NULL
+description:	picks the filter a grain just started reads the sound through
+		when the sinc kernel is chosen, from its sound step; grains without
+		one fall back to lagrange
+returns:		nothing
+********************************************************************************/
+inline void GrainVoice::useSinc(const t_nw_sinc *sinc)
+{
+	snd_sinc = nw_sinc_filter(sinc, snd_step_size);
+}
+
+/********************************************************************************
+void GrainVoice::setPitch(double pitch)
+
+inputs:			pitch			-- sample playback speed, 1 = normal
+description:	changes the speed of a grain already sounding, for grains that
+		read their pitch every sample; the level of the pyramid and the sinc
+		filter picked at the start of the grain are kept, and the caller
+		should have set snd_wraps, as the span checked by start() no longer
+		holds
+returns:		nothing
+********************************************************************************/
+NW_FORCEINLINE void GrainVoice::setPitch(double pitch)
+{
+	grain_pitch = pitch;
+	snd_step_size = pitch * snd_step_unit;
+}
+
+/********************************************************************************
+void GrainVoice::useTable(const float *table, long length, long win_frames)
+
+inputs:			table			-- window resampled to length samples
+				length			-- samples in the table, the grain length quantised
+				win_frames		-- frames in the window buffer
+description:	plays the window of a grain just started from a table instead
+		of the interpolator; the window step is quantised to match, so that
+		dropping the table mid-grain (win_table = 0) carries on from the same
+		place in the buffer
+returns:		nothing
+********************************************************************************/
+inline void GrainVoice::useTable(const float *table, long length, long win_frames)
+{
+	win_table = table;
+	win_table_length = length;
+	win_table_index = 0;
+	win_step_size = (double)win_frames / (double)length;
+}
+
+/********************************************************************************
+void GrainVoice::startWindow(const t_nw_window *w, long win_frames)
+
+inputs:			w				-- analytic shape, or NW_WINDOW_BUFFER
+				win_frames		-- frames the window steps through,
+								   NW_WINDOW_FRAMES for an analytic shape
+description:	plays the window from w, picking up at the current window
+		position, so a grain already sounding can switch shape
+returns:		nothing
+********************************************************************************/
+inline void GrainVoice::startWindow(const t_nw_window *w, long win_frames)
+{
+	win_table = 0;
+	win_gen.start(w, (double)win_frames / win_step_size, curr_win_pos / (double)win_frames);
+}
+
+/********************************************************************************
+void GrainVoice::useKernels(const t_nw_grain_kernels *kernels, long chan_s)
+
+inputs:			kernels			-- kernels for the owner's interpolation modes
+				chan_s			-- channels in the sound buffer
+description:	picks the kernel the grain plays through, by its direction and
+		the channels of the sound; call again for a grain already sounding
+		when the modes or the sound change
+returns:		nothing
+********************************************************************************/
+inline void GrainVoice::useKernels(const t_nw_grain_kernels *kernels, long chan_s)
+{
+	kernel = kernels->kernel[grain_direction != NW_GRAIN_FORWARD][chan_s == 2];
+}
+
+/********************************************************************************
+bool GrainVoice::play(const float *tab_s, long size_s, long chan_s,
+		const float *tab_w, long size_w, double *out1, double *out2, long len)
+
+inputs:			(as run)
+description:	renders up to len samples through the kernel picked by
+		useKernels()
+returns:		false once the grain has reached the end of its window
+********************************************************************************/
+NW_FORCEINLINE bool GrainVoice::play(const float *tab_s, long size_s, long chan_s, const float *tab_w,
+	long size_w, double *out1, double *out2, long len)
+{
+	return kernel(this, tab_s, size_s, chan_s, tab_w, size_w, out1, out2, len);
+}
+
+/********************************************************************************
+bool GrainVoice::run<InterpS, InterpW, Direction, Chans, Wrap, Window>(
+		const float *tab_s, long size_s, long chan_s, const float *tab_w,
+		long size_w, double *out1, double *out2, long len)
+
+inputs:			InterpS			-- NW_INTERP_* mode for the sound buffer
+				InterpW			-- NW_INTERP_* mode for the window buffer
+				Direction		-- NW_GRAIN_FORWARD or NW_GRAIN_REVERSE
+				Chans			-- 2 for a stereo sound, otherwise 1
+				Wrap			-- nw_wrap_loop if snd_wraps, otherwise nw_wrap_none
+				Window			-- NW_GRAIN_WIN_* the window is read from
+				tab_s			-- sound samples, the buffer or a level of the pyramid
+				size_s			-- frames in tab_s
+				chan_s			-- channels in the sound buffer
+				tab_w			-- window buffer samples, mono
+				size_w			-- frames in the window buffer
+				out1			-- left output, added to
+				out2			-- right output, added to
+				len				-- most samples to render
+description:	for every sample, advances the sound index in the grain
+		direction and wraps it into tab_s, reads the sound and window, scales
+		them by the grain gain and adds them to the outputs, then advances the
+		window index; mono sounds are added to both channels; tab_w is only read
+		for NW_GRAIN_WIN_BUFFER
+returns:		false once the grain has reached the end of its window, having
+		rendered its last sample
+********************************************************************************/
+template <int InterpS, int InterpW, short Direction, int Chans, class Wrap, int Window>
+bool GrainVoice::run(const float *tab_s, long size_s, long chan_s, const float *tab_w,
+	long size_w, double *out1, double *out2, long len)
+{
+	const float *table = win_table;
+	const t_nw_sinc_filter *sinc = snd_sinc;
+	double index_s = curr_snd_pos;
+	double index_w = curr_win_pos;
+	double step_s = snd_step_size;
+	double step_w = win_step_size;
+	double gain = grain_gain;
+	double snd_out[2], win_out;
+	long index_t = win_table_index;
+	long length_t = win_table_length;
+	long k = 0;
+	bool sounding = true;
+
+	while (k < len && sounding) {
+		// advance sound index, wrapping it if not within bounds
+		if (Direction == NW_GRAIN_FORWARD) {
+			index_s += step_s;		// addition
+		} else {	// if NW_GRAIN_REVERSE
+			index_s -= step_s;		// subtract
+		}
+		while (index_s < 0.0)
+			index_s += size_s;
+		while (index_s >= size_s)
+			index_s -= size_s;
+
+		// WINDOW OUT
+		if (Window == NW_GRAIN_WIN_TABLE)
+			win_out = table[index_t];
+		else if (Window == NW_GRAIN_WIN_COSINE)
+			win_out = win_gen.next<NW_WINDOW_FAMILY_COSINE>();
+		else if (Window == NW_GRAIN_WIN_GAUSS)
+			win_out = win_gen.next<NW_WINDOW_FAMILY_GAUSS>();
+		else if (Window == NW_GRAIN_WIN_RAMP)
+			win_out = win_gen.next<NW_WINDOW_FAMILY_RAMP>();
+		else
+			nw_interp<1, nw_wrap_loop>(InterpW, tab_w, size_w, 1, index_w, &win_out);
+
+		// SOUND OUT
+		if (Chans == 2) {
+			nw_interp<2, Wrap>(InterpS, tab_s, size_s, chan_s, index_s, snd_out, sinc);
+		} else {
+			nw_interp<1, Wrap>(InterpS, tab_s, size_s, chan_s, index_s, snd_out, sinc);
+			snd_out[1] = snd_out[0];
+		}
+
+		// add snd_out multiplied by win_out by gain value
+		win_out *= gain;
+		out1[k] += snd_out[0] * win_out;
+		out2[k] += snd_out[1] * win_out;
+		++k;
+
+		// advance window index; grains playing a table end on its last sample
+		index_w += step_w;
+		if (Window == NW_GRAIN_WIN_TABLE)
+			sounding = ++index_t < length_t;
+		else
+			sounding = index_w < size_w;
+	}
+
+	curr_snd_pos = index_s;
+	curr_win_pos = index_w;
+	win_table_index = index_t;
+	curr_count_samp += k;
+	return sounding;
+}
+
+/********************************************************************************
+bool nw_grain_window<InterpS, InterpW, Direction, Chans, Wrap>(GrainVoice *v,
+		const float *tab_s, long size_s, long chan_s, const float *tab_w,
+		long size_w, double *out1, double *out2, long len)
+
+inputs:			v				-- voice to play
+				(remaining inputs as GrainVoice::run)
+description:	picks the loop for the window source of the voice, and for an
+		analytic window the loop for its family; InterpW only tells the loops
+		reading the window buffer apart
+returns:		false once the grain has reached the end of its window
+********************************************************************************/
+template <int InterpS, int InterpW, short Direction, int Chans, class Wrap>
+bool nw_grain_window(GrainVoice *v, const float *tab_s, long size_s, long chan_s, const float *tab_w,
+	long size_w, double *out1, double *out2, long len)
+{
+	if (v->win_table)
+		return v->run<InterpS, NW_INTERP_NONE, Direction, Chans, Wrap, NW_GRAIN_WIN_TABLE>(tab_s,
+			size_s, chan_s, tab_w, size_w, out1, out2, len);
+	if (v->win_gen.type != NW_WINDOW_BUFFER) {
+		switch (v->win_gen.family) {
+			case NW_WINDOW_FAMILY_COSINE:
+				return v->run<InterpS, NW_INTERP_NONE, Direction, Chans, Wrap, NW_GRAIN_WIN_COSINE>(tab_s,
+					size_s, chan_s, tab_w, size_w, out1, out2, len);
+			case NW_WINDOW_FAMILY_GAUSS:
+				return v->run<InterpS, NW_INTERP_NONE, Direction, Chans, Wrap, NW_GRAIN_WIN_GAUSS>(tab_s,
+					size_s, chan_s, tab_w, size_w, out1, out2, len);
+			default:	// NW_WINDOW_FAMILY_RAMP
+				return v->run<InterpS, NW_INTERP_NONE, Direction, Chans, Wrap, NW_GRAIN_WIN_RAMP>(tab_s,
+					size_s, chan_s, tab_w, size_w, out1, out2, len);
+		}
+	}
+	return v->run<InterpS, InterpW, Direction, Chans, Wrap, NW_GRAIN_WIN_BUFFER>(tab_s,
+		size_s, chan_s, tab_w, size_w, out1, out2, len);
+}
+
+/********************************************************************************
+bool nw_grain_kernel<InterpS, InterpW, Direction, Chans>(GrainVoice *v,
+		const float *tab_s, long size_s, long chan_s, const float *tab_w,
+		long size_w, double *out1, double *out2, long len)
+
+inputs:			v				-- voice to play
+				(remaining inputs as GrainVoice::run)
+description:	a run of a voice with every option fixed, so the mode switches
+		in nw_interp() fold away; the level of the pyramid, the wrapping of
+		sound reads and the window source are picked here, once for the run,
+		as the perform routine only changes them between vectors
+returns:		false once the grain has reached the end of its window
+********************************************************************************/
+template <int InterpS, int InterpW, short Direction, int Chans>
+bool nw_grain_kernel(GrainVoice *v, const float *tab_s, long size_s, long chan_s, const float *tab_w,
+	long size_w, double *out1, double *out2, long len)
+{
+	if (v->snd_tab) {
+		tab_s = v->snd_tab;
+		size_s = v->snd_tab_frames;
+	}
+	if (v->snd_wraps)
+		return nw_grain_window<InterpS, InterpW, Direction, Chans, nw_wrap_loop>(v, tab_s, size_s,
+			chan_s, tab_w, size_w, out1, out2, len);
+	return nw_grain_window<InterpS, InterpW, Direction, Chans, nw_wrap_none>(v, tab_s, size_s,
+		chan_s, tab_w, size_w, out1, out2, len);
+}
+
+/* every kernel, by sound then window interpolation mode */
+#define NW_GRAIN_KERNELS(s, w)	{ { \
+	{ nw_grain_kernel<s, w, NW_GRAIN_FORWARD, 1>, nw_grain_kernel<s, w, NW_GRAIN_FORWARD, 2> }, \
+	{ nw_grain_kernel<s, w, NW_GRAIN_REVERSE, 1>, nw_grain_kernel<s, w, NW_GRAIN_REVERSE, 2> } } }
+#define NW_GRAIN_KERNELS_W(s)	{ NW_GRAIN_KERNELS(s, NW_INTERP_NONE), NW_GRAIN_KERNELS(s, NW_INTERP_LINEAR), \
+	NW_GRAIN_KERNELS(s, NW_INTERP_HERMITE), NW_GRAIN_KERNELS(s, NW_INTERP_LAGRANGE) }
+
+/********************************************************************************
+const t_nw_grain_kernels *nw_grain_kernels(short interp_s, short interp_w)
+
+inputs:			interp_s		-- NW_INTERP_* mode for the sound buffer
+				interp_w		-- NW_INTERP_* mode for the window buffer
+description:	finds the kernels for a pair of modes; the table is constant, so
+		the owner can hand the pointer to its perform routine as it is
+returns:		the kernels
+********************************************************************************/
+inline const t_nw_grain_kernels *nw_grain_kernels(short interp_s, short interp_w)
+{
+	static const t_nw_grain_kernels kernels[NW_INTERP_SND_MAX + 1][NW_INTERP_MAX + 1] = {
+		NW_GRAIN_KERNELS_W(NW_INTERP_NONE),
+		NW_GRAIN_KERNELS_W(NW_INTERP_LINEAR),
+		NW_GRAIN_KERNELS_W(NW_INTERP_HERMITE),
+		NW_GRAIN_KERNELS_W(NW_INTERP_LAGRANGE),
+		NW_GRAIN_KERNELS_W(NW_INTERP_SINC)
+	};
+
+	if (interp_s < 0 || interp_s > NW_INTERP_SND_MAX)
+		interp_s = NW_INTERP_LINEAR;
+	if (interp_w < 0 || interp_w > NW_INTERP_MAX)
+		interp_w = NW_INTERP_LINEAR;
+	return &kernels[interp_s][interp_w];
+}
+
+#endif /* __NW_GRAINVOICE */
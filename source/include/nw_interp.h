@@ -0,0 +1,337 @@
+/*
+** nw_interp.h
+**
+** header file
+** interpolation kernels shared by the grain objects
+**
+** kernels are templated on the number of channels read per frame (1, 2, or
+** 0 for every channel in the buffer) and on a wrap policy; use nw_wrap_none when
+** every frame a grain reads is known to lie inside the buffer, so that the
+** per-sample neighbour wrap disappears
+**
+** the windowed sinc kernel reads the sound only, through a filter picked once
+** per grain from the tables in nw_sinc.h
+**
+** Copyright © 2002,2015 by Nathan Wolek
+** License: http://opensource.org/licenses/BSD-3-Clause
+**
+*/
+
+#ifndef __NW_INTERP
+#define __NW_INTERP
+
+#include "nw_simd.h"
+#include "nw_sinc.h"
+
+#if defined(_MSC_VER)
+	#define NW_FORCEINLINE __forceinline
+#else
+	#define NW_FORCEINLINE inline __attribute__((always_inline))
+#endif
+
+/* interpolation modes, as used by the sndInterp and winInterp messages */
+#define NW_INTERP_NONE			0		// truncate to the frame below
+#define NW_INTERP_LINEAR		1		// 2 point linear
+#define NW_INTERP_HERMITE		2		// 4 point, 3rd order hermite
+#define NW_INTERP_LAGRANGE		3		// 4 point, 3rd order lagrange
+#define NW_INTERP_SINC			4		// NW_SINC_TAPS point windowed sinc, sound only
+#define NW_INTERP_MAX			NW_INTERP_LAGRANGE
+#define NW_INTERP_SND_MAX		NW_INTERP_SINC
+
+/* frames either side of an index that any kernel may read */
+#define NW_INTERP_PAD			NW_SINC_HALF
+
+/* wrap policies */
+
+struct nw_wrap_none {			// caller guarantees frames are in bounds
+	static const bool in_bounds = true;
+	static NW_FORCEINLINE long wrap(long i, long /* frames */) { return i; }
+};
+
+struct nw_wrap_loop {			// neighbour frames wrap around the buffer
+	static const bool in_bounds = false;
+	static NW_FORCEINLINE long wrap(long i, long frames)
+	{
+		if ((unsigned long)i < (unsigned long)frames)
+			return i;
+		// a buffer shorter than the kernel may be gone round more than once
+		i %= frames;
+		return (i < 0) ? i + frames : i;
+	}
+};
+
+/* interpolation kernels */
+
+struct nw_interp_none {
+	template <class Wrap, int Chans>
+	static NW_FORCEINLINE void read(const float *tab, long /* frames */, long chans, long i, double /* frac */, double *out)
+	{
+		const float *y1 = tab + i * chans;
+		for (long c = 0; c < (Chans ? Chans : chans); c++)
+			out[c] = y1[c];
+	}
+};
+
+struct nw_interp_linear {
+	template <class Wrap, int Chans>
+	static NW_FORCEINLINE void read(const float *tab, long frames, long chans, long i, double frac, double *out)
+	{
+		const float *y1 = tab + i * chans;
+		const float *y2 = tab + Wrap::wrap(i + 1, frames) * chans;
+		for (long c = 0; c < (Chans ? Chans : chans); c++)
+			out[c] = (double)y1[c] + frac * ((double)y2[c] - (double)y1[c]);
+	}
+};
+
+struct nw_interp_hermite {
+	template <class Wrap, int Chans>
+	static NW_FORCEINLINE void read(const float *tab, long frames, long chans, long i, double frac, double *out)
+	{
+		const float *y0 = tab + Wrap::wrap(i - 1, frames) * chans;
+		const float *y1 = tab + i * chans;
+		const float *y2 = tab + Wrap::wrap(i + 1, frames) * chans;
+		const float *y3 = tab + Wrap::wrap(i + 2, frames) * chans;
+		double s0, s1, s2, s3, c1, c2, c3;
+
+		for (long c = 0; c < (Chans ? Chans : chans); c++) {
+			s0 = y0[c], s1 = y1[c], s2 = y2[c], s3 = y3[c];
+			c1 = 0.5 * (s2 - s0);
+			c2 = s0 - 2.5 * s1 + 2.0 * s2 - 0.5 * s3;
+			c3 = 0.5 * (s3 - s0) + 1.5 * (s1 - s2);
+			out[c] = ((c3 * frac + c2) * frac + c1) * frac + s1;
+		}
+	}
+};
+
+struct nw_interp_lagrange {
+	template <class Wrap, int Chans>
+	static NW_FORCEINLINE void read(const float *tab, long frames, long chans, long i, double frac, double *out)
+	{
+		const float *y0 = tab + Wrap::wrap(i - 1, frames) * chans;
+		const float *y1 = tab + i * chans;
+		const float *y2 = tab + Wrap::wrap(i + 1, frames) * chans;
+		const float *y3 = tab + Wrap::wrap(i + 2, frames) * chans;
+		double d0 = frac + 1.0, d2 = frac - 1.0, d3 = frac - 2.0;
+		double w0 = -frac * d2 * d3 * (1.0 / 6.0);
+		double w1 = d0 * d2 * d3 * 0.5;
+		double w2 = -d0 * frac * d3 * 0.5;
+		double w3 = d0 * frac * d2 * (1.0 / 6.0);
+
+		for (long c = 0; c < (Chans ? Chans : chans); c++)
+			out[c] = w0 * y0[c] + w1 * y1[c] + w2 * y2[c] + w3 * y3[c];
+	}
+};
+
+/********************************************************************************
+float nw_sinc_dot(const float *r0, float mix, const float *y)
+
+inputs:			r0 -- filter row below the read, the next row follows it
+				mix -- fraction of the way to the next row
+				y -- NW_SINC_TAPS consecutive samples
+description:	weights the samples by coefficients mixed between two rows
+returns:		the filtered sample
+********************************************************************************/
+#if NW_SIMD_SSE2
+NW_FORCEINLINE float nw_sinc_hsum(__m128 v)
+{
+	v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+	return _mm_cvtss_f32(v);
+}
+#endif
+
+NW_FORCEINLINE float nw_sinc_dot(const float *r0, float mix, const float *y)
+{
+	const float *r1 = r0 + NW_SINC_TAPS;
+#if NW_SIMD_SSE2
+	__m128 m = _mm_set1_ps(mix), acc = _mm_setzero_ps(), c;
+
+	for (long k = 0; k < NW_SINC_TAPS; k += 4) {
+		c = _mm_loadu_ps(r0 + k);
+		c = _mm_add_ps(c, _mm_mul_ps(m, _mm_sub_ps(_mm_loadu_ps(r1 + k), c)));
+		acc = _mm_add_ps(acc, _mm_mul_ps(c, _mm_loadu_ps(y + k)));
+	}
+	return nw_sinc_hsum(acc);
+#else
+	float acc = 0.f;
+
+	for (long k = 0; k < NW_SINC_TAPS; k++)
+		acc += (r0[k] + mix * (r1[k] - r0[k])) * y[k];
+	return acc;
+#endif
+}
+
+/********************************************************************************
+void nw_sinc_dot2(const float *r0, float mix, const float *y, double *out)
+
+inputs:			y -- NW_SINC_TAPS consecutive interleaved stereo frames
+				out -- receives the left and right samples
+				(remaining inputs as nw_sinc_dot)
+description:	as nw_sinc_dot, for both channels of a stereo buffer at once
+returns:		nothing
+********************************************************************************/
+NW_FORCEINLINE void nw_sinc_dot2(const float *r0, float mix, const float *y, double *out)
+{
+	const float *r1 = r0 + NW_SINC_TAPS;
+#if NW_SIMD_SSE2
+	__m128 m = _mm_set1_ps(mix), acc_l = _mm_setzero_ps(), acc_r = _mm_setzero_ps(), c, a, b;
+
+	for (long k = 0; k < NW_SINC_TAPS; k += 4) {
+		c = _mm_loadu_ps(r0 + k);
+		c = _mm_add_ps(c, _mm_mul_ps(m, _mm_sub_ps(_mm_loadu_ps(r1 + k), c)));
+		a = _mm_loadu_ps(y + 2 * k);
+		b = _mm_loadu_ps(y + 2 * k + 4);
+		acc_l = _mm_add_ps(acc_l, _mm_mul_ps(c, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))));
+		acc_r = _mm_add_ps(acc_r, _mm_mul_ps(c, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))));
+	}
+	out[0] = nw_sinc_hsum(acc_l);
+	out[1] = nw_sinc_hsum(acc_r);
+#else
+	float acc_l = 0.f, acc_r = 0.f, c;
+
+	for (long k = 0; k < NW_SINC_TAPS; k++) {
+		c = r0[k] + mix * (r1[k] - r0[k]);
+		acc_l += c * y[2 * k];
+		acc_r += c * y[2 * k + 1];
+	}
+	out[0] = acc_l;
+	out[1] = acc_r;
+#endif
+}
+
+/********************************************************************************
+void nw_interp_sinc<Wrap, Chans>(const t_nw_sinc_filter *f, const float *tab,
+		long frames, long chans, double index, double *out)
+
+inputs:			f -- filter picked for the grain, see nw_sinc_filter()
+				(remaining inputs as nw_interp_frame)
+description:	reads one band-limited frame; frames lying inside the buffer
+		are filtered where they are, others are gathered through the wrap
+		policy first; frames must be at least NW_SINC_TAPS
+returns:		nothing
+********************************************************************************/
+template <class Wrap, int Chans>
+NW_FORCEINLINE void nw_interp_sinc(const t_nw_sinc_filter *f, const float *tab, long frames, long chans,
+	double index, double *out)
+{
+	long i = (long)index;
+	double pos = (index - (double)i) * f->phases;
+	long p = (long)pos;
+	float mix = (float)(pos - (double)p);
+	const float *r0 = f->rows + p * NW_SINC_TAPS;
+	long first = i - NW_SINC_HALF + 1;
+	float y[NW_SINC_TAPS];
+
+	if (Wrap::in_bounds && Chans == 1 && chans == 1) {
+		out[0] = nw_sinc_dot(r0, mix, tab + first);
+		return;
+	}
+	if (Wrap::in_bounds && Chans == 2 && chans == 2) {
+		nw_sinc_dot2(r0, mix, tab + first * 2, out);
+		return;
+	}
+	for (long c = 0; c < (Chans ? Chans : chans); c++) {
+		for (long k = 0; k < NW_SINC_TAPS; k++)
+			y[k] = tab[Wrap::wrap(first + k, frames) * chans + c];
+		out[c] = nw_sinc_dot(r0, mix, y);
+	}
+}
+
+/********************************************************************************
+void nw_interp_frame<Interp, Wrap, Chans>(const float *tab, long frames, long chans,
+		double index, double *out)
+
+inputs:			tab -- interleaved buffer samples
+				frames -- number of frames in tab
+				chans -- number of interleaved channels in tab
+				index -- fractional frame to read, 0 <= index < frames
+				out -- receives Chans values, or chans values if Chans is 0
+description:	reads one interpolated frame with a fixed kernel and wrap policy;
+		when Chans is less than chans only the first Chans channels are read
+returns:		nothing
+********************************************************************************/
+template <class Interp, class Wrap, int Chans>
+NW_FORCEINLINE void nw_interp_frame(const float *tab, long frames, long chans, double index, double *out)
+{
+	long i = (long)index;
+	Interp::template read<Wrap, Chans>(tab, frames, chans, i, index - (double)i, out);
+}
+
+/********************************************************************************
+void nw_interp<Chans, Wrap>(short mode, const float *tab, long frames, long chans,
+		double index, double *out, const t_nw_sinc_filter *sinc)
+
+inputs:			mode -- one of the NW_INTERP_* modes
+				sinc -- filter for NW_INTERP_SINC, chosen once per grain; without
+					one, or for a buffer shorter than NW_SINC_TAPS, lagrange is used
+				(remaining inputs as nw_interp_frame)
+description:	selects the kernel for a mode set by the sndInterp/winInterp
+		messages; everything is inlined, so the only cost over a fixed kernel
+		is one well predicted switch
+returns:		nothing
+********************************************************************************/
+template <int Chans, class Wrap>
+NW_FORCEINLINE void nw_interp(short mode, const float *tab, long frames, long chans, double index, double *out,
+	const t_nw_sinc_filter *sinc = NULL)
+{
+	switch (mode) {
+		case NW_INTERP_NONE:
+			nw_interp_frame<nw_interp_none, Wrap, Chans>(tab, frames, chans, index, out);
+			break;
+		case NW_INTERP_HERMITE:
+			nw_interp_frame<nw_interp_hermite, Wrap, Chans>(tab, frames, chans, index, out);
+			break;
+		case NW_INTERP_LAGRANGE:
+			nw_interp_frame<nw_interp_lagrange, Wrap, Chans>(tab, frames, chans, index, out);
+			break;
+		case NW_INTERP_SINC:
+			if (sinc && frames >= NW_SINC_TAPS)
+				nw_interp_sinc<Wrap, Chans>(sinc, tab, frames, chans, index, out);
+			else
+				nw_interp_frame<nw_interp_lagrange, Wrap, Chans>(tab, frames, chans, index, out);
+			break;
+		default:
+			nw_interp_frame<nw_interp_linear, Wrap, Chans>(tab, frames, chans, index, out);
+			break;
+	}
+}
+
+/********************************************************************************
+void nw_interp<Chans>(short mode, bool wraps, const float *tab, long frames, long chans,
+		double index, double *out, const t_nw_sinc_filter *sinc)
+
+inputs:			wraps -- false if every read of the grain stays clear of the
+					buffer ends, see nw_interp_wraps()
+				(remaining inputs as above)
+description:	picks the wrap policy once per grain rather than per neighbour
+returns:		nothing
+********************************************************************************/
+template <int Chans>
+NW_FORCEINLINE void nw_interp(short mode, bool wraps, const float *tab, long frames, long chans, double index, double *out,
+	const t_nw_sinc_filter *sinc = NULL)
+{
+	if (wraps)
+		nw_interp<Chans, nw_wrap_loop>(mode, tab, frames, chans, index, out, sinc);
+	else
+		nw_interp<Chans, nw_wrap_none>(mode, tab, frames, chans, index, out, sinc);
+}
+
+/********************************************************************************
+bool nw_interp_wraps(double first, double last, long frames)
+
+inputs:			first -- first fractional frame a grain will read
+				last -- last fractional frame a grain will read
+				frames -- number of frames in the buffer
+description:	tests whether any kernel reading between first and last could
+		touch a frame outside the buffer
+returns:		true if the wrapping policy is needed
+********************************************************************************/
+NW_FORCEINLINE bool nw_interp_wraps(double first, double last, long frames)
+{
+	double lo = first < last ? first : last;
+	double hi = first < last ? last : first;
+
+	return (lo < (double)NW_INTERP_PAD) || (hi >= (double)(frames - NW_INTERP_PAD - 1));
+}
+
+#endif /* __NW_INTERP */
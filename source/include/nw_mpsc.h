@@ -0,0 +1,128 @@
+/*
+** nw_mpsc.h
+**
+** header file
+** bounded lock-free queue for handing events from any number of threads to
+** the perform routine, which must never block on a lock; messages to an
+** object can come from the main thread and the scheduler thread at once
+**
+** Max allocates objects without running constructors, so a queue held in an
+** object struct is emptied by init() rather than by a constructor
+**
+** Copyright © 2015 by Nathan Wolek
+** License: http://opensource.org/licenses/BSD-3-Clause
+**
+*/
+
+#ifndef __NW_MPSC
+#define __NW_MPSC
+
+#include <atomic>
+
+/********************************************************************************
+template <class T, long Size> class NwMpscQueue
+
+description:	multiple producer, single consumer ring of Size items; Size
+		must be a power of two; every slot carries a sequence number telling
+		whose turn it is, producers claim a slot by moving "tail" on with a
+		compare and exchange, then publish the item by moving its sequence on
+		with a release store; the consumer alone moves "head"; positions count
+		up without bound and are compared by their difference, so they may
+		wrap
+********************************************************************************/
+template <class T, long Size>
+class NwMpscQueue
+{
+	static_assert(Size > 1 && (Size & (Size - 1)) == 0, "NwMpscQueue size must be a power of two");
+
+public:
+	void init(void);
+	bool push(const T &item);
+	bool pop(T *item);
+
+private:
+	struct slot
+	{
+		std::atomic<unsigned long> seq;		// position the slot is ready for
+		T item;
+	};
+
+	slot slots[Size];
+	std::atomic<unsigned long> tail;	// next position to push, claimed by producers
+	unsigned long head;					// next position to pop, consumer only
+};
+
+/********************************************************************************
+void NwMpscQueue::init(void)
+
+inputs:			nothing
+description:	empties the queue; only call while no side is running
+returns:		nothing
+********************************************************************************/
+template <class T, long Size>
+inline void NwMpscQueue<T, Size>::init(void)
+{
+	long i;
+
+	for (i = 0; i < Size; i++)
+		slots[i].seq.store((unsigned long)i, std::memory_order_relaxed);
+	head = 0;
+	tail.store(0, std::memory_order_release);
+}
+
+/********************************************************************************
+bool NwMpscQueue::push(const T &item)
+
+inputs:			item	-- copied into the queue
+description:	producer side, from any thread
+returns:		false if the queue is full and the item was dropped
+********************************************************************************/
+template <class T, long Size>
+inline bool NwMpscQueue<T, Size>::push(const T &item)
+{
+	unsigned long pos = tail.load(std::memory_order_relaxed);
+	slot *s;
+	long diff;
+
+	for (;;) {
+		s = slots + (pos & (Size - 1));
+		diff = (long)(s->seq.load(std::memory_order_acquire) - pos);
+		if (diff == 0) {
+			// the slot is free for this position, claim it
+			if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		} else if (diff < 0) {
+			return false;		// the consumer has not taken this slot yet
+		} else {
+			pos = tail.load(std::memory_order_relaxed);
+		}
+	}
+
+	s->item = item;
+	s->seq.store(pos + 1, std::memory_order_release);
+	return true;
+}
+
+/********************************************************************************
+bool NwMpscQueue::pop(T *item)
+
+inputs:			item	-- receives the oldest item
+description:	consumer side
+returns:		false if the queue is empty, or its oldest item is still being
+		written
+********************************************************************************/
+template <class T, long Size>
+inline bool NwMpscQueue<T, Size>::pop(T *item)
+{
+	slot *s = slots + (head & (Size - 1));
+
+	if (s->seq.load(std::memory_order_acquire) != head + 1)
+		return false;
+
+	*item = s->item;
+	s->seq.store(head + Size, std::memory_order_release);
+	++head;
+	return true;
+}
+
+#endif /* __NW_MPSC */
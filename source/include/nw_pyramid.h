@@ -0,0 +1,313 @@
+/*
+** nw_pyramid.h
+**
+** header file
+** the sound buffer decimated by octaves, free of any Max API calls, so that a
+** grain transposed far up reads a shorter copy with a small step instead of
+** striding through the buffer~; each level is filtered before it is halved,
+** so what it holds no longer aliases when read at up to NW_PYRAMID_STEP
+**
+** the perform routine says which buffer~ it plays and reads whatever levels
+** are ready; the levels themselves are built on the main thread a piece at a
+** time, so the perform routine never allocates or filters
+**
+** Max allocates objects without running constructors, so a pyramid held in
+** an object struct is emptied by init() rather than by a constructor
+**
+** Copyright © 2015 by Nathan Wolek
+** License: http://opensource.org/licenses/BSD-3-Clause
+**
+*/
+
+#ifndef __NW_PYRAMID
+#define __NW_PYRAMID
+
+#include <stdlib.h>
+#include <math.h>
+#include <atomic>
+
+#define NW_PYRAMID_LEVELS		4		// octaves below the buffer~, so up to 16x
+#define NW_PYRAMID_STEP			2.0		// largest step a grain reads a level with
+#define NW_PYRAMID_HALF			15		// halfband filter taps either side of the centre
+#define NW_PYRAMID_CHUNK		65536	// frames filtered per call to update()
+
+/* one octave down; frames are interleaved like the buffer~ they came from,
+   frame j standing for frame j << level of the buffer~ */
+typedef struct _nw_pyramid_level
+{
+	float *samples;
+	long frames;
+} t_nw_pyramid_level;
+
+/********************************************************************************
+class NwPyramid
+
+description:	the perform routine calls check() once per vector with the
+		sound buffer it plays, or NULL when no pyramid is wanted; any change
+		of buffer, frame count, channel count or modtime starts a new
+		generation, after which the perform routine must drop every level it
+		holds and reads none until update() has run on the main thread;
+		update() only frees levels of an old generation, and publishes each
+		new level once it is complete, so levels come in one at a time
+********************************************************************************/
+class NwPyramid
+{
+public:
+	void init(void);
+	void free(void);
+	// perform routine
+	bool check(void *buffer, long frames, long chans, long modtime);
+	long ready(void);
+	const t_nw_pyramid_level *level(long k);
+	long choose(double step);
+	// main thread
+	void *wanted(void);
+	bool update(const float *tab, long frames, long chans, long modtime);
+
+private:
+	t_nw_pyramid_level levels[NW_PYRAMID_LEVELS];
+	std::atomic<long> generation;	// bumped by check()
+	std::atomic<long> built;		// generation the levels belong to
+	std::atomic<long> count;		// levels complete in that generation
+	// what the current generation is for, set by check() before the bump
+	std::atomic<void *> want_buffer;
+	std::atomic<long> want_frames;
+	std::atomic<long> want_chans;
+	std::atomic<long> want_modtime;
+	long progress;					// frames of the next level done, main thread only
+	// buffer the current generation was started from, perform routine only
+	void *key_buffer;
+	long key_frames;
+	long key_chans;
+	long key_modtime;
+};
+
+/********************************************************************************
+void NwPyramid::init(void)
+
+inputs:			nothing
+description:	empties the pyramid; no level is ready until the first check()
+		and update()
+returns:		nothing
+********************************************************************************/
+inline void NwPyramid::init(void)
+{
+	long a;
+
+	for (a = 0; a < NW_PYRAMID_LEVELS; a++) {
+		levels[a].samples = NULL;
+		levels[a].frames = 0;
+	}
+	generation.store(0, std::memory_order_relaxed);
+	built.store(0, std::memory_order_relaxed);
+	count.store(0, std::memory_order_relaxed);
+	want_buffer.store(NULL, std::memory_order_relaxed);
+	want_frames.store(0, std::memory_order_relaxed);
+	want_chans.store(0, std::memory_order_relaxed);
+	want_modtime.store(0, std::memory_order_relaxed);
+	progress = 0;
+	key_buffer = NULL;
+	key_frames = key_chans = key_modtime = 0;
+}
+
+/********************************************************************************
+void NwPyramid::free(void)
+
+inputs:			nothing
+description:	frees every level; only call once the perform routine has stopped
+returns:		nothing
+********************************************************************************/
+inline void NwPyramid::free(void)
+{
+	long a;
+
+	for (a = 0; a < NW_PYRAMID_LEVELS; a++) {
+		::free(levels[a].samples);
+		levels[a].samples = NULL;
+		levels[a].frames = 0;
+	}
+	count.store(0, std::memory_order_relaxed);
+	progress = 0;
+}
+
+/********************************************************************************
+bool NwPyramid::check(void *buffer, long frames, long chans, long modtime)
+
+inputs:			buffer		-- sound buffer played, or NULL for no pyramid
+				frames		-- frames in the sound buffer
+				chans		-- channels in the sound buffer
+				modtime		-- modification time of the sound buffer
+description:	perform routine side; starts a new generation if the sound
+		differs from the one the levels were built from
+returns:		true if a new generation started, in which case every level
+		the caller holds must be dropped and update() scheduled
+********************************************************************************/
+inline bool NwPyramid::check(void *buffer, long frames, long chans, long modtime)
+{
+	if (buffer == key_buffer && (buffer == NULL ||
+		(frames == key_frames && chans == key_chans && modtime == key_modtime)))
+		return false;
+
+	key_buffer = buffer;
+	key_frames = frames;
+	key_chans = chans;
+	key_modtime = modtime;
+
+	want_buffer.store(buffer, std::memory_order_relaxed);
+	want_frames.store(frames, std::memory_order_relaxed);
+	want_chans.store(chans, std::memory_order_relaxed);
+	want_modtime.store(modtime, std::memory_order_relaxed);
+	generation.fetch_add(1, std::memory_order_release);
+	return true;
+}
+
+/********************************************************************************
+long NwPyramid::ready(void)
+
+inputs:			nothing
+description:	perform routine side; counts the levels of this generation
+		that have been built
+returns:		levels from 1 that level() may be asked for
+********************************************************************************/
+inline long NwPyramid::ready(void)
+{
+	if (built.load(std::memory_order_acquire) != generation.load(std::memory_order_relaxed))
+		return 0;
+	return count.load(std::memory_order_acquire);
+}
+
+/********************************************************************************
+const t_nw_pyramid_level *NwPyramid::level(long k)
+
+inputs:			k			-- level, from 1 to ready()
+description:	perform routine side
+returns:		the level k octaves below the buffer~
+********************************************************************************/
+inline const t_nw_pyramid_level *NwPyramid::level(long k)
+{
+	return levels + k - 1;
+}
+
+/********************************************************************************
+long NwPyramid::choose(double step)
+
+inputs:			step		-- sound frames a grain reads per output sample
+description:	perform routine side; picks the highest level that keeps the
+		step up to NW_PYRAMID_STEP, of those ready
+returns:		the level, 0 for the buffer~ itself
+********************************************************************************/
+inline long NwPyramid::choose(double step)
+{
+	long levels_ready = ready();
+	long k = 0;
+
+	step = fabs(step);
+	while (k < levels_ready && step > NW_PYRAMID_STEP) {
+		step *= 0.5;
+		k++;
+	}
+	return k;
+}
+
+/********************************************************************************
+void *NwPyramid::wanted(void)
+
+inputs:			nothing
+description:	main thread side; the buffer update() should be given
+returns:		the sound buffer of the current generation, or NULL for none
+********************************************************************************/
+inline void *NwPyramid::wanted(void)
+{
+	generation.load(std::memory_order_acquire);
+	return want_buffer.load(std::memory_order_relaxed);
+}
+
+/********************************************************************************
+bool NwPyramid::update(const float *tab, long frames, long chans, long modtime)
+
+inputs:			tab			-- samples of the buffer from wanted(), locked by
+							   the caller, or NULL if there is none
+				frames		-- frames in that buffer
+				chans		-- channels in that buffer
+				modtime		-- modification time of that buffer
+description:	main thread side; frees the levels of an old generation, then
+		filters up to NW_PYRAMID_CHUNK frames of the next level; the filter is
+		a blackman windowed halfband, read around the ends of the level below
+		as the grains themselves wrap; a buffer~ that no longer matches the
+		generation is left alone, as check() will start another
+returns:		true if more is left to build, so the caller should call again
+********************************************************************************/
+inline bool NwPyramid::update(const float *tab, long frames, long chans, long modtime)
+{
+	const double pi = 3.14159265358979323846;
+	long gen = generation.load(std::memory_order_acquire);
+	long k = count.load(std::memory_order_relaxed);
+	const float *src;
+	long src_frames, a, j, c, i, end;
+	double h[NW_PYRAMID_HALF + 1], sum, n;
+	float *dst;
+
+	if (gen != built.load(std::memory_order_relaxed)) {
+		// the perform routine reads no level until built matches its generation
+		free();
+		built.store(gen, std::memory_order_release);
+		k = 0;
+	}
+
+	if (!tab || !want_buffer.load(std::memory_order_relaxed) || k == NW_PYRAMID_LEVELS)
+		return false;
+	if (frames != want_frames.load(std::memory_order_relaxed) || chans != want_chans.load(std::memory_order_relaxed)
+		|| modtime != want_modtime.load(std::memory_order_relaxed))
+		return false;
+
+	src = k ? levels[k - 1].samples : tab;
+	src_frames = k ? levels[k - 1].frames : frames;
+	if (src_frames < 2 * NW_PYRAMID_HALF + 2)
+		return false;		// too short to be worth halving again
+
+	if (!levels[k].samples) {
+		levels[k].frames = (src_frames + 1) / 2;
+		levels[k].samples = (float *)malloc(levels[k].frames * chans * sizeof(float));
+		if (!levels[k].samples)
+			return false;
+		progress = 0;
+	}
+
+	// odd taps of a halfband are zero, apart from the centre
+	sum = h[0] = 0.5;
+	for (a = 1; a <= NW_PYRAMID_HALF; a++) {
+		n = (double)a;
+		h[a] = (a % 2) ? sin(0.5 * pi * n) / (pi * n) *
+			(0.42 + 0.5 * cos(pi * n / (NW_PYRAMID_HALF + 1)) + 0.08 * cos(2. * pi * n / (NW_PYRAMID_HALF + 1))) : 0.;
+		sum += 2. * h[a];
+	}
+
+	dst = levels[k].samples;
+	end = progress + NW_PYRAMID_CHUNK;
+	if (end > levels[k].frames)
+		end = levels[k].frames;
+	for (j = progress; j < end; j++) {
+		i = j * 2;
+		for (c = 0; c < chans; c++) {
+			double acc = h[0] * src[i * chans + c];
+			for (a = 1; a <= NW_PYRAMID_HALF; a += 2) {
+				long lo = i - a, hi = i + a;
+				if (lo < 0) lo += src_frames;
+				if (hi >= src_frames) hi -= src_frames;
+				acc += h[a] * ((double)src[lo * chans + c] + (double)src[hi * chans + c]);
+			}
+			dst[j * chans + c] = (float)(acc / sum);
+		}
+	}
+	progress = end;
+
+	if (progress < levels[k].frames)
+		return true;
+
+	// the level is complete; the perform routine may read it from now on
+	progress = 0;
+	count.store(k + 1, std::memory_order_release);
+	return k + 1 < NW_PYRAMID_LEVELS;
+}
+
+#endif /* __NW_PYRAMID */
@@ -0,0 +1,87 @@
+/*
+** nw_simd.h
+**
+** header file
+** processor feature tests for objects with vectorised render kernels
+**
+** kernels are compiled for x86 only; on other processors NW_SIMD_X86 is 0
+** and objects keep to their scalar routines
+**
+** Copyright © 2002,2015 by Nathan Wolek
+** License: http://opensource.org/licenses/BSD-3-Clause
+**
+*/
+
+#ifndef __NW_SIMD
+#define __NW_SIMD
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define NW_SIMD_X86 1
+	#include <immintrin.h>
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+		#define NW_TARGET_AVX2		// msvc accepts avx2 intrinsics in any function
+	#else
+		#define NW_TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#else
+	#define NW_SIMD_X86 0
+	#define NW_TARGET_AVX2
+#endif
+
+/* sse2 kernels that need no processor test, as the compiler targets it anyway */
+#if NW_SIMD_X86 && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+	#define NW_SIMD_SSE2 1
+#else
+	#define NW_SIMD_SSE2 0
+#endif
+
+/********************************************************************************
+bool nw_cpu_has_sse2(void)
+
+inputs:			nothing
+description:	tests whether sse2 kernels can run on this processor
+returns:		true if sse2 is available
+********************************************************************************/
+static inline bool nw_cpu_has_sse2(void)
+{
+#if !NW_SIMD_X86
+	return false;
+#elif defined(__x86_64__) || defined(_M_X64)
+	return true;		// part of every 64 bit x86 processor
+#elif defined(_MSC_VER)
+	int regs[4];
+	__cpuid(regs, 1);
+	return (regs[3] & (1 << 26)) != 0;
+#else
+	return __builtin_cpu_supports("sse2");
+#endif
+}
+
+/********************************************************************************
+bool nw_cpu_has_avx2(void)
+
+inputs:			nothing
+description:	tests whether avx2 kernels can run on this processor, including
+		operating system support for the 256 bit registers
+returns:		true if avx2 is available
+********************************************************************************/
+static inline bool nw_cpu_has_avx2(void)
+{
+#if !NW_SIMD_X86
+	return false;
+#elif defined(_MSC_VER)
+	int regs[4];
+	__cpuid(regs, 1);
+	if ((regs[2] & (1 << 27)) == 0 || (regs[2] & (1 << 28)) == 0)	// osxsave and avx
+		return false;
+	if ((_xgetbv(0) & 6) != 6)		// xmm and ymm state saved by the os
+		return false;
+	__cpuidex(regs, 7, 0);
+	return (regs[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif /* __NW_SIMD */
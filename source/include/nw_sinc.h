@@ -0,0 +1,183 @@
+/*
+** nw_sinc.h
+**
+** header file
+** polyphase windowed sinc filters for band-limited reading of the sound
+** buffer, free of any Max API calls; the kernel itself is in nw_interp.h
+**
+** each table holds one filter per cutoff, with a cutoff for every quarter
+** octave of transposition, so a grain reading the sound faster than its
+** sample rate can pick a filter that stops what would alias
+**
+** tables are built on first use and shared by every object asking for the
+** same number of phases; they are never freed, so the perform routine can
+** hold on to one without reference counting
+**
+** NW_SINC_TAPS may be set when compiling to trade cpu for quality
+**
+** Copyright © 2015 by Nathan Wolek
+** License: http://opensource.org/licenses/BSD-3-Clause
+**
+*/
+
+#ifndef __NW_SINC
+#define __NW_SINC
+
+#include <stdlib.h>
+#include <math.h>
+#include <atomic>
+
+#ifndef NW_SINC_TAPS
+	#define NW_SINC_TAPS		16		// frames read per output sample, a multiple of 4
+#endif
+#define NW_SINC_HALF			(NW_SINC_TAPS / 2)
+#define NW_SINC_PHASES			256		// default phases per frame
+#define NW_SINC_PHASES_MIN		16		// powers of two between these
+#define NW_SINC_PHASES_MAX		4096
+#define NW_SINC_STEPS			4		// cutoffs per octave of transposition
+#define NW_SINC_OCTAVES			3		// transpositions above 8x share the lowest cutoff
+#define NW_SINC_CUTOFFS			(NW_SINC_STEPS * NW_SINC_OCTAVES + 1)
+#define NW_SINC_ROLLOFF			0.9		// highest cutoff, as a fraction of nyquist
+
+#if (NW_SINC_TAPS < 4) || (NW_SINC_TAPS % 4)
+	#error NW_SINC_TAPS must be a multiple of 4
+#endif
+
+/* one filter; phases + 1 rows of NW_SINC_TAPS coefficients, row p for a read
+   p / phases of the way from frame i to frame i + 1, tap k weighting frame
+   i - NW_SINC_HALF + 1 + k */
+typedef struct _nw_sinc_filter
+{
+	const float *rows;
+	double phases;
+} t_nw_sinc_filter;
+
+/* every cutoff for one number of phases */
+typedef struct _nw_sinc
+{
+	long phases;
+	t_nw_sinc_filter filters[NW_SINC_CUTOFFS];
+} t_nw_sinc;
+
+/********************************************************************************
+long nw_sinc_phases(long phases)
+
+inputs:			phases		-- phases per frame asked for
+description:	rounds a table size to the power of two a table is built with
+returns:		phases per frame, between NW_SINC_PHASES_MIN and NW_SINC_PHASES_MAX
+********************************************************************************/
+inline long nw_sinc_phases(long phases)
+{
+	long p = NW_SINC_PHASES_MIN;
+
+	while (p < phases && p < NW_SINC_PHASES_MAX)
+		p <<= 1;
+	return p;
+}
+
+/********************************************************************************
+void nw_sinc_build(float *rows, long phases, double cutoff)
+
+inputs:			rows		-- (phases + 1) * NW_SINC_TAPS coefficients to fill
+				phases		-- phases per frame
+				cutoff		-- as a fraction of nyquist
+description:	samples a sinc at cutoff under a blackman-harris window spanning
+		every tap; each row is scaled to unity gain at dc, so that rows agree
+		on loudness however few taps cross zero
+returns:		nothing
+********************************************************************************/
+inline void nw_sinc_build(float *rows, long phases, double cutoff)
+{
+	const double pi = 3.14159265358979323846;
+	double x, t, h, sum, row[NW_SINC_TAPS];
+	long p, k;
+
+	for (p = 0; p <= phases; p++) {
+		sum = 0.;
+		for (k = 0; k < NW_SINC_TAPS; k++) {
+			x = (double)(k - NW_SINC_HALF + 1) - (double)p / (double)phases;
+			t = 0.5 + x / (double)NW_SINC_TAPS;
+			h = (x == 0.) ? cutoff : sin(pi * cutoff * x) / (pi * x);
+			h *= 0.35875 - 0.48829 * cos(2. * pi * t) + 0.14128 * cos(4. * pi * t)
+				- 0.01168 * cos(6. * pi * t);
+			row[k] = h;
+			sum += h;
+		}
+		for (k = 0; k < NW_SINC_TAPS; k++)
+			rows[p * NW_SINC_TAPS + k] = (float)(row[k] / sum);
+	}
+}
+
+/********************************************************************************
+const t_nw_sinc *nw_sinc_get(long phases)
+
+inputs:			phases		-- phases per frame, see nw_sinc_phases()
+description:	finds the shared table with this many phases, building it the
+		first time it is asked for; only call from the main thread, as
+		building allocates
+returns:		the table, or NULL if memory ran out
+********************************************************************************/
+inline const t_nw_sinc *nw_sinc_get(long phases)
+{
+	static std::atomic<t_nw_sinc *> tables[16];
+	t_nw_sinc *s, *none = NULL;
+	long slot, a, row_count;
+	float *rows;
+
+	phases = nw_sinc_phases(phases);
+	for (slot = 0; (NW_SINC_PHASES_MIN << slot) < phases; slot++)
+		;
+
+	s = tables[slot].load(std::memory_order_acquire);
+	if (s)
+		return s;
+
+	row_count = (phases + 1) * NW_SINC_TAPS;
+	s = (t_nw_sinc *)malloc(sizeof(t_nw_sinc));
+	rows = (float *)malloc(NW_SINC_CUTOFFS * row_count * sizeof(float));
+	if (!s || !rows) {
+		::free(s);
+		::free(rows);
+		return NULL;
+	}
+	s->phases = phases;
+	for (a = 0; a < NW_SINC_CUTOFFS; a++) {
+		nw_sinc_build(rows + a * row_count, phases, NW_SINC_ROLLOFF * pow(2., -(double)a / NW_SINC_STEPS));
+		s->filters[a].rows = rows + a * row_count;
+		s->filters[a].phases = (double)phases;
+	}
+
+	// another thread may have built the same table meanwhile
+	if (!tables[slot].compare_exchange_strong(none, s, std::memory_order_acq_rel)) {
+		::free(rows);
+		::free(s);
+		return none;
+	}
+	return s;
+}
+
+/********************************************************************************
+const t_nw_sinc_filter *nw_sinc_filter(const t_nw_sinc *s, double step)
+
+inputs:			s			-- table to pick from, may be NULL
+				step		-- sound frames read per output sample
+description:	picks the widest filter that still stops everything a grain
+		reading at this step would alias; called once per grain
+returns:		the filter, or NULL if s is NULL
+********************************************************************************/
+inline const t_nw_sinc_filter *nw_sinc_filter(const t_nw_sinc *s, double step)
+{
+	long a = 0;
+
+	if (!s)
+		return NULL;
+	step = fabs(step);
+	if (step > 1.) {
+		a = (long)ceil(log2(step) * NW_SINC_STEPS - 1e-9);
+		if (a > NW_SINC_CUTOFFS - 1)
+			a = NW_SINC_CUTOFFS - 1;
+	}
+	return s->filters + a;
+}
+
+#endif /* __NW_SINC */
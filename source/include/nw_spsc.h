@@ -0,0 +1,100 @@
+/*
+** nw_spsc.h
+**
+** header file
+** bounded lock-free queue for handing events from one message thread to the
+** perform routine, which must never block on a lock
+**
+** Max allocates objects without running constructors, so a queue held in an
+** object struct is emptied by init() rather than by a constructor
+**
+** Copyright © 2015 by Nathan Wolek
+** License: http://opensource.org/licenses/BSD-3-Clause
+**
+*/
+
+#ifndef __NW_SPSC
+#define __NW_SPSC
+
+#include <atomic>
+
+/********************************************************************************
+template <class T, long Size> class NwSpscQueue
+
+description:	single producer, single consumer ring of Size - 1 items; Size
+		must be a power of two; the producer only writes "tail" and the
+		consumer only writes "head", so each side publishes its index with a
+		release store after touching the items
+********************************************************************************/
+template <class T, long Size>
+class NwSpscQueue
+{
+	static_assert(Size > 1 && (Size & (Size - 1)) == 0, "NwSpscQueue size must be a power of two");
+
+public:
+	void init(void);
+	bool push(const T &item);
+	bool pop(T *item);
+
+private:
+	T items[Size];
+	std::atomic<long> head;		// next item to pop, written by the consumer
+	std::atomic<long> tail;		// next slot to push, written by the producer
+};
+
+/********************************************************************************
+void NwSpscQueue::init(void)
+
+inputs:			nothing
+description:	empties the queue; only call while neither side is running
+returns:		nothing
+********************************************************************************/
+template <class T, long Size>
+inline void NwSpscQueue<T, Size>::init(void)
+{
+	head.store(0, std::memory_order_relaxed);
+	tail.store(0, std::memory_order_relaxed);
+}
+
+/********************************************************************************
+bool NwSpscQueue::push(const T &item)
+
+inputs:			item	-- copied into the queue
+description:	producer side
+returns:		false if the queue is full and the item was dropped
+********************************************************************************/
+template <class T, long Size>
+inline bool NwSpscQueue<T, Size>::push(const T &item)
+{
+	long t = tail.load(std::memory_order_relaxed);
+	long next = (t + 1) & (Size - 1);
+
+	if (next == head.load(std::memory_order_acquire))
+		return false;
+
+	items[t] = item;
+	tail.store(next, std::memory_order_release);
+	return true;
+}
+
+/********************************************************************************
+bool NwSpscQueue::pop(T *item)
+
+inputs:			item	-- receives the oldest item
+description:	consumer side
+returns:		false if the queue is empty
+********************************************************************************/
+template <class T, long Size>
+inline bool NwSpscQueue<T, Size>::pop(T *item)
+{
+	long h = head.load(std::memory_order_relaxed);
+
+	if (h == tail.load(std::memory_order_acquire))
+		return false;
+
+	*item = items[h];
+	head.store((h + 1) & (Size - 1), std::memory_order_release);
+	return true;
+}
+
+#endif /* __NW_SPSC */
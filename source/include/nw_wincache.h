@@ -0,0 +1,264 @@
+/*
+** nw_wincache.h
+**
+** header file
+** window shapes resampled once per grain length, free of any Max API calls,
+** shared by the grain objects that start whole grains on a trigger
+** (nw.grainbang~, nw.grainpulse~)
+**
+** the perform routine looks tables up and asks for missing lengths; the
+** tables themselves are built by the owner on the main thread, so the perform
+** routine never allocates or resamples
+**
+** Max allocates objects without running constructors, so a cache held in an
+** object struct is emptied by init() rather than by a constructor
+**
+** Copyright © 2015 by Nathan Wolek
+** License: http://opensource.org/licenses/BSD-3-Clause
+**
+*/
+
+#ifndef __NW_WINCACHE
+#define __NW_WINCACHE
+
+#include <stdlib.h>
+#include <atomic>
+#include "nw_interp.h"
+#include "nw_spsc.h"
+
+#define NW_WINCACHE_SLOTS		32		// distinct grain lengths held at once
+#define NW_WINCACHE_LENGTH_MAX	16384	// longest grain cached, in samples
+#define NW_WINCACHE_REQUESTS	64		// power of two, pending lengths
+
+/********************************************************************************
+long nw_wincache_length(double grain_samples)
+
+inputs:			grain_samples	-- grain length, in output samples
+description:	quantises a grain length to the table length that plays it
+returns:		table length, or 0 if grains this long are not cached
+********************************************************************************/
+inline long nw_wincache_length(double grain_samples)
+{
+	long length = (long)(grain_samples + 0.5);
+
+	if (length < 1 || length > NW_WINCACHE_LENGTH_MAX)
+		return 0;
+	return length;
+}
+
+/* one resampled window; length is published last, so a non-zero length
+   means the table is complete */
+typedef struct _nw_wincache_slot
+{
+	std::atomic<long> length;
+	float *table;
+} t_nw_wincache_slot;
+
+/********************************************************************************
+class NwWinCache
+
+description:	the perform routine calls check() once per vector with the
+		window buffer it locked; any change of buffer, frame count, modtime or
+		interpolation starts a new generation, after which the perform routine
+		must drop every table it holds and reads none until update() has run on
+		the main thread; update() only frees tables of an old generation, so a
+		table handed out by find() stays valid until the perform routine itself
+		moves on; slots are never evicted within a generation, lengths past the
+		last slot are simply played through the interpolator
+********************************************************************************/
+class NwWinCache
+{
+public:
+	void init(void);
+	void free(void);
+	// perform routine
+	bool check(const void *buffer, long frames, long modtime, short interp);
+	const float *find(long length);
+	bool request(long length);
+	// main thread
+	void update(const float *tab_w, long size_w);
+
+private:
+	t_nw_wincache_slot slots[NW_WINCACHE_SLOTS];
+	NwSpscQueue<long, NW_WINCACHE_REQUESTS> requests;
+	std::atomic<long> generation;	// bumped by check()
+	std::atomic<long> ready;		// generation the slots were built for
+	std::atomic<long> build_interp;	// interpolation for the current generation
+	long built;						// main thread only
+	// window the current generation was started from, perform routine only
+	const void *key_buffer;
+	long key_frames;
+	long key_modtime;
+	short key_interp;
+};
+
+/********************************************************************************
+void NwWinCache::init(void)
+
+inputs:			nothing
+description:	empties the cache; no table is found until the first check()
+		and update()
+returns:		nothing
+********************************************************************************/
+inline void NwWinCache::init(void)
+{
+	long a;
+
+	for (a = 0; a < NW_WINCACHE_SLOTS; a++) {
+		slots[a].length.store(0, std::memory_order_relaxed);
+		slots[a].table = NULL;
+	}
+	requests.init();
+	generation.store(0, std::memory_order_relaxed);
+	ready.store(-1, std::memory_order_relaxed);
+	build_interp.store(NW_INTERP_LINEAR, std::memory_order_relaxed);
+	built = -1;
+	key_buffer = NULL;
+	key_frames = 0;
+	key_modtime = 0;
+	key_interp = -1;
+}
+
+/********************************************************************************
+void NwWinCache::free(void)
+
+inputs:			nothing
+description:	frees every table; only call once the perform routine has stopped
+returns:		nothing
+********************************************************************************/
+inline void NwWinCache::free(void)
+{
+	long a;
+
+	for (a = 0; a < NW_WINCACHE_SLOTS; a++) {
+		if (slots[a].table)
+			::free(slots[a].table);
+	}
+	init();
+}
+
+/********************************************************************************
+bool NwWinCache::check(const void *buffer, long frames, long modtime, short interp)
+
+inputs:			buffer		-- window buffer locked for this vector
+				frames		-- frames in the window buffer
+				modtime		-- modification time of the window buffer
+				interp		-- NW_INTERP_* mode for the window buffer
+description:	perform routine side; starts a new generation if the window
+		differs from the one the tables were built from
+returns:		true if a new generation started, in which case every table
+		the caller holds must be dropped and update() scheduled
+********************************************************************************/
+inline bool NwWinCache::check(const void *buffer, long frames, long modtime, short interp)
+{
+	if (buffer == key_buffer && frames == key_frames && modtime == key_modtime && interp == key_interp)
+		return false;
+
+	key_buffer = buffer;
+	key_frames = frames;
+	key_modtime = modtime;
+	key_interp = interp;
+
+	build_interp.store(interp, std::memory_order_relaxed);
+	generation.fetch_add(1, std::memory_order_release);
+	return true;
+}
+
+/********************************************************************************
+const float *NwWinCache::find(long length)
+
+inputs:			length		-- table length from nw_wincache_length()
+description:	perform routine side; looks for the window resampled to length
+returns:		the table, or NULL if it has not been built yet
+********************************************************************************/
+inline const float *NwWinCache::find(long length)
+{
+	long a;
+
+	if (ready.load(std::memory_order_acquire) != generation.load(std::memory_order_relaxed))
+		return NULL;
+
+	for (a = 0; a < NW_WINCACHE_SLOTS; a++) {
+		long l = slots[a].length.load(std::memory_order_acquire);
+		if (l == length)
+			return slots[a].table;
+		if (l == 0)		// slots fill from the front
+			break;
+	}
+	return NULL;
+}
+
+/********************************************************************************
+bool NwWinCache::request(long length)
+
+inputs:			length		-- table length from nw_wincache_length()
+description:	perform routine side; asks update() to build a table
+returns:		false if the request was dropped because the queue is full
+********************************************************************************/
+inline bool NwWinCache::request(long length)
+{
+	return requests.push(length);
+}
+
+/********************************************************************************
+void NwWinCache::update(const float *tab_w, long size_w)
+
+inputs:			tab_w		-- window buffer samples, mono, locked by the caller
+				size_w		-- frames in the window buffer
+description:	main thread side; clears the tables of an old generation, then
+		builds every requested length that is not held yet; each table reads
+		the window at length evenly spaced positions with the interpolation of
+		the generation, so that a grain of length samples reads it straight
+		through; a generation started meanwhile is left for the next update()
+returns:		nothing
+********************************************************************************/
+inline void NwWinCache::update(const float *tab_w, long size_w)
+{
+	long gen = generation.load(std::memory_order_acquire);
+	short interp = (short)build_interp.load(std::memory_order_relaxed);
+	double pos, step, out;
+	long length, a, k;
+	float *table;
+
+	if (gen != built) {
+		// the perform routine reads no slot until ready matches its generation
+		for (a = 0; a < NW_WINCACHE_SLOTS; a++) {
+			slots[a].length.store(0, std::memory_order_relaxed);
+			if (slots[a].table)
+				::free(slots[a].table);
+			slots[a].table = NULL;
+		}
+		built = gen;
+		ready.store(gen, std::memory_order_release);
+	}
+
+	while (requests.pop(&length)) {
+		if (size_w < 1 || length < 1 || length > NW_WINCACHE_LENGTH_MAX)
+			continue;
+
+		// find the length, or the first free slot
+		for (a = 0; a < NW_WINCACHE_SLOTS; a++) {
+			long l = slots[a].length.load(std::memory_order_relaxed);
+			if (l == length || l == 0)
+				break;
+		}
+		if (a == NW_WINCACHE_SLOTS || slots[a].length.load(std::memory_order_relaxed) == length)
+			continue;
+
+		table = (float *)malloc(length * sizeof(float));
+		if (!table)
+			continue;
+
+		step = (double)size_w / (double)length;
+		for (k = 0; k < length; k++) {
+			pos = k * step;
+			nw_interp<1, nw_wrap_loop>(interp, tab_w, size_w, 1, pos, &out);
+			table[k] = (float)out;
+		}
+
+		slots[a].table = table;
+		slots[a].length.store(length, std::memory_order_release);
+	}
+}
+
+#endif /* __NW_WINCACHE */
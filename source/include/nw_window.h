@@ -0,0 +1,348 @@
+/*
+** nw_window.h
+**
+** header file
+** analytic grain windows, free of any Max API calls, shared by the grain
+** objects and by the nw_bench profiling target; the shapes follow the files
+** in media/grain_windows, so a patch can pick one by name instead of loading
+** it into a window buffer~
+**
+** grains with a fixed step run a recurrence, cos x stepped by the two-term
+** cosine recurrence into a cubic for the cosine sums and running products for
+** the exponentials, so a window sample costs a few multiplies and no memory
+** reads; the recurrence is instantiated for each family, so a grain loop that
+** picks the family once reads its window without a branch; nw_window_value()
+** evaluates the same shapes directly for positions that do not move by a
+** fixed step
+**
+** Max allocates objects without running constructors, so a generator held in
+** an object struct is set up by start() rather than by a constructor
+**
+** Copyright © 2015 by Nathan Wolek
+** License: http://opensource.org/licenses/BSD-3-Clause
+**
+*/
+
+#ifndef __NW_WINDOW
+#define __NW_WINDOW
+
+#include <math.h>
+#include <string.h>
+#include "nw_interp.h"
+
+/* window shapes */
+#define NW_WINDOW_BUFFER			0	// read the window buffer~
+#define NW_WINDOW_HANNING			1
+#define NW_WINDOW_HAMMING			2
+#define NW_WINDOW_BLACKMAN			3
+#define NW_WINDOW_BLACKMAN_HARRIS	4
+#define NW_WINDOW_GAUSS				5
+#define NW_WINDOW_QUASI_GAUSS		6
+#define NW_WINDOW_EXPODEC			7
+#define NW_WINDOW_REXPODEC			8
+#define NW_WINDOW_3STAGE_LINEAR		9
+#define NW_WINDOW_TRIANGLE			10
+
+/* recurrences behind the shapes */
+#define NW_WINDOW_FAMILY_COSINE		1	// sum of cosines of the grain phase
+#define NW_WINDOW_FAMILY_GAUSS		2	// gaussian edges around a flat middle
+#define NW_WINDOW_FAMILY_RAMP		3	// least of two linear ramps and an exponential
+
+/* frames a grain steps through with an analytic window, in place of the frames
+   of a window buffer~ */
+#define NW_WINDOW_FRAMES			1024
+
+#define NW_WINDOW_ATTACK			0.02	// expodec attack, rexpodec release, in grains
+#define NW_WINDOW_PI				3.14159265358979323846
+
+/* a window shape with its parameter, and the constants derived from it */
+typedef struct _nw_window
+{
+	short type;				// NW_WINDOW_*
+	short family;			// NW_WINDOW_FAMILY_*, or 0 for NW_WINDOW_BUFFER
+	double param;			// as given to nw_window_set, after clipping
+	double a[4];			// cosine sum coefficients
+	double rise;			// gaussian: end of the rising edge, in grains
+	double fall;			// gaussian: start of the falling edge, in grains
+	double width;			// gaussian: deviation, in grains
+	double up_slope;		// ramp: rise per grain, 0 for none
+	double down_slope;		// ramp: fall per grain, 0 for none
+	double log_g0;			// ramp: log of the exponential at the start
+	double log_g_slope;		// ramp: change of that log per grain
+} t_nw_window;
+
+/********************************************************************************
+bool nw_window_set(t_nw_window *w, const char *name, bool has_param, double param)
+
+inputs:			w			-- receives the shape
+				name		-- "buffer" or a shape from media/grain_windows
+				has_param	-- false to use the default parameter
+				param		-- gauss width, or the flat part of quasi-gauss and
+							   3stage-linear, or the expodec and rexpodec decay;
+							   clipped to its range, ignored by other shapes
+description:	looks up a window shape by name; widths and flat parts are in
+		grains, decays are the log of the level they fall to over the grain
+returns:		false if the name is not a known shape, leaving w unchanged
+********************************************************************************/
+inline bool nw_window_set(t_nw_window *w, const char *name, bool has_param, double param)
+{
+	static const struct {
+		const char *name;
+		short type;
+		short family;
+		double def, min, max;	// parameter
+	} shapes[] = {
+		{ "buffer",				NW_WINDOW_BUFFER,			0,							0.,		0.,		0.		},
+		{ "hanning",			NW_WINDOW_HANNING,			NW_WINDOW_FAMILY_COSINE,	0.,		0.,		0.		},
+		{ "hamming",			NW_WINDOW_HAMMING,			NW_WINDOW_FAMILY_COSINE,	0.,		0.,		0.		},
+		{ "blackman",			NW_WINDOW_BLACKMAN,			NW_WINDOW_FAMILY_COSINE,	0.,		0.,		0.		},
+		{ "blackman-harris",	NW_WINDOW_BLACKMAN_HARRIS,	NW_WINDOW_FAMILY_COSINE,	0.,		0.,		0.		},
+		{ "gauss",				NW_WINDOW_GAUSS,			NW_WINDOW_FAMILY_GAUSS,		0.15,	0.05,	1.		},
+		{ "quasi-gauss",		NW_WINDOW_QUASI_GAUSS,		NW_WINDOW_FAMILY_GAUSS,		0.3,	0.,		0.9		},
+		{ "expodec",			NW_WINDOW_EXPODEC,			NW_WINDOW_FAMILY_RAMP,		5.,		0.,		40.		},
+		{ "rexpodec",			NW_WINDOW_REXPODEC,			NW_WINDOW_FAMILY_RAMP,		5.,		0.,		40.		},
+		{ "3stage-linear",		NW_WINDOW_3STAGE_LINEAR,	NW_WINDOW_FAMILY_RAMP,		0.3,	0.,		0.9		},
+		{ "triangle",			NW_WINDOW_TRIANGLE,			NW_WINDOW_FAMILY_RAMP,		0.,		0.,		0.		},
+	};
+	long i, count = (long)(sizeof(shapes) / sizeof(shapes[0]));
+	double ramp;
+
+	for (i = 0; i < count; i++) {
+		if (!strcmp(name, shapes[i].name))
+			break;
+	}
+	if (i == count)
+		return false;
+
+	if (!has_param) param = shapes[i].def;
+	if (param < shapes[i].min) param = shapes[i].min;
+	if (param > shapes[i].max) param = shapes[i].max;
+
+	memset(w, 0, sizeof(t_nw_window));
+	w->type = shapes[i].type;
+	w->family = shapes[i].family;
+	w->param = param;
+
+	switch (w->type) {
+		case NW_WINDOW_HANNING:
+			w->a[0] = 0.5; w->a[1] = 0.5;
+			break;
+		case NW_WINDOW_HAMMING:
+			w->a[0] = 0.54; w->a[1] = 0.46;
+			break;
+		case NW_WINDOW_BLACKMAN:
+			w->a[0] = 0.42; w->a[1] = 0.5; w->a[2] = 0.08;
+			break;
+		case NW_WINDOW_BLACKMAN_HARRIS:
+			w->a[0] = 0.35875; w->a[1] = 0.48829; w->a[2] = 0.14128; w->a[3] = 0.01168;
+			break;
+		case NW_WINDOW_GAUSS:
+			w->rise = w->fall = 0.5;
+			w->width = param;
+			break;
+		case NW_WINDOW_QUASI_GAUSS:
+			// each edge is half a gaussian that is 4 deviations wide
+			ramp = (1. - param) * 0.5;
+			w->rise = ramp;
+			w->fall = 1. - ramp;
+			w->width = ramp * 0.25;
+			break;
+		case NW_WINDOW_EXPODEC:
+			w->up_slope = 1. / NW_WINDOW_ATTACK;
+			w->log_g0 = param * NW_WINDOW_ATTACK;
+			w->log_g_slope = -param;
+			break;
+		case NW_WINDOW_REXPODEC:
+			w->down_slope = 1. / NW_WINDOW_ATTACK;
+			w->log_g0 = -param * (1. - NW_WINDOW_ATTACK);
+			w->log_g_slope = param;
+			break;
+		case NW_WINDOW_3STAGE_LINEAR:
+		case NW_WINDOW_TRIANGLE:
+			ramp = (1. - param) * 0.5;
+			w->up_slope = w->down_slope = 1. / ramp;
+			break;
+	}
+
+	return true;
+}
+
+/********************************************************************************
+double nw_window_value(const t_nw_window *w, double x)
+
+inputs:			w		-- an analytic shape
+				x		-- position in the grain, 0 to 1
+description:	evaluates a window directly, for windows whose position does
+		not move by a fixed step
+returns:		window value
+********************************************************************************/
+inline double nw_window_value(const t_nw_window *w, double x)
+{
+	double d, up, down, g;
+
+	switch (w->family) {
+		case NW_WINDOW_FAMILY_COSINE:
+			d = 2. * NW_WINDOW_PI * x;
+			return w->a[0] - w->a[1] * cos(d) + w->a[2] * cos(2. * d) - w->a[3] * cos(3. * d);
+		case NW_WINDOW_FAMILY_GAUSS:
+			if (x < w->rise) {
+				d = (x - w->rise) / w->width;
+			} else if (x > w->fall) {
+				d = (x - w->fall) / w->width;
+			} else {
+				return 1.;
+			}
+			return exp(-0.5 * d * d);
+		case NW_WINDOW_FAMILY_RAMP:
+			up = (w->up_slope > 0.) ? x * w->up_slope : HUGE_VAL;
+			down = (w->down_slope > 0.) ? (1. - x) * w->down_slope : HUGE_VAL;
+			g = exp(w->log_g0 + w->log_g_slope * x);
+			if (down < up) up = down;
+			return (g < up) ? g : up;
+	}
+	return 0.;
+}
+
+/********************************************************************************
+class NwWindowGen
+
+description:	steps an analytic window through one grain a sample at a time;
+		type is NW_WINDOW_BUFFER until start() is given a shape; the caller
+		picks next() for the family of the shape
+********************************************************************************/
+class NwWindowGen
+{
+public:
+	short type;					// NW_WINDOW_* of the shape being played
+	short family;				// NW_WINDOW_FAMILY_* of the shape being played
+
+	void start(const t_nw_window *w, double samples, double pos);
+	template <short Family>
+	NW_FORCEINLINE double next(void);
+
+private:
+	void seed(void);
+
+	t_nw_window shape;
+	double x0, dx;				// position of the first sample and the step, in grains
+	double c, c_prev, k;		// cosine: cos x at this sample and the last, 2 cos dx
+	double p[4];				// cosine: the sum as a cubic in cos x
+	double g, r, q;				// gaussian: value, ratio to the next, change of ratio
+	double up, up_inc, down, down_inc;	// ramp: linear ramps, g and q hold the exponential
+	long n;						// samples played since start()
+	long seed_flat, seed_fall;	// gaussian: samples at which the edges change
+};
+
+/********************************************************************************
+void NwWindowGen::start(const t_nw_window *w, double samples, double pos)
+
+inputs:			w			-- shape to play, copied
+				samples		-- grain length, in output samples
+				pos			-- position of the first sample, 0 to 1
+description:	sets up the recurrence for a grain; pos is non-zero when a
+		grain already sounding switches shape
+returns:		nothing
+********************************************************************************/
+inline void NwWindowGen::start(const t_nw_window *w, double samples, double pos)
+{
+	type = w->type;
+	family = w->family;
+	if (type == NW_WINDOW_BUFFER)
+		return;
+
+	shape = *w;
+	x0 = pos;
+	dx = (samples > 0.) ? 1. / samples : 1.;
+	n = 0;
+
+	switch (shape.family) {
+		case NW_WINDOW_FAMILY_COSINE:
+			// cos 2x = 2c^2 - 1 and cos 3x = 4c^3 - 3c; the recurrence drifts
+			// by under 1e-6 over a ten second grain at 96 kHz
+			p[0] = shape.a[0] - shape.a[2];
+			p[1] = -shape.a[1] + 3. * shape.a[3];
+			p[2] = 2. * shape.a[2];
+			p[3] = -4. * shape.a[3];
+			c = cos(2. * NW_WINDOW_PI * x0);
+			c_prev = cos(2. * NW_WINDOW_PI * (x0 - dx));
+			k = 2. * cos(2. * NW_WINDOW_PI * dx);
+			break;
+		case NW_WINDOW_FAMILY_GAUSS:
+			// samples before the flat middle, then before the falling edge
+			seed_flat = (long)ceil((shape.rise - x0) / dx);
+			seed_fall = (long)floor((shape.fall - x0) / dx) + 1;
+			if (seed_flat < 0) seed_flat = 0;
+			if (seed_fall < seed_flat) seed_fall = seed_flat;
+			seed();
+			break;
+		case NW_WINDOW_FAMILY_RAMP:
+			up = (shape.up_slope > 0.) ? x0 * shape.up_slope : HUGE_VAL;
+			up_inc = shape.up_slope * dx;
+			down = (shape.down_slope > 0.) ? (1. - x0) * shape.down_slope : HUGE_VAL;
+			down_inc = shape.down_slope * dx;
+			g = exp(shape.log_g0 + shape.log_g_slope * x0);
+			q = exp(shape.log_g_slope * dx);
+			break;
+	}
+}
+
+/********************************************************************************
+void NwWindowGen::seed(void)
+
+inputs:			nothing
+description:	restarts the gaussian recurrence for the edge the next sample
+		falls in; the ratio of neighbouring samples of exp(-u*u/2) changes by
+		the same factor every sample, so two multiplies step it exactly
+returns:		nothing
+********************************************************************************/
+inline void NwWindowGen::seed(void)
+{
+	double x = x0 + n * dx;
+	double u, du;
+
+	if (n >= seed_flat && n < seed_fall) {
+		g = r = q = 1.;
+		return;
+	}
+
+	u = (x - (n < seed_flat ? shape.rise : shape.fall)) / shape.width;
+	du = dx / shape.width;
+	g = exp(-0.5 * u * u);
+	r = exp(-(u * du + 0.5 * du * du));
+	q = exp(-du * du);
+}
+
+/********************************************************************************
+double NwWindowGen::next<Family>(void)
+
+inputs:			Family		-- NW_WINDOW_FAMILY_* of the shape started
+description:	reads the window at the current sample and steps to the next
+returns:		window value
+********************************************************************************/
+template <short Family>
+NW_FORCEINLINE double NwWindowGen::next(void)
+{
+	double out, t;
+
+	if (Family == NW_WINDOW_FAMILY_COSINE) {
+		out = ((p[3] * c + p[2]) * c + p[1]) * c + p[0];
+		t = k * c - c_prev;	// cos(x + dx) = 2 cos dx cos x - cos(x - dx)
+		c_prev = c;
+		c = t;
+	} else if (Family == NW_WINDOW_FAMILY_GAUSS) {
+		out = g;
+		g *= r;
+		r *= q;
+		if (++n == seed_flat || n == seed_fall)
+			seed();
+	} else {	// NW_WINDOW_FAMILY_RAMP
+		out = (up < down) ? up : down;
+		if (g < out) out = g;
+		up += up_inc;
+		down -= down_inc;
+		g *= q;
+	}
+	return out;
+}
+
+#endif /* __NW_WINDOW */
@@ -0,0 +1,562 @@
+/*
+** cppan_dsp.h
+**
+** header file
+** constant power panning for nw.cppan~, free of any Max API calls so that it
+** can also be driven by the nw_bench profiling target
+**
+** with more than two speakers the outputs form a ring, output k sitting at
+** position k / speakers, and a source is panned with equal power between the
+** two neighbours it falls between, as 2d vbap does for a ring of equally
+** spaced speakers
+**
+** Max allocates objects without running constructors, so a CpPan held in an
+** object struct is set up by init() rather than by a constructor
+**
+** Copyright © 2002,2015 by Nathan Wolek
+** License: http://opensource.org/licenses/BSD-3-Clause
+**
+*/
+
+#ifndef __CPPAN_DSP
+#define __CPPAN_DSP
+
+#include <math.h>
+#include <string.h>
+
+#include "nw_interp.h"		// for NW_FORCEINLINE
+#include "nw_simd.h"
+
+#define TABLE_COEFF		(sqrt(2.0) / 2.0)	// coefficient used in calculating gains
+#define CPPAN_RAMP_MS	10.0				// time to glide to a new float position
+#define CPPAN_SPEAKERS_MIN	2				// left and right
+#define CPPAN_SPEAKERS_MAX	32				// largest ring
+
+/*
+** the gains for position p are TABLE_COEFF * (cos(a) + sin(a)) on the left and
+** TABLE_COEFF * (cos(a) - sin(a)) on the right, with a = pi/4 - p * pi/2; as
+** |a| <= pi/4, taylor series to a^11 and a^12 are good to about 1e-11, which
+** lets the audio rate kernels compute exact gains for every sample without
+** any table lookups
+*/
+#define CPPAN_PI_4		0.78539816339744830962
+#define CPPAN_PI_2		1.57079632679489661923
+#define CPPAN_SIN_3		(-1.0 / 6.0)
+#define CPPAN_SIN_5		(1.0 / 120.0)
+#define CPPAN_SIN_7		(-1.0 / 5040.0)
+#define CPPAN_SIN_9		(1.0 / 362880.0)
+#define CPPAN_SIN_11	(-1.0 / 39916800.0)
+#define CPPAN_COS_2		(-1.0 / 2.0)
+#define CPPAN_COS_4		(1.0 / 24.0)
+#define CPPAN_COS_6		(-1.0 / 720.0)
+#define CPPAN_COS_8		(1.0 / 40320.0)
+#define CPPAN_COS_10	(-1.0 / 3628800.0)
+#define CPPAN_COS_12	(1.0 / 479001600.0)
+
+typedef void (*t_cppan_kernel)(const double *in, const double *pan_in, double *outL, double *outR, long n);
+
+class CpPan
+{
+public:
+	double curr_pos;		// position set by setPos(), where control mode settles
+	double ramp_pos;		// position control mode is at, gliding toward curr_pos
+	double ramp_inc;		// change in ramp_pos per sample
+	long ramp_left;			// samples until ramp_pos reaches curr_pos
+	long ramp_length;		// samples in a glide, 0 until the sample rate is known
+	double curr_multL;		// gains at ramp_pos; in a ring, of ring_index and
+	double curr_multR;		// ring_index_b, the speaker after it
+	long ring_index;
+	long ring_index_b;
+	long speakers;			// 2 for left and right, more for a ring
+	double audio_pos;		// last position read in audio mode
+	t_cppan_kernel audio_kernel;	// fastest audio rate kernel for this processor
+
+	bool init(double initial_pos);
+	void setSampleRate(double sr);
+	void setSpeakers(long n);
+	bool setPos(double f);
+	void setGains(double pos);
+	void processControl(const double *in, double *outL, double *outR, long n);
+	void processAudio(const double *in, const double *pan_in, double *outL, double *outR, long n);
+	void processRingControl(const double *in, double **outs, long n);
+	void processRingAudio(const double *in, const double *pan_in, double **outs, long n);
+};
+
+/********************************************************************************
+void cppan_gains(double pos, double *multL, double *multR)
+
+inputs:			pos		-- pan position, 0 to 1
+				multL	-- receives the left channel gain
+				multR	-- receives the right channel gain
+description:	equal power gains for a position
+returns:		nothing
+********************************************************************************/
+NW_FORCEINLINE void cppan_gains(double pos, double *multL, double *multR)
+{
+	double a = CPPAN_PI_4 - pos * CPPAN_PI_2;
+	double a2 = a * a;
+	double s = a * (1.0 + a2 * (CPPAN_SIN_3 + a2 * (CPPAN_SIN_5 + a2 * (CPPAN_SIN_7
+				+ a2 * (CPPAN_SIN_9 + a2 * CPPAN_SIN_11)))));
+	double c = 1.0 + a2 * (CPPAN_COS_2 + a2 * (CPPAN_COS_4 + a2 * (CPPAN_COS_6
+				+ a2 * (CPPAN_COS_8 + a2 * (CPPAN_COS_10 + a2 * CPPAN_COS_12)))));
+
+	*multL = TABLE_COEFF * (c + s);
+	*multR = TABLE_COEFF * (c - s);
+}
+
+/********************************************************************************
+void cppan_ringGains(double pos, long speakers, long *index, long *index_b,
+		double *multA, double *multB)
+
+inputs:			pos		-- pan position, wrapped to 0 to 1
+				speakers -- number of speakers in the ring
+				index	-- receives the speaker at or before the position
+				index_b	-- receives the speaker after it
+				multA	-- receives the gain of that speaker
+				multB	-- receives the gain of the speaker after it
+description:	equal power gains between the two neighbours of a position on
+		a ring of equally spaced speakers
+returns:		nothing
+********************************************************************************/
+NW_FORCEINLINE void cppan_ringGains(double pos, long speakers, long *index, long *index_b,
+		double *multA, double *multB)
+{
+	double x = (pos - floor(pos)) * (double)speakers;
+	long k = (long)x;
+
+	if (k >= speakers)		// a position just under 1 can round up
+	{
+		k = 0;
+		x = 0.0;
+	}
+
+	*index = k;
+	*index_b = (k + 1 < speakers) ? k + 1 : 0;
+	cppan_gains(x - (double)k, multA, multB);
+}
+
+/********************************************************************************
+void cppan_audioScalar(const double *in, const double *pan_in, double *outL,
+		double *outR, long n)
+
+inputs:			in			-- input signal
+				pan_in		-- pan position signal, clipped to 0 to 1
+				outL		-- left channel output
+				outR		-- right channel output
+				n			-- number of samples
+description:	pans with a position read every sample; the vector kernels
+		finish their blocks here
+returns:		nothing
+********************************************************************************/
+inline void cppan_audioScalar(const double *in, const double *pan_in, double *outL, double *outR, long n)
+{
+    double val, pan_val, multL, multR;
+
+    while(n--)
+    {
+        pan_val = *pan_in;
+
+        // check constraints
+        if (pan_val < 0.0)
+            pan_val = 0.0;
+        else if (pan_val > 1.0)
+            pan_val = 1.0;
+
+        cppan_gains(pan_val, &multL, &multR);
+
+        val = *in;
+        *outL = multL * val;
+        *outR = multR * val;
+
+        ++in, ++outL, ++outR, ++pan_in;				// advance the pointers
+    }
+}
+
+#if NW_SIMD_X86
+
+/********************************************************************************
+void cppan_audioSSE2(const double *in, const double *pan_in, double *outL,
+		double *outR, long n)
+
+inputs:			(as cppan_audioScalar)
+description:	pans two samples at a time
+returns:		nothing
+********************************************************************************/
+inline void cppan_audioSSE2(const double *in, const double *pan_in, double *outL, double *outR, long n)
+{
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d pi_4 = _mm_set1_pd(CPPAN_PI_4);
+    const __m128d pi_2 = _mm_set1_pd(CPPAN_PI_2);
+    const __m128d coeff = _mm_set1_pd(TABLE_COEFF);
+    __m128d a, a2, s, c, val;
+    long i;
+
+    for (i = 0; i + 2 <= n; i += 2) {
+        a = _mm_max_pd(_mm_min_pd(_mm_loadu_pd(pan_in + i), one), zero);
+        a = _mm_sub_pd(pi_4, _mm_mul_pd(a, pi_2));
+        a2 = _mm_mul_pd(a, a);
+
+        s = _mm_add_pd(_mm_set1_pd(CPPAN_SIN_9), _mm_mul_pd(a2, _mm_set1_pd(CPPAN_SIN_11)));
+        s = _mm_add_pd(_mm_set1_pd(CPPAN_SIN_7), _mm_mul_pd(a2, s));
+        s = _mm_add_pd(_mm_set1_pd(CPPAN_SIN_5), _mm_mul_pd(a2, s));
+        s = _mm_add_pd(_mm_set1_pd(CPPAN_SIN_3), _mm_mul_pd(a2, s));
+        s = _mm_mul_pd(a, _mm_add_pd(one, _mm_mul_pd(a2, s)));
+
+        c = _mm_add_pd(_mm_set1_pd(CPPAN_COS_10), _mm_mul_pd(a2, _mm_set1_pd(CPPAN_COS_12)));
+        c = _mm_add_pd(_mm_set1_pd(CPPAN_COS_8), _mm_mul_pd(a2, c));
+        c = _mm_add_pd(_mm_set1_pd(CPPAN_COS_6), _mm_mul_pd(a2, c));
+        c = _mm_add_pd(_mm_set1_pd(CPPAN_COS_4), _mm_mul_pd(a2, c));
+        c = _mm_add_pd(_mm_set1_pd(CPPAN_COS_2), _mm_mul_pd(a2, c));
+        c = _mm_add_pd(one, _mm_mul_pd(a2, c));
+
+        val = _mm_mul_pd(_mm_loadu_pd(in + i), coeff);
+        _mm_storeu_pd(outL + i, _mm_mul_pd(val, _mm_add_pd(c, s)));
+        _mm_storeu_pd(outR + i, _mm_mul_pd(val, _mm_sub_pd(c, s)));
+    }
+
+    cppan_audioScalar(in + i, pan_in + i, outL + i, outR + i, n - i);
+}
+
+/********************************************************************************
+void cppan_audioAVX2(const double *in, const double *pan_in, double *outL,
+		double *outR, long n)
+
+inputs:			(as cppan_audioScalar)
+description:	pans four samples at a time
+returns:		nothing
+********************************************************************************/
+NW_TARGET_AVX2 inline void cppan_audioAVX2(const double *in, const double *pan_in, double *outL, double *outR, long n)
+{
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d pi_4 = _mm256_set1_pd(CPPAN_PI_4);
+    const __m256d pi_2 = _mm256_set1_pd(CPPAN_PI_2);
+    const __m256d coeff = _mm256_set1_pd(TABLE_COEFF);
+    __m256d a, a2, s, c, val;
+    long i;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        a = _mm256_max_pd(_mm256_min_pd(_mm256_loadu_pd(pan_in + i), one), zero);
+        a = _mm256_sub_pd(pi_4, _mm256_mul_pd(a, pi_2));
+        a2 = _mm256_mul_pd(a, a);
+
+        s = _mm256_add_pd(_mm256_set1_pd(CPPAN_SIN_9), _mm256_mul_pd(a2, _mm256_set1_pd(CPPAN_SIN_11)));
+        s = _mm256_add_pd(_mm256_set1_pd(CPPAN_SIN_7), _mm256_mul_pd(a2, s));
+        s = _mm256_add_pd(_mm256_set1_pd(CPPAN_SIN_5), _mm256_mul_pd(a2, s));
+        s = _mm256_add_pd(_mm256_set1_pd(CPPAN_SIN_3), _mm256_mul_pd(a2, s));
+        s = _mm256_mul_pd(a, _mm256_add_pd(one, _mm256_mul_pd(a2, s)));
+
+        c = _mm256_add_pd(_mm256_set1_pd(CPPAN_COS_10), _mm256_mul_pd(a2, _mm256_set1_pd(CPPAN_COS_12)));
+        c = _mm256_add_pd(_mm256_set1_pd(CPPAN_COS_8), _mm256_mul_pd(a2, c));
+        c = _mm256_add_pd(_mm256_set1_pd(CPPAN_COS_6), _mm256_mul_pd(a2, c));
+        c = _mm256_add_pd(_mm256_set1_pd(CPPAN_COS_4), _mm256_mul_pd(a2, c));
+        c = _mm256_add_pd(_mm256_set1_pd(CPPAN_COS_2), _mm256_mul_pd(a2, c));
+        c = _mm256_add_pd(one, _mm256_mul_pd(a2, c));
+
+        val = _mm256_mul_pd(_mm256_loadu_pd(in + i), coeff);
+        _mm256_storeu_pd(outL + i, _mm256_mul_pd(val, _mm256_add_pd(c, s)));
+        _mm256_storeu_pd(outR + i, _mm256_mul_pd(val, _mm256_sub_pd(c, s)));
+    }
+
+    // avoid the penalty for mixing avx and sse code in the rest of the chain
+    _mm256_zeroupper();
+
+    cppan_audioScalar(in + i, pan_in + i, outL + i, outR + i, n - i);
+}
+
+#endif /* NW_SIMD_X86 */
+
+/********************************************************************************
+bool CpPan::init(double initial_pos)
+
+inputs:			initial_pos		-- initial position of pan
+description:	chooses the audio rate kernel and sets the initial position
+returns:		false if the position is out of range, as setPos()
+********************************************************************************/
+inline bool CpPan::init(double initial_pos)
+{
+	audio_kernel = cppan_audioScalar;
+#if NW_SIMD_X86
+	if (nw_cpu_has_avx2())
+		audio_kernel = cppan_audioAVX2;
+	else if (nw_cpu_has_sse2())
+		audio_kernel = cppan_audioSSE2;
+#endif
+
+	// no glide until the sample rate is known
+	ramp_length = 0;
+	ramp_left = 0;
+	ramp_inc = 0.0;
+	speakers = CPPAN_SPEAKERS_MIN;
+	curr_pos = ramp_pos = audio_pos = 0.5;
+	setGains(ramp_pos);
+
+	return setPos(initial_pos);
+}
+
+/********************************************************************************
+void CpPan::setSpeakers(long n)
+
+inputs:			n		-- number of outputs, clipped to CPPAN_SPEAKERS_MIN to
+						CPPAN_SPEAKERS_MAX
+description:	chooses left and right panning for 2 speakers, or a ring
+returns:		nothing
+********************************************************************************/
+inline void CpPan::setSpeakers(long n)
+{
+	if (n < CPPAN_SPEAKERS_MIN) n = CPPAN_SPEAKERS_MIN;
+	if (n > CPPAN_SPEAKERS_MAX) n = CPPAN_SPEAKERS_MAX;
+
+	speakers = n;
+	setGains(ramp_pos);
+}
+
+/********************************************************************************
+void CpPan::setGains(double pos)
+
+inputs:			pos		-- pan position, 0 to 1
+description:	sets "curr_multL", "curr_multR" and the ring indices for a position
+returns:		nothing
+********************************************************************************/
+inline void CpPan::setGains(double pos)
+{
+	if (speakers > CPPAN_SPEAKERS_MIN)
+	{
+		cppan_ringGains(pos, speakers, &ring_index, &ring_index_b, &curr_multL, &curr_multR);
+	}
+	else
+	{
+		ring_index = 0;
+		ring_index_b = 1;
+		cppan_gains(pos, &curr_multL, &curr_multR);
+	}
+}
+
+/********************************************************************************
+void CpPan::setSampleRate(double sr)
+
+inputs:			sr		-- sample rate
+description:	sets the length of the glide to a new float position
+returns:		nothing
+********************************************************************************/
+inline void CpPan::setSampleRate(double sr)
+{
+	ramp_length = (long)(CPPAN_RAMP_MS * 0.001 * sr + 0.5);
+	if (ramp_length < 1)
+		ramp_length = 1;
+}
+
+/********************************************************************************
+bool CpPan::setPos(double f)
+
+inputs:			f		-- pan position, 0 to 1
+description:	sets "curr_pos" and starts the glide of control mode toward it;
+		in a ring the glide takes the shorter way round; before the sample
+		rate is known the position is taken at once
+returns:		false if the position is out of range and was ignored
+********************************************************************************/
+inline bool CpPan::setPos(double f)
+{
+	double dist;
+
+	if (f >= 0.0 && f <= 1.0) // if within 0 and 1
+	{
+		curr_pos = f;
+
+		if (ramp_length > 0)
+		{
+			dist = f - ramp_pos;
+			if (speakers > CPPAN_SPEAKERS_MIN)
+				dist -= floor(dist + 0.5);
+
+			ramp_inc = dist / (double)ramp_length;
+			ramp_left = ramp_length;
+		}
+		else
+		{
+			ramp_pos = f;
+			ramp_left = 0;
+			setGains(ramp_pos);
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+/********************************************************************************
+void CpPan::processControl(const double *in, double *outL, double *outR, long n)
+
+inputs:			in			-- input signal
+				outL		-- left channel output
+				outR		-- right channel output
+				n			-- number of samples
+description:	pans with the position set by setPos(), gliding to it over
+		CPPAN_RAMP_MS after a change
+returns:		nothing
+********************************************************************************/
+inline void CpPan::processControl(const double *in, double *outL, double *outR, long n)
+{
+    double multL = curr_multL;			// get current left channel multiplier
+    double multR = curr_multR;			// get current right channel multiplier
+    double pos = ramp_pos;
+    long left = ramp_left;
+    double val;
+
+    // glide, with gains computed every sample
+    while (n && left)
+    {
+        pos = (--left == 0) ? curr_pos : pos + ramp_inc;
+        cppan_gains(pos, &multL, &multR);
+
+        val = *in;
+        *outL = multL * val;
+        *outR = multR * val;
+
+        ++in, ++outL, ++outR, --n;			// advance the pointers
+    }
+
+    while(n--)
+    {
+        val = *in;
+        *outL = multL * val;				// multiply left value by gain
+        *outR = multR * val;				// multiply right value by gain
+
+        ++in, ++outL, ++outR;				// advance the pointers
+    }
+
+    // update object variables
+    ramp_pos = pos;
+    ramp_left = left;
+    curr_multL = multL;
+    curr_multR = multR;
+}
+
+/********************************************************************************
+void CpPan::processAudio(const double *in, const double *pan_in, double *outL,
+		double *outR, long n)
+
+inputs:			in			-- input signal
+				pan_in		-- pan position signal, clipped to 0 to 1
+				outL		-- left channel output
+				outR		-- right channel output
+				n			-- number of samples
+description:	pans with a position read every sample
+returns:		nothing
+********************************************************************************/
+inline void CpPan::processAudio(const double *in, const double *pan_in, double *outL, double *outR, long n)
+{
+    if (n <= 0)
+        return;
+
+    audio_kernel(in, pan_in, outL, outR, n);
+
+    // update object variables
+    audio_pos = pan_in[n - 1] < 0.0 ? 0.0 : (pan_in[n - 1] > 1.0 ? 1.0 : pan_in[n - 1]);
+}
+
+/********************************************************************************
+void CpPan::processRingControl(const double *in, double **outs, long n)
+
+inputs:			in			-- input signal
+				outs		-- one output per speaker
+				n			-- number of samples
+description:	pans around the ring with the position set by setPos(); only
+		the active pair is written, the other outputs are zeroed a block at a
+		time
+returns:		nothing
+********************************************************************************/
+inline void CpPan::processRingControl(const double *in, double **outs, long n)
+{
+    double multA = curr_multL;
+    double multB = curr_multR;
+    double pos = ramp_pos;
+    long left = ramp_left;
+    long num_speakers = speakers;
+    long index = ring_index;
+    long index_b = ring_index_b;
+    long i = 0, j;
+    double val;
+
+    if (left)
+    {
+        // glide, the active pair can change from sample to sample
+        for (j = 0; j < num_speakers; j++)
+            memset(outs[j], 0, n * sizeof(double));
+
+        for (; i < n && left; i++)
+        {
+            pos = (--left == 0) ? curr_pos : pos + ramp_inc;
+            cppan_ringGains(pos, num_speakers, &index, &index_b, &multA, &multB);
+
+            val = in[i];
+            outs[index][i] = multA * val;
+            outs[index_b][i] = multB * val;
+        }
+
+        pos -= floor(pos);
+    }
+    else
+    {
+        for (j = 0; j < num_speakers; j++)
+            if (j != index && j != index_b)
+                memset(outs[j], 0, n * sizeof(double));
+    }
+
+    for (; i < n; i++)
+    {
+        val = in[i];
+        outs[index][i] = multA * val;
+        outs[index_b][i] = multB * val;
+    }
+
+    // update object variables
+    ramp_pos = pos;
+    ramp_left = left;
+    ring_index = index;
+    ring_index_b = index_b;
+    curr_multL = multA;
+    curr_multR = multB;
+}
+
+/********************************************************************************
+void CpPan::processRingAudio(const double *in, const double *pan_in, double **outs,
+		long n)
+
+inputs:			in			-- input signal
+				pan_in		-- pan position signal, wrapped to 0 to 1
+				outs		-- one output per speaker
+				n			-- number of samples
+description:	pans around the ring with a position read every sample; the
+		outputs are zeroed a block at a time, then each sample is written to
+		its active pair only
+returns:		nothing
+********************************************************************************/
+inline void CpPan::processRingAudio(const double *in, const double *pan_in, double **outs, long n)
+{
+    long num_speakers = speakers;
+    long index, index_b, i, j;
+    double multA, multB, val;
+
+    if (n <= 0)
+        return;
+
+    for (j = 0; j < num_speakers; j++)
+        memset(outs[j], 0, n * sizeof(double));
+
+    for (i = 0; i < n; i++)
+    {
+        cppan_ringGains(pan_in[i], num_speakers, &index, &index_b, &multA, &multB);
+
+        val = in[i];
+        outs[index][i] = multA * val;
+        outs[index_b][i] = multB * val;
+    }
+
+    // update object variables
+    audio_pos = pan_in[n - 1] - floor(pan_in[n - 1]);
+}
+
+#endif /* __CPPAN_DSP */
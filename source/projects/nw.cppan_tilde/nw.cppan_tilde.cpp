@@ -2,7 +2,8 @@
 ** nw.cppan~.c
 **
 ** MSP object
-** allows mono input signal to be panned across two output channels
+** allows mono input signal to be panned across two output channels, or around
+** a ring of speakers with @speakers
 ** 2001/03/22 started by Nathan Wolek
 **
 ** Copyright © 2001,2014 by Nathan Wolek
@@ -12,6 +13,7 @@
 
 
 #include "c74_msp.h"
+#include "cppan_dsp.h"
 
 using namespace c74::max;
 
@@ -24,10 +26,6 @@ using namespace c74::max;
 #define ASSIST_OUTLET	2
 
 #define DEFAULT_POS		0.5					// default position, when no argument given
-#define TABLE_SIZE 		1024				// size of table used for panning function
-#define TABLE_COEFF		(sqrt(2.0) / 2.0)	// coefficient used in calculating table
-#define DtoR 			2.0 * 3.1415927 / 360.0
-						// allows easy conversion from degrees to radians
 
 static t_class *cpPan_class;		// required global pointer to this class
 
@@ -35,28 +33,26 @@ static t_class *cpPan_class;		// required global pointer to this class
 typedef struct _cpPan
 {
 	t_pxobject x_obj;
-	float curr_pos;
-	long curr_index;
-	float curr_multL;
-	float curr_multR;
-	float table_left[TABLE_SIZE];
-	float table_right[TABLE_SIZE];
+	CpPan pan;							// panning tables and position
+	long speakers;						// number of signal outlets
+	short outlets_made;					// speakers is fixed once the outlets exist
 } t_cpPan;
 
 /* method definitions for this object */
-void cpPan_fillTables(t_cpPan *x);
-void *cpPan_new(double initial_pos);
+void *cpPan_new(t_symbol *s, long argc, t_atom *argv);
 void cpPan_dsp64(t_cpPan *x, t_object *dsp64, short *count, double samplerate,
                   long maxvectorsize, long flags);
 void cpPan_perform64c(t_cpPan *x, t_object *dsp64, double **ins, long numins, double **outs,long numouts, long vectorsize, long flags, void *userparam);
 void cpPan_perform64a(t_cpPan *x, t_object *dsp64, double **ins, long numins, double **outs,long numouts, long vectorsize, long flags, void *userparam);
+void cpPan_perform64rc(t_cpPan *x, t_object *dsp64, double **ins, long numins, double **outs,long numouts, long vectorsize, long flags, void *userparam);
+void cpPan_perform64ra(t_cpPan *x, t_object *dsp64, double **ins, long numins, double **outs,long numouts, long vectorsize, long flags, void *userparam);
 void cpPan_float(t_cpPan *x, double f);
 void cpPan_setPosVars(t_cpPan *x, double f);
 void cpPan_assist(t_cpPan *x, t_object *b, long msg, long arg, char *s);
 void cpPan_getinfo(t_cpPan *x);
+t_max_err cpPan_speakers_set(t_cpPan *x, void *attr, long argc, t_atom *argv);
 /* method definitions for debugging this object */
 #ifdef DEBUG
-	void cpPan_table(t_cpPan *x, long value);
 	void cpPan_position(t_cpPan *x);
 #endif /* DEBUG */
 
@@ -72,12 +68,17 @@ int C74_EXPORT main(void)
 {
     t_class *c;
     
-    c = class_new(OBJECT_NAME, (method)cpPan_new, (method)dsp_free, (short)sizeof(t_cpPan), 0L,
-                  A_DEFFLOAT, 0);
+    c = class_new(OBJECT_NAME, (method)cpPan_new, (method)dsp_free, (long)sizeof(t_cpPan), 0L,
+                  A_GIMME, 0);
     class_dspinit(c); // add standard functions to class
 	
+	/* number of outlets, 2 for left and right or more for a ring */
+	CLASS_ATTR_LONG(c, "speakers", 0, t_cpPan, speakers);
+	CLASS_ATTR_ACCESSORS(c, "speakers", NULL, cpPan_speakers_set);
+	CLASS_ATTR_FILTER_CLIP(c, "speakers", CPPAN_SPEAKERS_MIN, CPPAN_SPEAKERS_MAX);
+	CLASS_ATTR_LABEL(c, "speakers", 0, "Number of Speakers");
+	
 	#ifdef DEBUG
-		class_addmethod(c, (method)cpPan_table, "table", A_DEFLONG, 0);
 		class_addmethod(c, (method)cpPan_position, "position", 0);
 	#endif /* DEBUG */
 	
@@ -105,57 +106,39 @@ int C74_EXPORT main(void)
 }
 
 /********************************************************************************
-void cpPan_fillTables(t_cpPan *x)
-
-inputs:			x		-- pointer to this object
-description:	fills "table_left" and "table_right" with values used to determine 
-		amplitude of each channel during panning
-returns:		nothing
-********************************************************************************/
-void cpPan_fillTables(t_cpPan *x)
-{
-	float *tab_a = (float *)(x->table_left);		// get pointer to table_left
-	float *tab_b = (float *)(x->table_right);		// get pointer to table_right
-	long n = TABLE_SIZE;							// set counter equal to TABLE_SIZE
-	float pos_deg, pos_rad;							// initial loop vars
-	float degtorad = DtoR;
-	float tab_coeff = TABLE_COEFF;
-	
-	while (--n >= 0) {
-		pos_deg = ((float)n / (float)(TABLE_SIZE-1)) * -90.0 + 45.0;	// current position in degrees
-		pos_rad = pos_deg * degtorad;					// convert to radians
-		
-		/* fill table with values */
-// WINDOWS CANT LINK THESE, SO I SWAPPED THEM OUT	-TAP (2004.08.05)
-//		tab_a[n] = tab_coeff * (cosf(pos_rad) + sinf(pos_rad));
-//		tab_b[n] = tab_coeff * (cosf(pos_rad) - sinf(pos_rad));
-		tab_a[n] = tab_coeff * (cos(pos_rad) + sin(pos_rad));
-		tab_b[n] = tab_coeff * (cos(pos_rad) - sin(pos_rad));
-	}
-	
-	#ifdef DEBUG
-		object_post((t_object*)x, "Tables filled");
-	#endif /* DEBUG */
-}
-
-/********************************************************************************
-void *cpPan_new(double initial_pos)
+void *cpPan_new(t_symbol *s, long argc, t_atom *argv)
 
-inputs:			initial_pos		-- object argument 1; initial position of pan
+inputs:			s		-- name of the object
+				argc	-- number of arguments
+				argv	-- argument 1 is the initial position of pan, followed by
+						attributes
 description:	called for each new instance of object in the MAX environment;
-		defines inlets and outlets; sets argument for "initial_pos"
+		defines inlets and one outlet per speaker; sets argument for
+		"initial_pos"
 returns:		nothing
 ********************************************************************************/
-void *cpPan_new(double initial_pos)
+void *cpPan_new(t_symbol *s, long argc, t_atom *argv)
 {
 	t_cpPan *x = (t_cpPan *) object_alloc((t_class*) cpPan_class);
+	long attrstart = attr_args_offset((short)argc, argv);
+	double initial_pos = attrstart > 0 ? atom_getfloat(argv) : 0.0;
+	long i;
+	
+	/* process attributes first, @speakers decides the number of outlets */
+	x->speakers = CPPAN_SPEAKERS_MIN;
+	attr_args_process(x, (short)argc, argv);
 	
 	dsp_setup((t_pxobject *)x, 2);					// two inlets
-	outlet_new((t_pxobject *)x, "signal");			// left outlet
-	outlet_new((t_pxobject *)x, "signal");			// right outlet
+	for (i = 0; i < x->speakers; i++)
+		outlet_new((t_pxobject *)x, "signal");		// one outlet per speaker
+	x->outlets_made = 1;
 	
-	cpPan_fillTables(x);							// fill the tables
-	cpPan_setPosVars(x, initial_pos);				// set the initial position
+	// set the initial position, the center if it is out of range
+	if (!x->pan.init(initial_pos))
+	{
+		object_post((t_object*)x, "pan value is out of range");
+	}
+	x->pan.setSpeakers(x->speakers);
 	
 	x->x_obj.z_misc = Z_NO_INPLACE;
 	
@@ -188,7 +171,19 @@ void cpPan_dsp64(t_cpPan *x, t_object *dsp64, short *count, double samplerate,
         object_post((t_object*)x, "adding 64 bit perform method");
     #endif /* DEBUG */
     
-    if (count[1])
+    x->pan.setSampleRate(samplerate);
+    
+    if (x->speakers > CPPAN_SPEAKERS_MIN)
+    {
+        if (count[1])
+            dsp_add64(dsp64, (t_object*)x, (t_perfroutine64)cpPan_perform64ra, 0, NULL);
+        else
+            dsp_add64(dsp64, (t_object*)x, (t_perfroutine64)cpPan_perform64rc, 0, NULL);
+        #ifdef DEBUG
+            object_post((t_object*)x, "panning around a ring of %ld speakers", x->speakers);
+        #endif /* DEBUG */
+    }
+    else if (count[1])
     {
         dsp_add64(dsp64, (t_object*)x, (t_perfroutine64)cpPan_perform64a, 0, NULL);
         #ifdef DEBUG
@@ -225,35 +220,8 @@ void cpPan_dsp64(t_cpPan *x, t_object *dsp64, short *count, double samplerate,
 void cpPan_perform64c(t_cpPan *x, t_object *dsp64, double **ins, long numins, double **outs,
                           long numouts, long vectorsize, long flags, void *userparam)
 {
-    // local vars
-    double *in = ins[0];
-    double *outL = outs[0];
-    double *outR = outs[1];
-    double multL = x->curr_multL;			// get current left channel multiplier
-    double multR = x->curr_multR;			// get current right channel multiplier
-    
-    // local vars used for while loop
-    double valL, valR;
-    long n;
-    
-    // check constraints
-    // completed by cpPan_setPosVars(), so we don't repeat here
-    
-    n = vectorsize;
-    while(n--)
-    {
-        valL = *in;
-        *outL = multL * valL;				// multiply left value by table value
-        
-        valR = *in;
-        *outR = multR * valR;				// multiply right value by table value
-        
-        ++in, ++outL, ++outR;				// advance the pointers
-    }
-    
-    // update object variables
-    // none changed, so we don't need to make updates
-    
+    // position is checked by cpPan_setPosVars(), so we don't repeat here
+    x->pan.processControl(ins[0], outs[0], outs[1], vectorsize);
 }
 
 /********************************************************************************
@@ -275,48 +243,53 @@ void cpPan_perform64c(t_cpPan *x, t_object *dsp64, double **ins, long numins, do
 void cpPan_perform64a(t_cpPan *x, t_object *dsp64, double **ins, long numins, double **outs,
                       long numouts, long vectorsize, long flags, void *userparam)
 {
-    // local vars
-    double *in = ins[0];
-    double *pan_in = ins[1];
-    double *outL = outs[0];
-    double *outR = outs[1];
-    float *tabL = x->table_left;			// create local pointer to left table, TODO: update to doubles
-    float *tabR = x->table_right;			// create local pointer to right table, TODO: update to doubles
-    
-    // local vars used for while loop
-    double valL, valR, pan_val;
-    long n, pan_index;
-    
-    n = vectorsize;
-    while(n--)
-    {
-        pan_val = *pan_in;								// get "pan_val"
-        
-        // check constraints
-        if (pan_val < 0.0)			// if less than 0
-        {
-            pan_val = 0.0;
-        }
-        else if (pan_val > 1.0)		// if greater than table length
-        {
-            pan_val = 1.0;
-        }
-        
-        pan_index = (long) ((pan_val * (float)(TABLE_SIZE - 1)) + 0.5);
-        // set "pan_index"
-        
-        valL = *in;
-        *outL = tabL[pan_index] * valL;				// multiply left value by table value
-        
-        valR = *in;
-        *outR = tabR[pan_index] * valR;				// multiply right value by table value
-        
-        ++in, ++outL, ++outR, ++pan_in;				// advance the pointers
-    }
-    
-    // update object variables
-    x->curr_pos = (float)pan_val;
-    
+    x->pan.processAudio(ins[0], ins[1], outs[0], outs[1], vectorsize);
+}
+
+/********************************************************************************
+ void *cpPan_perform64rc(t_cpPan *x, t_object *dsp64, double **ins, long numins, double **outs,
+ long numouts, long vectorsize, long flags, void *userparam)
+ 
+ inputs:	x		--
+ dsp64   --
+ ins     --
+ numins  --
+ outs    -- one per speaker
+ numouts --
+ vectorsize --
+ flags   --
+ userparam  --
+ description:	called at interrupt level to pan around a ring with a float
+        position at 64-bit
+ returns:		nothing
+ ********************************************************************************/
+void cpPan_perform64rc(t_cpPan *x, t_object *dsp64, double **ins, long numins, double **outs,
+                       long numouts, long vectorsize, long flags, void *userparam)
+{
+    x->pan.processRingControl(ins[0], outs, vectorsize);
+}
+
+/********************************************************************************
+ void *cpPan_perform64ra(t_cpPan *x, t_object *dsp64, double **ins, long numins, double **outs,
+ long numouts, long vectorsize, long flags, void *userparam)
+ 
+ inputs:	x		--
+ dsp64   --
+ ins     --
+ numins  --
+ outs    -- one per speaker
+ numouts --
+ vectorsize --
+ flags   --
+ userparam  --
+ description:	called at interrupt level to pan around a ring with a signal
+        position at 64-bit
+ returns:		nothing
+ ********************************************************************************/
+void cpPan_perform64ra(t_cpPan *x, t_object *dsp64, double **ins, long numins, double **outs,
+                       long numouts, long vectorsize, long flags, void *userparam)
+{
+    x->pan.processRingAudio(ins[0], ins[1], outs, vectorsize);
 }
 
 /********************************************************************************
@@ -345,31 +318,51 @@ void cpPan_setPosVars(t_cpPan *x, double f)
 
 inputs:			x		-- pointer to our object
 				f		-- value of float input
-description:	uses float input to set "curr_pos", "curr_index", "curr_multL",
-		and "curr_multR" variable, check to make sure value is in range
+description:	uses float input to set "curr_pos", which the gains glide to,
+		check to make sure value is in range
 returns:		nothing
 ********************************************************************************/
 void cpPan_setPosVars(t_cpPan *x, double f)
 {
-	long index;
-	
-	if (f >= 0.0 && f <= 1.0) // if within 0 and 1
-	{
-		x->curr_pos = f;
-		
-		index = (long) ((f * (float)(TABLE_SIZE - 1)) + 0.5);
-		
-		x->curr_multL = x->table_left[index];
-		x->curr_multR = x->table_right[index];
-		
-		x->curr_index = index;
-	}
-	else
+	if (!x->pan.setPos(f))
 	{
 		object_post((t_object*)x, "pan value is out of range");
 	}
 }
 
+/********************************************************************************
+t_max_err cpPan_speakers_set(t_cpPan *x, void *attr, long argc, t_atom *argv)
+
+inputs:			x		-- pointer to our object
+				attr	-- the attribute being set
+				argc	-- number of values
+				argv	-- new number of speakers
+description:	setter for the "speakers" attribute; decides the number of
+		outlets, so it can only be set as the object is created
+returns:		MAX_ERR_NONE, or MAX_ERR_GENERIC once the outlets exist
+********************************************************************************/
+t_max_err cpPan_speakers_set(t_cpPan *x, void *attr, long argc, t_atom *argv)
+{
+	long l;
+	
+	if (x->outlets_made) {
+		object_error((t_object*)x, "speakers can only be set when the object is created");
+		return MAX_ERR_GENERIC;
+	}
+	
+	if (argc && argv) {
+		l = (long)atom_getlong(argv);
+		if (l < CPPAN_SPEAKERS_MIN) l = CPPAN_SPEAKERS_MIN;
+		if (l > CPPAN_SPEAKERS_MAX) l = CPPAN_SPEAKERS_MAX;
+		x->speakers = l;
+		
+		#ifdef DEBUG
+			object_post((t_object*)x, "speakers set to %ld", x->speakers);
+		#endif // DEBUG //
+	}
+	return MAX_ERR_NONE;
+}
+
 /********************************************************************************
 void cpPan_assist(t_cpPan *x, t_object *b, long msg, long arg, char *s)
 
@@ -390,9 +383,14 @@ void cpPan_assist(t_cpPan *x, t_object *b, long msg, long arg, char *s)
 				strcpy(s, "(signal) input");
 				break;
 			case 1:
-				strcpy(s, "(signal/float) pan position; 0. = hard left, 1. = hard right");
+				if (x->speakers > CPPAN_SPEAKERS_MIN)
+					strcpy(s, "(signal/float) pan position around the ring; 0. = first speaker");
+				else
+					strcpy(s, "(signal/float) pan position; 0. = hard left, 1. = hard right");
 				break;
 		}
+	} else if (msg==ASSIST_OUTLET && x->speakers > CPPAN_SPEAKERS_MIN) {
+		sprintf(s, "(signal) speaker %ld output", arg + 1);
 	} else if (msg==ASSIST_OUTLET) {
 		switch (arg) {
 			case 0:
@@ -425,28 +423,6 @@ void cpPan_getinfo(t_cpPan *x)
 
 /* the following methods are only compiled into the code during debugging*/
 #ifdef DEBUG
-/********************************************************************************
-void cpPan_table(t_cpPan *x, long value)
-
-inputs:			x		-- pointer to this object
-				value	-- argument from "table" message; sets table index
-description:	inquire the array values for a specified table index
-returns:		nothing
-********************************************************************************/
-	void cpPan_table(t_cpPan *x, long value)
-	{
-		if (value >= 0 && value <= (TABLE_SIZE - 1)) 
-		{
-			object_post((t_object*)x, "at table position %ld the signal will be multiplied by...", value);
-			object_post((t_object*)x, "Left channel: %f", x->table_left[value]);
-			object_post((t_object*)x, "Right channel: %f", x->table_right[value]);
-		}
-		else
-		{
-			object_post((t_object*)x, "value %ld is out of array bounds", value);
-		}
-	}
-	
 /********************************************************************************
 void cpPan_position(t_cpPan *x)
 
@@ -456,11 +432,14 @@ returns:		nothing
 ********************************************************************************/
 	void cpPan_position(t_cpPan *x)
 	{
-		object_post((t_object*)x, "pan position = %f, table index = %ld", x->curr_pos,
-					x->curr_index);
-		object_post((t_object*)x, "at this table position, the signal will be multiplied by...");
-		object_post((t_object*)x, "Left channel: %f", x->curr_multL);
-		object_post((t_object*)x, "Right channel: %f", x->curr_multR);
+		object_post((t_object*)x, "pan position = %f, gliding from %f", x->pan.curr_pos,
+					x->pan.ramp_pos);
+		object_post((t_object*)x, "at this position, the signal will be multiplied by...");
+		object_post((t_object*)x, "Left channel: %f", x->pan.curr_multL);
+		object_post((t_object*)x, "Right channel: %f", x->pan.curr_multR);
+		if (x->speakers > CPPAN_SPEAKERS_MIN)
+			object_post((t_object*)x, "(in a ring, speakers %ld and %ld)", x->pan.ring_index + 1,
+						x->pan.ring_index_b + 1);
 	}
 #endif /* DEBUG */
 
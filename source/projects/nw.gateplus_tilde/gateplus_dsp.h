@@ -0,0 +1,157 @@
+/*
+** gateplus_dsp.h
+**
+** header file
+** zero-crossing gate for nw.gateplus~, free of any Max API calls so that it
+** can also be driven by the nw_bench profiling target
+**
+** Max allocates objects without running constructors, so a GatePlus held in
+** an object struct is set up by init() rather than by a constructor
+**
+** Copyright © 2015 by Nathan Wolek
+** License: http://opensource.org/licenses/BSD-3-Clause
+**
+*/
+
+#ifndef __GATEPLUS_DSP
+#define __GATEPLUS_DSP
+
+/* for gate stage flag */
+#define GATE_CLOSED			0
+#define MONITOR_OPEN		1
+#define GATE_OPEN			2
+#define MONITOR_CLOSED		3
+
+class GatePlus
+{
+public:
+    // current gate info
+    short gate_stage;       // see flags above
+    long sample_count;      // non-zero during stages 1,2,3
+
+    //history
+    double last_ctrl_in;
+    double last_sig_in;
+
+    void init(void);
+    void process(const double *in_ctrl, const double *in_signal, double *out_signal,
+        double *out_count, long n);
+};
+
+/********************************************************************************
+void GatePlus::init(void)
+
+inputs:			nothing
+description:	closes the gate and clears the history
+returns:		nothing
+********************************************************************************/
+inline void GatePlus::init(void)
+{
+    last_ctrl_in = 0.0;
+    last_sig_in = 0.0;
+    sample_count = 0;
+    gate_stage = GATE_CLOSED;
+}
+
+/********************************************************************************
+void GatePlus::process(const double *in_ctrl, const double *in_signal,
+		double *out_signal, double *out_count, long n)
+
+inputs:			in_ctrl		-- control signal, non-zero to open the gate
+				in_signal	-- signal to pass through
+				out_signal	-- gated signal
+				out_count	-- samples since the gate left GATE_CLOSED
+				n			-- number of samples
+description:	opens and closes the gate, but only at positive zero-crossings
+		of the input signal
+returns:		nothing
+********************************************************************************/
+inline void GatePlus::process(const double *in_ctrl, const double *in_signal, double *out_signal,
+    double *out_count, long n)
+{
+    // local vars for object vars and while loop
+    short g_stage = gate_stage;
+    double lc_in = last_ctrl_in;
+    double ls_in = last_sig_in;
+    long count_samp = sample_count;
+
+    while (n--) {
+
+        // test control input for change
+        if ((lc_in == 0.) != (*in_ctrl == 0.)) {
+
+            // what we do depends on the gate stage
+            switch (g_stage)
+            {
+                case GATE_CLOSED:
+                    ++g_stage; // change to MONITOR_OPEN
+                    break;
+                case MONITOR_OPEN:
+                    --g_stage; // change to GATE_CLOSED
+                    break;
+                case GATE_OPEN:
+                    ++g_stage; // change to MONITOR_CLOSED
+                    break;
+                case MONITOR_CLOSED:
+                    --g_stage; // change to GATE_OPEN
+                    break;
+            }
+
+        }
+
+        // if we are monitoring...
+        if (g_stage % 2)
+        {
+            // look for positive zero-crossing
+            if (ls_in < 0. && *in_signal >= 0.)
+            {
+                // and change gate stage
+                switch (g_stage)
+                {
+                    case MONITOR_OPEN:
+                        ++g_stage; // change to GATE_OPEN
+                        break;
+                    case MONITOR_CLOSED:
+                        g_stage = GATE_CLOSED;
+                        break;
+                }
+            }
+        }
+
+        // let sound through under right conditions
+        if (g_stage > MONITOR_OPEN) // if GATE_OPEN or MONITOR_CLOSED
+        {
+            *out_signal = *in_signal;
+        } else {
+            *out_signal = 0.;
+        }
+
+        // if gate isn't open or monitoring...
+        if (g_stage == GATE_CLOSED)
+        {
+            // don't count the samples
+            count_samp = 0;
+        } else {
+            // otherwise count the samples
+            count_samp++;
+        }
+
+        // write sample count output
+        *out_count = (double)count_samp;
+
+        // update history
+        lc_in = *in_ctrl;
+        ls_in = *in_signal;
+
+        // advance pointers
+        ++in_ctrl, ++in_signal, ++out_signal, ++out_count;
+    }
+
+    // update object vars
+    gate_stage = g_stage;
+    last_ctrl_in = lc_in;
+    last_sig_in = ls_in;
+    sample_count = count_samp;
+}
+
+#endif /* __GATEPLUS_DSP */
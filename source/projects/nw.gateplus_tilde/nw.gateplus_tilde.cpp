@@ -12,6 +12,7 @@
 */
 
 #include "c74_msp.h"
+#include "gateplus_dsp.h"
 
 using namespace c74::max;
 
@@ -23,25 +24,14 @@ using namespace c74::max;
 #define ASSIST_INLET	1
 #define ASSIST_OUTLET	2
 
-/* for gate stage flag */
-#define GATE_CLOSED			0
-#define MONITOR_OPEN		1
-#define GATE_OPEN			2
-#define MONITOR_CLOSED		3
-
 static t_class *gateplus_class;		// required global pointing to this class
 
 typedef struct _gateplus
 {
     t_pxobject x_obj;					// <--
     
-    // current gate info
-    short gate_stage;       // see flags in header
-    long sample_count;      // non-zero during stages 1,2,3
-    
-    //history
-    double last_ctrl_in;
-    double last_sig_in;
+    // gate stage and history
+    GatePlus gate;
     
 } t_gateplus;
 
@@ -88,6 +78,8 @@ int C74_EXPORT main(void)
     #ifndef DEBUG
         
     #endif /* DEBUG */
+    
+    return 0;
 }
 
 /********************************************************************************
@@ -106,13 +98,8 @@ void *gateplus_new(long outlets)
     outlet_new((t_pxobject *)x, "signal");			// outlet for signal to pass through
     outlet_new((t_pxobject *)x, "signal");			// outlet for sample count
     
-    /* setup variables */
-    x->last_ctrl_in = 0.0;
-    x->last_sig_in = 0.0;
-    x->sample_count = 0;
-    
-    /* set flags to defaults */
-    x->gate_stage = GATE_CLOSED;
+    /* setup variables and set flags to defaults */
+    x->gate.init();
     
     x->x_obj.z_misc = Z_NO_INPLACE;
     
@@ -173,104 +160,10 @@ void gateplus_dsp64(t_gateplus *x, t_object *dsp64, short *count, double sampler
  ********************************************************************************/
 void gateplus_perform64(t_gateplus *x, t_object *dsp64, double **ins, long numins, double **outs, long numouts, long vectorsize, long flags, void *userparam)
 {
-    // local vars outlets and inlets
-    double *in_ctrl = ins[0];
-    double *in_signal = ins[1];
-    double *out_signal = outs[0];
-    double *out_count = outs[1];
-    
-    // local vars for object vars and while loop
-    long n, count_samp;
-    short g_stage;
-    double lc_in, ls_in;
-    
     // check to make sure object is enabled
     if (x->x_obj.z_disabled) goto out; // if not, skip ahead
     
-    // assign values to local vars
-    g_stage = x->gate_stage;
-    lc_in = x->last_ctrl_in;
-    ls_in = x->last_sig_in;
-    count_samp = x->sample_count;
-    
-    n = vectorsize;
-    while (n--) {
-        
-        // test control input for change
-        if ((lc_in == 0.) != (*in_ctrl == 0.)) {
-            
-            // what we do depends on the gate stage
-            switch (g_stage)
-            {
-                case GATE_CLOSED:
-                    ++g_stage; // change to MONITOR_OPEN
-                    break;
-                case MONITOR_OPEN:
-                    --g_stage; // change to GATE_CLOSED
-                    break;
-                case GATE_OPEN:
-                    ++g_stage; // change to MONITOR_CLOSED
-                    break;
-                case MONITOR_CLOSED:
-                    --g_stage; // change to GATE_OPEN
-                    break;
-            }
-            
-        }
-        
-        // if we are monitoring...
-        if (g_stage % 2)
-        {
-            // look for positive zero-crossing
-            if (ls_in < 0. && *in_signal >= 0.)
-            {
-                // and change gate stage
-                switch (g_stage)
-                {
-                    case MONITOR_OPEN:
-                        ++g_stage; // change to GATE_OPEN
-                        break;
-                    case MONITOR_CLOSED:
-                        g_stage = GATE_CLOSED;
-                        break;
-                }
-            }
-        }
-        
-        // let sound through under right conditions
-        if (g_stage > MONITOR_OPEN) // if GATE_OPEN or MONITOR_CLOSED
-        {
-            *out_signal = *in_signal;
-        } else {
-            *out_signal = 0.;
-        }
-        
-        // if gate isn't open or monitoring...
-        if (g_stage == 0)
-        {
-            // don't count the samples
-            count_samp = 0;
-        } else {
-            // otherwise count the samples
-            count_samp++;
-        }
-        
-        // write sample count output
-        *out_count = (double)count_samp;
-        
-        // update history
-        lc_in = *in_ctrl;
-        ls_in = *in_signal;
-        
-        // advance pointers
-        ++in_ctrl, ++in_signal, ++out_signal;
-    }
-    
-    // update global vars
-    x->gate_stage = g_stage;
-    x->last_ctrl_in = lc_in;
-    x->last_sig_in = ls_in;
-    x->sample_count = count_samp;
+    x->gate.process(ins[0], ins[1], outs[0], outs[1], vectorsize);
     
 out:
     return;
@@ -2,7 +2,8 @@
 ** nw.grainbang~.c
 **
 ** MSP object
-** sends out a single grains when it receives a bang 
+** sends out a grain when it receives a bang or a grain message; grains are
+** queued and start at their exact sample, several may sound at once
 ** 2001/07/18 started by Nathan Wolek
 **
 ** Copyright © 2002,2014 by Nathan Wolek
@@ -11,6 +12,14 @@
 */
 
 #include "c74_msp.h"
+#include <atomic>
+#include "nw_bufswap.h"
+#include "nw_interp.h"
+#include "nw_grainvoice.h"
+#include "nw_pyramid.h"
+#include "nw_mpsc.h"
+#include "nw_wincache.h"
+#include "nw_window.h"
 
 using namespace c74::max;
 
@@ -22,18 +31,37 @@ using namespace c74::max;
 #define ASSIST_INLET	1
 #define ASSIST_OUTLET	2
 
-/* for the grain stage */
-#define NEW_GRAIN		2
-#define FINISH_GRAIN	1
-#define	NO_GRAIN		0
-
 /* for direction flag */
-#define FORWARD_GRAINS		0
-#define REVERSE_GRAINS		1
+#define FORWARD_GRAINS		NW_GRAIN_FORWARD
+#define REVERSE_GRAINS		NW_GRAIN_REVERSE
 
 /* for interpolation flag */
-#define INTERP_OFF			0
-#define INTERP_ON			1
+#define INTERP_OFF			NW_INTERP_NONE
+#define INTERP_ON			NW_INTERP_LINEAR
+#define INTERP_HERMITE		NW_INTERP_HERMITE
+#define INTERP_LAGRANGE		NW_INTERP_LAGRANGE
+#define INTERP_SINC			NW_INTERP_SINC
+
+/* for the voice pool */
+#define VOICES_MIN			1
+#define VOICES_MAX			64
+#define NO_VOICE			-1
+
+/* for the grain queue */
+#define QUEUE_SIZE			256		// power of two, grains waiting at once
+
+/* a grain waiting to start, queued by a bang or a grain message */
+typedef struct _grainbang_event
+{
+	double time;				// scheduler time in milliseconds to start at
+	long delay;					// in samples from the current vector, once pending
+	double pos_start;			// in milliseconds
+	double length;				// in milliseconds
+	double pitch;				// as multiplier
+	double gain;				// linear gain mult
+	short direction;			// forward or reverse
+	short from_inlets;			// signal inlets override the values above
+} t_grainbang_event;
 
 static t_class *grainbang_class;		// required global pointing to this class
 
@@ -42,29 +70,43 @@ typedef struct _grainbang
 	t_pxobject x_obj;					// <--
 	// sound buffer info
 	t_symbol *snd_sym;
-    t_buffer_ref *snd_buf_ptr;
-    t_buffer_ref *next_snd_buf_ptr;
+	t_buffer_ref *snd_ref;				// last buffer~ linked, main thread only
+	NwBufSwap snd_swap;					// hands snd_ref to the perform routine
+	t_nw_bufinfo snd_buf;				// buffer~ being played, perform only
 	//double snd_last_out;	//removed 2005.02.02
 	//long snd_buf_length;	//removed 2002.07.11
 	short snd_interp;
+	const t_nw_sinc *snd_sinc;			// sinc tables, once sndInterp 4 or sincTable asks
+	NwPyramid snd_pyramid;				// sound decimated by octaves, for grains pitched up
+	t_qelem *pyramid_qelem;				// builds levels asked for by the perform routine
+	short pyramid;						// "pyramid" message
 	// window buffer info
 	t_symbol *win_sym;
-    t_buffer_ref *win_buf_ptr;
-    t_buffer_ref *next_win_buf_ptr;
+	t_buffer_ref *win_ref;				// last buffer~ linked, main thread only
+	NwBufSwap win_swap;					// hands win_ref to the perform routine
+	t_nw_bufinfo win_buf;				// buffer~ being played, perform only
 	//double win_last_out;	//removed 2005.02.02
 	//long win_buf_length;	//removed 2002.07.11
 	short win_interp;
-	// current grain info
-	double grain_pos_start;	// in samples
-	double grain_length;	// in milliseconds
-    double grain_pitch;		// as multiplier
-    double grain_gain;		// linear gain mult
-	double grain_sound_length;	// in milliseconds
-	double win_step_size;	// in samples
-	double snd_step_size;	// in samples
-	double curr_win_pos;	// in samples
-	double curr_snd_pos;	// in samples
-	short grain_direction;	// forward or reverse
+	long win_buf_frames;				// window length in use, cached at vector start
+	NwWinCache win_cache;				// window resampled per grain length
+	t_qelem *win_cache_qelem;			// builds tables asked for by the perform routine
+	t_nw_window window;					// analytic shape, or NW_WINDOW_BUFFER
+	t_nw_window next_window;			// last shape given to the window message, main thread only
+	NwSwap<t_nw_window> window_swap;	// hands next_window to the perform routine
+	// perform kernels, see nw_grain_kernels()
+	std::atomic<const t_nw_grain_kernels *> next_kernels;	// for snd_interp and win_interp
+	const t_nw_grain_kernels *grain_kernels;	// kernels voices play, perform only
+	short grain_stereo;					// sound was stereo when they were picked
+	// voice pool, active voices are packed at the front
+	GrainVoice voice_pool[VOICES_MAX];
+	long voice_count;					// "voices" attribute
+	long voice_active_count;
+	long voice_newest;					// index of last voice started, or NO_VOICE
+	// grains waiting to start
+	NwMpscQueue<t_grainbang_event, QUEUE_SIZE> grain_queue;	// from bang and grain, on any thread
+	t_grainbang_event grain_pending[QUEUE_SIZE];	// perform only, sorted by delay
+	long grain_pending_count;
 	// defered grain info at control rate
 	double next_grain_pos_start;	// in milliseconds
 	double next_grain_length;		// in milliseconds
@@ -76,33 +118,51 @@ typedef struct _grainbang
 	short grain_length_connected;		// <--
 	short grain_pitch_connected;		// <--
     short grain_gain_connected;
+	long modulate;						// "modulate" attribute
+	short modulate_gain;				// gain read every sample, chosen by dsp64
+	short modulate_pitch;				// pitch read every sample, chosen by dsp64
 	// grain tracking info
-    short grain_stage;
-    long curr_count_samp;
 	//long curr_grain_samp;				//removed 2003.08.04
 	double output_sr;					// <--
 	double output_1oversr;				// <--
 	//overflow outlet, added 2002.10.23
 	void *out_overflow;					// <--
+	t_qelem *overflow_qelem;			// bangs out_overflow from the perform routine
 } t_grainbang;
 
-void *grainbang_new(t_symbol *snd, t_symbol *win);
+void *grainbang_new(t_symbol *s, long argc, t_atom *argv);
+void grainbang_free(t_grainbang *x);
 void grainbang_perform64zero(t_grainbang *x, t_object *dsp64, double **ins, long numins, double **outs,long numouts, long vectorsize, long flags, void *userparam);
+template <bool ModGain, bool ModPitch>
 void grainbang_perform64(t_grainbang *x, t_object *dsp64, double **ins, long numins, double **outs,long numouts, long vectorsize, long flags, void *userparam);
 void grainbang_dsp64(t_grainbang *x, t_object *dsp64, short *count, double samplerate, long maxvectorsize, long flags);
 void grainbang_setsnd(t_grainbang *x, t_symbol *s);
 void grainbang_setwin(t_grainbang *x, t_symbol *s);
+void grainbang_window(t_grainbang *x, t_symbol *s, long argc, t_atom *argv);
 void grainbang_float(t_grainbang *x, double f);
 void grainbang_int(t_grainbang *x, long l);
 void grainbang_bang(t_grainbang *x);
-void grainbang_overflow(t_grainbang *x, t_symbol *s, short argc, t_atom argv);
-void grainbang_initGrain(t_grainbang *x, float in_pos_start, float in_length, float in_pitch_mult, float in_gain_mult);
+void grainbang_grain(t_grainbang *x, t_symbol *s, long argc, t_atom *argv);
+void grainbang_queueGrain(t_grainbang *x, t_grainbang_event *e);
+void grainbang_overflow(t_grainbang *x);
+bool grainbang_initGrain(t_grainbang *x, GrainVoice *v, t_grainbang_event *e, float in_pos_start,
+		float in_length, float in_pitch_mult, float in_gain_mult);
+void grainbang_updateBuffers(t_grainbang *x);
+void grainbang_publishKernels(t_grainbang *x);
+void grainbang_updateKernels(t_grainbang *x, long chan_s);
+void grainbang_buildWindows(t_grainbang *x);
+void grainbang_buildPyramid(t_grainbang *x);
+void grainbang_drainQueue(t_grainbang *x, long vectorsize);
+void grainbang_agePending(t_grainbang *x, long due, long vectorsize);
+void grainbang_skipQueue(t_grainbang *x, long vectorsize);
 void grainbang_sndInterp(t_grainbang *x, long l);
+void grainbang_sincTable(t_grainbang *x, long l);
+void grainbang_pyramid(t_grainbang *x, long l);
 void grainbang_winInterp(t_grainbang *x, long l);
 void grainbang_reverse(t_grainbang *x, long l);
 void grainbang_assist(t_grainbang *x, t_object *b, long msg, long arg, char *s);
 void grainbang_getinfo(t_grainbang *x);
-double mcLinearInterp(float *in_array, long index_i, double index_frac, long in_size, short in_chans);
+t_max_err grainbang_voices_set(t_grainbang *x, void *attr, long argc, t_atom *argv);
 
 t_symbol *ps_buffer;
 
@@ -118,16 +178,30 @@ int C74_EXPORT main(void)
 {
     t_class *c;
     
-    c = class_new(OBJECT_NAME, (method)grainbang_new, (method)dsp_free,
-                  (short)sizeof(t_grainbang), 0L, A_SYM, A_SYM, 0);
+    c = class_new(OBJECT_NAME, (method)grainbang_new, (method)grainbang_free,
+                  (long)sizeof(t_grainbang), 0L, A_GIMME, 0);
     class_dspinit(c); // add standard functions to class
 	
+	/* number of grains that may sound at once */
+	CLASS_ATTR_LONG(c, "voices", 0, t_grainbang, voice_count);
+	CLASS_ATTR_ACCESSORS(c, "voices", NULL, grainbang_voices_set);
+	CLASS_ATTR_FILTER_CLIP(c, "voices", VOICES_MIN, VOICES_MAX);
+	CLASS_ATTR_LABEL(c, "voices", 0, "Maximum Overlapping Grains");
+	
+	/* gain and pitch read from their inlets every sample of a grain */
+	CLASS_ATTR_LONG(c, "modulate", 0, t_grainbang, modulate);
+	CLASS_ATTR_FILTER_CLIP(c, "modulate", 0, 1);
+	CLASS_ATTR_LABEL(c, "modulate", 0, "Modulate Gain and Pitch");
+	
 	/* bind method "grainbang_setsnd" to the 'setSound' message */
 	class_addmethod(c, (method)grainbang_setsnd, "setSound", A_SYM, 0);
 	
 	/* bind method "grainbang_setwin" to the 'setWin' message */
 	class_addmethod(c, (method)grainbang_setwin, "setWin", A_SYM, 0);
 	
+	/* bind method "grainbang_window" to the 'window' message */
+	class_addmethod(c, (method)grainbang_window, "window", A_GIMME, 0);
+	
 	/* bind method "grainbang_float" to incoming floats */
 	class_addmethod(c, (method)grainbang_float, "float", A_FLOAT, 0);
 	
@@ -137,12 +211,21 @@ int C74_EXPORT main(void)
 	/* bind method "grainbang_bang" to incoming bangs */
 	class_addmethod(c, (method)grainbang_bang, "bang", 0);
 	
+	/* bind method "grainbang_grain" to the grain message */
+	class_addmethod(c, (method)grainbang_grain, "grain", A_GIMME, 0);
+	
 	/* bind method "grainbang_reverse" to the direction message */
 	class_addmethod(c, (method)grainbang_reverse, "reverse", A_LONG, 0);
 	
 	/* bind method "grainbang_sndInterp" to the sndInterp message */
 	class_addmethod(c, (method)grainbang_sndInterp, "sndInterp", A_LONG, 0);
 	
+	/* bind method "grainbang_sincTable" to the sincTable message */
+	class_addmethod(c, (method)grainbang_sincTable, "sincTable", A_LONG, 0);
+	
+	/* bind method "grainbang_pyramid" to the pyramid message */
+	class_addmethod(c, (method)grainbang_pyramid, "pyramid", A_LONG, 0);
+	
 	/* bind method "grainbang_winInterp" to the winInterp message */
 	class_addmethod(c, (method)grainbang_winInterp, "winInterp", A_LONG, 0);
 	
@@ -169,52 +252,104 @@ int C74_EXPORT main(void)
 }
 
 /********************************************************************************
-void *grainbang_new(double initial_pos)
+void *grainbang_new(t_symbol *s, long argc, t_atom *argv)
 
-inputs:			*snd		-- name of buffer holding sound
-				*win		-- name of buffer holding window
+inputs:			s			-- name of the object
+				argc, argv	-- name of buffer holding sound, name of buffer
+					holding window, then attributes (@voices)
 description:	called for each new instance of object in the MAX environment;
 		defines inlets and outlets; sets variables and buffers
 returns:		nothing
 ********************************************************************************/
-void *grainbang_new(t_symbol *snd, t_symbol *win)
+void *grainbang_new(t_symbol *s, long argc, t_atom *argv)
 {
 	t_grainbang *x = (t_grainbang *) object_alloc((t_class*) grainbang_class);
+	long attrstart = attr_args_offset((short)argc, argv);
+	t_symbol *snd = attrstart > 0 ? atom_getsym(argv) : gensym("");
+	t_symbol *win = attrstart > 1 ? atom_getsym(argv + 1) : gensym("");
+	
 	dsp_setup((t_pxobject *)x, 5);					// five inlets
 	x->out_overflow = outlet_new((t_pxobject *)x, "bang");		// overflow outlet
     outlet_new((t_pxobject *)x, "signal");          // sample count outlet
     outlet_new((t_pxobject *)x, "signal");			// signal ch2 outlet
     outlet_new((t_pxobject *)x, "signal");			// signal ch1 outlet
+	x->overflow_qelem = qelem_new(x, (method)grainbang_overflow);
+	x->win_cache_qelem = qelem_new(x, (method)grainbang_buildWindows);
+	x->pyramid_qelem = qelem_new(x, (method)grainbang_buildPyramid);
 	
 	/* set buffer names */
 	x->snd_sym = snd;
 	x->win_sym = win;
 	
 	/* zero pointers */
-	x->snd_buf_ptr = x->next_snd_buf_ptr = NULL;
-	x->win_buf_ptr = x->next_win_buf_ptr = NULL;
+	x->snd_ref = x->win_ref = NULL;
+	x->snd_swap.init();
+	x->win_swap.init();
+	nw_bufinfo_set(&x->snd_buf, NULL, 0, 0, 0.0, 0);
+	nw_bufinfo_set(&x->win_buf, NULL, 0, 0, 0.0, 0);
+	x->win_buf_frames = 0;
+	x->win_cache.init();
+	x->snd_pyramid.init();
+	nw_window_set(&x->window, "buffer", false, 0.);
+	x->next_window = x->window;
+	x->window_swap.init();
 	
 	/* setup variables */
-	x->grain_pos_start = x->next_grain_pos_start = 0.0;
-	x->grain_length = x->next_grain_length = 50.0;
-	x->grain_pitch = x->next_grain_pitch = 1.0;
-    x->grain_gain = x->next_grain_gain = 1.0;
-	x->grain_stage = NO_GRAIN;
-	x->win_step_size = x->snd_step_size = 0.0;
-	x->curr_win_pos = x->curr_snd_pos = 0.0;
-    x->curr_count_samp = -1;
+	x->next_grain_pos_start = 0.0;
+	x->next_grain_length = 50.0;
+	x->next_grain_pitch = 1.0;
+    x->next_grain_gain = 1.0;
+	
+	/* start with one idle voice and no grains waiting */
+	x->voice_count = VOICES_MIN;
+	x->voice_active_count = 0;
+	x->voice_newest = NO_VOICE;
+	x->grain_queue.init();
+	x->grain_pending_count = 0;
 	
 	/* set flags to defaults */
 	x->snd_interp = INTERP_ON;
+	x->snd_sinc = NULL;
+	x->pyramid = false;
 	x->win_interp = INTERP_ON;
-	x->grain_direction = x->next_grain_direction = FORWARD_GRAINS;
+	x->next_grain_direction = FORWARD_GRAINS;
+	grainbang_publishKernels(x);
+	x->grain_kernels = NULL;
+	x->grain_stereo = false;
+	x->modulate = false;
+	x->modulate_gain = x->modulate_pitch = false;
+	
+	x->output_sr = sys_getsr();
+	x->output_1oversr = 1.0 / x->output_sr;
 	
 	x->x_obj.z_misc = Z_NO_INPLACE;
 	
+	/* process attributes, like @voices */
+	attr_args_process(x, (short)argc, argv);
+	
 	/* return a pointer to the new object */
 	return (x);
 }
 
+/********************************************************************************
+void grainbang_free(t_grainbang *x)
+
+inputs:			x		-- pointer to this object
+description:	called when the object is deleted
+returns:		nothing
+********************************************************************************/
+void grainbang_free(t_grainbang *x)
+{
+	// must be first
+	dsp_free((t_pxobject *)x);
+	
+	qelem_free(x->overflow_qelem);
+	qelem_free(x->win_cache_qelem);
+	x->win_cache.free();
+	qelem_free(x->pyramid_qelem);
+	x->snd_pyramid.free();
+}
+
 
 /********************************************************************************
  void grainbang_dsp64()
@@ -231,6 +366,7 @@ void *grainbang_new(t_symbol *snd, t_symbol *win)
 void grainbang_dsp64(t_grainbang *x, t_object *dsp64, short *count, double samplerate,
                       long maxvectorsize, long flags)
 {
+    t_perfroutine64 perform;
     
     #ifdef DEBUG
         object_post((t_object*)x, "adding 64 bit perform method");
@@ -238,7 +374,8 @@ void grainbang_dsp64(t_grainbang *x, t_object *dsp64, short *count, double sampl
     
     /* set buffers */
     grainbang_setsnd(x, x->snd_sym);
-    grainbang_setwin(x, x->win_sym);
+    if (x->next_window.type == NW_WINDOW_BUFFER)
+        grainbang_setwin(x, x->win_sym);
     
     /* test inlets for signal data */
     x->grain_pos_start_connected = count[1];
@@ -246,18 +383,29 @@ void grainbang_dsp64(t_grainbang *x, t_object *dsp64, short *count, double sampl
     x->grain_pitch_connected = count[3];
     x->grain_gain_connected = count[4];
     
+    // grains only follow inlets that are connected
+    x->modulate_gain = x->modulate && x->grain_gain_connected;
+    x->modulate_pitch = x->modulate && x->grain_pitch_connected;
+    
     // grab sample rate
     x->output_sr = samplerate;
     x->output_1oversr = 1.0 / x->output_sr;
     
-    // set stage to no grain
-    //x->grain_stage = NO_GRAIN;
-    
     if (count[5] || count[6]) {	// if output 1 or 2 are connected..
         #ifdef DEBUG
             object_post((t_object*)x, "output is being computed");
         #endif /* DEBUG */
-        dsp_add64(dsp64, (t_object*)x, (t_perfroutine64)grainbang_perform64, 0, NULL);
+        // reading inlets every sample has a routine of its own, so the
+        // default one costs nothing extra
+        if (x->modulate_gain && x->modulate_pitch)
+            perform = (t_perfroutine64)grainbang_perform64<true, true>;
+        else if (x->modulate_gain)
+            perform = (t_perfroutine64)grainbang_perform64<true, false>;
+        else if (x->modulate_pitch)
+            perform = (t_perfroutine64)grainbang_perform64<false, true>;
+        else
+            perform = (t_perfroutine64)grainbang_perform64<false, false>;
+        dsp_add64(dsp64, (t_object*)x, perform, 0, NULL);
     } else {					// if not...
         #ifdef DEBUG
             object_post((t_object*)x, "no output computed");
@@ -290,6 +438,9 @@ void grainbang_perform64zero(t_grainbang *x, t_object *dsp64, double **ins, long
 		for (auto i=0; i<vectorsize; ++i)
 			outs[channel][i] = 0.0;
 	}
+	
+	// grains due while nothing is heard are not played late
+	grainbang_skipQueue(x, vectorsize);
 }
 
 /********************************************************************************
@@ -304,9 +455,12 @@ void grainbang_perform64zero(t_grainbang *x, t_object *dsp64, double **ins, long
  vectorsize --
  flags   --
  userparam  --
- description:	called at interrupt level to compute object's output at 64-bit
+ description:	called at interrupt level to compute object's output at 64-bit;
+        ModGain and ModPitch set grains begun from the inlets to read gain and
+        pitch every sample, see the modulate attribute
  returns:		nothing
  ********************************************************************************/
+template <bool ModGain, bool ModPitch>
 void grainbang_perform64(t_grainbang *x, t_object *dsp64, double **ins, long numins, double **outs,
                           long numouts, long vectorsize, long flags, void *userparam)
 {
@@ -321,190 +475,185 @@ void grainbang_perform64(t_grainbang *x, t_object *dsp64, double **ins, long num
     
     // local vars for snd and win buffer
     t_buffer_obj *snd_object, *win_object;
+    t_buffer_info b_info;
     float *tab_s, *tab_w;
-    double snd_out, snd_out2, win_out;
     long size_s, size_w, chan_s;
     
+    // local vars for voice pool
+    GrainVoice *pool = x->voice_pool;
+    GrainVoice *v;
+    long a, active_count, voice_count, newest;
+    
+    // local vars for grains waiting to start
+    t_grainbang_event *pending = x->grain_pending;
+    long due, started;
+    bool overflow = false;
+    
     // local vars for object vars and while loop
-    double index_s, index_w, temp_index_frac;
-    long n, count_samp, temp_index_int, temp_index_int_times_chan;
-    double s_step_size, w_step_size, g_gain;
-    short interp_s, interp_w, g_direction;
+    long n, i, j, end, count;
+    short interp_w;
+    bool sounding;
     
     // check to make sure buffers are loaded with proper file types
     if (x->x_obj.z_disabled)		// and object is enabled
         goto out;
-    if (x->snd_buf_ptr == NULL || (x->win_buf_ptr == NULL))
+    
+    // buffers only change at vector boundaries, so all voices share one lock
+    grainbang_updateBuffers(x);
+    
+    if (x->snd_buf.ref == NULL || (x->window.type == NW_WINDOW_BUFFER && x->win_buf.ref == NULL))
         goto zero;
     
-    // get sound buffer info
-    snd_object = buffer_ref_getobject(x->snd_buf_ptr);
+    // get sound buffer info; values cached when it was linked are read again
+    // only if the buffer~ has been changed since
+    snd_object = buffer_ref_getobject((t_buffer_ref *)x->snd_buf.ref);
     tab_s = buffer_locksamples(snd_object);
     if (!tab_s)		// buffer samples were not accessible
         goto zero;
-    size_s = buffer_getframecount(snd_object);
-    chan_s = buffer_getchannelcount(snd_object);
+    buffer_getinfo(snd_object, &b_info);
+    if (b_info.b_modtime != x->snd_buf.modtime) {
+        nw_bufinfo_set(&x->snd_buf, x->snd_buf.ref, b_info.b_frames, b_info.b_nchans, b_info.b_sr, b_info.b_modtime);
+        for (a = 0; a < x->voice_active_count; a++)
+            pool[a].snd_wraps = true;
+    }
+    size_s = x->snd_buf.frames;
+    chan_s = x->snd_buf.chans;
     
-    // get window buffer info
-    win_object = buffer_ref_getobject(x->win_buf_ptr);
-    tab_w = buffer_locksamples(win_object);
-    if (!tab_w)		// buffer samples were not accessible
-        goto zero;
-    size_w = buffer_getframecount(win_object);
+    // kernels for the modes last published and the channels of this sound
+    grainbang_updateKernels(x, chan_s);
     
-    // get snd and win index info
-    index_s = x->curr_snd_pos;
-    index_w = x->curr_win_pos;
-    s_step_size = x->snd_step_size;
-    w_step_size = x->win_step_size;
+    // a changed sound retires the pyramid, so sounding voices go back to the buffer~
+    if (x->snd_pyramid.check(x->pyramid ? x->snd_buf.ref : NULL, size_s, chan_s, x->snd_buf.modtime)) {
+        for (a = 0; a < x->voice_active_count; a++)
+            pool[a].dropLevel();
+        qelem_set(x->pyramid_qelem);
+    }
+    
+    // get window buffer info, unless an analytic window is playing
+    if (x->window.type == NW_WINDOW_BUFFER) {
+        win_object = buffer_ref_getobject((t_buffer_ref *)x->win_buf.ref);
+        tab_w = buffer_locksamples(win_object);
+        if (!tab_w) {		// buffer samples were not accessible
+            buffer_unlocksamples(snd_object);
+            goto zero;
+        }
+        buffer_getinfo(win_object, &b_info);
+        if (b_info.b_modtime != x->win_buf.modtime)
+            nw_bufinfo_set(&x->win_buf, x->win_buf.ref, b_info.b_frames, b_info.b_nchans, b_info.b_sr, b_info.b_modtime);
+        size_w = x->win_buf.frames;
+    } else {
+        win_object = NULL;
+        tab_w = NULL;
+        size_w = NW_WINDOW_FRAMES;
+    }
+    
+    // cache window length used by grainbang_initGrain
+    x->win_buf_frames = size_w;
+    
+    // take new grains from the queue, then count those starting in this vector
+    grainbang_drainQueue(x, vectorsize);
+    due = 0;
+    while (due < x->grain_pending_count && pending[due].delay < vectorsize)
+        ++due;
+    started = 0;
     
     // get grain options
-    interp_s = x->snd_interp;
     interp_w = x->win_interp;
-    g_gain = x->grain_gain;
-    g_direction = x->grain_direction;
+    
+    // a changed window retires every table, so sounding voices go back to interpolating
+    if (win_object) {
+        if (x->win_cache.check(win_object, size_w, x->win_buf.modtime, interp_w)) {
+            for (a = 0; a < x->voice_active_count; a++)
+                pool[a].win_table = NULL;
+            qelem_set(x->win_cache_qelem);
+        }
+    }
     
     // get history from last vector
-    count_samp = x->curr_count_samp;
+    active_count = x->voice_active_count;
+    voice_count = x->voice_count;
+    newest = x->voice_newest;
     
-    n = vectorsize;
-    while(n--)
+    // voices add themselves to the outputs
+    for (i = 0; i < vectorsize; i++) {
+        out_signal[i] = 0.0;
+        out_signal2[i] = 0.0;
+        out_sample_count[i] = -1.0;
+    }
+    
+    // render in runs that end where the next grain is due
+    i = 0;
+    while (i < vectorsize)
     {
-        // advance window index
-        index_w += w_step_size;
-        if (index_w > size_w) { // if we exceed the window size
-            if (x->grain_stage == FINISH_GRAIN) { // and if the grain is sounding
-                x->grain_stage = NO_GRAIN;
-                count_samp = -1;
+        // start every grain that is due on this sample
+        while (started < due && pending[started].delay == i) {
+            if (active_count < voice_count) { // if a voice is free...
+                if (grainbang_initGrain(x, pool + active_count, pending + started,
+                                        in_sound_start[i], in_dur[i], in_sample_increment[i], in_gain[i]))
+                    newest = active_count++;
+            } else {
+                overflow = true;
             }
+            ++started;
         }
+        end = (started < due) ? pending[started].delay : vectorsize;
         
-        // should we start a grain ?
-        if (count_samp == -1) { // if sample count is -1...
-            if (x->grain_stage == NEW_GRAIN) { // if bang...
-                buffer_unlocksamples(snd_object);
-                buffer_unlocksamples(win_object);
-                
-                grainbang_initGrain(x, *in_sound_start, *in_dur, *in_sample_increment, *in_gain);
-                
-                // get snd buffer info
-                snd_object = buffer_ref_getobject(x->snd_buf_ptr);
-                tab_s = buffer_locksamples(snd_object);
-                if (!tab_s)	{	// buffer samples were not accessible
-                    *out_signal = 0.0;
-                    *out_signal2 = 0.0;
-                    *out_sample_count = (double)count_samp;
-                    goto advance_pointers;
+        // render each active voice
+        a = 0;
+        while (a < active_count) {
+            v = pool + a;
+            count = v->curr_count_samp;
+            
+            // voices following the inlets are played a sample at a time
+            if ((ModGain || ModPitch) && v->modulated) {
+                sounding = true;
+                for (j = i; j < end && sounding; j++) {
+                    if (ModGain)
+                        v->grain_gain = in_gain[j];
+                    if (ModPitch)
+                        v->setPitch(in_sample_increment[j]);
+                    sounding = v->play(tab_s, size_s, chan_s, tab_w, size_w, out_signal + j, out_signal2 + j, 1);
                 }
-                size_s = buffer_getframecount(snd_object);
-                
-                // get win buffer info
-                win_object = buffer_ref_getobject(x->win_buf_ptr);
-                tab_w = buffer_locksamples(win_object);
-                if (!tab_w)	{	// buffer samples were not accessible
-                    *out_signal = 0.0;
-                    *out_signal2 = 0.0;
-                    *out_sample_count = (double)count_samp;
-                    goto advance_pointers;
+            } else {
+                sounding = v->play(tab_s, size_s, chan_s, tab_w, size_w, out_signal + i, out_signal2 + i, end - i);
+            }
+            
+            if (a == newest) {
+                n = v->curr_count_samp - count;		// samples played
+                for (j = 0; j < n; j++)
+                    out_sample_count[i + j] = (double)(count + 1 + j);
+            }
+            
+            // free the voice once it has played to the end of its window
+            if (!sounding) {
+                --active_count;
+                if (newest == a) {
+                    newest = NO_VOICE;
+                } else if (newest == active_count) {
+                    newest = a;
                 }
-                size_w = buffer_getframecount(win_object);
-                
-                // get snd and win index info
-                index_s = x->curr_snd_pos;
-                index_w = x->curr_win_pos;
-                s_step_size = x->snd_step_size;
-                w_step_size = x->win_step_size;
-                
-                // get grain options
-                interp_s = x->snd_interp;
-                interp_w = x->win_interp;
-                g_gain = x->grain_gain;
-                g_direction = x->grain_direction;
-                
-                // get history from last vector
-                count_samp = x->curr_count_samp;
-                
-                // move to next stage
-                x->grain_stage = FINISH_GRAIN;
-                
-            } else { // if not...
-                *out_signal = 0.0;
-                *out_signal2 = 0.0;
-                *out_sample_count = (double)count_samp;
-                goto advance_pointers;
+                *v = pool[active_count];	// keep active voices packed
+            } else {
+                ++a;
             }
         }
         
-        // if we made it here, then we will actually start counting
-        count_samp++;
-        
-        // advance sound index
-        if (g_direction == FORWARD_GRAINS) {
-            index_s += s_step_size;     // addition
-        } else {	// if REVERSE_GRAINS
-            index_s -= s_step_size;		// subtract
-        }
-        
-        // wrap sound index if not within bounds
-        while (index_s < 0.0)
-            index_s += size_s;
-        while (index_s >= size_s)
-            index_s -= size_s;
-        
-        // WINDOW OUT
-        
-        // compute temporary vars for interpolation
-        temp_index_int = (long)(index_w); // integer portion of index
-        temp_index_frac = index_w - (double)temp_index_int; // fractional portion of index
-        
-        // get value from the win buffer samples
-        if (interp_w == INTERP_ON) {
-            win_out = mcLinearInterp(tab_w, temp_index_int, temp_index_frac, size_w, 1);
-        } else {	// if INTERP_OFF
-            win_out = tab_w[temp_index_int];
-        }
-        
-        // SOUND OUT
-        
-        // compute temporary vars for interpolation
-        temp_index_int = (long)(index_s); // integer portion of index
-        temp_index_frac = index_s - (double)temp_index_int; // fractional portion of index
-        temp_index_int_times_chan = temp_index_int * chan_s;
-        
-        // get value from the snd buffer samples
-        if (interp_s == INTERP_ON) {
-            snd_out = mcLinearInterp(tab_s, temp_index_int_times_chan, temp_index_frac, size_s, chan_s);
-            snd_out2 = (chan_s == 2) ?
-                mcLinearInterp(tab_s, temp_index_int_times_chan + 1, temp_index_frac, size_s, chan_s) :
-                snd_out;
-        } else {	// if INTERP_OFF
-            snd_out = tab_s[temp_index_int_times_chan];
-            snd_out2 = (chan_s == 2) ?
-                tab_s[temp_index_int_times_chan + 1] :
-                snd_out;
-        }
-        
-        // OUTLETS
-        
-        // multiply snd_out by win_out by gain value
-        *out_signal = snd_out * win_out * g_gain;
-        *out_signal2 = snd_out2 * win_out * g_gain;;
-        
-        *out_sample_count = (double)count_samp;
-        
-    advance_pointers:
-        // advance all pointers
-        ++in_sound_start, ++in_dur, ++in_sample_increment, ++in_gain;
-        ++out_signal, ++out_signal2, ++out_sample_count;
+        i = end;
     }
     
+    // drop the grains that started, the rest move one vector closer
+    grainbang_agePending(x, due, vectorsize);
+    
     // update object history for next vector
-    x->curr_snd_pos = index_s;
-    x->curr_win_pos = index_w;
-    x->curr_count_samp = count_samp;
+    x->voice_active_count = active_count;
+    x->voice_newest = newest;
     
     buffer_unlocksamples(snd_object);
-    buffer_unlocksamples(win_object);
+    if (win_object)
+        buffer_unlocksamples(win_object);
+    
+    if (overflow)
+        qelem_set(x->overflow_qelem);
     return;
     
     // alternate blank output
@@ -518,144 +667,335 @@ zero:
     }
     
 out:
+    // grains due while nothing is heard are not played late
+    grainbang_skipQueue(x, vectorsize);
     return;
     
 }
 
 /********************************************************************************
-void grainbang_initGrain()
+bool grainbang_initGrain(t_grainbang *x, GrainVoice *v, t_grainbang_event *e,
+		float in_pos_start, float in_length, float in_pitch_mult, float in_gain_mult)
 
 inputs:	x					-- pointer to this object
+        v					-- voice that will play the grain
+        e					-- queued grain settings
         in_pos_start		-- offset within sampled buffer
         in_length			-- length of grain
         in_pitch_mult		-- sample playback speed, 1 = normal
         in_gain_mult		-- scales gain output, 1 = no change
-description:	initializes grain vars; called from perform method when bang is
-		received
-returns:		nothing 
+description:	initializes grain vars; called from perform method on the sample
+		where a queued grain is due; uses buffer info cached at the start of
+		the vector; a buffer~ window plays from a table when one has been built
+		for the grain length, otherwise the table is asked for
+returns:		false if the grain duration signal was not above zero, leaving
+		the voice free
 ********************************************************************************/
-void grainbang_initGrain(t_grainbang *x, float in_pos_start, float in_length, float in_pitch_mult, float in_gain_mult)
+bool grainbang_initGrain(t_grainbang *x, GrainVoice *v, t_grainbang_event *e, float in_pos_start,
+		float in_length, float in_pitch_mult, float in_gain_mult)
 {
+	const float *table;
+	long length;
+	
+	// messages are checked when queued, but a signal can still be zero
+	if (e->from_inlets && x->grain_length_connected && !(in_length > 0.0f))
+		return false;
+	
 	#ifdef DEBUG
 		object_post((t_object*)x, "initializing grain");
 	#endif /* DEBUG */
+	
+    /* should input variables be at audio or control rate ? */
+    
+    v->start(e->from_inlets && x->grain_pos_start_connected ? in_pos_start : e->pos_start,
+             e->from_inlets && x->grain_length_connected ? in_length : e->length,
+             e->from_inlets && x->grain_pitch_connected ? in_pitch_mult : e->pitch,
+             e->from_inlets && x->grain_gain_connected ? in_gain_mult : e->gain,
+             e->direction,
+             x->snd_buf.sr, x->snd_buf.msr, x->snd_buf.frames, x->win_buf_frames, x->output_sr);
+    if (x->pyramid)
+        v->useLevel(&x->snd_pyramid, x->snd_buf.msr);
+    v->useSinc(x->snd_sinc);
+    v->useKernels(x->grain_kernels, x->snd_buf.chans);
+    
+    // grains begun from the inlets follow them, and once the pitch moves the
+    // span checked by start no longer holds
+    if (e->from_inlets && (x->modulate_gain || x->modulate_pitch)) {
+        v->modulated = true;
+        if (x->modulate_pitch)
+            v->snd_wraps = true;
+    }
     
-    t_buffer_obj	*snd_object;
-    t_buffer_obj	*win_object;
+    if (x->window.type != NW_WINDOW_BUFFER) {
+        v->startWindow(&x->window, x->win_buf_frames);
+        return true;
+    }
+    
+    length = nw_wincache_length(fabs(v->grain_length) * x->output_sr * 0.001);
+    if (length) {
+        table = x->win_cache.find(length);
+        if (table)
+            v->useTable(table, length, x->win_buf_frames);
+        else if (x->win_cache.request(length))
+            qelem_set(x->win_cache_qelem);
+    }
+    
+    // send report out at beginning of grain ?
+	
+	#ifdef DEBUG
+		object_post((t_object*)x, "beginning of grain");
+		object_post((t_object*)x, "win step size = %f samps", v->win_step_size);
+		object_post((t_object*)x, "snd step size = %f samps", v->snd_step_size);
+	#endif /* DEBUG */
 	
-	if (x->next_snd_buf_ptr != NULL) {	//added 2002.07.24
-		x->snd_buf_ptr = x->next_snd_buf_ptr;
-		x->next_snd_buf_ptr = NULL;
-		//x->snd_last_out = 0.0;	//removed 2005.02.02
+	return true;
+}
+
+/********************************************************************************
+void grainbang_updateBuffers(t_grainbang *x)
+
+inputs:			x					-- pointer to this object
+description:	takes buffers posted by setSound and setWin, and the shape
+		deferred by window; called from perform method at the start of each 
+		vector so that every voice reads the same locked buffers; voices 
+		already sounding are rescaled to the length of a new window, and carry
+		on from the same place with a new shape
+returns:		nothing 
+********************************************************************************/
+void grainbang_updateBuffers(t_grainbang *x)
+{
+	GrainVoice *v;
+	double win_scale;
+	long new_frames, a;
+	bool win_swapped = false, shape_swapped = false;
+	
+	if (x->snd_swap.take(&x->snd_buf)) {
+		// sounding voices checked their span against the old sound
+		for (a = 0; a < x->voice_active_count; a++)
+			x->voice_pool[a].snd_wraps = true;
 		
 		#ifdef DEBUG
 			object_post((t_object*)x, "sound buffer pointer updated");
 		#endif /* DEBUG */
 	}
-	if (x->next_win_buf_ptr != NULL) {	//added 2002.07.24
-		x->win_buf_ptr = x->next_win_buf_ptr;
-		x->next_win_buf_ptr = NULL;
-		//x->win_last_out = 0.0;	//removed 2005.02.02
+	if (x->win_swap.take(&x->win_buf)) {
+		win_swapped = true;
 		
 		#ifdef DEBUG
 			object_post((t_object*)x, "window buffer pointer updated");
 		#endif /* DEBUG */
 	}
+	if (x->window_swap.take(&x->window)) {
+		shape_swapped = true;
+	}
 	
-    snd_object = buffer_ref_getobject(x->snd_buf_ptr);
-    win_object = buffer_ref_getobject(x->win_buf_ptr);
+	if (win_swapped || shape_swapped) {
+		// keep sounding voices at the same relative place in the new window
+		if (x->window.type != NW_WINDOW_BUFFER)
+			new_frames = NW_WINDOW_FRAMES;
+		else if (x->win_buf.ref != NULL)
+			new_frames = x->win_buf.frames;
+		else
+			new_frames = 0;
+		if (x->win_buf_frames > 0 && new_frames > 0 && new_frames != x->win_buf_frames) {
+			win_scale = (double)new_frames / (double)(x->win_buf_frames);
+			for (a = 0; a < x->voice_active_count; a++) {
+				v = x->voice_pool + a;
+				v->curr_win_pos *= win_scale;
+				v->win_step_size *= win_scale;
+			}
+		}
+		x->win_buf_frames = new_frames;
+		
+		if (shape_swapped) {
+			for (a = 0; a < x->voice_active_count; a++)
+				x->voice_pool[a].startWindow(&x->window, new_frames);
+		}
+	}
+}
+
+/********************************************************************************
+void grainbang_buildWindows(t_grainbang *x)
+
+inputs:			x					-- pointer to this object
+description:	builds the window tables asked for by the perform routine;
+		called from a qelem so that resampling stays off the audio thread
+returns:		nothing 
+********************************************************************************/
+void grainbang_buildWindows(t_grainbang *x)
+{
+	t_buffer_obj *win_object;
+	float *tab_w;
 	
-    /* should input variables be at audio or control rate ? */
-    
-    // temporarily stash here as milliseconds
-    x->grain_pos_start = x->grain_pos_start_connected ? in_pos_start : x->next_grain_pos_start;
-    
-    x->grain_length = x->grain_length_connected ? in_length : x->next_grain_length;
-    
-    x->grain_pitch = x->grain_pitch_connected ? in_pitch_mult : x->next_grain_pitch;
-    
-    x->grain_gain = x->grain_gain_connected ? in_gain_mult : x->next_grain_gain;
-    
-    /* compute dependent variables */
+	if (x->win_ref == NULL)
+		return;
 	
-	// compute amount of sound file for grain
-    x->grain_sound_length = x->grain_length * x->grain_pitch;
-    if (x->grain_sound_length < 0.) x->grain_sound_length *= -1.; // needs to be positive to prevent buffer overruns
-    
-    // compute window buffer step size per vector sample
-    x->win_step_size = (double)(buffer_getframecount(win_object)) / (x->grain_length * x->output_sr * 0.001);
-    if (x->win_step_size < 0.) x->win_step_size *= -1.; // needs to be positive to prevent buffer overruns
+	win_object = buffer_ref_getobject(x->win_ref);
+	tab_w = buffer_locksamples(win_object);
+	if (!tab_w)
+		return;
 	
-    // compute sound buffer step size per vector sample
-    x->snd_step_size = x->grain_pitch * buffer_getsamplerate(snd_object) * x->output_1oversr;
-    //if (x->snd_step_size < 0.) x->snd_step_size *= -1.; // needs to be positive to prevent buffer overruns
-    
-    // update direction option
-    x->grain_direction = x->next_grain_direction;
-    
-    if (x->grain_direction == FORWARD_GRAINS) {	// if forward...
-        x->grain_pos_start = x->grain_pos_start * buffer_getmillisamplerate(snd_object);
-        x->curr_snd_pos = x->grain_pos_start - x->snd_step_size;
-    } else {	// if reverse...
-        x->grain_pos_start = (x->grain_pos_start + x->grain_sound_length) * buffer_getmillisamplerate(snd_object);
-        x->curr_snd_pos = x->grain_pos_start + x->snd_step_size;
-    }
-    
-    x->curr_win_pos = 0.0;
-    
-    // reset history
-    x->curr_count_samp = -1;
-    
-    // send report out at beginning of grain ?
+	x->win_cache.update(tab_w, buffer_getframecount(win_object));
+	buffer_unlocksamples(win_object);
 	
 	#ifdef DEBUG
-		object_post((t_object*)x, "beginning of grain");
-		object_post((t_object*)x, "win step size = %f samps", x->win_step_size);
-		object_post((t_object*)x, "snd step size = %f samps", x->snd_step_size);
+		object_post((t_object*)x, "window tables built");
+	#endif /* DEBUG */
+}
+
+/********************************************************************************
+void grainbang_buildPyramid(t_grainbang *x)
+
+inputs:			x					-- pointer to this object
+description:	builds the levels of the pyramid asked for by the perform
+		routine, a piece at a time; called from a qelem so that filtering
+		stays off the audio thread, and sets the qelem again until done
+returns:		nothing 
+********************************************************************************/
+void grainbang_buildPyramid(t_grainbang *x)
+{
+	t_buffer_ref *snd_ref = (t_buffer_ref *)x->snd_pyramid.wanted();
+	t_buffer_obj *snd_object;
+	t_buffer_info b_info;
+	float *tab_s;
+	bool more;
+	
+	// with no sound wanted, the levels of the last one are only freed
+	snd_object = snd_ref ? buffer_ref_getobject(snd_ref) : NULL;
+	tab_s = snd_object ? buffer_locksamples(snd_object) : NULL;
+	if (!tab_s) {
+		x->snd_pyramid.update(NULL, 0, 0, 0);
+		return;
+	}
+	
+	buffer_getinfo(snd_object, &b_info);
+	more = x->snd_pyramid.update(tab_s, b_info.b_frames, b_info.b_nchans, b_info.b_modtime);
+	buffer_unlocksamples(snd_object);
+	
+	if (more)
+		qelem_set(x->pyramid_qelem);
+	
+	#ifdef DEBUG
+		object_post((t_object*)x, more ? "pyramid level building" : "pyramid built");
 	#endif /* DEBUG */
 }
 
+/********************************************************************************
+void grainbang_drainQueue(t_grainbang *x, long vectorsize)
+
+inputs:			x					-- pointer to this object
+				vectorsize			-- samples in the vector about to be rendered
+description:	moves grains from the queue to the pending list, converting
+		their scheduler times to samples; the vector is taken to cover the
+		scheduler time from one vector before now up to now, so grains queued
+		during the last vector start as far into this one as they came after
+		it began, and keep their spacing at any vector size; grains already
+		late start on the first sample; the list is kept sorted by delay, and
+		grains with equal delays stay in the order they were queued; grains
+		that do not fit stay in the queue for a later vector
+returns:		nothing 
+********************************************************************************/
+void grainbang_drainQueue(t_grainbang *x, long vectorsize)
+{
+	t_grainbang_event *pending = x->grain_pending;
+	t_grainbang_event e;
+	double vector_time;
+	long a;
+	
+	// scheduler time at which this vector begins
+	vector_time = gettime_forobject((t_object*)x) - (double)vectorsize * x->output_1oversr * 1000.0;
+	
+	while (x->grain_pending_count < QUEUE_SIZE && x->grain_queue.pop(&e)) {
+		e.delay = (e.time > vector_time) ? (long)((e.time - vector_time) * x->output_sr * 0.001 + 0.5) : 0;
+		
+		// insert after every grain that starts no later
+		a = x->grain_pending_count++;
+		while (a > 0 && pending[a - 1].delay > e.delay) {
+			pending[a] = pending[a - 1];
+			--a;
+		}
+		pending[a] = e;
+	}
+}
+
+/********************************************************************************
+void grainbang_agePending(t_grainbang *x, long due, long vectorsize)
+
+inputs:			x					-- pointer to this object
+				due					-- grains at the front of the pending list
+									   that were due in this vector
+				vectorsize			-- samples in the vector just rendered
+description:	drops the grains that were due, and moves the rest one vector
+		closer
+returns:		nothing 
+********************************************************************************/
+void grainbang_agePending(t_grainbang *x, long due, long vectorsize)
+{
+	t_grainbang_event *pending = x->grain_pending;
+	long a;
+	
+	x->grain_pending_count -= due;
+	for (a = 0; a < x->grain_pending_count; a++) {
+		pending[a] = pending[a + due];
+		pending[a].delay -= vectorsize;
+	}
+}
+
+/********************************************************************************
+void grainbang_skipQueue(t_grainbang *x, long vectorsize)
+
+inputs:			x					-- pointer to this object
+				vectorsize			-- samples in the vector just rendered
+description:	called from perform method for a vector rendered without grains,
+		while the object is muted or a buffer is missing; grains due in it are
+		dropped rather than started late, so that the queue neither fills up
+		nor bursts when sound comes back
+returns:		nothing 
+********************************************************************************/
+void grainbang_skipQueue(t_grainbang *x, long vectorsize)
+{
+	long due = 0;
+	
+	grainbang_drainQueue(x, vectorsize);
+	while (due < x->grain_pending_count && x->grain_pending[due].delay < vectorsize)
+		++due;
+	grainbang_agePending(x, due, vectorsize);
+}
+
 /********************************************************************************
 void grainbang_setsnd(t_index *x, t_symbol *s)
 
 inputs:			x		-- pointer to this object
 				s		-- name of buffer to link
-description:	links buffer holding the grain sound source 
+description:	links buffer holding the grain sound source; the perform
+		routine takes it, with its frame count, channel count and sample rate,
+		at the start of its next vector
 returns:		nothing
 ********************************************************************************/
 void grainbang_setsnd(t_grainbang *x, t_symbol *s)
 {
     t_buffer_ref *b = buffer_ref_new((t_object*)x, s);
+    t_buffer_info b_info;
+    t_nw_bufinfo info;
     
     if (buffer_ref_exists(b)) {
         t_buffer_obj	*b_object = buffer_ref_getobject(b);
         
-        if (buffer_getchannelcount(b_object) > 2) {
+        buffer_getinfo(b_object, &b_info);
+        if (b_info.b_nchans > 2) {
 			object_error((t_object*)x, "buffer~ > %s < must be mono or stereo", s->s_name);
-			x->next_snd_buf_ptr = NULL;		//added 2002.07.15
 		} else {
-			if (x->snd_buf_ptr == NULL) { // if first buffer make current buffer
-				x->snd_sym = s;
-				x->snd_buf_ptr = b;
-				//x->snd_last_out = 0.0;	//removed 2005.02.02
-				
-				#ifdef DEBUG
-					object_post((t_object*)x, "current sound set to buffer~ > %s <", s->s_name);
-				#endif /* DEBUG */
-			} else { // defer to next buffer
-				x->snd_sym = s;
-				x->next_snd_buf_ptr = b;
-				//x->snd_buf_length = b->b_frames;	//removed 2002.07.11
-				//x->snd_last_out = 0.0;		//removed 2002.07.24
-				
-				#ifdef DEBUG
-					object_post((t_object*)x, "next sound set to buffer~ > %s <", s->s_name);
-				#endif /* DEBUG */
-			}
+			x->snd_sym = s;
+			x->snd_ref = b;
+			nw_bufinfo_set(&info, b, b_info.b_frames, b_info.b_nchans, b_info.b_sr, b_info.b_modtime);
+			x->snd_swap.post(info);
+			
+			#ifdef DEBUG
+				object_post((t_object*)x, "next sound set to buffer~ > %s <", s->s_name);
+			#endif /* DEBUG */
 		}
 	} else {
 		object_error((t_object*)x, "no buffer~ * %s * found", s->s_name);
-		x->next_snd_buf_ptr = NULL;
 	}
 }
 
@@ -664,48 +1004,74 @@ void grainbang_setwin(t_grainbang *x, t_symbol *s)
 
 inputs:			x		-- pointer to this object
 				s		-- name of buffer to link
-description:	links buffer holding the grain window 
+description:	links buffer holding the grain window; the perform routine
+		takes it at the start of its next vector
 returns:		nothing
 ********************************************************************************/
 void grainbang_setwin(t_grainbang *x, t_symbol *s)
 {
     t_buffer_ref *b = buffer_ref_new((t_object*)x, s);
+    t_buffer_info b_info;
+    t_nw_bufinfo info;
     
     if (buffer_ref_exists(b)) {
         t_buffer_obj	*b_object = buffer_ref_getobject(b);
         
-        if (buffer_getchannelcount(b_object) != 1) {
+        buffer_getinfo(b_object, &b_info);
+        if (b_info.b_nchans != 1) {
             object_error((t_object*)x, "buffer~ > %s < must be mono", s->s_name);
-			x->next_win_buf_ptr = NULL;		//added 2002.07.15
 		} else {
-			if (x->win_buf_ptr == NULL) { // if first buffer make current buffer
-				x->win_sym = s;
-				x->win_buf_ptr = b;
-				//x->win_last_out = 0.0;	//removed 2005.02.02
-				
-				/* set current win position to 1 more than length */
-				x->curr_win_pos = 0.0;
-				
-				#ifdef DEBUG
-					object_post((t_object*)x, "current window set to buffer~ > %s <", s->s_name);
-				#endif /* DEBUG */
-			} else { // else defer to next buffer
-				x->win_sym = s;
-				x->next_win_buf_ptr = b;
-				//x->win_buf_length = b->b_frames;	//removed 2002.07.11
-				//x->win_last_out = 0.0;		//removed 2002.07.24
-				
-				#ifdef DEBUG
-					object_post((t_object*)x, "next window set to buffer~ > %s <", s->s_name);
-				#endif /* DEBUG */
-			}
+			x->win_sym = s;
+			x->win_ref = b;
+			nw_bufinfo_set(&info, b, b_info.b_frames, b_info.b_nchans, b_info.b_sr, b_info.b_modtime);
+			x->win_swap.post(info);
+			
+			#ifdef DEBUG
+				object_post((t_object*)x, "next window set to buffer~ > %s <", s->s_name);
+			#endif /* DEBUG */
 		}
 	} else {
 		object_error((t_object*)x, "no buffer~ > %s < found", s->s_name);
-		x->next_win_buf_ptr = NULL;
 	}
 }
 
+/********************************************************************************
+void grainbang_window(t_grainbang *x, t_symbol *s, long argc, t_atom *argv)
+
+inputs:			x		-- pointer to this object
+				s		-- message selector
+				argc	-- number of arguments
+				argv	-- shape name, then an optional parameter
+description:	method called when "window" message is received; picks one of the
+		analytic window shapes, or "buffer" to go back to the window buffer~;
+		takes effect at the start of the next vector
+returns:		nothing
+********************************************************************************/
+void grainbang_window(t_grainbang *x, t_symbol *s, long argc, t_atom *argv)
+{
+	t_nw_window w;
+	
+	if (argc < 1 || atom_gettype(argv) != A_SYM) {
+		object_error((t_object*)x, "window needs the name of a shape");
+		return;
+	}
+	if (!nw_window_set(&w, atom_getsym(argv)->s_name, argc > 1, argc > 1 ? atom_getfloat(argv + 1) : 0.)) {
+		object_error((t_object*)x, "window %s was not understood", atom_getsym(argv)->s_name);
+		return;
+	}
+	
+	// the window buffer~ is only linked when the dsp starts with it in use
+	if (w.type == NW_WINDOW_BUFFER && x->win_ref == NULL)
+		grainbang_setwin(x, x->win_sym);
+	
+	x->next_window = w;
+	x->window_swap.post(w);
+	
+	#ifdef DEBUG
+		object_post((t_object*)x, "window is set to %s", atom_getsym(argv)->s_name);
+	#endif /* DEBUG */
+}
+
 /********************************************************************************
 void grainbang_float(t_grainbang *x, double f)
 
@@ -724,7 +1090,11 @@ void grainbang_float(t_grainbang *x, double f)
             x->next_grain_pos_start = f;
             break;
         case 2:
-            x->next_grain_length = f;
+            if (f > 0.0) {
+                x->next_grain_length = f;
+            } else {
+                object_post((t_object*)x, "grain length must be greater than zero");
+            }
             break;
         case 3:
             x->next_grain_pitch = f;
@@ -757,7 +1127,11 @@ void grainbang_int(t_grainbang *x, long l)
             x->next_grain_pos_start = (double)l;
             break;
         case 2:
-            x->next_grain_length = (double)l;
+            if (l > 0) {
+                x->next_grain_length = (double)l;
+            } else {
+                object_post((t_object*)x, "grain length must be greater than zero");
+            }
             break;
         case 3:
             x->next_grain_pitch = (double)l;
@@ -775,22 +1149,26 @@ void grainbang_int(t_grainbang *x, long l)
 void grainbang_bang(t_grainbang *x)
 
 inputs:			x		-- pointer to our object
-description:	handles bangs sent to inlets; inlet 1 creates a grain; all others
-	post an error to the max window
+description:	handles bangs sent to inlets; inlet 1 queues a grain stamped with
+	the scheduler time of the bang, using the signal inlets if connected and
+	the last floats received if not; all others post an error to the max window
 returns:		nothing
 ********************************************************************************/
 void grainbang_bang(t_grainbang *x)
 {
+	t_grainbang_event e;
+	
 	if (x->x_obj.z_in == 0) // if inlet 1
 	{
-		if (sys_getdspstate() && x->grain_stage == NO_GRAIN) {
-			x->grain_stage = NEW_GRAIN;
-			#ifdef DEBUG
-				object_post((t_object*)x, "grain stage set to new grain");
-			#endif // DEBUG //
-		} else {
-			defer(x, (method)grainbang_overflow,0L,0,0L); //added 2002.11.19
-		}
+		e.time = gettime_forobject((t_object*)x);
+		e.pos_start = x->next_grain_pos_start;
+		e.length = x->next_grain_length;
+		e.pitch = x->next_grain_pitch;
+		e.gain = x->next_grain_gain;
+		e.direction = x->next_grain_direction;
+		e.from_inlets = true;
+		
+		grainbang_queueGrain(x, &e);
 	}
 	else // all other inlets
 	{
@@ -799,44 +1177,204 @@ void grainbang_bang(t_grainbang *x)
 }
 
 /********************************************************************************
-void grainbang_overflow(t_grainbang *x, t_symbol *s, short argc, t_atom argv)
+void grainbang_grain(t_grainbang *x, t_symbol *s, long argc, t_atom *argv)
+
+inputs:			x		-- pointer to our object
+				s		-- name of the message
+				argc	-- number of values
+				argv	-- time offset in ms, sound buffer offset in ms, grain 
+					duration in ms, sample increment and gain multiplier
+description:	method called when "grain" message is received; queues a grain
+	with its own settings to start the given time after the scheduler time
+	of the message, so that grains keep their spacing whatever the vector
+	size; a duration that is not above zero is refused
+returns:		nothing
+********************************************************************************/
+void grainbang_grain(t_grainbang *x, t_symbol *s, long argc, t_atom *argv)
+{
+	t_grainbang_event e;
+	double offset;
+	
+	if (argc != 5) {
+		object_error((t_object*)x, "grain needs time offset, position, duration, pitch and gain");
+		return;
+	}
+	
+	offset = atom_getfloat(argv);
+	if (offset < 0.0) offset = 0.0;
+	e.time = gettime_forobject((t_object*)x) + offset;
+	e.pos_start = atom_getfloat(argv + 1);
+	e.length = atom_getfloat(argv + 2);
+	if (!(e.length > 0.0)) {
+		object_post((t_object*)x, "grain length must be greater than zero");
+		return;
+	}
+	e.pitch = atom_getfloat(argv + 3);
+	e.gain = atom_getfloat(argv + 4);
+	e.direction = x->next_grain_direction;
+	e.from_inlets = false;
+	
+	grainbang_queueGrain(x, &e);
+}
+
+/********************************************************************************
+void grainbang_queueGrain(t_grainbang *x, t_grainbang_event *e)
+
+inputs:			x		-- pointer to our object
+				e		-- settings of the grain to start
+description:	hands a grain to the perform method, from whichever thread the
+	message came on; bangs the overflow outlet if dsp is off or the queue is
+	full
+returns:		nothing
+********************************************************************************/
+void grainbang_queueGrain(t_grainbang *x, t_grainbang_event *e)
+{
+	if (sys_getdspstate() && x->grain_queue.push(*e)) {
+		#ifdef DEBUG
+			object_post((t_object*)x, "grain queued");
+		#endif // DEBUG //
+	} else {
+		qelem_set(x->overflow_qelem); //added 2002.11.19
+	}
+}
+
+/********************************************************************************
+void grainbang_overflow(t_grainbang *x)
 
 inputs:			x		-- pointer to our object
-description:	handles bangs sent to overflow outlet; allows the method to be 
-	deferred
+description:	handles bangs sent to overflow outlet; called from a qelem so
+	that the perform method can report grains that found no free voice
 returns:		nothing
 ********************************************************************************/
-void grainbang_overflow(t_grainbang *x, t_symbol *s, short argc, t_atom argv)
+void grainbang_overflow(t_grainbang *x)
 {
 	if (sys_getdspstate()) {
 		outlet_bang(x->out_overflow);
 	}
 }
 
+/********************************************************************************
+void grainbang_publishKernels(t_grainbang *x)
+
+inputs:			x		-- pointer to this object
+description:	hands the kernels for the current sndInterp and winInterp modes
+		to the perform routine, which takes them at its next vector; one
+		pointer is swapped, so the two modes always arrive together
+returns:		nothing
+********************************************************************************/
+void grainbang_publishKernels(t_grainbang *x)
+{
+	x->next_kernels.store(nw_grain_kernels(x->snd_interp, x->win_interp), std::memory_order_release);
+}
+
+/********************************************************************************
+void grainbang_updateKernels(t_grainbang *x, long chan_s)
+
+inputs:			x		-- pointer to this object
+				chan_s	-- channels in the sound buffer
+description:	perform routine side; takes the kernels last published, and
+		moves sounding voices onto them when they or the sound's channels
+		change, so that every voice plays the modes set
+returns:		nothing
+********************************************************************************/
+void grainbang_updateKernels(t_grainbang *x, long chan_s)
+{
+	const t_nw_grain_kernels *kernels = x->next_kernels.load(std::memory_order_acquire);
+	long a;
+	
+	if (kernels == x->grain_kernels && x->grain_stereo == (chan_s == 2))
+		return;
+	
+	x->grain_kernels = kernels;
+	x->grain_stereo = (chan_s == 2);
+	for (a = 0; a < x->voice_active_count; a++)
+		x->voice_pool[a].useKernels(kernels, chan_s);
+}
+
 /********************************************************************************
 void grainbang_sndInterp(t_grainbang *x, long l)
 
 inputs:			x		-- pointer to our object
 				l		-- flag value
 description:	method called when "sndInterp" message is received; allows user 
-		to define whether interpolation is used in pulling values from the sound
-		buffer; default is on
+		to choose the interpolation used in pulling values from the sound
+		buffer; 0 = off, 1 = linear, 2 = hermite, 3 = lagrange, 4 = windowed
+		sinc; default is linear
 returns:		nothing
 ********************************************************************************/
 void grainbang_sndInterp(t_grainbang *x, long l)
 {
-	if (l == INTERP_OFF) {
-		x->snd_interp = INTERP_OFF;
+	if (l == INTERP_SINC && !x->snd_sinc) {
+		x->snd_sinc = nw_sinc_get(NW_SINC_PHASES);
+		if (!x->snd_sinc) {
+			object_error((t_object*)x, "out of memory for the sinc table");
+			return;
+		}
+	}
+	
+	if (l >= INTERP_OFF && l <= INTERP_SINC) {
+		x->snd_interp = (short)l;
+		grainbang_publishKernels(x);
 		#ifdef DEBUG
-			object_post((t_object*)x, "sndInterp is set to off");
+			object_post((t_object*)x, "sndInterp is set to %ld", l);
 		#endif // DEBUG //
-	} else if (l == INTERP_ON) {
-		x->snd_interp = INTERP_ON;
+	} else {
+		object_error((t_object*)x, "sndInterp message was not understood");
+	}
+}
+
+/********************************************************************************
+void grainbang_sincTable(t_grainbang *x, long l)
+
+inputs:			x		-- pointer to our object
+				l		-- phases per frame
+description:	method called when "sincTable" message is received; sets the
+		size of the table read by sndInterp 4, rounded to a power of two
+		between 16 and 4096; larger tables read between frames more finely;
+		default is 256; grains begun afterwards use it
+returns:		nothing
+********************************************************************************/
+void grainbang_sincTable(t_grainbang *x, long l)
+{
+	const t_nw_sinc *sinc;
+	
+	if (l < 1) {
+		object_error((t_object*)x, "sincTable message was not understood");
+		return;
+	}
+	
+	sinc = nw_sinc_get(l);
+	if (!sinc) {
+		object_error((t_object*)x, "out of memory for the sinc table");
+		return;
+	}
+	x->snd_sinc = sinc;
+	#ifdef DEBUG
+		object_post((t_object*)x, "sincTable is set to %ld phases", sinc->phases);
+	#endif // DEBUG //
+}
+
+/********************************************************************************
+void grainbang_pyramid(t_grainbang *x, long l)
+
+inputs:			x		-- pointer to our object
+				l		-- flag value
+description:	method called when "pyramid" message is received; 1 keeps
+		copies of the sound buffer decimated by octaves, built in the
+		background each time the buffer~ changes, and grains pitched up by
+		more than 2 read the copy that brings their step to 2 or below, which
+		reads less memory and aliases less; 0 = off; default is off
+returns:		nothing
+********************************************************************************/
+void grainbang_pyramid(t_grainbang *x, long l)
+{
+	if (l == 0 || l == 1) {
+		x->pyramid = (short)l;
 		#ifdef DEBUG
-			object_post((t_object*)x, "sndInterp is set to on");
+			object_post((t_object*)x, "pyramid is set to %ld", l);
 		#endif // DEBUG //
 	} else {
-		object_error((t_object*)x, "sndInterp message was not understood");
+		object_error((t_object*)x, "pyramid message was not understood");
 	}
 }
 
@@ -846,21 +1384,17 @@ void grainbang_winInterp(t_grainbang *x, long l)
 inputs:			x		-- pointer to our object
 				l		-- flag value
 description:	method called when "winInterp" message is received; allows user 
-		to define whether interpolation is used in pulling values from the window
-		buffer; default is on
+		to choose the interpolation used in pulling values from the window
+		buffer; 0 = off, 1 = linear, 2 = hermite, 3 = lagrange; default is linear
 returns:		nothing
 ********************************************************************************/
 void grainbang_winInterp(t_grainbang *x, long l)
 {
-	if (l == INTERP_OFF) {
-		x->win_interp = INTERP_OFF;
-		#ifdef DEBUG
-			object_post((t_object*)x, "winInterp is set to off");
-		#endif // DEBUG //
-	} else if (l == INTERP_ON) {
-		x->win_interp = INTERP_ON;
+	if (l >= INTERP_OFF && l <= INTERP_LAGRANGE) {
+		x->win_interp = (short)l;
+		grainbang_publishKernels(x);
 		#ifdef DEBUG
-			object_post((t_object*)x, "winInterp is set to on");
+			object_post((t_object*)x, "winInterp is set to %ld", l);
 		#endif // DEBUG //
 	} else {
 		object_error((t_object*)x, "winInterp was not understood");
@@ -894,6 +1428,34 @@ void grainbang_reverse(t_grainbang *x, long l)
 	
 }
 
+/********************************************************************************
+t_max_err grainbang_voices_set(t_grainbang *x, void *attr, long argc, t_atom *argv)
+
+inputs:			x		-- pointer to our object
+				attr	-- the attribute being set
+				argc	-- number of values
+				argv	-- new number of voices
+description:	setter for the "voices" attribute; defines how many grains may
+		sound at once; voices beyond a lowered count are left to finish
+returns:		MAX_ERR_NONE
+********************************************************************************/
+t_max_err grainbang_voices_set(t_grainbang *x, void *attr, long argc, t_atom *argv)
+{
+	long l;
+	
+	if (argc && argv) {
+		l = (long)atom_getlong(argv);
+		if (l < VOICES_MIN) l = VOICES_MIN;
+		if (l > VOICES_MAX) l = VOICES_MAX;
+		x->voice_count = l;
+		
+		#ifdef DEBUG
+			object_post((t_object*)x, "voices set to %ld", x->voice_count);
+		#endif // DEBUG //
+	}
+	return MAX_ERR_NONE;
+}
+
 /********************************************************************************
 void grainbang_assist(t_grainbang *x, t_object *b, long msg, long arg, char *s)
 
@@ -911,7 +1473,7 @@ void grainbang_assist(t_grainbang *x, t_object *b, long msg, long arg, char *s)
 	if (msg==ASSIST_INLET) {
 		switch (arg) {
 			case 0:
-				strcpy(s, "(bang) starts grain production");
+				strcpy(s, "(bang/grain) starts grain production");
 				break;
             case 1:
                 strcpy(s, "(signal/float) sound buffer offset in ms");
@@ -962,35 +1524,3 @@ void grainbang_getinfo(t_grainbang *x)
 	object_post((t_object*)x, "%s object by Nathan Wolek", OBJECT_NAME);
 	object_post((t_object*)x, "Last updated on %s - www.nathanwolek.com", __DATE__);
 }
-
-
-/********************************************************************************
-double mcLinearInterp(float *in_array, long index_i, double index_frac, 
-		long in_size, short in_chans)
-
-inputs:			*in_array -- name of array of input values
-				index_i -- index value of sample, specific channel within interleaved frame
-				index_frac -- fractional portion of index value for interp
-				in_size -- size of input buffer to perform wrapping
-				in_chans -- number of channels in input buffer
-description:	performs linear interpolation on an input array and to return 
-	value of a fractional sample location
-returns:		interpolated output
-********************************************************************************/
-double mcLinearInterp(float *in_array, long index_i, double index_frac, long in_size, short in_chans)
-{
-	double out, sample1, sample2;
-	long index_iP1 = index_i + in_chans;		// corresponding sample in next frame
-	
-	// make sure that index_iP1 is not out of range
-	while (index_iP1 >= in_size * in_chans) index_iP1 -= in_size;
-	
-	// get samples
-	sample1 = (double)in_array[index_i];
-	sample2 = (double)in_array[index_iP1];
-	
-	//linear interp formula
-	out = sample1 + index_frac * (sample2 - sample1);
-	
-	return out;
-}
\ No newline at end of file
@@ -11,6 +11,10 @@
 */
 
 #include "c74_msp.h"
+#include <atomic>
+#include "nw_bufswap.h"
+#include "nw_interp.h"
+#include "nw_window.h"
 
 using namespace c74::max;
 
@@ -27,29 +31,52 @@ using namespace c74::max;
 #define REVERSE_GRAINS		1
 
 /* for interpolation flag */
-#define INTERP_OFF			0
-#define INTERP_ON			1
+#define INTERP_OFF			NW_INTERP_NONE
+#define INTERP_ON			NW_INTERP_LINEAR
+#define INTERP_HERMITE		NW_INTERP_HERMITE
+#define INTERP_LAGRANGE		NW_INTERP_LAGRANGE
+#define INTERP_SINC			NW_INTERP_SINC
 
 static t_class *grainphase_class;		// required global pointing to this class
 
+/* the perform loop for one set of options, see grainphase_run() */
+struct _grainphase;
+typedef long (*t_grainphase_kernel)(struct _grainphase *x, const float *tab_s, long size_s, long chan_s,
+	const float *tab_w, long size_w, const t_nw_window *window, double **ins, double **outs, long i, long vectorsize);
+
+/* the kernels for one pair of interpolation modes */
+typedef struct _grainphase_kernels
+{
+	t_grainphase_kernel kernel[2][2];	// by grain direction, then mono or stereo
+} t_grainphase_kernels;
+
 typedef struct _grainphase
 {
 	t_pxobject x_obj;					// <--
 	// sound buffer info
 	t_symbol *snd_sym;
-	t_buffer_ref *snd_buf_ptr;
-	t_buffer_ref *next_snd_buf_ptr;
+	t_buffer_ref *snd_ref;				// last buffer~ linked, main thread only
+	NwBufSwap snd_swap;					// hands snd_ref to the perform routine
+	t_nw_bufinfo snd_buf;				// buffer~ being played, perform only
 	//double snd_last_out;	//removed 2005.02.02
 	//long snd_buf_length;	//removed 2002.07.11
 	short snd_interp;
+	const t_nw_sinc *snd_sinc;			// sinc tables, once sndInterp 4 or sincTable asks
 	// window buffer info
 	t_symbol *win_sym;
-	t_buffer_ref *win_buf_ptr;
-	t_buffer_ref *next_win_buf_ptr;
+	t_buffer_ref *win_ref;				// last buffer~ linked, main thread only
+	NwBufSwap win_swap;					// hands win_ref to the perform routine
+	t_nw_bufinfo win_buf;				// buffer~ being played, perform only
 	//double win_last_out;	//removed 2005.02.02
 	double win_last_index;  // in frames
 	//long win_buf_length;	//removed 2002.07.11
 	short win_interp;
+	t_nw_window window;					// analytic shape, or NW_WINDOW_BUFFER
+	t_nw_window next_window;			// last shape given to the window message, main thread only
+	NwSwap<t_nw_window> window_swap;	// hands next_window to the perform routine
+	// perform kernels
+	std::atomic<const t_grainphase_kernels *> next_kernels;	// for snd_interp and win_interp
+	t_grainphase_kernel grain_kernel;	// kernel playing, perform only
 	// grain info
 	double grain_pos_start;	// in samples
     double grain_pitch;	// as multiplier, 0 to 1
@@ -58,6 +85,7 @@ typedef struct _grainphase
 	double grain_sound_length; // in samples
 	double curr_snd_pos; // in samples
 	double snd_step_size; // in samples
+	const t_nw_sinc_filter *grain_sinc;	// filter for the sinc kernel, see nw_sinc.h
 	// defered grain info at control rate
 	double next_grain_pos_start;	// in milliseconds
     double next_grain_pitch;		// as multiplier, 0 to 1
@@ -79,14 +107,35 @@ void grainphase_initGrain(t_grainphase *x, float in_pos_start, float in_pitch_mu
 void grainphase_dsp64(t_grainphase *x, t_object *dsp64, short *count, double samplerate, long maxvectorsize, long flags);
 void grainphase_setsnd(t_grainphase *x, t_symbol *s);
 void grainphase_setwin(t_grainphase *x, t_symbol *s);
+void grainphase_window(t_grainphase *x, t_symbol *s, long argc, t_atom *argv);
 void grainphase_float(t_grainphase *x, double f);
 void grainphase_int(t_grainphase *x, long l);
 void grainphase_assist(t_grainphase *x, t_object *b, long msg, long arg, char *s);
 void grainphase_getinfo(t_grainphase *x);
 void grainphase_sndInterp(t_grainphase *x, long l);
+void grainphase_sincTable(t_grainphase *x, long l);
 void grainphase_winInterp(t_grainphase *x, long l);
 void grainphase_reverse(t_grainphase *x, long l);
-double mcLinearInterp(float *in_array, long index_i, double index_frac, long in_size, short in_chans);
+void grainphase_publishKernels(t_grainphase *x);
+t_grainphase_kernel grainphase_kernel(t_grainphase *x);
+template <int InterpS, int InterpW, short Direction, int Chans>
+long grainphase_run(t_grainphase *x, const float *tab_s, long size_s, long chan_s, const float *tab_w, long size_w,
+	const t_nw_window *window, double **ins, double **outs, long i, long vectorsize);
+
+/* every kernel, by sound then window interpolation mode */
+#define GRAINPHASE_KERNELS(s, w)	{ { \
+	{ grainphase_run<s, w, FORWARD_GRAINS, 1>, grainphase_run<s, w, FORWARD_GRAINS, 2> }, \
+	{ grainphase_run<s, w, REVERSE_GRAINS, 1>, grainphase_run<s, w, REVERSE_GRAINS, 2> } } }
+#define GRAINPHASE_KERNELS_W(s)		{ GRAINPHASE_KERNELS(s, INTERP_OFF), GRAINPHASE_KERNELS(s, INTERP_ON), \
+	GRAINPHASE_KERNELS(s, INTERP_HERMITE), GRAINPHASE_KERNELS(s, INTERP_LAGRANGE) }
+
+static const t_grainphase_kernels grainphase_kernels[INTERP_SINC + 1][INTERP_LAGRANGE + 1] = {
+	GRAINPHASE_KERNELS_W(INTERP_OFF),
+	GRAINPHASE_KERNELS_W(INTERP_ON),
+	GRAINPHASE_KERNELS_W(INTERP_HERMITE),
+	GRAINPHASE_KERNELS_W(INTERP_LAGRANGE),
+	GRAINPHASE_KERNELS_W(INTERP_SINC)
+};
 
 t_symbol *ps_buffer;
 
@@ -112,6 +161,9 @@ int C74_EXPORT main(void)
 	/* bind method "grainphase_setwin" to the 'setWin' message */
 	class_addmethod(c, (method)grainphase_setwin, "setWin", A_SYM, 0);
 	
+	/* bind method "grainphase_window" to the 'window' message */
+	class_addmethod(c, (method)grainphase_window, "window", A_GIMME, 0);
+	
 	/* bind method "grainphase_float" to the incoming floats */
 	class_addmethod(c, (method)grainphase_float, "float", A_FLOAT, 0);
 	
@@ -130,6 +182,9 @@ int C74_EXPORT main(void)
 	/* bind method "grainphase_sndInterp" to the sndInterp message */
 	class_addmethod(c, (method)grainphase_sndInterp, "sndInterp", A_LONG, 0);
 	
+	/* bind method "grainphase_sincTable" to the sincTable message */
+	class_addmethod(c, (method)grainphase_sincTable, "sincTable", A_LONG, 0);
+	
 	/* bind method "grainphase_winInterp" to the winInterp message */
 	class_addmethod(c, (method)grainphase_winInterp, "winInterp", A_LONG, 0);
 	
@@ -171,20 +226,30 @@ void *grainphase_new(t_symbol *snd, t_symbol *win)
 	x->win_sym = win;
 	
 	/* zero pointers */
-	x->snd_buf_ptr = x->next_snd_buf_ptr = NULL;
-	x->win_buf_ptr = x->next_win_buf_ptr = NULL;
+	x->snd_ref = x->win_ref = NULL;
+	x->snd_swap.init();
+	x->win_swap.init();
+	nw_bufinfo_set(&x->snd_buf, NULL, 0, 0, 0.0, 0);
+	nw_bufinfo_set(&x->win_buf, NULL, 0, 0, 0.0, 0);
+	nw_window_set(&x->window, "buffer", false, 0.);
+	x->next_window = x->window;
+	x->window_swap.init();
 	
 	/* setup variables */
 	x->grain_pos_start = x->next_grain_pos_start = 0.0;
 	x->grain_pitch = x->next_grain_pitch = 1.0;
     x->grain_gain = x->next_grain_gain = 1.0;
 	x->curr_snd_pos = x->snd_step_size = 0.0;
+	x->grain_sinc = NULL;
     x->win_last_index = 0.0;
 	
 	/* set flags to defaults */
 	x->snd_interp = INTERP_ON;
+	x->snd_sinc = NULL;
 	x->win_interp = INTERP_ON;
 	x->grain_direction = x->next_grain_direction = FORWARD_GRAINS;
+	grainphase_publishKernels(x);
+	x->grain_kernel = NULL;
 	
 	x->x_obj.z_misc = Z_NO_INPLACE;
 	
@@ -214,7 +279,10 @@ void grainphase_dsp64(t_grainphase *x, t_object *dsp64, short *count, double sam
     
     // set buffers
     grainphase_setsnd(x, x->snd_sym);
-    grainphase_setwin(x, x->win_sym);
+    if (x->next_window.type == NW_WINDOW_BUFFER)
+        grainphase_setwin(x, x->win_sym);
+    else if (x->win_ref == NULL)
+        x->win_last_index = NW_WINDOW_FRAMES;	// first grain starts at once, as a first window buffer does
     
     // test inlets for signals
     x->grain_pos_start_connected = count[1];
@@ -284,7 +352,6 @@ void grainphase_perform64(t_grainphase *x, t_object *dsp64, double **ins, long n
                           long numouts, long vectorsize, long flags, void *userparam)
 {
     // local vars outlets and inlets
-    double *in_phase = ins[0];
     double *in_sound_start = ins[1];
     double *in_sample_increment = ins[2];
     double *in_gain = ins[3];
@@ -294,56 +361,169 @@ void grainphase_perform64(t_grainphase *x, t_object *dsp64, double **ins, long n
     
     // local vars for snd and win buffer
     t_buffer_obj *snd_object, *win_object;
+    t_buffer_info b_info;
     float *tab_s, *tab_w;
-    double snd_out, snd_out2, win_out;
-    long size_s, chan_s, size_w;
+    long size_s, chan_s, size_w, last_size_w;
+    const t_nw_window *window;
     
     // local vars for object vars and while loop
-    double index_s, index_w, temp_index_frac;
-    long n, count_samp, temp_index_int, temp_index_int_times_chan;
-    double s_step_size, w_last_index, approx_grain_length, g_gain;
-    short interp_s, interp_w, g_direction;
+    long n;
+    double approx_grain_length;
     
     // check to make sure buffers are loaded with proper file types
     if (x->x_obj.z_disabled)		// and object is enabled
         goto out;
-    if (x->snd_buf_ptr == NULL || (x->win_buf_ptr == NULL))
+    
+    // window length the last vector measured the phase in
+    last_size_w = (x->window.type == NW_WINDOW_BUFFER) ? x->win_buf.frames : NW_WINDOW_FRAMES;
+    
+    // the window position comes from the phase inlet, so a new shape and new
+    // buffers can take over at any vector; they are never swapped mid-vector
+    x->window_swap.take(&x->window);
+    if (x->snd_swap.take(&x->snd_buf)) {
+        #ifdef DEBUG
+            object_post((t_object*)x, "sound buffer pointer updated");
+        #endif /* DEBUG */
+    }
+    if (x->win_swap.take(&x->win_buf)) {
+        #ifdef DEBUG
+            object_post((t_object*)x, "window buffer pointer updated");
+        #endif /* DEBUG */
+    }
+    
+    if (x->snd_buf.ref == NULL || (x->window.type == NW_WINDOW_BUFFER && x->win_buf.ref == NULL))
         goto zero;
     
-    // get sound buffer info
-    snd_object = buffer_ref_getobject(x->snd_buf_ptr);
+    // get sound buffer info; values cached when it was linked are read again
+    // only if the buffer~ has been changed since
+    snd_object = buffer_ref_getobject((t_buffer_ref *)x->snd_buf.ref);
     tab_s = buffer_locksamples(snd_object);
     if (!tab_s)		// buffer samples were not accessible
         goto zero;
-    size_s = buffer_getframecount(snd_object);
-    chan_s = buffer_getchannelcount(snd_object);
+    buffer_getinfo(snd_object, &b_info);
+    if (b_info.b_modtime != x->snd_buf.modtime)
+        nw_bufinfo_set(&x->snd_buf, x->snd_buf.ref, b_info.b_frames, b_info.b_nchans, b_info.b_sr, b_info.b_modtime);
+    size_s = x->snd_buf.frames;
+    chan_s = x->snd_buf.chans;
     
-    // get window buffer info
-    win_object = buffer_ref_getobject(x->win_buf_ptr);
-    tab_w = buffer_locksamples(win_object);
-    if (!tab_w)		// buffer samples were not accessible
-        goto zero;
-    size_w = buffer_getframecount(win_object);
+    // get window buffer info, unless an analytic window is playing
+    if (x->window.type == NW_WINDOW_BUFFER) {
+        window = NULL;
+        win_object = buffer_ref_getobject((t_buffer_ref *)x->win_buf.ref);
+        tab_w = buffer_locksamples(win_object);
+        if (!tab_w) {	// buffer samples were not accessible
+            buffer_unlocksamples(snd_object);
+            goto zero;
+        }
+        buffer_getinfo(win_object, &b_info);
+        if (b_info.b_modtime != x->win_buf.modtime)
+            nw_bufinfo_set(&x->win_buf, x->win_buf.ref, b_info.b_frames, b_info.b_nchans, b_info.b_sr, b_info.b_modtime);
+        size_w = x->win_buf.frames;
+    } else {
+        window = &x->window;
+        win_object = NULL;
+        tab_w = NULL;
+        size_w = NW_WINDOW_FRAMES;
+    }
+    
+    // carry the last window position over to a window of another length, so
+    // that a grain begins where it would have; with no window before, the
+    // first grain starts at once
+    if (size_w != last_size_w)
+        x->win_last_index = last_size_w ? x->win_last_index * size_w / last_size_w : size_w;
+    
+    // the kernel for the modes sndInterp and winInterp last set, the grain
+    // playing, and the sound as it is now; each grain begun picks another
+    x->grain_kernel = grainphase_kernel(x);
+    
+    n = 0;
+    while ((n = x->grain_kernel(x, tab_s, size_s, chan_s, tab_w, size_w, window, ins, outs, n, vectorsize)) < vectorsize) {
+        
+        // needed in case REVERSE_GRAINS
+        approx_grain_length = x->curr_count_samp * x->output_1oversr * 0.001;
+        
+        // initialize grain; both buffers stay locked, as initGrain
+        // only works from values cached with them
+        grainphase_initGrain(x, in_sound_start[n], approx_grain_length, in_sample_increment[n], in_gain[n]);
+    }
+    
+    buffer_unlocksamples(snd_object);
+    if (win_object)
+        buffer_unlocksamples(win_object);
+    return;
+    
+    // alternate blank output
+zero:
+    n = vectorsize;
+    while(n--)
+    {
+        *out_signal++ = 0.;
+        *out_signal2++ = 0.;
+        *out_sample_count++ = -1.;
+    }
     
-    // get snd and win index info
+out:
+    return;
+
+    
+}
+
+/********************************************************************************
+long grainphase_run<InterpS, InterpW, Direction, Chans>(t_grainphase *x,
+		const float *tab_s, long size_s, long chan_s, const float *tab_w,
+		long size_w, const t_nw_window *window, double **ins, double **outs,
+		long i, long vectorsize)
+
+inputs:			x			-- pointer to this object
+				tab_s		-- sound buffer samples, locked
+				size_s		-- frames in the sound buffer
+				chan_s		-- channels in the sound buffer
+				tab_w		-- window buffer samples, locked, or NULL
+				size_w		-- frames in the window
+				window		-- analytic window, or NULL to read tab_w
+				ins, outs	-- signal vectors of the perform routine
+				i			-- first sample to compute
+				vectorsize	-- samples in the vector
+description:	the perform loop for one set of options; interpolation modes,
+		grain direction and sound channels are template arguments, so none of
+		them is tested per sample; stops on the sample where the phase wraps,
+		so that the caller can begin a grain there, which picks its own kernel;
+		win_last_index is left at that sample's window index, so the next call
+		renders the sample without beginning the grain again
+returns:		the sample a grain begins on, or vectorsize
+********************************************************************************/
+template <int InterpS, int InterpW, short Direction, int Chans>
+long grainphase_run(t_grainphase *x, const float *tab_s, long size_s, long chan_s, const float *tab_w, long size_w,
+	const t_nw_window *window, double **ins, double **outs, long i, long vectorsize)
+{
+    // local vars outlets and inlets
+    double *in_phase = ins[0];
+    double *out_signal = outs[0];
+    double *out_signal2 = outs[1];
+    double *out_sample_count = outs[2];
+    
+    // local vars for object vars and while loop
+    double snd_out[2], win_out;
+    double index_s, index_w, s_step_size, w_last_index, g_gain;
+    long count_samp;
+    const t_nw_sinc_filter *sinc_s;
+    
+    // get snd index info
     index_s = x->curr_snd_pos;
     s_step_size = x->snd_step_size;
     
     // get grain options
-    interp_s = x->snd_interp;
-    interp_w = x->win_interp;
+    sinc_s = x->grain_sinc;
     g_gain = x->grain_gain;
-    g_direction = x->grain_direction;
     
-    // get history from last vector
+    // get history
     count_samp = x->curr_count_samp;
     w_last_index = x->win_last_index;
     
-    n = vectorsize;
-    while(n--) {
+    for (; i < vectorsize; i++) {
         
         // compute window index from inlet
-        index_w = *in_phase * size_w;
+        index_w = in_phase[i] * size_w;
         
         // wrap to make index in bounds
         while (index_w < 0.)
@@ -353,56 +533,8 @@ void grainphase_perform64(t_grainphase *x, t_object *dsp64, double **ins, long n
         
         if (index_w < w_last_index) {   // if window has wrapped...
             if (index_w < 10.0) {       // and it is beginning...
-                
-                buffer_unlocksamples(snd_object);
-                buffer_unlocksamples(win_object);
-                
-                // needed in case REVERSE_GRAINS
-                approx_grain_length = count_samp * x->output_1oversr * 0.001;
-                
-                // initialize grain
-                grainphase_initGrain(x, *in_sound_start, approx_grain_length, *in_sample_increment, *in_gain);
-                
-                // get snd buffer info
-                snd_object = buffer_ref_getobject(x->snd_buf_ptr);
-                tab_s = buffer_locksamples(snd_object);
-                if (!tab_s)	{	// buffer samples were not accessible
-                    *out_signal = 0.0;
-                    *out_signal2 = 0.0;
-                    *out_sample_count = (double)count_samp;
-                    w_last_index = index_w;
-                    goto advance_pointers;
-                }
-                size_s = buffer_getframecount(snd_object);
-                
-                // get win buffer info
-                win_object = buffer_ref_getobject(x->win_buf_ptr);
-                tab_w = buffer_locksamples(win_object);
-                if (!tab_w)	{	// buffer samples were not accessible
-                    *out_signal = 0.0;
-                    *out_signal2 = 0.0;
-                    *out_sample_count = (double)count_samp;
-                    w_last_index = index_w;
-                    goto advance_pointers;
-                }
-                size_w = buffer_getframecount(win_object);
-                
-                // get snd index info
-                index_s = x->curr_snd_pos;
-                s_step_size = x->snd_step_size;
-                
-                // re-compute win step size
-                index_w = *in_phase * size_w;
-                
-                // get grain options
-                interp_s = x->snd_interp;
-                interp_w = x->win_interp;
-                g_gain = x->grain_gain;
-                g_direction = x->grain_direction;
-                
-                // get history
-                count_samp = x->curr_count_samp;
-                
+                w_last_index = index_w;
+                break;
             }
         }
         
@@ -410,7 +542,7 @@ void grainphase_perform64(t_grainphase *x, t_object *dsp64, double **ins, long n
         ++count_samp;
         
         // advance sound index
-        if (g_direction == FORWARD_GRAINS) {
+        if (Direction == FORWARD_GRAINS) {
             index_s += s_step_size;     // addition
         } else {
             index_s -= s_step_size;     // subtract
@@ -424,75 +556,41 @@ void grainphase_perform64(t_grainphase *x, t_object *dsp64, double **ins, long n
         
         // WINDOW OUT
         
-        // compute temporary vars for interpolation
-        temp_index_int = (long)(index_w); // integer portion of index
-        temp_index_frac = index_w - (double)temp_index_int; // fractional portion of index
-        
-        // get value from win buffer samples
-        if (interp_w == INTERP_ON) {
-            win_out = mcLinearInterp(tab_w, temp_index_int, temp_index_frac, size_w, 1);
-        } else {
-            win_out = tab_w[temp_index_int];
-        }
+        // get value from win buffer samples, or the analytic window; the
+        // phase inlet need not move by a fixed step, so the closed form is
+        // evaluated at every sample
+        if (window)
+            win_out = nw_window_value(window, index_w / size_w);
+        else
+            nw_interp<1, nw_wrap_loop>(InterpW, tab_w, size_w, 1, index_w, &win_out);
         
         // SOUND OUT
         
-        // compute temporary vars for interpolation
-        temp_index_int = (long)(index_s); // integer portion of index
-        temp_index_frac = index_s - (double)temp_index_int; // fractional portion of index
-        temp_index_int_times_chan = temp_index_int * chan_s;
-        
-        // get value from snd buffer samples
-        if (interp_s == INTERP_ON) {
-            snd_out = mcLinearInterp(tab_s, temp_index_int_times_chan, temp_index_frac, size_s, chan_s);
-            snd_out2 = (chan_s == 2) ?
-                mcLinearInterp(tab_s, temp_index_int_times_chan + 1, temp_index_frac, size_s, chan_s) :
-                snd_out;
+        // get value from snd buffer samples; grain length is only estimated
+        // here, so neighbours are always wrapped
+        if (Chans == 2) {
+            nw_interp<2, nw_wrap_loop>(InterpS, tab_s, size_s, 2, index_s, snd_out, sinc_s);
         } else {
-            snd_out = tab_s[temp_index_int_times_chan];
-            snd_out2 = (chan_s == 2) ?
-                tab_s[temp_index_int_times_chan + 1] :
-                snd_out;
+            nw_interp<1, nw_wrap_loop>(InterpS, tab_s, size_s, chan_s, index_s, snd_out, sinc_s);
+            snd_out[1] = snd_out[0];
         }
         
         // OUTLETS
         
-        *out_signal = snd_out * win_out * g_gain;
-        *out_signal2 = snd_out2 * win_out * g_gain;
-        *out_sample_count = (double)count_samp;
+        out_signal[i] = snd_out[0] * win_out * g_gain;
+        out_signal2[i] = snd_out[1] * win_out * g_gain;
+        out_sample_count[i] = (double)count_samp;
         
         // update vars for last output
         w_last_index = index_w;
-    
-advance_pointers:
-        // advance all pointers
-        ++in_phase, ++in_sound_start, ++in_sample_increment, ++in_gain;
-        ++out_signal, ++out_signal2, ++out_sample_count;
     }
     
-    // update object history for next vector
+    // update object history
     x->curr_snd_pos = index_s;
     x->curr_count_samp = count_samp;
     x->win_last_index = w_last_index;
     
-    buffer_unlocksamples(snd_object);
-    buffer_unlocksamples(win_object);
-    return;
-    
-    // alternate blank output
-zero:
-    n = vectorsize;
-    while(n--)
-    {
-        *out_signal = 0.;
-        *out_signal2 = 0.;
-        *out_sample_count = -1.;
-    }
-    
-out:
-    return;
-
-    
+    return i;
 }
 
 /********************************************************************************
@@ -504,7 +602,8 @@ out:
  in_pitch_mult		-- sample playback speed, 1 = normal
  in_gain_mult		-- scales gain output, 1 = no change
  description:	initializes grain vars; called from perform method when pulse is
- received
+ received; makes no buffer~ calls, working only from the values cached with
+ the sound buffer, so the perform routine can keep its buffers locked
  returns:		nothing
  ********************************************************************************/
 void grainphase_initGrain(t_grainphase *x, float in_pos_start, float in_length, float in_pitch_mult, float in_gain_mult)
@@ -513,31 +612,6 @@ void grainphase_initGrain(t_grainphase *x, float in_pos_start, float in_length,
         object_post((t_object*)x, "initializing grain");
     #endif /* DEBUG */
     
-    /* should the buffers be updated ? */
-    
-    t_buffer_obj	*snd_object;
-    t_buffer_obj	*win_object;
-    
-    if (x->next_snd_buf_ptr != NULL) {
-        x->snd_buf_ptr = x->next_snd_buf_ptr;
-        x->next_snd_buf_ptr = NULL;
-        
-        #ifdef DEBUG
-            object_post((t_object*)x, "sound buffer pointer updated");
-        #endif /* DEBUG */
-    }
-    if (x->next_win_buf_ptr != NULL) {
-        x->win_buf_ptr = x->next_win_buf_ptr;
-        x->next_win_buf_ptr = NULL;
-        
-        #ifdef DEBUG
-            object_post((t_object*)x, "window buffer pointer updated");
-        #endif /* DEBUG */
-    }
-    
-    snd_object = buffer_ref_getobject(x->snd_buf_ptr);
-    win_object = buffer_ref_getobject(x->win_buf_ptr);
-    
     /* should input variables be at audio or control rate ? */
     
     // temporarily stash here as milliseconds
@@ -554,17 +628,19 @@ void grainphase_initGrain(t_grainphase *x, float in_pos_start, float in_length,
     if (x->grain_sound_length < 0.) x->grain_sound_length *= -1.; // needs to be positive to prevent buffer overruns
     
     // compute sound buffer step size per vector sample
-    x->snd_step_size = x->grain_pitch * buffer_getsamplerate(snd_object) * x->output_1oversr;
+    x->snd_step_size = x->grain_pitch * x->snd_buf.sr * x->output_1oversr;
     //if (x->snd_step_size < 0.) x->snd_step_size *= -1.; // needs to be positive to prevent buffer overruns
+    x->grain_sinc = nw_sinc_filter(x->snd_sinc, x->snd_step_size);
     
-    // update direction option
+    // update direction option, and the kernel playing in that direction
     x->grain_direction = x->next_grain_direction;
+    x->grain_kernel = grainphase_kernel(x);
     
     if (x->grain_direction == FORWARD_GRAINS) {	// if forward...
-        x->grain_pos_start = x->grain_pos_start * buffer_getmillisamplerate(snd_object);
+        x->grain_pos_start = x->grain_pos_start * x->snd_buf.msr;
         x->curr_snd_pos = x->grain_pos_start - x->snd_step_size;
     } else {	// if reverse...
-        x->grain_pos_start = (x->grain_pos_start + x->grain_sound_length) * buffer_getmillisamplerate(snd_object);
+        x->grain_pos_start = (x->grain_pos_start + x->grain_sound_length) * x->snd_buf.msr;
         x->curr_snd_pos = x->grain_pos_start + x->snd_step_size;
     }
     
@@ -579,47 +655,69 @@ void grainphase_initGrain(t_grainphase *x, float in_pos_start, float in_length,
     
 }
 
+/********************************************************************************
+void grainphase_publishKernels(t_grainphase *x)
+
+inputs:			x		-- pointer to this object
+description:	hands the kernels for the current sndInterp and winInterp modes
+		to the perform routine, which takes them at its next vector or grain;
+		one pointer is swapped, so the two modes always arrive together
+returns:		nothing
+********************************************************************************/
+void grainphase_publishKernels(t_grainphase *x)
+{
+	x->next_kernels.store(&grainphase_kernels[x->snd_interp][x->win_interp], std::memory_order_release);
+}
+
+/********************************************************************************
+t_grainphase_kernel grainphase_kernel(t_grainphase *x)
+
+inputs:			x		-- pointer to this object
+description:	perform routine side; picks the kernel for the published modes,
+		the direction of the grain playing and the channels of the sound
+returns:		the kernel
+********************************************************************************/
+t_grainphase_kernel grainphase_kernel(t_grainphase *x)
+{
+	const t_grainphase_kernels *kernels = x->next_kernels.load(std::memory_order_acquire);
+	
+	return kernels->kernel[x->grain_direction][x->snd_buf.chans == 2];
+}
+
 /********************************************************************************
 void grainphase_setsnd(t_index *x, t_symbol *s)
 
 inputs:			x		-- pointer to this object
 				s		-- name of buffer to link
-description:	links buffer holding the grain sound source 
+description:	links buffer holding the grain sound source; the perform
+		routine takes it, with its frame count, channel count and sample rate,
+		at the start of its next vector
 returns:		nothing
 ********************************************************************************/
 void grainphase_setsnd(t_grainphase *x, t_symbol *s)
 {
     t_buffer_ref *b = buffer_ref_new((t_object*)x, s);
+    t_buffer_info b_info;
+    t_nw_bufinfo info;
     
     if (buffer_ref_exists(b)) {
         t_buffer_obj	*b_object = buffer_ref_getobject(b);
         
-        if (buffer_getchannelcount(b_object) > 2) {
+        buffer_getinfo(b_object, &b_info);
+        if (b_info.b_nchans > 2) {
 			object_error((t_object*)x, "buffer~ > %s < must be mono or stereo", s->s_name);
-			x->next_snd_buf_ptr = NULL;		//added 2002.07.15
 		} else {
-			if (x->snd_buf_ptr == NULL) { // if first buffer make current buffer
-				x->snd_sym = s;
-				x->snd_buf_ptr = b;
-				//x->snd_last_out = 0.0;	//removed 2005.02.02
-				
-				#ifdef DEBUG
-					object_post((t_object*)x, "current sound set to buffer~ > %s <", s->s_name);
-				#endif /* DEBUG */
-			} else { // else defer to next buffer
-				x->snd_sym = s;
-				x->next_snd_buf_ptr = b;
-				//x->snd_buf_length = b->b_frames;	//removed 2002.07.11
-				//x->snd_last_out = 0.0;		//removed 2002.07.24
-				
-				#ifdef DEBUG
-					object_post((t_object*)x, "next sound set to buffer~ > %s <", s->s_name);
-				#endif /* DEBUG */
-			}
+			x->snd_sym = s;
+			x->snd_ref = b;
+			nw_bufinfo_set(&info, b, b_info.b_frames, b_info.b_nchans, b_info.b_sr, b_info.b_modtime);
+			x->snd_swap.post(info);
+			
+			#ifdef DEBUG
+				object_post((t_object*)x, "next sound set to buffer~ > %s <", s->s_name);
+			#endif /* DEBUG */
 		}
 	} else {
 		object_error((t_object*)x, "no buffer~ * %s * found", s->s_name);
-		x->next_snd_buf_ptr = NULL;
 	}
 }
 
@@ -628,46 +726,74 @@ void grainphase_setwin(t_grainphase *x, t_symbol *s)
 
 inputs:			x		-- pointer to this object
 				s		-- name of buffer to link
-description:	links buffer holding the grain window 
+description:	links buffer holding the grain window; the perform routine
+		takes it at the start of its next vector
 returns:		nothing
 ********************************************************************************/
 void grainphase_setwin(t_grainphase *x, t_symbol *s)
 {
     t_buffer_ref *b = buffer_ref_new((t_object*)x, s);
+    t_buffer_info b_info;
+    t_nw_bufinfo info;
     
     if (buffer_ref_exists(b)) {
         t_buffer_obj	*b_object = buffer_ref_getobject(b);
         
-        if (buffer_getchannelcount(b_object) != 1) {
+        buffer_getinfo(b_object, &b_info);
+        if (b_info.b_nchans != 1) {
 			object_error((t_object*)x, "buffer~ > %s < must be mono", s->s_name);
-			x->next_win_buf_ptr = NULL;		//added 2002.07.15
 		} else {
-			if (x->win_buf_ptr == NULL) { // if first buffer make current buffer
-				x->win_sym = s;
-				x->win_buf_ptr = b;
-				//x->win_last_out = 0.0;	//removed 2005.02.02
-				x->win_last_index = buffer_getframecount(b_object);
-				
-				#ifdef DEBUG
-					object_post((t_object*)x, "current window set to buffer~ > %s <", s->s_name);
-				#endif /* DEBUG */
-			} else { // else defer to next buffer
-				x->win_sym = s;
-				x->next_win_buf_ptr = b;
-				//x->win_buf_length = b->b_frames;	//removed 2002.07.11
-				//x->win_last_out = 0.0;		//removed 2002.07.24
-				
-				#ifdef DEBUG
-					object_post((t_object*)x, "next window set to buffer~ > %s <", s->s_name);
-				#endif /* DEBUG */
-			}
+			x->win_sym = s;
+			x->win_ref = b;
+			nw_bufinfo_set(&info, b, b_info.b_frames, b_info.b_nchans, b_info.b_sr, b_info.b_modtime);
+			x->win_swap.post(info);
+			
+			#ifdef DEBUG
+				object_post((t_object*)x, "next window set to buffer~ > %s <", s->s_name);
+			#endif /* DEBUG */
 		}
 	} else {
 		object_error((t_object*)x, "no buffer~ > %s < found", s->s_name);
-		x->next_win_buf_ptr = NULL;
 	}
 }
 
+/********************************************************************************
+void grainphase_window(t_grainphase *x, t_symbol *s, long argc, t_atom *argv)
+
+inputs:			x		-- pointer to this object
+				s		-- message selector
+				argc	-- number of arguments
+				argv	-- shape name, then an optional parameter
+description:	method called when "window" message is received; picks one of the
+		analytic window shapes, or "buffer" to go back to the window buffer~;
+		takes effect at the start of the next vector
+returns:		nothing
+********************************************************************************/
+void grainphase_window(t_grainphase *x, t_symbol *s, long argc, t_atom *argv)
+{
+	t_nw_window w;
+	
+	if (argc < 1 || atom_gettype(argv) != A_SYM) {
+		object_error((t_object*)x, "window needs the name of a shape");
+		return;
+	}
+	if (!nw_window_set(&w, atom_getsym(argv)->s_name, argc > 1, argc > 1 ? atom_getfloat(argv + 1) : 0.)) {
+		object_error((t_object*)x, "window %s was not understood", atom_getsym(argv)->s_name);
+		return;
+	}
+	
+	// the window buffer~ is only linked when the dsp starts with it in use
+	if (w.type == NW_WINDOW_BUFFER && x->win_ref == NULL)
+		grainphase_setwin(x, x->win_sym);
+	
+	x->next_window = w;
+	x->window_swap.post(w);
+	
+	#ifdef DEBUG
+		object_post((t_object*)x, "window is set to %s", atom_getsym(argv)->s_name);
+	#endif /* DEBUG */
+}
+
 /********************************************************************************
 void grainphase_float(t_grainphase *x, double f)
 
@@ -793,48 +919,80 @@ void grainphase_sndInterp(t_grainphase *x, long l)
 inputs:			x		-- pointer to our object
 				l		-- flag value
 description:	method called when "sndInterp" message is received; allows user 
-		to define whether interpolation is used in pulling values from the sound
-		buffer; default is on
+		to choose the interpolation used in pulling values from the sound
+		buffer; 0 = off, 1 = linear, 2 = hermite, 3 = lagrange, 4 = windowed
+		sinc; default is linear
 returns:		nothing
 ********************************************************************************/
 void grainphase_sndInterp(t_grainphase *x, long l)
 {
-	if (l == INTERP_OFF) {
-		x->snd_interp = INTERP_OFF;
-		#ifdef DEBUG
-			object_post((t_object*)x, "sndInterp is set to off");
-		#endif // DEBUG //
-	} else if (l == INTERP_ON) {
-		x->snd_interp = INTERP_ON;
+	if (l == INTERP_SINC && !x->snd_sinc) {
+		x->snd_sinc = nw_sinc_get(NW_SINC_PHASES);
+		if (!x->snd_sinc) {
+			object_error((t_object*)x, "out of memory for the sinc table");
+			return;
+		}
+	}
+	
+	if (l >= INTERP_OFF && l <= INTERP_SINC) {
+		x->snd_interp = (short)l;
+		grainphase_publishKernels(x);
 		#ifdef DEBUG
-			object_post((t_object*)x, "sndInterp is set to on");
+			object_post((t_object*)x, "sndInterp is set to %ld", l);
 		#endif // DEBUG //
 	} else {
 		object_error((t_object*)x, "sndInterp message was not understood");
 	}
 }
 
+/********************************************************************************
+void grainphase_sincTable(t_grainphase *x, long l)
+
+inputs:			x		-- pointer to our object
+				l		-- phases per frame
+description:	method called when "sincTable" message is received; sets the
+		size of the table read by sndInterp 4, rounded to a power of two
+		between 16 and 4096; larger tables read between frames more finely;
+		default is 256; grains begun afterwards use it
+returns:		nothing
+********************************************************************************/
+void grainphase_sincTable(t_grainphase *x, long l)
+{
+	const t_nw_sinc *sinc;
+	
+	if (l < 1) {
+		object_error((t_object*)x, "sincTable message was not understood");
+		return;
+	}
+	
+	sinc = nw_sinc_get(l);
+	if (!sinc) {
+		object_error((t_object*)x, "out of memory for the sinc table");
+		return;
+	}
+	x->snd_sinc = sinc;
+	#ifdef DEBUG
+		object_post((t_object*)x, "sincTable is set to %ld phases", sinc->phases);
+	#endif // DEBUG //
+}
+
 /********************************************************************************
 void grainphase_winInterp(t_grainphase *x, long l)
 
 inputs:			x		-- pointer to our object
 				l		-- flag value
 description:	method called when "winInterp" message is received; allows user 
-		to define whether interpolation is used in pulling values from the window
-		buffer; default is on
+		to choose the interpolation used in pulling values from the window
+		buffer; 0 = off, 1 = linear, 2 = hermite, 3 = lagrange; default is linear
 returns:		nothing
 ********************************************************************************/
 void grainphase_winInterp(t_grainphase *x, long l)
 {
-	if (l == INTERP_OFF) {
-		x->win_interp = INTERP_OFF;
-		#ifdef DEBUG
-			object_post((t_object*)x, "winInterp is set to off");
-		#endif // DEBUG //
-	} else if (l == INTERP_ON) {
-		x->win_interp = INTERP_ON;
+	if (l >= INTERP_OFF && l <= INTERP_LAGRANGE) {
+		x->win_interp = (short)l;
+		grainphase_publishKernels(x);
 		#ifdef DEBUG
-			object_post((t_object*)x, "winInterp is set to on");
+			object_post((t_object*)x, "winInterp is set to %ld", l);
 		#endif // DEBUG //
 	} else {
 		object_error((t_object*)x, "winInterp was not understood");
@@ -867,34 +1025,3 @@ void grainphase_reverse(t_grainphase *x, long l)
 	}
 	
 }
-
-/********************************************************************************
-double mcLinearInterp(float *in_array, long index_i, double index_frac, 
-		long in_size, short in_chans)
-
-inputs:			*in_array -- name of array of input values
-				index_i -- index value of sample, specific channel within interleaved frame
-				index_frac -- fractional portion of index value for interp
-				in_size -- size of input buffer to perform wrapping
-				in_chans -- number of channels in input buffer
-description:	performs linear interpolation on an input array and to return 
-	value of a fractional sample location
-returns:		interpolated output
-********************************************************************************/
-double mcLinearInterp(float *in_array, long index_i, double index_frac, long in_size, short in_chans)
-{
-	double out, sample1, sample2;
-	long index_iP1 = index_i + in_chans;		// corresponding sample in next frame
-	
-	// make sure that index_iP1 is not out of range
-	while (index_iP1 >= in_size * in_chans) index_iP1 -= in_size;
-	
-	// get samples
-	sample1 = (double)in_array[index_i];
-	sample2 = (double)in_array[index_iP1];
-	
-	//linear interp formula
-	out = sample1 + index_frac * (sample2 - sample1);
-	
-	return out;
-}
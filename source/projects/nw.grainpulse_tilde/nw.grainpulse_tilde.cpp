@@ -4,6 +4,7 @@
 ** MSP object
 ** sends out a single grains when it receives a pulse
 ** 2001/08/29 started by Nathan Wolek
+** 2026/10/17 multichannel patch cords, one pool of voices per channel
 **
 ** Copyright © 2002,2014 by Nathan Wolek
 ** License: http://opensource.org/licenses/BSD-3-Clause
@@ -11,6 +12,13 @@
 */
 
 #include "c74_msp.h"
+#include <atomic>
+#include "nw_bufswap.h"
+#include "nw_interp.h"
+#include "nw_grainvoice.h"
+#include "nw_pyramid.h"
+#include "nw_wincache.h"
+#include "nw_window.h"
 
 using namespace c74::max;
 
@@ -23,17 +31,41 @@ using namespace c74::max;
 #define ASSIST_OUTLET	2
 
 /* for direction flag */
-#define FORWARD_GRAINS		0
-#define REVERSE_GRAINS		1
+#define FORWARD_GRAINS		NW_GRAIN_FORWARD
+#define REVERSE_GRAINS		NW_GRAIN_REVERSE
 
 /* for interpolation flag */
-#define INTERP_OFF			0
-#define INTERP_ON			1
+#define INTERP_OFF			NW_INTERP_NONE
+#define INTERP_ON			NW_INTERP_LINEAR
+#define INTERP_HERMITE		NW_INTERP_HERMITE
+#define INTERP_LAGRANGE		NW_INTERP_LAGRANGE
+#define INTERP_SINC			NW_INTERP_SINC
 
 /* for overflow flag, added 2002.10.28 */
 #define OVERFLOW_OFF		0
 #define OVERFLOW_ON			1
 
+/* for the voice pool */
+#define VOICES_MIN			1
+#define VOICES_MAX			64
+#define NO_VOICE			-1
+
+/* for multichannel patch cords */
+#define NUM_INLETS			5
+#define NUM_OUTLETS			4
+#define CHANS_MAX			1024		// widest multichannel cord followed
+
+/* one pulse stream, its voices are packed at the front of the pool */
+typedef struct _grainpulse_chan
+{
+	GrainVoice voice_pool[VOICES_MAX];
+	long voice_active_count;
+	long voice_newest;					// index of last voice started, or NO_VOICE
+	short overflow_status;	//added 2002.10.28, only used while all voices are sounding
+			//will produce false positives otherwise
+	float last_pulse_in;
+} t_grainpulse_chan;
+
 static t_class *grainpulse_class;		// required global pointing to this class
 
 typedef struct _grainpulse
@@ -41,31 +73,45 @@ typedef struct _grainpulse
 	t_pxobject x_obj;					// <--
 	// sound buffer info
 	t_symbol *snd_sym;
-	t_buffer_ref *snd_buf_ptr;
-	t_buffer_ref *next_snd_buf_ptr;
+	t_buffer_ref *snd_ref;				// last buffer~ linked, main thread only
+	NwBufSwap snd_swap;					// hands snd_ref to the perform routine
+	t_nw_bufinfo snd_buf;				// buffer~ being played, perform only
 	//double snd_last_out; removed 2005.01.25
 	//long snd_buf_length;	//removed 2002.07.11
 	short snd_interp;
+	const t_nw_sinc *snd_sinc;			// sinc tables, once sndInterp 4 or sincTable asks
+	NwPyramid snd_pyramid;				// sound decimated by octaves, for grains pitched up
+	t_qelem *pyramid_qelem;				// builds levels asked for by the perform routine
+	short pyramid;						// "pyramid" message
 	// window buffer info
 	t_symbol *win_sym;
-	t_buffer_ref *win_buf_ptr;
-	t_buffer_ref *next_win_buf_ptr;
+	t_buffer_ref *win_ref;				// last buffer~ linked, main thread only
+	NwBufSwap win_swap;					// hands win_ref to the perform routine
+	t_nw_bufinfo win_buf;				// buffer~ being played, perform only
 	//double win_last_out; removed 2005.01.25
 	//long win_buf_length;	//removed 2002.07.11
 	short win_interp;
-	// current grain info
-	double grain_pos_start;	// in samples
-	double grain_length;	// in milliseconds
-	double grain_pitch;		// as multiplier
-	double grain_gain;		// linear gain mult; add 2008.04.22
-	double grain_sound_length;	// in milliseconds
-	double win_step_size;	// in samples
-	double snd_step_size;	// in samples
-	double curr_win_pos;	// in samples
-	double curr_snd_pos;	// in samples
-	short grain_direction;	// forward or reverse
-	short overflow_status;	//added 2002.10.28, only used while grain is sounding // <--
-			//will produce false positives otherwise
+	long win_buf_frames;				// window length in use, cached at vector start
+	NwWinCache win_cache;				// window resampled per grain length
+	t_qelem *win_cache_qelem;			// builds tables asked for by the perform routine
+	t_nw_window window;					// analytic shape, or NW_WINDOW_BUFFER
+	t_nw_window next_window;			// last shape given to the window message, main thread only
+	NwSwap<t_nw_window> window_swap;	// hands next_window to the perform routine
+	// perform kernels, see nw_grain_kernels()
+	std::atomic<const t_nw_grain_kernels *> next_kernels;	// for snd_interp and win_interp
+	const t_nw_grain_kernels *grain_kernels;	// kernels voices play, perform only
+	short grain_stereo;					// sound was stereo when they were picked
+	// one voice pool per channel of the pulse input; a pool is allocated once
+	// and kept until the object is freed, so a chain still running never
+	// sees one move
+	t_grainpulse_chan *chans[CHANS_MAX];
+	std::atomic<long> chan_alloc;		// pools in chans, published after them
+	long out_chans;						// channels in each outlet
+	long in_chans[NUM_INLETS];			// channels in each inlet
+	// inlets as the perform routine sees them, set only by dsp64
+	long perf_in_chans[NUM_INLETS];
+	long perf_in_offset[NUM_INLETS];	// first of each inlet in the perform ins
+	long voice_count;					// "voices" attribute, for each channel
 	// defered grain info at control rate
 	double next_grain_pos_start;	// in milliseconds
 	double next_grain_length;		// in milliseconds
@@ -77,9 +123,10 @@ typedef struct _grainpulse
 	short grain_length_connected;		// <--
 	short grain_pitch_connected;		// <--
 	short grain_gain_connected;			// add 2008.04.22
+	long modulate;						// "modulate" attribute
+	short modulate_gain;				// gain read every sample, chosen by dsp64
+	short modulate_pitch;				// pitch read every sample, chosen by dsp64
 	// grain tracking info
-	long curr_count_samp;
-    float last_pulse_in;				// <--
 	double output_sr;					// <--
 	double output_1oversr;				// <--
 	//bang on init outlet, added 2004.03.10
@@ -89,23 +136,41 @@ typedef struct _grainpulse
 	t_symbol *ts_pscale;
 } t_grainpulse;
 
-void *grainpulse_new(t_symbol *snd, t_symbol *win);
+void *grainpulse_new(t_symbol *s, long argc, t_atom *argv);
+void grainpulse_free(t_grainpulse *x);
 void grainpulse_perform64zero(t_grainpulse *x, t_object *dsp64, double **ins, long numins, double **outs,long numouts, long vectorsize, long flags, void *userparam);
+template <bool ModGain, bool ModPitch>
 void grainpulse_perform64(t_grainpulse *x, t_object *dsp64, double **ins, long numins, double **outs,long numouts, long vectorsize, long flags, void *userparam);
-void grainpulse_initGrain(t_grainpulse *x, float in_pos_start, float in_length, 
+template <bool ModGain, bool ModPitch>
+void grainpulse_renderChannel(t_grainpulse *x, t_grainpulse_chan *ch, double **ins, double **outs,
+		long vectorsize, const float *tab_s, long size_s, long chan_s, const float *tab_w, long size_w);
+void grainpulse_initGrain(t_grainpulse *x, GrainVoice *v, float in_pos_start, float in_length,
 		float in_pitch_mult, float in_gain_mult);
+void grainpulse_updateBuffers(t_grainpulse *x);
+void grainpulse_publishKernels(t_grainpulse *x);
+void grainpulse_updateKernels(t_grainpulse *x, long chan_s);
+void grainpulse_soundChanged(t_grainpulse *x);
+void grainpulse_buildWindows(t_grainpulse *x);
+void grainpulse_buildPyramid(t_grainpulse *x);
 void grainpulse_reportoninit(t_grainpulse *x, t_symbol *s, short argc, t_atom argv);
 void grainpulse_dsp64(t_grainpulse *x, t_object *dsp64, short *count, double samplerate, long maxvectorsize, long flags);
+long grainpulse_inputchanged(t_grainpulse *x, long index, long count);
+long grainpulse_multichanneloutputs(t_grainpulse *x, long index);
+bool grainpulse_resizeChans(t_grainpulse *x, long count);
+void grainpulse_initChan(t_grainpulse_chan *ch);
 void grainpulse_setsnd(t_grainpulse *x, t_symbol *s);
 void grainpulse_setwin(t_grainpulse *x, t_symbol *s);
+void grainpulse_window(t_grainpulse *x, t_symbol *s, long argc, t_atom *argv);
 void grainpulse_float(t_grainpulse *x, double f);
 void grainpulse_int(t_grainpulse *x, long l);
 void grainpulse_sndInterp(t_grainpulse *x, long l);
+void grainpulse_sincTable(t_grainpulse *x, long l);
+void grainpulse_pyramid(t_grainpulse *x, long l);
 void grainpulse_winInterp(t_grainpulse *x, long l);
 void grainpulse_reverse(t_grainpulse *x, long l);
 void grainpulse_assist(t_grainpulse *x, t_object *b, long msg, long arg, char *s);
 void grainpulse_getinfo(t_grainpulse *x);
-double mcLinearInterp(float *in_array, long index_i, double index_frac, long in_size, short in_chans);
+t_max_err grainpulse_voices_set(t_grainpulse *x, void *attr, long argc, t_atom *argv);
 
 t_symbol *ps_buffer;
 
@@ -121,16 +186,30 @@ int C74_EXPORT main(void)
 {
     t_class *c;
     
-    c = class_new(OBJECT_NAME, (method)grainpulse_new, (method)dsp_free,
-			(short)sizeof(t_grainpulse), 0L, A_SYM, A_SYM, 0);
+    c = class_new(OBJECT_NAME, (method)grainpulse_new, (method)grainpulse_free,
+			(long)sizeof(t_grainpulse), 0L, A_GIMME, 0);
     class_dspinit(c); // add standard functions to class
 	
+	/* number of grains that may sound at once */
+	CLASS_ATTR_LONG(c, "voices", 0, t_grainpulse, voice_count);
+	CLASS_ATTR_ACCESSORS(c, "voices", NULL, grainpulse_voices_set);
+	CLASS_ATTR_FILTER_CLIP(c, "voices", VOICES_MIN, VOICES_MAX);
+	CLASS_ATTR_LABEL(c, "voices", 0, "Maximum Overlapping Grains");
+	
+	/* gain and pitch read from their inlets every sample of a grain */
+	CLASS_ATTR_LONG(c, "modulate", 0, t_grainpulse, modulate);
+	CLASS_ATTR_FILTER_CLIP(c, "modulate", 0, 1);
+	CLASS_ATTR_LABEL(c, "modulate", 0, "Modulate Gain and Pitch");
+	
 	/* bind method "grainpulse_setsnd" to the 'setSound' message */
 	class_addmethod(c, (method)grainpulse_setsnd, "setSound", A_SYM, 0);
 	
 	/* bind method "grainpulse_setwin" to the 'setWin' message */
 	class_addmethod(c, (method)grainpulse_setwin, "setWin", A_SYM, 0);
 	
+	/* bind method "grainpulse_window" to the 'window' message */
+	class_addmethod(c, (method)grainpulse_window, "window", A_GIMME, 0);
+	
 	/* bind method "grainpulse_float" to incoming floats */
 	class_addmethod(c, (method)grainpulse_float, "float", A_FLOAT, 0);
 	
@@ -143,6 +222,12 @@ int C74_EXPORT main(void)
 	/* bind method "grainpulse_sndInterp" to the sndInterp message */
 	class_addmethod(c, (method)grainpulse_sndInterp, "sndInterp", A_LONG, 0);
 	
+	/* bind method "grainpulse_sincTable" to the sincTable message */
+	class_addmethod(c, (method)grainpulse_sincTable, "sincTable", A_LONG, 0);
+	
+	/* bind method "grainpulse_pyramid" to the pyramid message */
+	class_addmethod(c, (method)grainpulse_pyramid, "pyramid", A_LONG, 0);
+	
 	/* bind method "grainpulse_winInterp" to the winInterp message */
 	class_addmethod(c, (method)grainpulse_winInterp, "winInterp", A_LONG, 0);
 	
@@ -154,6 +239,10 @@ int C74_EXPORT main(void)
     
     /* bind method "grainpulse_dsp64" to the dsp64 message */
     class_addmethod(c, (method)grainpulse_dsp64, "dsp64", A_CANT, 0);
+    
+    /* bind methods for multichannel patch cords */
+    class_addmethod(c, (method)grainpulse_inputchanged, "inputchanged", A_CANT, 0);
+    class_addmethod(c, (method)grainpulse_multichanneloutputs, "multichanneloutputs", A_CANT, 0);
 	
     class_register(CLASS_BOX, c); // register the class w max
     grainpulse_class = c;
@@ -169,41 +258,71 @@ int C74_EXPORT main(void)
 }
 
 /********************************************************************************
-void *grainpulse_new(double initial_pos)
+void *grainpulse_new(t_symbol *s, long argc, t_atom *argv)
 
-inputs:			*snd		-- name of buffer holding sound
-				*win		-- name of buffer holding window
+inputs:			s			-- name of object
+				argc		-- number of arguments
+				argv		-- sound buffer name, window buffer name, then
+					attributes (@voices)
 description:	called for each new instance of object in the MAX environment;
 		defines inlets and outlets; sets variables and buffers
 returns:		nothing
 ********************************************************************************/
-void *grainpulse_new(t_symbol *snd, t_symbol *win)
+void *grainpulse_new(t_symbol *s, long argc, t_atom *argv)
 {
 	t_grainpulse *x = (t_grainpulse *) object_alloc((t_class*) grainpulse_class);
-	dsp_setup((t_pxobject *)x, 5);					// five inlets; change 2008.04.22
+	long attrstart = attr_args_offset((short)argc, argv);
+	t_symbol *snd = attrstart > 0 ? atom_getsym(argv) : gensym("");
+	t_symbol *win = attrstart > 1 ? atom_getsym(argv + 1) : gensym("");
+	long i;
+	
+	dsp_setup((t_pxobject *)x, NUM_INLETS);			// five inlets; change 2008.04.22
     outlet_new((t_pxobject *)x, "signal");			// overflow outlet
     outlet_new((t_pxobject *)x, "signal");          // sample count outlet
     outlet_new((t_pxobject *)x, "signal");			// signal ch2 outlet
     outlet_new((t_pxobject *)x, "signal");			// signal ch1 outlet
+	x->win_cache_qelem = qelem_new(x, (method)grainpulse_buildWindows);
+	x->pyramid_qelem = qelem_new(x, (method)grainpulse_buildPyramid);
+	x->win_cache.init();
+	x->snd_pyramid.init();
+	nw_window_set(&x->window, "buffer", false, 0.);
+	x->next_window = x->window;
+	x->window_swap.init();
+	
+	/* one channel until a multichannel cord is connected */
+	x->chan_alloc.store(0, std::memory_order_relaxed);
+	if (!grainpulse_resizeChans(x, 1)) {
+		object_error((t_object*)x, "could not allocate grain voices");
+		object_free(x);
+		return NULL;
+	}
+	x->out_chans = 1;
+	for (i = 0; i < NUM_INLETS; i++) {
+		x->in_chans[i] = 1;
+		x->perf_in_chans[i] = 1;
+		x->perf_in_offset[i] = i;
+	}
 	
 	/* set buffer names */
 	x->snd_sym = snd;
 	x->win_sym = win;
 	
 	/* zero pointers */
-	x->snd_buf_ptr = x->next_snd_buf_ptr = NULL;
-	x->win_buf_ptr = x->next_win_buf_ptr = NULL;
+	x->snd_ref = x->win_ref = NULL;
+	x->snd_swap.init();
+	x->win_swap.init();
+	nw_bufinfo_set(&x->snd_buf, NULL, 0, 0, 0.0, 0);
+	nw_bufinfo_set(&x->win_buf, NULL, 0, 0, 0.0, 0);
 	
 	/* setup variables */
-	x->grain_pos_start = x->next_grain_pos_start = 0.0;
-	x->grain_length = x->next_grain_length = 50.0;
-	x->grain_pitch = x->next_grain_pitch = 1.0;
-	x->grain_gain = x->next_grain_gain = 1.0;
-	x->win_step_size = x->snd_step_size = 0.0;
-	x->curr_snd_pos = 0.0;
-	x->curr_win_pos = 0.0;
-	x->last_pulse_in = 0.0;
-    x->curr_count_samp = -1;
+	x->next_grain_pos_start = 0.0;
+	x->next_grain_length = 50.0;
+	x->next_grain_pitch = 1.0;
+	x->next_grain_gain = 1.0;
+	x->win_buf_frames = 0;
+	
+	/* start with one voice per channel */
+	x->voice_count = VOICES_MIN;
 	
 	/* setup t_symbols for output messages (saves overhead)*/
 	x->ts_offset = gensym("offset");
@@ -212,15 +331,132 @@ void *grainpulse_new(t_symbol *snd, t_symbol *win)
 	
 	/* set flags to defaults */
 	x->snd_interp = INTERP_ON;
+	x->snd_sinc = NULL;
+	x->pyramid = false;
 	x->win_interp = INTERP_ON;
-	x->grain_direction = x->next_grain_direction = FORWARD_GRAINS;
+	x->next_grain_direction = FORWARD_GRAINS;
+	grainpulse_publishKernels(x);
+	x->grain_kernels = NULL;
+	x->grain_stereo = false;
+	x->modulate = false;
+	x->modulate_gain = x->modulate_pitch = false;
 	
-	x->x_obj.z_misc = Z_NO_INPLACE;
+	x->x_obj.z_misc = Z_NO_INPLACE | Z_MC_INLETS;
+	
+	/* process attributes, like @voices */
+	attr_args_process(x, (short)argc, argv);
 	
 	/* return a pointer to the new object */
 	return (x);
 }
 
+/********************************************************************************
+void grainpulse_free(t_grainpulse *x)
+
+inputs:			x		-- pointer to this object
+description:	called when the object is deleted; frees the voice pools and
+		window tables
+returns:		nothing
+********************************************************************************/
+void grainpulse_free(t_grainpulse *x)
+{
+	long i;
+	
+	dsp_free((t_pxobject *)x);
+	
+	qelem_free(x->win_cache_qelem);
+	x->win_cache.free();
+	qelem_free(x->pyramid_qelem);
+	x->snd_pyramid.free();
+	for (i = x->chan_alloc.load(std::memory_order_relaxed) - 1; i >= 0; i--)
+		sysmem_freeptr(x->chans[i]);
+}
+
+/********************************************************************************
+bool grainpulse_resizeChans(t_grainpulse *x, long count)
+
+inputs:			x		-- pointer to this object
+				count	-- number of channels to render
+description:	allocates voice pools until there are at least count channels;
+		pools are only ever added, each one published with a release after it
+		is set up, so a perform routine running meanwhile keeps rendering the
+		pools it already had
+returns:		false if count is past CHANS_MAX or the memory could not be
+		allocated; the channels that could be are kept
+********************************************************************************/
+bool grainpulse_resizeChans(t_grainpulse *x, long count)
+{
+	t_grainpulse_chan *ch;
+	long alloc = x->chan_alloc.load(std::memory_order_relaxed);
+	
+	for (; alloc < count && alloc < CHANS_MAX; alloc++) {
+		ch = (t_grainpulse_chan *)sysmem_newptrclear((long)sizeof(t_grainpulse_chan));
+		if (!ch)
+			return false;
+		
+		grainpulse_initChan(ch);
+		x->chans[alloc] = ch;
+		x->chan_alloc.store(alloc + 1, std::memory_order_release);
+	}
+	return (count <= CHANS_MAX);
+}
+
+/********************************************************************************
+void grainpulse_initChan(t_grainpulse_chan *ch)
+
+inputs:			ch		-- channel to set up
+description:	starts a channel with no voices sounding
+returns:		nothing
+********************************************************************************/
+void grainpulse_initChan(t_grainpulse_chan *ch)
+{
+	ch->voice_active_count = 0;
+	ch->voice_newest = NO_VOICE;
+	ch->overflow_status = OVERFLOW_OFF;
+	ch->last_pulse_in = 0.0;
+}
+
+/********************************************************************************
+long grainpulse_inputchanged(t_grainpulse *x, long index, long count)
+
+inputs:			x		-- pointer to this object
+				index	-- inlet whose channel count changed
+				count	-- channels now connected to it
+description:	called when a multichannel cord changes; the outlets carry as
+		many channels as the widest inlet, and narrower inlets repeat theirs
+returns:		true if the number of output channels changed
+********************************************************************************/
+long grainpulse_inputchanged(t_grainpulse *x, long index, long count)
+{
+	long i, widest = 1;
+	
+	if (index >= 0 && index < NUM_INLETS)
+		x->in_chans[index] = (count > 0) ? count : 1;
+	
+	for (i = 0; i < NUM_INLETS; i++)
+		if (x->in_chans[i] > widest)
+			widest = x->in_chans[i];
+	
+	if (widest == x->out_chans)
+		return false;
+	
+	x->out_chans = widest;
+	return true;
+}
+
+/********************************************************************************
+long grainpulse_multichanneloutputs(t_grainpulse *x, long index)
+
+inputs:			x		-- pointer to this object
+				index	-- outlet
+description:	reports the channels of every outlet to a multichannel cord
+returns:		number of channels
+********************************************************************************/
+long grainpulse_multichanneloutputs(t_grainpulse *x, long index)
+{
+	return x->out_chans;
+}
+
 
 /********************************************************************************
  void grainpulse_dsp64()
@@ -242,9 +478,28 @@ void grainpulse_dsp64(t_grainpulse *x, t_object *dsp64, short *count, double sam
         object_post((t_object*)x, "adding 64 bit perform method");
     #endif /* DEBUG */
     
+    long i, chans, offset;
+    t_perfroutine64 perform;
+    
     /* set buffers */
     grainpulse_setsnd(x, x->snd_sym);
-    grainpulse_setwin(x, x->win_sym);
+    if (x->next_window.type == NW_WINDOW_BUFFER)
+        grainpulse_setwin(x, x->win_sym);
+    
+    /* find where each inlet starts among the perform inputs */
+    offset = 0;
+    for (i = 0; i < NUM_INLETS; i++) {
+        chans = (long)object_method(dsp64, gensym("getnuminputchannels"), x, i);
+        x->in_chans[i] = (chans > 0) ? chans : 1;
+        x->perf_in_chans[i] = x->in_chans[i];
+        x->perf_in_offset[i] = offset;
+        offset += x->in_chans[i];
+    }
+    
+    /* every output channel has its own voices */
+    if (!grainpulse_resizeChans(x, x->out_chans)) {
+        object_error((t_object*)x, "could not allocate grain voices for %ld channels", x->out_chans);
+    }
     
     /* test inlets for signal data */
     x->grain_pos_start_connected = count[1];
@@ -252,18 +507,33 @@ void grainpulse_dsp64(t_grainpulse *x, t_object *dsp64, short *count, double sam
     x->grain_pitch_connected = count[3];
     x->grain_gain_connected = count[4];
     
+    // grains only follow inlets that are connected
+    x->modulate_gain = x->modulate && x->grain_gain_connected;
+    x->modulate_pitch = x->modulate && x->grain_pitch_connected;
+    
     // grab sample rate
     x->output_sr = samplerate;
     x->output_1oversr = 1.0 / x->output_sr;
     
     // set overflow status
-    x->overflow_status = OVERFLOW_OFF;
+    for (i = x->chan_alloc.load(std::memory_order_relaxed) - 1; i >= 0; i--)
+        x->chans[i]->overflow_status = OVERFLOW_OFF;
     
     if (count[5] || count[6]) {	// if input and output connected..
         #ifdef DEBUG
             object_post((t_object*)x, "output is being computed");
         #endif /* DEBUG */
-        dsp_add64(dsp64, (t_object*)x, (t_perfroutine64)grainpulse_perform64, 0, NULL);
+        // reading inlets every sample has a routine of its own, so the
+        // default one costs nothing extra
+        if (x->modulate_gain && x->modulate_pitch)
+            perform = (t_perfroutine64)grainpulse_perform64<true, true>;
+        else if (x->modulate_gain)
+            perform = (t_perfroutine64)grainpulse_perform64<true, false>;
+        else if (x->modulate_pitch)
+            perform = (t_perfroutine64)grainpulse_perform64<false, true>;
+        else
+            perform = (t_perfroutine64)grainpulse_perform64<false, false>;
+        dsp_add64(dsp64, (t_object*)x, perform, 0, NULL);
     } else {					// if not...
         #ifdef DEBUG
             object_post((t_object*)x, "no output computed");
@@ -310,245 +580,136 @@ void grainpulse_perform64zero(t_grainpulse *x, t_object *dsp64, double **ins, lo
  vectorsize --
  flags   --
  userparam  --
- description:	called at interrupt level to compute object's output at 64-bit
+ description:	called at interrupt level to compute object's output at 64-bit;
+        every channel of a multichannel cord is rendered here, sharing one lock
+        of each buffer; ModGain and ModPitch are passed on to renderChannel
  returns:		nothing
  ********************************************************************************/
+template <bool ModGain, bool ModPitch>
 void grainpulse_perform64(t_grainpulse *x, t_object *dsp64, double **ins, long numins, double **outs,
                             long numouts, long vectorsize, long flags, void *userparam)
 {
-    // local vars outlets and inlets
-    double *in_pulse = ins[0];
-    double *in_sound_start = ins[1];
-    double *in_dur = ins[2];
-    double *in_sample_increment = ins[3];
-    double *in_gain = ins[4];
-    double *out_signal = outs[0];
-    double *out_signal2 = outs[1];
-    double *out_sample_count = outs[2];
-    double *out_overflow = outs[3];
-    
     // local vars for snd and win buffer
     t_buffer_obj *snd_object, *win_object;
+    t_buffer_info b_info;
     float *tab_s, *tab_w;
-    double snd_out, snd_out2, win_out;
     long size_s, chan_s, size_w;
     
-    // local vars for object vars and while loop
-    double index_s, index_w, temp_index_frac;
-    long n, count_samp, temp_index_int, temp_index_int_times_chan;
-    double s_step_size, w_step_size, g_gain;
-    short interp_s, interp_w, g_direction, of_status;
-    float last_pulse;
+    // local vars for channels
+    double *chan_ins[NUM_INLETS];
+    double *chan_outs[NUM_OUTLETS];
+    long chan_alloc = x->chan_alloc.load(std::memory_order_acquire);	// channels with voices
+    long out_chans = numouts / NUM_OUTLETS;	// the outlets as this chain was built
+    long c, i, n;
     
     // check to make sure buffers are loaded with proper file types
     if (x->x_obj.z_disabled)		// and object is enabled
         goto out;
-    if (x->snd_buf_ptr == NULL || (x->win_buf_ptr == NULL))
+    
+    // buffers only change at vector boundaries, so all voices share one lock
+    grainpulse_updateBuffers(x);
+    
+    if (x->snd_buf.ref == NULL || (x->window.type == NW_WINDOW_BUFFER && x->win_buf.ref == NULL))
         goto zero;
     
-    // get sound buffer info
-    snd_object = buffer_ref_getobject(x->snd_buf_ptr);
+    // get sound buffer info; values cached when it was linked are read again
+    // only if the buffer~ has been changed since
+    snd_object = buffer_ref_getobject((t_buffer_ref *)x->snd_buf.ref);
     tab_s = buffer_locksamples(snd_object);
     if (!tab_s)		// buffer samples were not accessible
         goto zero;
-    size_s = buffer_getframecount(snd_object);
-    chan_s = buffer_getchannelcount(snd_object);
+    buffer_getinfo(snd_object, &b_info);
+    if (b_info.b_modtime != x->snd_buf.modtime) {
+        nw_bufinfo_set(&x->snd_buf, x->snd_buf.ref, b_info.b_frames, b_info.b_nchans, b_info.b_sr, b_info.b_modtime);
+        grainpulse_soundChanged(x);
+    }
+    size_s = x->snd_buf.frames;
+    chan_s = x->snd_buf.chans;
     
-    // get window buffer info
-    win_object = buffer_ref_getobject(x->win_buf_ptr);
-    tab_w = buffer_locksamples(win_object);
-    if (!tab_w)		// buffer samples were not accessible
-        goto zero;
-    size_w = buffer_getframecount(win_object);
+    // kernels for the modes last published and the channels of this sound
+    grainpulse_updateKernels(x, chan_s);
     
-    // get snd and win index info
-    index_s = x->curr_snd_pos;
-    index_w = x->curr_win_pos;
-    s_step_size = x->snd_step_size;
-    w_step_size = x->win_step_size;
+    // a changed sound retires the pyramid, so sounding voices go back to the buffer~
+    if (x->snd_pyramid.check(x->pyramid ? x->snd_buf.ref : NULL, size_s, chan_s, x->snd_buf.modtime)) {
+        for (c = 0; c < chan_alloc; c++) {
+            for (i = 0; i < x->chans[c]->voice_active_count; i++)
+                x->chans[c]->voice_pool[i].dropLevel();
+        }
+        qelem_set(x->pyramid_qelem);
+    }
     
-    // get grain options
-    interp_s = x->snd_interp;
-    interp_w = x->win_interp;
-    g_gain = x->grain_gain;
-    g_direction = x->grain_direction;
-    of_status = x->overflow_status;
+    // get window buffer info, unless an analytic window is playing
+    if (x->window.type == NW_WINDOW_BUFFER) {
+        win_object = buffer_ref_getobject((t_buffer_ref *)x->win_buf.ref);
+        tab_w = buffer_locksamples(win_object);
+        if (!tab_w) {		// buffer samples were not accessible
+            buffer_unlocksamples(snd_object);
+            goto zero;
+        }
+        buffer_getinfo(win_object, &b_info);
+        if (b_info.b_modtime != x->win_buf.modtime)
+            nw_bufinfo_set(&x->win_buf, x->win_buf.ref, b_info.b_frames, b_info.b_nchans, b_info.b_sr, b_info.b_modtime);
+        size_w = x->win_buf.frames;
+    } else {
+        win_object = NULL;
+        tab_w = NULL;
+        size_w = NW_WINDOW_FRAMES;
+    }
     
-    // get history from last vector
-    last_pulse = x->last_pulse_in;
-    count_samp = x->curr_count_samp;
+    // cache window length used by grainpulse_initGrain
+    x->win_buf_frames = size_w;
     
-    n = vectorsize;
-    while(n--)
-    {
-        // advance window index
-        index_w += w_step_size;
-        // and if we exceed the window size, stop producing grain
-        if (index_w > size_w) count_samp = -1;
-        
-        // should we start a grain ?
-        if (count_samp == -1) { // if sample count is -1...
-            if (last_pulse == 0.0 && *in_pulse == 1.0) { // if pulse begins...
-                buffer_unlocksamples(snd_object);
-                buffer_unlocksamples(win_object);
-                
-                grainpulse_initGrain(x, *in_sound_start, *in_dur, *in_sample_increment, *in_gain);
-                
-                // get snd buffer info
-                snd_object = buffer_ref_getobject(x->snd_buf_ptr);
-                tab_s = buffer_locksamples(snd_object);
-                if (!tab_s)	{	// buffer samples were not accessible
-                    *out_signal = 0.0;
-                    *out_signal2 = 0.0;
-                    *out_overflow = 0.0;
-                    *out_sample_count = (double)count_samp;
-                    last_pulse = *in_pulse;
-                    goto advance_pointers;
-                }
-                size_s = buffer_getframecount(snd_object);
-                
-                // get win buffer info
-                win_object = buffer_ref_getobject(x->win_buf_ptr);
-                tab_w = buffer_locksamples(win_object);
-                if (!tab_w)	{	// buffer samples were not accessible
-                    *out_signal = 0.0;
-                    *out_signal2 = 0.0;
-                    *out_overflow = 0.0;
-                    *out_sample_count = (double)count_samp;
-                    last_pulse = *in_pulse;
-                    goto advance_pointers;
-                }
-                size_w = buffer_getframecount(win_object);
-                
-                // get snd and win index info
-                index_s = x->curr_snd_pos;
-                index_w = x->curr_win_pos;
-                s_step_size = x->snd_step_size;
-                w_step_size = x->win_step_size;
-                
-                // get grain options
-                interp_s = x->snd_interp;
-                interp_w = x->win_interp;
-                g_gain = x->grain_gain;
-                g_direction = x->grain_direction;
-                /*** of_status = x->overflow_status; ***/
-                
-                // get history from last vector
-                last_pulse = x->last_pulse_in;
-                count_samp = x->curr_count_samp;
-                
-                // BUT this stays off until duty cycle ends
-                of_status = OVERFLOW_OFF;
-                
-            } else { // if not...
-                *out_signal = 0.0;
-                *out_signal2 = 0.0;
-                *out_overflow = 0.0;
-                *out_sample_count = (double)count_samp;
-                last_pulse = *in_pulse;
-                goto advance_pointers;
+    // a changed window retires every table, so sounding voices go back to interpolating
+    if (win_object) {
+        if (x->win_cache.check(win_object, size_w, x->win_buf.modtime, x->win_interp)) {
+            for (c = 0; c < chan_alloc; c++) {
+                for (i = 0; i < x->chans[c]->voice_active_count; i++)
+                    x->chans[c]->voice_pool[i].win_table = NULL;
             }
+            qelem_set(x->win_cache_qelem);
         }
-
-        // pulse tracking for overflow
-        if (!of_status) {
-            if (last_pulse == 1.0 && *in_pulse == 0.0) { // if grain on & pulse ends...
-                of_status = OVERFLOW_ON;	//start overflowing
-            }
-        }
-        
-        // if we made it here, then we will actually start counting
-        count_samp++;
-        
-        // advance sound index
-        if (g_direction == FORWARD_GRAINS) {
-            index_s += s_step_size;     // addition
-        } else {	// if REVERSE_GRAINS
-            index_s -= s_step_size;		// subtract
-        }
-        
-        // wrap sound index if not within bounds
-        while (index_s < 0.0)
-            index_s += size_s;
-        while (index_s >= size_s)
-            index_s -= size_s;
-        
-        // WINDOW OUT
-        
-        // compute temporary vars for interpolation
-        temp_index_int = (long)(index_w); // integer portion of index
-        temp_index_frac = index_w - (double)temp_index_int; // fractional portion of index
-        
-        // get value from the win buffer samples
-        if (interp_w == INTERP_ON) {
-            win_out = mcLinearInterp(tab_w, temp_index_int, temp_index_frac, size_w, 1);
-        } else {	// if INTERP_OFF
-            win_out = tab_w[temp_index_int];
-        }
-        
-        // SOUND OUT
-        
-        // compute temporary vars for interpolation
-        temp_index_int = (long)(index_s); // integer portion of index
-        temp_index_frac = index_s - (double)temp_index_int; // fractional portion of index
-        temp_index_int_times_chan = temp_index_int * chan_s;
-        
-        // get value from the snd buffer samples
-        if (interp_s == INTERP_ON) {
-            snd_out = mcLinearInterp(tab_s, temp_index_int_times_chan, temp_index_frac, size_s, chan_s);
-            snd_out2 = (chan_s == 2) ?
-                mcLinearInterp(tab_s, temp_index_int_times_chan + 1, temp_index_frac, size_s, chan_s) :
-                snd_out;
-        } else {	// if INTERP_OFF
-            snd_out = tab_s[temp_index_int_times_chan];
-            snd_out2 = (chan_s == 2) ?
-                tab_s[temp_index_int_times_chan + 1] :
-                snd_out;
-        }
-        
-        // OUTLETS
-        
-        // multiply snd_out by win_out by gain value
-        *out_signal = snd_out * win_out * g_gain;
-        *out_signal2 = snd_out2 * win_out * g_gain;
+    }
+    
+    for (c = 0; c < out_chans; c++) {
+        // outlets are in order, each with every channel
+        for (i = 0; i < NUM_OUTLETS; i++)
+            chan_outs[i] = outs[i * out_chans + c];
         
-        if (of_status) {
-            *out_overflow = *in_pulse;
-        } else {
-            *out_overflow = 0.0;
+        if (c >= chan_alloc) {		// no voices for this channel
+            for (n = 0; n < vectorsize; n++) {
+                chan_outs[0][n] = chan_outs[1][n] = 0.;
+                chan_outs[2][n] = chan_outs[3][n] = -1.;
+            }
+            continue;
         }
         
-        *out_sample_count = (double)count_samp;
+        // inlets with fewer channels repeat them
+        for (i = 0; i < NUM_INLETS; i++)
+            chan_ins[i] = ins[x->perf_in_offset[i] + c % x->perf_in_chans[i]];
         
-        // update vars for last output
-        last_pulse = *in_pulse;
-    
-advance_pointers:
-        // advance all pointers
-        ++in_pulse, ++in_sound_start, ++in_dur, ++in_sample_increment, ++in_gain;
-        ++out_signal, ++out_signal2, ++out_overflow, ++out_sample_count;
+        grainpulse_renderChannel<ModGain, ModPitch>(x, x->chans[c], chan_ins, chan_outs, vectorsize,
+            tab_s, size_s, chan_s, tab_w, size_w);
     }
 
-    // update object history for next vector
-    x->curr_snd_pos = index_s;
-    x->curr_win_pos = index_w;
-    x->last_pulse_in = last_pulse;
-    x->overflow_status = of_status;
-    x->curr_count_samp = count_samp;
-
     buffer_unlocksamples(snd_object);
-    buffer_unlocksamples(win_object);
+    if (win_object)
+        buffer_unlocksamples(win_object);
     return;
 
     // alternate blank output
 zero:
-    n = vectorsize;
-    while(n--)
-    {
-        *out_signal++ = 0.;
-        *out_signal2++ = 0.;
-        *out_sample_count++ = -1.;
-        *out_overflow++ = -1.;
+    for (c = 0; c < out_chans; c++) {
+        for (i = 0; i < NUM_OUTLETS; i++)
+            chan_outs[i] = outs[i * out_chans + c];
+        
+        n = vectorsize;
+        while(n--)
+        {
+            *chan_outs[0]++ = 0.;
+            *chan_outs[1]++ = 0.;
+            *chan_outs[2]++ = -1.;
+            *chan_outs[3]++ = -1.;
+        }
     }
 
 out:
@@ -557,96 +718,378 @@ out:
 }
 
 /********************************************************************************
-void grainpulse_initGrain(t_grainpulse *x, float in_pos_start, float in_length,
-		float in_pitch_mult, float in_gain_mult)
+void grainpulse_renderChannel(t_grainpulse *x, t_grainpulse_chan *ch, double **ins,
+		double **outs, long vectorsize, const float *tab_s, long size_s,
+		long chan_s, const float *tab_w, long size_w)
+
+inputs:			x			-- pointer to this object
+				ch			-- channel to render
+				ins			-- pulse, offset, duration, increment and gain inputs
+				outs		-- ch1, ch2, sample count and overflow outputs
+				vectorsize	-- number of samples
+				tab_s		-- locked sound buffer and its frames and channels
+				tab_w		-- locked window buffer and its frames
+description:	starts and renders the grains of one channel of pulses; each
+		voice renders the run up to the next pulse in one kernel call; ModGain
+		and ModPitch set grains to read gain and pitch every sample, see the
+		modulate attribute, so those are played a sample at a time
+returns:		nothing
+********************************************************************************/
+template <bool ModGain, bool ModPitch>
+void grainpulse_renderChannel(t_grainpulse *x, t_grainpulse_chan *ch, double **ins, double **outs,
+		long vectorsize, const float *tab_s, long size_s, long chan_s, const float *tab_w, long size_w)
+{
+    // local vars outlets and inlets
+    double *in_pulse = ins[0];
+    double *in_sound_start = ins[1];
+    double *in_dur = ins[2];
+    double *in_sample_increment = ins[3];
+    double *in_gain = ins[4];
+    double *out_signal = outs[0];
+    double *out_signal2 = outs[1];
+    double *out_sample_count = outs[2];
+    double *out_overflow = outs[3];
+    
+    // local vars for voice pool
+    GrainVoice *pool = ch->voice_pool;
+    GrainVoice *v;
+    long a, active_count, voice_count, newest;
+    
+    // local vars for object vars and while loop
+    long i, j, n, end, count, full_end;
+    short of_status;
+    float last_pulse, of_last_pulse;
+    bool sounding;
+    
+    // get grain options
+    of_status = ch->overflow_status;
+    
+    // get history from last vector
+    last_pulse = of_last_pulse = ch->last_pulse_in;
+    active_count = ch->voice_active_count;
+    voice_count = x->voice_count;
+    newest = ch->voice_newest;
+    
+    // voices add themselves to the outputs
+    for (i = 0; i < vectorsize; i++) {
+        out_signal[i] = 0.0;
+        out_signal2[i] = 0.0;
+        out_sample_count[i] = -1.0;
+    }
+    
+    // render in runs that end where the next pulse begins
+    i = 0;
+    while (i < vectorsize)
+    {
+        // should we start a grain ?
+        if (last_pulse == 0.0 && in_pulse[i] == 1.0) { // if pulse begins...
+            if (active_count < voice_count) { // and a voice is free...
+                newest = active_count++;
+                grainpulse_initGrain(x, pool + newest, in_sound_start[i], in_dur[i], in_sample_increment[i], in_gain[i]);
+                
+                // BUT this stays off until duty cycle ends
+                of_status = OVERFLOW_OFF;
+            }
+        }
+        last_pulse = in_pulse[i];
+        for (end = i + 1; end < vectorsize; end++) {
+            if (last_pulse == 0.0 && in_pulse[end] == 1.0)
+                break;
+            last_pulse = in_pulse[end];
+        }
+        
+        // a full pool stays full until the first voice in the run is freed
+        full_end = (active_count >= voice_count) ? end : i;
+        
+        // render each active voice
+        a = 0;
+        while (a < active_count) {
+            v = pool + a;
+            count = v->curr_count_samp;
+            
+            // voices following the inlets are played a sample at a time
+            if (ModGain || ModPitch) {
+                sounding = true;
+                for (j = i; j < end && sounding; j++) {
+                    if (ModGain)
+                        v->grain_gain = in_gain[j];
+                    if (ModPitch)
+                        v->setPitch(in_sample_increment[j]);
+                    sounding = v->play(tab_s, size_s, chan_s, tab_w, size_w, out_signal + j, out_signal2 + j, 1);
+                }
+            } else {
+                sounding = v->play(tab_s, size_s, chan_s, tab_w, size_w, out_signal + i, out_signal2 + i, end - i);
+            }
+            
+            n = v->curr_count_samp - count;		// samples played
+            if (a == newest) {
+                for (j = 0; j < n; j++)
+                    out_sample_count[i + j] = (double)(count + 1 + j);
+            }
+            
+            // free the voice once it has played to the end of its window
+            if (!sounding) {
+                if (i + n < full_end)
+                    full_end = i + n;		// room for a grain from the next sample
+                --active_count;
+                if (newest == a) {
+                    newest = NO_VOICE;
+                } else if (newest == active_count) {
+                    newest = a;
+                }
+                *v = pool[active_count];	// keep active voices packed
+            } else {
+                ++a;
+            }
+        }
+        
+        // pulse tracking for overflow, only while every voice is sounding
+        for (j = i; j < end; j++) {
+            if (j < full_end) {
+                if (!of_status) {
+                    if (of_last_pulse == 1.0 && in_pulse[j] == 0.0) { // if pool full & pulse ends...
+                        of_status = OVERFLOW_ON;	//start overflowing
+                    }
+                }
+                out_overflow[j] = of_status ? in_pulse[j] : 0.0;
+            } else {
+                out_overflow[j] = 0.0;
+            }
+            of_last_pulse = in_pulse[j];
+        }
+        
+        i = end;
+    }
+    
+    // update channel history for next vector
+    ch->last_pulse_in = last_pulse;
+    ch->overflow_status = of_status;
+    ch->voice_active_count = active_count;
+    ch->voice_newest = newest;
+}
+
+/********************************************************************************
+void grainpulse_initGrain(t_grainpulse *x, GrainVoice *v, float in_pos_start,
+		float in_length, float in_pitch_mult, float in_gain_mult)
 
 inputs:			x					-- pointer to this object
+				v					-- voice that will play the grain
 				in_pos_start		-- offset within sampled buffer
 				in_length			-- length of grain
 				in_pitch_mult		-- sample playback speed, 1 = normal
 				in_gain_mult		-- scales gain output, 1 = no change
 description:	initializes grain vars; called from perform method when pulse is 
-		received
+		received; uses buffer info cached at the start of the vector; a
+		buffer~ window plays from a table when one has been built for the grain
+		length, otherwise the table is asked for
 returns:		nothing 
 ********************************************************************************/
-void grainpulse_initGrain(t_grainpulse *x, float in_pos_start, float in_length, 
+void grainpulse_initGrain(t_grainpulse *x, GrainVoice *v, float in_pos_start, float in_length,
 		float in_pitch_mult, float in_gain_mult)
 {
+	const float *table;
+	long length;
+	
 	#ifdef DEBUG
 		object_post((t_object*)x, "initializing grain");
 	#endif /* DEBUG */
+	
+    /* should input variables be at audio or control rate ? */
     
-    t_buffer_obj	*snd_object;
-    t_buffer_obj	*win_object;
+    v->start(x->grain_pos_start_connected ? in_pos_start : x->next_grain_pos_start,
+             x->grain_length_connected ? in_length : x->next_grain_length,
+             x->grain_pitch_connected ? in_pitch_mult : x->next_grain_pitch,
+             x->grain_gain_connected ? in_gain_mult : x->next_grain_gain,
+             x->next_grain_direction,
+             x->snd_buf.sr, x->snd_buf.msr, x->snd_buf.frames, x->win_buf_frames, x->output_sr);
+    if (x->pyramid)
+        v->useLevel(&x->snd_pyramid, x->snd_buf.msr);
+    v->useSinc(x->snd_sinc);
+    v->useKernels(x->grain_kernels, x->snd_buf.chans);
+	
+	// once the pitch moves, the span checked by start no longer holds
+	if (x->modulate_pitch)
+		v->snd_wraps = true;
+	
+	if (x->window.type != NW_WINDOW_BUFFER) {
+		v->startWindow(&x->window, x->win_buf_frames);
+		return;
+	}
+	
+	length = nw_wincache_length(fabs(v->grain_length) * x->output_sr * 0.001);
+	if (length) {
+		table = x->win_cache.find(length);
+		if (table)
+			v->useTable(table, length, x->win_buf_frames);
+		else if (x->win_cache.request(length))
+			qelem_set(x->win_cache_qelem);
+	}
+	
+	// send report out at beginning of grain
+	//defer(x, (void *)grainpulse_reportoninit,0L,0,0L);
+	
+	#ifdef DEBUG
+		object_post((t_object*)x, "beginning of grain");
+		object_post((t_object*)x, "win step size = %f samps", v->win_step_size);
+		object_post((t_object*)x, "snd step size = %f samps", v->snd_step_size);
+	#endif /* DEBUG */
+}
+
+/********************************************************************************
+void grainpulse_soundChanged(t_grainpulse *x)
+
+inputs:			x					-- pointer to this object
+description:	called from perform method when a new sound buffer is taken or
+		the buffer~ itself is changed; sounding voices checked their span 
+		against the old sound, so they go back to wrapping every read
+returns:		nothing 
+********************************************************************************/
+void grainpulse_soundChanged(t_grainpulse *x)
+{
+	t_grainpulse_chan *ch;
+	long chan_alloc = x->chan_alloc.load(std::memory_order_acquire);
+	long a, c;
+	
+	for (c = 0; c < chan_alloc; c++) {
+		ch = x->chans[c];
+		for (a = 0; a < ch->voice_active_count; a++)
+			ch->voice_pool[a].snd_wraps = true;
+	}
+}
+
+/********************************************************************************
+void grainpulse_updateBuffers(t_grainpulse *x)
+
+inputs:			x					-- pointer to this object
+description:	takes buffers posted by setSound and setWin, and the shape
+		deferred by window; called from perform method at the start of each 
+		vector so that every voice reads the same locked buffers; voices 
+		already sounding are rescaled to the length of a new window, and carry
+		on from the same place with a new shape; channels past the outlets keep
+		their voices, so every allocated channel is updated
+returns:		nothing 
+********************************************************************************/
+void grainpulse_updateBuffers(t_grainpulse *x)
+{
+	t_grainpulse_chan *ch;
+	GrainVoice *v;
+	double win_scale;
+	long chan_alloc = x->chan_alloc.load(std::memory_order_acquire);
+	long new_frames, a, c;
+	bool win_swapped = false, shape_swapped = false;
 	
-	if (x->next_snd_buf_ptr != NULL) {
-		x->snd_buf_ptr = x->next_snd_buf_ptr;
-		x->next_snd_buf_ptr = NULL;
+	if (x->snd_swap.take(&x->snd_buf)) {
+		grainpulse_soundChanged(x);
 		
 		#ifdef DEBUG
 			object_post((t_object*)x, "sound buffer pointer updated");
 		#endif /* DEBUG */
 	}
-	if (x->next_win_buf_ptr != NULL) {
-		x->win_buf_ptr = x->next_win_buf_ptr;
-		x->next_win_buf_ptr = NULL;
+	if (x->win_swap.take(&x->win_buf)) {
+		win_swapped = true;
 		
 		#ifdef DEBUG
 			object_post((t_object*)x, "window buffer pointer updated");
 		#endif /* DEBUG */
 	}
+	if (x->window_swap.take(&x->window)) {
+		shape_swapped = true;
+	}
+	
+	if (win_swapped || shape_swapped) {
+		// keep sounding voices at the same relative place in the new window
+		if (x->window.type != NW_WINDOW_BUFFER)
+			new_frames = NW_WINDOW_FRAMES;
+		else if (x->win_buf.ref != NULL)
+			new_frames = x->win_buf.frames;
+		else
+			new_frames = 0;
+		if (x->win_buf_frames > 0 && new_frames > 0 && new_frames != x->win_buf_frames) {
+			win_scale = (double)new_frames / (double)(x->win_buf_frames);
+			for (c = 0; c < chan_alloc; c++) {
+				ch = x->chans[c];
+				for (a = 0; a < ch->voice_active_count; a++) {
+					v = ch->voice_pool + a;
+					v->curr_win_pos *= win_scale;
+					v->win_step_size *= win_scale;
+				}
+			}
+		}
+		x->win_buf_frames = new_frames;
+		
+		if (shape_swapped) {
+			for (c = 0; c < chan_alloc; c++) {
+				ch = x->chans[c];
+				for (a = 0; a < ch->voice_active_count; a++)
+					ch->voice_pool[a].startWindow(&x->window, new_frames);
+			}
+		}
+	}
+}
+
+/********************************************************************************
+void grainpulse_buildWindows(t_grainpulse *x)
+
+inputs:			x					-- pointer to this object
+description:	builds the window tables asked for by the perform routine;
+		called from a qelem so that resampling stays off the audio thread
+returns:		nothing 
+********************************************************************************/
+void grainpulse_buildWindows(t_grainpulse *x)
+{
+	t_buffer_obj *win_object;
+	float *tab_w;
 	
-	snd_object = buffer_ref_getobject(x->snd_buf_ptr);
-	win_object = buffer_ref_getobject(x->win_buf_ptr);
+	if (x->win_ref == NULL)
+		return;
 	
-    /* should input variables be at audio or control rate ? */
-    
-    // temporarily stash here as milliseconds
-    x->grain_pos_start = x->grain_pos_start_connected ? in_pos_start : x->next_grain_pos_start;
-    
-    x->grain_length = x->grain_length_connected ? in_length : x->next_grain_length;
-    
-    x->grain_pitch = x->grain_pitch_connected ? in_pitch_mult : x->next_grain_pitch;
-    
-    x->grain_gain = x->grain_gain_connected ? in_gain_mult : x->next_grain_gain;
-    
-    /* compute dependent variables */
-    
-	// compute amount of sound file for grain
-	x->grain_sound_length = x->grain_length * x->grain_pitch;
-    if (x->grain_sound_length < 0.) x->grain_sound_length *= -1.; // needs to be positive to prevent buffer overruns
+	win_object = buffer_ref_getobject(x->win_ref);
+	tab_w = buffer_locksamples(win_object);
+	if (!tab_w)
+		return;
 	
-	// compute window buffer step size per vector sample 
-	x->win_step_size = (double)(buffer_getframecount(win_object)) / (x->grain_length * x->output_sr * 0.001);
-    if (x->win_step_size < 0.) x->win_step_size *= -1.; // needs to be positive to prevent buffer overruns
-    
-	// compute sound buffer step size per vector sample
-	x->snd_step_size = x->grain_pitch * buffer_getsamplerate(snd_object) * x->output_1oversr;
-    //if (x->snd_step_size < 0.) x->snd_step_size *= -1.; // needs to be positive to prevent buffer overruns
-    
-    // update direction option
-    x->grain_direction = x->next_grain_direction;
-	
-	if (x->grain_direction == FORWARD_GRAINS) {	// if forward...
-        x->grain_pos_start = x->grain_pos_start * buffer_getmillisamplerate(snd_object);
-        x->curr_snd_pos = x->grain_pos_start - x->snd_step_size;
-    } else {	// if reverse...
-        x->grain_pos_start = (x->grain_pos_start + x->grain_sound_length) * buffer_getmillisamplerate(snd_object);
-        x->curr_snd_pos = x->grain_pos_start + x->snd_step_size;
-    }
+	x->win_cache.update(tab_w, buffer_getframecount(win_object));
+	buffer_unlocksamples(win_object);
 	
-    x->curr_win_pos = 0.0;
+	#ifdef DEBUG
+		object_post((t_object*)x, "window tables built");
+	#endif /* DEBUG */
+}
+
+/********************************************************************************
+void grainpulse_buildPyramid(t_grainpulse *x)
+
+inputs:			x					-- pointer to this object
+description:	builds the levels of the pyramid asked for by the perform
+		routine, a piece at a time; called from a qelem so that filtering
+		stays off the audio thread, and sets the qelem again until done
+returns:		nothing 
+********************************************************************************/
+void grainpulse_buildPyramid(t_grainpulse *x)
+{
+	t_buffer_ref *snd_ref = (t_buffer_ref *)x->snd_pyramid.wanted();
+	t_buffer_obj *snd_object;
+	t_buffer_info b_info;
+	float *tab_s;
+	bool more;
+	
+	// with no sound wanted, the levels of the last one are only freed
+	snd_object = snd_ref ? buffer_ref_getobject(snd_ref) : NULL;
+	tab_s = snd_object ? buffer_locksamples(snd_object) : NULL;
+	if (!tab_s) {
+		x->snd_pyramid.update(NULL, 0, 0, 0);
+		return;
+	}
 	
-    // reset history
-    x->curr_count_samp = -1;
+	buffer_getinfo(snd_object, &b_info);
+	more = x->snd_pyramid.update(tab_s, b_info.b_frames, b_info.b_nchans, b_info.b_modtime);
+	buffer_unlocksamples(snd_object);
 	
-	// send report out at beginning of grain
-	//defer(x, (void *)grainpulse_reportoninit,0L,0,0L);
+	if (more)
+		qelem_set(x->pyramid_qelem);
 	
 	#ifdef DEBUG
-		object_post((t_object*)x, "beginning of grain");
-		object_post((t_object*)x, "win step size = %f samps", x->win_step_size);
-		object_post((t_object*)x, "snd step size = %f samps", x->snd_step_size);
+		object_post((t_object*)x, more ? "pyramid level building" : "pyramid built");
 	#endif /* DEBUG */
 }
 
@@ -661,10 +1104,16 @@ returns:		nothing
 void grainpulse_reportoninit(t_grainpulse *x, t_symbol *s, short argc, t_atom argv)
 {
 	t_atom ta_msgvals[3];
+	GrainVoice *v;
+	
+	// reports the first channel
+	if (x->chans[0]->voice_newest == NO_VOICE)
+		return;
+	v = x->chans[0]->voice_pool + x->chans[0]->voice_newest;
 	
-	atom_setfloat(ta_msgvals, (float) x->grain_pos_start);
-	atom_setfloat((ta_msgvals + 1), (float) x->grain_length);
-	atom_setfloat((ta_msgvals + 2), (float) x->grain_pitch);
+	atom_setfloat(ta_msgvals, (float) v->grain_pos_start);
+	atom_setfloat((ta_msgvals + 1), (float) v->grain_length);
+	atom_setfloat((ta_msgvals + 2), (float) v->grain_pitch);
 	
 	if (sys_getdspstate()) {
 		//report settings used in grain production
@@ -679,42 +1128,35 @@ void grainpulse_setsnd(t_index *x, t_symbol *s)
 
 inputs:			x		-- pointer to this object
 				s		-- name of buffer to link
-description:	links buffer holding the grain sound source 
+description:	links buffer holding the grain sound source; the perform
+		routine takes it, with its frame count, channel count and sample rate,
+		at the start of its next vector
 returns:		nothing
 ********************************************************************************/
 void grainpulse_setsnd(t_grainpulse *x, t_symbol *s)
 {
 	t_buffer_ref *b = buffer_ref_new((t_object*)x, s);
+	t_buffer_info b_info;
+	t_nw_bufinfo info;
 	
     if (buffer_ref_exists(b)) {
         t_buffer_obj	*b_object = buffer_ref_getobject(b);
         
-		if (buffer_getchannelcount(b_object) > 2) {
+		buffer_getinfo(b_object, &b_info);
+		if (b_info.b_nchans > 2) {
 			object_error((t_object*)x, "buffer~ > %s < must be mono or stereo", s->s_name);
-			x->next_snd_buf_ptr = NULL;		//added 2002.07.15
 		} else {
-			if (x->snd_buf_ptr == NULL) { // if first buffer make current buffer
-				x->snd_sym = s;
-				x->snd_buf_ptr = b;
-				//x->snd_last_out = 0.0; removed 2005.01.25
-				
-				#ifdef DEBUG
-					object_post((t_object*)x, "current sound set to buffer~ > %s <", s->s_name);
-				#endif /* DEBUG */
-			} else { // else defer to next buffer
-				x->snd_sym = s;
-				x->next_snd_buf_ptr = b;
-				//x->snd_buf_length = b->b_frames;	//removed 2002.07.11
-				//x->snd_last_out = 0.0;		//removed 2002.07.24
-				
-				#ifdef DEBUG
-					object_post((t_object*)x, "next sound set to buffer~ > %s <", s->s_name);
-				#endif /* DEBUG */
-			}
+			x->snd_sym = s;
+			x->snd_ref = b;
+			nw_bufinfo_set(&info, b, b_info.b_frames, b_info.b_nchans, b_info.b_sr, b_info.b_modtime);
+			x->snd_swap.post(info);
+			
+			#ifdef DEBUG
+				object_post((t_object*)x, "next sound set to buffer~ > %s <", s->s_name);
+			#endif /* DEBUG */
 		}
 	} else {
 		object_error((t_object*)x, "no buffer~ * %s * found", s->s_name);
-		x->next_snd_buf_ptr = NULL;
 	}
 }
 
@@ -723,48 +1165,74 @@ void grainpulse_setwin(t_grainpulse *x, t_symbol *s)
 
 inputs:			x		-- pointer to this object
 				s		-- name of buffer to link
-description:	links buffer holding the grain window 
+description:	links buffer holding the grain window; the perform routine
+		takes it at the start of its next vector
 returns:		nothing
 ********************************************************************************/
 void grainpulse_setwin(t_grainpulse *x, t_symbol *s)
 {
     t_buffer_ref *b = buffer_ref_new((t_object*)x, s);
+    t_buffer_info b_info;
+    t_nw_bufinfo info;
     
     if (buffer_ref_exists(b)) {
         t_buffer_obj	*b_object = buffer_ref_getobject(b);
         
-        if (buffer_getchannelcount(b_object) != 1) {
+        buffer_getinfo(b_object, &b_info);
+        if (b_info.b_nchans != 1) {
 			object_error((t_object*)x, "buffer~ > %s < must be mono", s->s_name);
-			x->next_win_buf_ptr = NULL;		//added 2002.07.15
 		} else {
-			if (x->win_buf_ptr == NULL) { // if first buffer make current buffer
-				x->win_sym = s;
-				x->win_buf_ptr = b;
-				//x->win_last_out = 0.0; removed 2005.01.25
-				
-				/* set current win position to 1 more than length */
-				x->curr_win_pos = (double)(buffer_getframecount(b_object)) + 1.0;
-				
-				#ifdef DEBUG
-					object_post((t_object*)x, "current window set to buffer~ > %s <", s->s_name);
-				#endif /* DEBUG */
-			} else { // else defer to next buffer
-				x->win_sym = s;
-				x->next_win_buf_ptr = b;
-				//x->win_buf_length = b->b_frames;	//removed 2002.07.11
-				//x->win_last_out = 0.0;		//removed 2002.07.24
-				
-				#ifdef DEBUG
-					object_post((t_object*)x, "next window set to buffer~ > %s <", s->s_name);
-				#endif /* DEBUG */
-			}
+			x->win_sym = s;
+			x->win_ref = b;
+			nw_bufinfo_set(&info, b, b_info.b_frames, b_info.b_nchans, b_info.b_sr, b_info.b_modtime);
+			x->win_swap.post(info);
+			
+			#ifdef DEBUG
+				object_post((t_object*)x, "next window set to buffer~ > %s <", s->s_name);
+			#endif /* DEBUG */
 		}
 	} else {
 		object_error((t_object*)x, "no buffer~ > %s < found", s->s_name);
-		x->next_win_buf_ptr = NULL;
 	}
 }
 
+/********************************************************************************
+void grainpulse_window(t_grainpulse *x, t_symbol *s, long argc, t_atom *argv)
+
+inputs:			x		-- pointer to this object
+				s		-- message selector
+				argc	-- number of arguments
+				argv	-- shape name, then an optional parameter
+description:	method called when "window" message is received; picks one of the
+		analytic window shapes, or "buffer" to go back to the window buffer~;
+		takes effect at the start of the next vector
+returns:		nothing
+********************************************************************************/
+void grainpulse_window(t_grainpulse *x, t_symbol *s, long argc, t_atom *argv)
+{
+	t_nw_window w;
+	
+	if (argc < 1 || atom_gettype(argv) != A_SYM) {
+		object_error((t_object*)x, "window needs the name of a shape");
+		return;
+	}
+	if (!nw_window_set(&w, atom_getsym(argv)->s_name, argc > 1, argc > 1 ? atom_getfloat(argv + 1) : 0.)) {
+		object_error((t_object*)x, "window %s was not understood", atom_getsym(argv)->s_name);
+		return;
+	}
+	
+	// the window buffer~ is only linked when the dsp starts with it in use
+	if (w.type == NW_WINDOW_BUFFER && x->win_ref == NULL)
+		grainpulse_setwin(x, x->win_sym);
+	
+	x->next_window = w;
+	x->window_swap.post(w);
+	
+	#ifdef DEBUG
+		object_post((t_object*)x, "window is set to %s", atom_getsym(argv)->s_name);
+	#endif /* DEBUG */
+}
+
 /********************************************************************************
 void grainpulse_float(t_grainpulse *x, double f)
 
@@ -843,30 +1311,133 @@ void grainpulse_int(t_grainpulse *x, long l)
 	}
 }
 
+/********************************************************************************
+void grainpulse_publishKernels(t_grainpulse *x)
+
+inputs:			x		-- pointer to this object
+description:	hands the kernels for the current sndInterp and winInterp modes
+		to the perform routine, which takes them at its next vector; one
+		pointer is swapped, so the two modes always arrive together
+returns:		nothing
+********************************************************************************/
+void grainpulse_publishKernels(t_grainpulse *x)
+{
+	x->next_kernels.store(nw_grain_kernels(x->snd_interp, x->win_interp), std::memory_order_release);
+}
+
+/********************************************************************************
+void grainpulse_updateKernels(t_grainpulse *x, long chan_s)
+
+inputs:			x		-- pointer to this object
+				chan_s	-- channels in the sound buffer
+description:	perform routine side; takes the kernels last published, and
+		moves sounding voices onto them when they or the sound's channels
+		change, so that every voice plays the modes set
+returns:		nothing
+********************************************************************************/
+void grainpulse_updateKernels(t_grainpulse *x, long chan_s)
+{
+	const t_nw_grain_kernels *kernels = x->next_kernels.load(std::memory_order_acquire);
+	t_grainpulse_chan *ch;
+	long chan_alloc = x->chan_alloc.load(std::memory_order_acquire);
+	long a, c;
+	
+	if (kernels == x->grain_kernels && x->grain_stereo == (chan_s == 2))
+		return;
+	
+	x->grain_kernels = kernels;
+	x->grain_stereo = (chan_s == 2);
+	for (c = 0; c < chan_alloc; c++) {
+		ch = x->chans[c];
+		for (a = 0; a < ch->voice_active_count; a++)
+			ch->voice_pool[a].useKernels(kernels, chan_s);
+	}
+}
+
 /********************************************************************************
 void grainpulse_sndInterp(t_grainpulse *x, long l)
 
 inputs:			x		-- pointer to our object
 				l		-- flag value
 description:	method called when "sndInterp" message is received; allows user 
-		to define whether interpolation is used in pulling values from the sound
-		buffer; default is on
+		to choose the interpolation used in pulling values from the sound
+		buffer; 0 = off, 1 = linear, 2 = hermite, 3 = lagrange, 4 = windowed
+		sinc; default is linear
 returns:		nothing
 ********************************************************************************/
 void grainpulse_sndInterp(t_grainpulse *x, long l)
 {
-	if (l == INTERP_OFF) {
-		x->snd_interp = INTERP_OFF;
+	if (l == INTERP_SINC && !x->snd_sinc) {
+		x->snd_sinc = nw_sinc_get(NW_SINC_PHASES);
+		if (!x->snd_sinc) {
+			object_error((t_object*)x, "out of memory for the sinc table");
+			return;
+		}
+	}
+	
+	if (l >= INTERP_OFF && l <= INTERP_SINC) {
+		x->snd_interp = (short)l;
+		grainpulse_publishKernels(x);
 		#ifdef DEBUG
-			object_post((t_object*)x, "sndInterp is set to off");
+			object_post((t_object*)x, "sndInterp is set to %ld", l);
 		#endif // DEBUG //
-	} else if (l == INTERP_ON) {
-		x->snd_interp = INTERP_ON;
+	} else {
+		object_error((t_object*)x, "sndInterp message was not understood");
+	}
+}
+
+/********************************************************************************
+void grainpulse_sincTable(t_grainpulse *x, long l)
+
+inputs:			x		-- pointer to our object
+				l		-- phases per frame
+description:	method called when "sincTable" message is received; sets the
+		size of the table read by sndInterp 4, rounded to a power of two
+		between 16 and 4096; larger tables read between frames more finely;
+		default is 256; grains begun afterwards use it
+returns:		nothing
+********************************************************************************/
+void grainpulse_sincTable(t_grainpulse *x, long l)
+{
+	const t_nw_sinc *sinc;
+	
+	if (l < 1) {
+		object_error((t_object*)x, "sincTable message was not understood");
+		return;
+	}
+	
+	sinc = nw_sinc_get(l);
+	if (!sinc) {
+		object_error((t_object*)x, "out of memory for the sinc table");
+		return;
+	}
+	x->snd_sinc = sinc;
+	#ifdef DEBUG
+		object_post((t_object*)x, "sincTable is set to %ld phases", sinc->phases);
+	#endif // DEBUG //
+}
+
+/********************************************************************************
+void grainpulse_pyramid(t_grainpulse *x, long l)
+
+inputs:			x		-- pointer to our object
+				l		-- flag value
+description:	method called when "pyramid" message is received; 1 keeps
+		copies of the sound buffer decimated by octaves, built in the
+		background each time the buffer~ changes, and grains pitched up by
+		more than 2 read the copy that brings their step to 2 or below, which
+		reads less memory and aliases less; 0 = off; default is off
+returns:		nothing
+********************************************************************************/
+void grainpulse_pyramid(t_grainpulse *x, long l)
+{
+	if (l == 0 || l == 1) {
+		x->pyramid = (short)l;
 		#ifdef DEBUG
-			object_post((t_object*)x, "sndInterp is set to on");
+			object_post((t_object*)x, "pyramid is set to %ld", l);
 		#endif // DEBUG //
 	} else {
-		object_error((t_object*)x, "sndInterp message was not understood");
+		object_error((t_object*)x, "pyramid message was not understood");
 	}
 }
 
@@ -876,21 +1447,17 @@ void grainpulse_winInterp(t_grainpulse *x, long l)
 inputs:			x		-- pointer to our object
 				l		-- flag value
 description:	method called when "winInterp" message is received; allows user 
-		to define whether interpolation is used in pulling values from the window
-		buffer; default is off
+		to choose the interpolation used in pulling values from the window
+		buffer; 0 = off, 1 = linear, 2 = hermite, 3 = lagrange; default is linear
 returns:		nothing
 ********************************************************************************/
 void grainpulse_winInterp(t_grainpulse *x, long l)
 {
-	if (l == INTERP_OFF) {
-		x->win_interp = INTERP_OFF;
+	if (l >= INTERP_OFF && l <= INTERP_LAGRANGE) {
+		x->win_interp = (short)l;
+		grainpulse_publishKernels(x);
 		#ifdef DEBUG
-			object_post((t_object*)x, "winInterp is set to off");
-		#endif // DEBUG //
-	} else if (l == INTERP_ON) {
-		x->win_interp = INTERP_ON;
-		#ifdef DEBUG
-			object_post((t_object*)x, "winInterp is set to on");
+			object_post((t_object*)x, "winInterp is set to %ld", l);
 		#endif // DEBUG //
 	} else {
 		object_error((t_object*)x, "winInterp was not understood");
@@ -924,6 +1491,34 @@ void grainpulse_reverse(t_grainpulse *x, long l)
 	
 }
 
+/********************************************************************************
+t_max_err grainpulse_voices_set(t_grainpulse *x, void *attr, long argc, t_atom *argv)
+
+inputs:			x		-- pointer to our object
+				attr	-- the attribute being set
+				argc	-- number of values
+				argv	-- new number of voices
+description:	setter for the "voices" attribute; defines how many grains may
+		sound at once; voices beyond a lowered count are left to finish
+returns:		MAX_ERR_NONE
+********************************************************************************/
+t_max_err grainpulse_voices_set(t_grainpulse *x, void *attr, long argc, t_atom *argv)
+{
+	long l;
+	
+	if (argc && argv) {
+		l = (long)atom_getlong(argv);
+		if (l < VOICES_MIN) l = VOICES_MIN;
+		if (l > VOICES_MAX) l = VOICES_MAX;
+		x->voice_count = l;
+		
+		#ifdef DEBUG
+			object_post((t_object*)x, "voices set to %ld", x->voice_count);
+		#endif // DEBUG //
+	}
+	return MAX_ERR_NONE;
+}
+
 /********************************************************************************
 void grainpulse_assist(t_grainpulse *x, t_object *b, long msg, long arg, char *s)
 
@@ -993,34 +1588,3 @@ void grainpulse_getinfo(t_grainpulse *x)
 	object_post((t_object*)x, "Last updated on %s - www.nathanwolek.com", __DATE__);
 }
 
-
-/********************************************************************************
-double mcLinearInterp(float *in_array, long index_i, double index_frac, 
-		long in_size, short in_chans)
-
-inputs:			*in_array -- name of array of input values
-				index_i -- index value of sample, specific channel within interleaved frame
-				index_frac -- fractional portion of index value for interp
-				in_size -- size of input buffer to perform wrapping
-				in_chans -- number of channels in input buffer
-description:	performs linear interpolation on an input array and to return 
-	value of a fractional sample location
-returns:		interpolated output
-********************************************************************************/
-double mcLinearInterp(float *in_array, long index_i, double index_frac, long in_size, short in_chans)
-{
-	double out, sample1, sample2;
-	long index_iP1 = index_i + in_chans;		// corresponding sample in next frame
-	
-	// make sure that index_iP1 is not out of range
-	while (index_iP1 >= in_size * in_chans) index_iP1 -= in_size;
-	
-	// get samples
-	sample1 = (double)in_array[index_i];
-	sample2 = (double)in_array[index_iP1];
-	
-	//linear interp formula
-	out = sample1 + index_frac * (sample2 - sample1);
-	
-	return out;
-}
\ No newline at end of file
@@ -4,6 +4,7 @@
 ** MSP object
 ** sends out a continuous stream of grains 
 ** 2001/03/29 started by Nathan Wolek
+** 2026/10/17 multichannel patch cords, one stream per channel
 **
 ** Copyright © 2002,2015 by Nathan Wolek
 ** License: http://opensource.org/licenses/BSD-3-Clause
@@ -11,6 +12,12 @@
 */
 
 #include "c74_msp.h"
+#include <atomic>
+#include "nw_bufswap.h"
+#include "nw_interp.h"
+#include "nw_pyramid.h"
+#include "nw_simd.h"
+#include "nw_window.h"
 
 using namespace c74::max;
 
@@ -27,41 +34,85 @@ using namespace c74::max;
 #define REVERSE_GRAINS		1
 
 /* for interpolation flag */
-#define INTERP_OFF			0
-#define INTERP_ON			1
+#define INTERP_OFF			NW_INTERP_NONE
+#define INTERP_ON			NW_INTERP_LINEAR
+#define INTERP_HERMITE		NW_INTERP_HERMITE
+#define INTERP_LAGRANGE		NW_INTERP_LAGRANGE
+#define INTERP_SINC			NW_INTERP_SINC
+
+/* for multichannel patch cords */
+#define NUM_INLETS			4
+#define NUM_OUTLETS			3
+#define CHANS_MAX			1024		// widest multichannel cord followed
 
 static t_class *grainstream_class;		// required global pointing to this class
 
+/* the scalar kernels for one pair of interpolation modes, see grainstream_kernelScalar() */
+struct _grainstream_kernels;
+
+typedef struct _grainstream_chan	// one stream of grains
+{
+	// current grain info
+	double grain_freq;		// in hertz
+	double grain_pos_start;	// in samples
+	double grain_pitch;		// as multiplier
+	double grain_gain;		// linear gain mult
+	double grain_length;	// in milliseconds
+	double grain_sound_length;	// in milliseconds
+	double win_step_size;	// in samples
+	double snd_step_size;	// in samples
+	double snd_step_unit;	// snd_step_size at a pitch of 1
+	double curr_win_pos;	// in samples
+	double curr_snd_pos;	// in samples
+	double win_last_index;
+	short grain_direction;	// forward or reverse
+	short snd_wraps;		// grain reads near the ends of the sound buffer
+	const t_nw_sinc_filter *snd_sinc;	// filter for the sinc kernel, see nw_sinc.h
+	// decimated sound, see nw_pyramid.h; positions and step are in its frames
+	const float *snd_tab;
+	long snd_tab_frames;
+	long snd_level;
+	long curr_count_samp;
+} t_grainstream_chan;
+
 typedef struct _grainstream
 {
 	t_pxobject x_obj;				// <--
 	// sound buffer info
     t_symbol *snd_sym;
-    t_buffer_ref *snd_buf_ptr;
-    t_buffer_ref *next_snd_buf_ptr;
+	t_buffer_ref *snd_ref;					// last buffer~ linked, main thread only
+	NwBufSwap snd_swap;						// hands snd_ref to the perform routine
+	t_nw_bufinfo snd_buf;					// buffer~ being played, perform only
 	//double snd_last_out;
 	//long snd_buf_length;	//removed 2002.07.11
 	short snd_interp;
+	const t_nw_sinc *snd_sinc;			// sinc tables, once sndInterp 4 or sincTable asks
+	NwPyramid snd_pyramid;				// sound decimated by octaves, for grains pitched up
+	t_qelem *pyramid_qelem;				// builds levels asked for by the perform routine
+	short pyramid;						// "pyramid" message
 	// window buffer info
     t_symbol *win_sym;
-    t_buffer_ref *win_buf_ptr;
-    t_buffer_ref *next_win_buf_ptr;
+	t_buffer_ref *win_ref;					// last buffer~ linked, main thread only
+	NwBufSwap win_swap;						// hands win_ref to the perform routine
+	t_nw_bufinfo win_buf;					// buffer~ being played, perform only
 	//double win_last_out;
-	double win_last_index;
 	//long win_buf_length;	//removed 2002.07.11
 	short win_interp;
-	// current grain info
-	double grain_freq;		// in hertz
-	double grain_pos_start;	// in samples
-    double grain_pitch;		// as multiplier
-    double grain_gain;		// linear gain mult
-	double grain_length;	// in milliseconds
-	double grain_sound_length;	// in milliseconds
-	double win_step_size;	// in samples
-	double snd_step_size;	// in samples
-	double curr_win_pos;	// in samples
-	double curr_snd_pos;	// in samples
-	short grain_direction;	// forward or reverse
+	long win_buf_frames;					// window length in use, cached at vector start
+	t_nw_window window;						// analytic shape, or NW_WINDOW_BUFFER
+	t_nw_window next_window;				// last shape given to the window message, main thread only
+	NwSwap<t_nw_window> window_swap;		// hands next_window to the perform routine
+	std::atomic<const struct _grainstream_kernels *> next_kernels;	// for snd_interp and win_interp
+	// one stream per channel of the inputs; a stream is allocated once and
+	// kept until the object is freed, so a chain still running never sees
+	// one move
+	t_grainstream_chan *chans[CHANS_MAX];
+	std::atomic<long> chan_alloc;			// streams in chans, published after them
+	long out_chans;							// channels in each outlet
+	long in_chans[NUM_INLETS];				// channels in each inlet
+	// inlets as the perform routine sees them, set only by dsp64
+	long perf_in_chans[NUM_INLETS];
+	long perf_in_offset[NUM_INLETS];	// first of each inlet in the perform ins
 	// defered grain info at control rate
 	double next_grain_freq;			// in hertz
 	double next_grain_pos_start;	// in milliseconds
@@ -73,28 +124,101 @@ typedef struct _grainstream
 	short grain_pos_start_connected;		// <--
 	short grain_pitch_connected;			// <--
     short grain_gain_connected;
-    long curr_count_samp;
+	long modulate;							// "modulate" attribute
+	short modulate_gain;					// gain read every sample, chosen by dsp64
+	short modulate_pitch;					// pitch read every sample, chosen by dsp64
 	double output_sr;						// <--
 	double output_1oversr;					// <--
+	short simd;								// use vector kernels when available
 } t_grainstream;
 
-void *grainstream_new(t_symbol *snd, t_symbol *win);
+typedef struct _grainstream_run		// one grain between window wraps
+{
+	const float *tab_s;
+	const float *tab_w;
+	long size_s;
+	long chan_s;
+	long size_w;
+	const t_nw_window *window;	// analytic shape, or NULL to read tab_w
+	double index_w;		// window position of first sample
+	double w_step;		// in samples
+	double index_s;		// sound position before first sample
+	double s_step;		// in samples, negative if reverse
+	double gain;		// linear gain mult
+	long count;			// sample count before first sample
+	short wraps_s;
+	const t_nw_sinc_filter *sinc_s;
+} t_grainstream_run;
+
+typedef void (*t_grainstream_kernel)(t_grainstream_run *r, double *out1, double *out2, double *out_count, long len);
+
+typedef struct _grainstream_kernels
+{
+	t_grainstream_kernel scalar[2];		// mono or stereo
+	short interp_s;
+	short interp_w;
+} t_grainstream_kernels;
+
+void *grainstream_new(t_symbol *s, long argc, t_atom *argv);
+void grainstream_free(t_grainstream *x);
 void grainstream_perform64zero(t_grainstream *x, t_object *dsp64, double **ins, long numins, double **outs,long numouts, long vectorsize, long flags, void *userparam);
+template <bool ModGain, bool ModPitch>
 void grainstream_perform64(t_grainstream *x, t_object *dsp64, double **ins, long numins, double **outs,long numouts, long vectorsize, long flags, void *userparam);
-void grainstream_initGrain(t_grainstream *x, float in_pos_start, float in_pitch_mult, float in_length, float in_gain_mult);
+template <bool ModGain, bool ModPitch>
+void grainstream_renderChannel(t_grainstream *x, t_grainstream_chan *ch, double **ins, double **outs,
+		long vectorsize, const float *tab_s, long size_s, long chan_s, const float *tab_w, long size_w,
+		const t_grainstream_kernels *kernels);
+long grainstream_runLength(double pos, double step, double limit, long max);
+template <int InterpS, int InterpW, int Chans>
+void grainstream_kernelScalar(t_grainstream_run *r, double *out1, double *out2, double *out_count, long len);
+template <int InterpS, int InterpW, int Chans, class Wrap, short Family>
+void grainstream_runScalar(t_grainstream_run *r, double *out1, double *out2, double *out_count, long len);
+template <int InterpS, int InterpW, int Chans, short Family>
+void grainstream_wrapScalar(t_grainstream_run *r, double *out1, double *out2, double *out_count, long len);
+void grainstream_kernelSSE2(t_grainstream_run *r, double *out1, double *out2, double *out_count, long len);
+NW_TARGET_AVX2 void grainstream_kernelAVX2(t_grainstream_run *r, double *out1, double *out2, double *out_count, long len);
+void grainstream_kernelTail(t_grainstream_run *r, double *out1, double *out2, double *out_count, long from, long len);
+void grainstream_initGrain(t_grainstream *x, t_grainstream_chan *ch, float in_freq, float in_pos_start,
+		float in_pitch_mult, float in_gain_mult);
+void grainstream_updateBuffers(t_grainstream *x);
+void grainstream_publishKernels(t_grainstream *x);
+void grainstream_soundChanged(t_grainstream *x);
+void grainstream_dropLevels(t_grainstream *x);
+void grainstream_buildPyramid(t_grainstream *x);
 void grainstream_dsp64(t_grainstream *x, t_object *dsp64, short *count, double samplerate, long maxvectorsize, long flags);
+long grainstream_inputchanged(t_grainstream *x, long index, long count);
+long grainstream_multichanneloutputs(t_grainstream *x, long index);
+bool grainstream_resizeChans(t_grainstream *x, long count);
+void grainstream_initChan(t_grainstream *x, t_grainstream_chan *ch);
 void grainstream_setsnd(t_grainstream *x, t_symbol *s);
 void grainstream_setwin(t_grainstream *x, t_symbol *s);
+void grainstream_window(t_grainstream *x, t_symbol *s, long argc, t_atom *argv);
 void grainstream_float(t_grainstream *x, double f);
 void grainstream_int(t_grainstream *x, long l);
 void grainstream_sndInterp(t_grainstream *x, long l);
+void grainstream_sincTable(t_grainstream *x, long l);
+void grainstream_pyramid(t_grainstream *x, long l);
 void grainstream_winInterp(t_grainstream *x, long l);
 void grainstream_reverse(t_grainstream *x, long l);
+void grainstream_simd(t_grainstream *x, long l);
 void grainstream_assist(t_grainstream *x, t_object *b, long msg, long arg, char *s);
 void grainstream_getinfo(t_grainstream *x);
-double mcLinearInterp(float *in_array, long index_i, double index_frac, long in_size, short in_chans);
+
+/* every scalar kernel, by sound then window interpolation mode */
+#define GRAINSTREAM_KERNELS(s, w)	{ { grainstream_kernelScalar<s, w, 1>, grainstream_kernelScalar<s, w, 2> }, s, w }
+#define GRAINSTREAM_KERNELS_W(s)	{ GRAINSTREAM_KERNELS(s, INTERP_OFF), GRAINSTREAM_KERNELS(s, INTERP_ON), \
+	GRAINSTREAM_KERNELS(s, INTERP_HERMITE), GRAINSTREAM_KERNELS(s, INTERP_LAGRANGE) }
+
+static const t_grainstream_kernels grainstream_kernels[INTERP_SINC + 1][INTERP_LAGRANGE + 1] = {
+	GRAINSTREAM_KERNELS_W(INTERP_OFF),
+	GRAINSTREAM_KERNELS_W(INTERP_ON),
+	GRAINSTREAM_KERNELS_W(INTERP_HERMITE),
+	GRAINSTREAM_KERNELS_W(INTERP_LAGRANGE),
+	GRAINSTREAM_KERNELS_W(INTERP_SINC)
+};
 
 t_symbol *ps_buffer;
+t_grainstream_kernel grainstream_simd_kernel;	// fastest kernel for this processor, or NULL
 
 /********************************************************************************
 int main(void)
@@ -108,16 +232,24 @@ int C74_EXPORT main(void)
 {
     t_class *c;
     
-    c = class_new(OBJECT_NAME, (method)grainstream_new, (method)dsp_free,
-                  (short)sizeof(t_grainstream), 0L, A_SYM, A_SYM, 0);
+    c = class_new(OBJECT_NAME, (method)grainstream_new, (method)grainstream_free,
+                  (long)sizeof(t_grainstream), 0L, A_GIMME, 0);
     class_dspinit(c); // add standard functions to class
 	
+	/* gain and pitch read from their inlets every sample of a grain */
+	CLASS_ATTR_LONG(c, "modulate", 0, t_grainstream, modulate);
+	CLASS_ATTR_FILTER_CLIP(c, "modulate", 0, 1);
+	CLASS_ATTR_LABEL(c, "modulate", 0, "Modulate Gain and Pitch");
+	
 	/* bind method "grainstream_setsnd" to the 'setSound' message */
 	class_addmethod(c, (method)grainstream_setsnd, "setSound", A_SYM, 0);
 	
 	/* bind method "grainstream_setwin" to the 'setWin' message */
 	class_addmethod(c, (method)grainstream_setwin, "setWin", A_SYM, 0);
 	
+	/* bind method "grainstream_window" to the 'window' message */
+	class_addmethod(c, (method)grainstream_window, "window", A_GIMME, 0);
+	
 	/* bind method "grainstream_float" to incoming floats */
 	class_addmethod(c, (method)grainstream_float, "float", A_FLOAT, 0);
 	
@@ -130,9 +262,18 @@ int C74_EXPORT main(void)
 	/* bind method "grainstream_sndInterp" to the sndInterp message */
 	class_addmethod(c, (method)grainstream_sndInterp, "sndInterp", A_LONG, 0);
 	
+	/* bind method "grainstream_sincTable" to the sincTable message */
+	class_addmethod(c, (method)grainstream_sincTable, "sincTable", A_LONG, 0);
+	
+	/* bind method "grainstream_pyramid" to the pyramid message */
+	class_addmethod(c, (method)grainstream_pyramid, "pyramid", A_LONG, 0);
+	
 	/* bind method "grainstream_winInterp" to the winInterp message */
 	class_addmethod(c, (method)grainstream_winInterp, "winInterp", A_LONG, 0);
 	
+	/* bind method "grainstream_simd" to the simd message */
+	class_addmethod(c, (method)grainstream_simd, "simd", A_LONG, 0);
+	
 	/* bind method "grainstream_assist" to the assistance message */
 	class_addmethod(c, (method)grainstream_assist, "assist", A_CANT, 0);
 	
@@ -142,12 +283,25 @@ int C74_EXPORT main(void)
     /* bind method "grainstream_dsp64" to the dsp64 message */
     class_addmethod(c, (method)grainstream_dsp64, "dsp64", A_CANT, 0);
     
+    /* bind methods for multichannel patch cords */
+    class_addmethod(c, (method)grainstream_inputchanged, "inputchanged", A_CANT, 0);
+    class_addmethod(c, (method)grainstream_multichanneloutputs, "multichanneloutputs", A_CANT, 0);
+    
     class_register(CLASS_BOX, c); // register the class w max
     grainstream_class = c;
 	
 	/* needed for 'buffer~' work, checks for validity of buffer specified */
 	ps_buffer = gensym("buffer~");
 	
+	/* choose the vector kernel this processor supports */
+	grainstream_simd_kernel = NULL;
+#if NW_SIMD_X86
+	if (nw_cpu_has_avx2())
+		grainstream_simd_kernel = grainstream_kernelAVX2;
+	else if (nw_cpu_has_sse2())
+		grainstream_simd_kernel = grainstream_kernelSSE2;
+#endif
+	
     #ifdef DEBUG
     
     #endif /* DEBUG */
@@ -156,49 +310,202 @@ int C74_EXPORT main(void)
 }
 
 /********************************************************************************
-void *grainstream_new(double initial_pos)
+void *grainstream_new(t_symbol *s, long argc, t_atom *argv)
 
-inputs:			*snd		-- name of buffer holding sound
-				*win		-- name of buffer holding window
+inputs:			s			-- name of the object
+				argc, argv	-- name of buffer holding sound, name of buffer
+					holding window, then attributes (@modulate)
 description:	called for each new instance of object in the MAX environment;
 		defines inlets and outlets; sets variables and buffers
 returns:		nothing
 ********************************************************************************/
-void *grainstream_new(t_symbol *snd, t_symbol *win)
+void *grainstream_new(t_symbol *s, long argc, t_atom *argv)
 {
 	t_grainstream *x = (t_grainstream *) object_alloc((t_class*) grainstream_class);
-	dsp_setup((t_pxobject *)x, 4);					// four inlets
+	long attrstart = attr_args_offset((short)argc, argv);
+	t_symbol *snd = attrstart > 0 ? atom_getsym(argv) : gensym("");
+	t_symbol *win = attrstart > 1 ? atom_getsym(argv + 1) : gensym("");
+	long i;
+	
+	dsp_setup((t_pxobject *)x, NUM_INLETS);			// four inlets
     outlet_new((t_pxobject *)x, "signal");          // sample count outlet
     outlet_new((t_pxobject *)x, "signal");			// signal ch2 outlet
     outlet_new((t_pxobject *)x, "signal");			// signal ch1 outlet
+	x->pyramid_qelem = qelem_new(x, (method)grainstream_buildPyramid);
 	
 	/* set buffer names */
 	x->snd_sym = snd;
 	x->win_sym = win;
 	
 	/* zero pointers */
-	x->snd_buf_ptr = x->next_snd_buf_ptr = NULL;
-	x->win_buf_ptr = x->next_win_buf_ptr = NULL;
+	x->snd_ref = x->win_ref = NULL;
+	x->snd_swap.init();
+	x->win_swap.init();
+	nw_bufinfo_set(&x->snd_buf, NULL, 0, 0, 0.0, 0);
+	nw_bufinfo_set(&x->win_buf, NULL, 0, 0, 0.0, 0);
+	x->win_buf_frames = 0;
+	x->snd_pyramid.init();
+	nw_window_set(&x->window, "buffer", false, 0.);
+	x->next_window = x->window;
+	x->window_swap.init();
 	
 	/* setup variables */
-	x->grain_freq = x->next_grain_freq = 20.0;
-	x->grain_pos_start = x->next_grain_pos_start = 0.0;
-    x->grain_pitch = x->next_grain_pitch = 1.0;
-    x->grain_gain = x->next_grain_gain = 1.0;
-	x->win_step_size = x->snd_step_size = 0.0;
-	x->curr_win_pos = x->curr_snd_pos = 0.0;
+	x->next_grain_freq = 20.0;
+	x->next_grain_pos_start = 0.0;
+    x->next_grain_pitch = 1.0;
+    x->next_grain_gain = 1.0;
 	
 	/* set flags to defaults */
 	x->snd_interp = INTERP_ON;
+	x->snd_sinc = NULL;
+	x->pyramid = false;
 	x->win_interp = INTERP_ON;
-	x->grain_direction = x->next_grain_direction = FORWARD_GRAINS;
+	x->next_grain_direction = FORWARD_GRAINS;
+	grainstream_publishKernels(x);
+	x->modulate = false;
+	x->modulate_gain = x->modulate_pitch = false;
+	x->simd = true;
 	
-	x->x_obj.z_misc = Z_NO_INPLACE;
+	/* one stream until a multichannel cord is connected */
+	x->chan_alloc.store(0, std::memory_order_relaxed);
+	if (!grainstream_resizeChans(x, 1)) {
+		object_error((t_object*)x, "could not allocate grain streams");
+		object_free(x);
+		return NULL;
+	}
+	x->out_chans = 1;
+	for (i = 0; i < NUM_INLETS; i++) {
+		x->in_chans[i] = 1;
+		x->perf_in_chans[i] = 1;
+		x->perf_in_offset[i] = i;
+	}
+	
+	x->x_obj.z_misc = Z_NO_INPLACE | Z_MC_INLETS;
+	
+	/* process attributes, like @modulate */
+	attr_args_process(x, (short)argc, argv);
 	
 	/* return a pointer to the new object */
 	return (x);
 }
 
+/********************************************************************************
+void grainstream_free(t_grainstream *x)
+
+inputs:			x		-- pointer to this object
+description:	called when the object is deleted; frees the streams and the
+		pyramid
+returns:		nothing
+********************************************************************************/
+void grainstream_free(t_grainstream *x)
+{
+	long i;
+	
+	dsp_free((t_pxobject *)x);
+	
+	qelem_free(x->pyramid_qelem);
+	x->snd_pyramid.free();
+	
+	for (i = x->chan_alloc.load(std::memory_order_relaxed) - 1; i >= 0; i--)
+		sysmem_freeptr(x->chans[i]);
+}
+
+/********************************************************************************
+bool grainstream_resizeChans(t_grainstream *x, long count)
+
+inputs:			x		-- pointer to this object
+				count	-- number of channels to render
+description:	allocates streams until there are at least count channels;
+		streams are only ever added, each one published with a release after
+		it is set up, so a perform routine running meanwhile keeps rendering
+		the streams it already had
+returns:		false if count is past CHANS_MAX or the memory could not be
+		allocated; the channels that could be are kept
+********************************************************************************/
+bool grainstream_resizeChans(t_grainstream *x, long count)
+{
+	t_grainstream_chan *ch;
+	long alloc = x->chan_alloc.load(std::memory_order_relaxed);
+	
+	for (; alloc < count && alloc < CHANS_MAX; alloc++) {
+		ch = (t_grainstream_chan *)sysmem_newptrclear((long)sizeof(t_grainstream_chan));
+		if (!ch)
+			return false;
+		
+		grainstream_initChan(x, ch);
+		x->chans[alloc] = ch;
+		x->chan_alloc.store(alloc + 1, std::memory_order_release);
+	}
+	return (count <= CHANS_MAX);
+}
+
+/********************************************************************************
+void grainstream_initChan(t_grainstream *x, t_grainstream_chan *ch)
+
+inputs:			x		-- pointer to this object
+				ch		-- channel to set up
+description:	starts a channel so that its first sample begins a grain
+returns:		nothing
+********************************************************************************/
+void grainstream_initChan(t_grainstream *x, t_grainstream_chan *ch)
+{
+	ch->grain_freq = x->next_grain_freq;
+	ch->grain_pos_start = x->next_grain_pos_start;
+	ch->grain_pitch = x->next_grain_pitch;
+	ch->grain_gain = x->next_grain_gain;
+	ch->win_step_size = ch->snd_step_size = 0.0;
+	ch->snd_step_unit = 0.0;
+	ch->curr_win_pos = ch->curr_snd_pos = 0.0;
+	ch->win_last_index = HUGE_VAL;		// any window position is a wrap
+	ch->grain_direction = x->next_grain_direction;
+	ch->snd_wraps = true;
+	ch->snd_sinc = NULL;
+	ch->snd_tab = NULL;
+	ch->snd_level = 0;
+	ch->curr_count_samp = -1;
+}
+
+/********************************************************************************
+long grainstream_inputchanged(t_grainstream *x, long index, long count)
+
+inputs:			x		-- pointer to this object
+				index	-- inlet whose channel count changed
+				count	-- channels now connected to it
+description:	called when a multichannel cord changes; the outlets carry as
+		many channels as the widest inlet, and narrower inlets repeat theirs
+returns:		true if the number of output channels changed
+********************************************************************************/
+long grainstream_inputchanged(t_grainstream *x, long index, long count)
+{
+	long i, widest = 1;
+	
+	if (index >= 0 && index < NUM_INLETS)
+		x->in_chans[index] = (count > 0) ? count : 1;
+	
+	for (i = 0; i < NUM_INLETS; i++)
+		if (x->in_chans[i] > widest)
+			widest = x->in_chans[i];
+	
+	if (widest == x->out_chans)
+		return false;
+	
+	x->out_chans = widest;
+	return true;
+}
+
+/********************************************************************************
+long grainstream_multichanneloutputs(t_grainstream *x, long index)
+
+inputs:			x		-- pointer to this object
+				index	-- outlet
+description:	reports the channels of every outlet to a multichannel cord
+returns:		number of channels
+********************************************************************************/
+long grainstream_multichanneloutputs(t_grainstream *x, long index)
+{
+	return x->out_chans;
+}
+
 
 /********************************************************************************
  void grainstream_dsp64()
@@ -220,9 +527,28 @@ void grainstream_dsp64(t_grainstream *x, t_object *dsp64, short *count, double s
         object_post((t_object*)x, "adding 64 bit perform method");
     #endif /* DEBUG */
     
+    long i, chans, offset;
+    t_perfroutine64 perform;
+    
     // set buffers
     grainstream_setsnd(x, x->snd_sym);
-    grainstream_setwin(x, x->win_sym);
+    if (x->next_window.type == NW_WINDOW_BUFFER)
+        grainstream_setwin(x, x->win_sym);
+    
+    // find where each inlet starts among the perform inputs
+    offset = 0;
+    for (i = 0; i < NUM_INLETS; i++) {
+        chans = (long)object_method(dsp64, gensym("getnuminputchannels"), x, i);
+        x->in_chans[i] = (chans > 0) ? chans : 1;
+        x->perf_in_chans[i] = x->in_chans[i];
+        x->perf_in_offset[i] = offset;
+        offset += x->in_chans[i];
+    }
+    
+    // every output channel has its own stream
+    if (!grainstream_resizeChans(x, x->out_chans)) {
+        object_error((t_object*)x, "could not allocate grain streams for %ld channels", x->out_chans);
+    }
     
     // test inlets for signal connections
     x->grain_freq_connected = count[0];
@@ -230,6 +556,10 @@ void grainstream_dsp64(t_grainstream *x, t_object *dsp64, short *count, double s
     x->grain_pitch_connected = count[2];
     x->grain_gain_connected = count[3];
     
+    // grains only follow inlets that are connected
+    x->modulate_gain = x->modulate && x->grain_gain_connected;
+    x->modulate_pitch = x->modulate && x->grain_pitch_connected;
+    
     x->output_sr = samplerate;
     x->output_1oversr = 1.0 / x->output_sr;
     
@@ -238,7 +568,17 @@ void grainstream_dsp64(t_grainstream *x, t_object *dsp64, short *count, double s
         #ifdef DEBUG
             object_post((t_object*)x, "output is being computed");
         #endif /* DEBUG */
-        dsp_add64(dsp64, (t_object*)x, (t_perfroutine64)grainstream_perform64, 0, NULL);
+        // reading inlets every sample has a routine of its own, so the
+        // default one costs nothing extra
+        if (x->modulate_gain && x->modulate_pitch)
+            perform = (t_perfroutine64)grainstream_perform64<true, true>;
+        else if (x->modulate_gain)
+            perform = (t_perfroutine64)grainstream_perform64<true, false>;
+        else if (x->modulate_pitch)
+            perform = (t_perfroutine64)grainstream_perform64<false, true>;
+        else
+            perform = (t_perfroutine64)grainstream_perform64<false, false>;
+        dsp_add64(dsp64, (t_object*)x, perform, 0, NULL);
     } else {
         #ifdef DEBUG
             object_post((t_object*)x, "no output computed");
@@ -285,72 +625,189 @@ void grainstream_perform64zero(t_grainstream *x, t_object *dsp64, double **ins,
  vectorsize --
  flags   --
  userparam  --
- description:	called at interrupt level to compute object's output at 64-bit
+ description:	called at interrupt level to compute object's output at 64-bit;
+        every channel of a multichannel cord is rendered here, sharing one lock
+        of each buffer; ModGain and ModPitch are passed on to renderChannel
  returns:		nothing
  ********************************************************************************/
+template <bool ModGain, bool ModPitch>
 void grainstream_perform64(t_grainstream *x, t_object *dsp64, double **ins, long numins, double **outs,
                           long numouts, long vectorsize, long flags, void *userparam)
 {
-    // local vars outlets and inlets
-    double *in_freq = ins[0];
-    double *in_sound_start = ins[1];
-    double *in_sample_increment = ins[2];
-    double *in_gain = ins[3];
-    double *out_signal = outs[0];
-    double *out_signal2 = outs[1];
-    double *out_sample_count = outs[2];
-    
     // local vars for snd and win buffer
     t_buffer_obj *snd_object, *win_object;
+    t_buffer_info b_info;
     float *tab_s, *tab_w;
-    double snd_out, snd_out2, win_out;
     long size_s, chan_s, size_w;
     
-    // local vars for object vars and while loop
-    double index_s, index_w, temp_index_frac;
-    long n, count_samp, temp_index_int, temp_index_int_times_chan;
-    double s_step_size, w_step_size, w_last_index, g_gain;
-    short interp_s, interp_w, g_direction;
+    // local vars for channels
+    double *chan_ins[NUM_INLETS];
+    double *chan_outs[NUM_OUTLETS];
+    long chan_alloc = x->chan_alloc.load(std::memory_order_acquire);	// channels with streams
+    long out_chans = numouts / NUM_OUTLETS;	// the outlets as this chain was built
+    long c, i, n;
+    
+    // kernels for the modes last published
+    const t_grainstream_kernels *kernels = x->next_kernels.load(std::memory_order_acquire);
     
     // check to make sure buffers are loaded with proper file types
     if (x->x_obj.z_disabled)		// and object is enabled
         goto out;
-    if (x->snd_buf_ptr == NULL || (x->win_buf_ptr == NULL))
+    
+    // buffers only change at vector boundaries, so every grain shares one lock
+    grainstream_updateBuffers(x);
+    
+    if (x->snd_buf.ref == NULL || (x->window.type == NW_WINDOW_BUFFER && x->win_buf.ref == NULL))
         goto zero;
     
-    // get sound buffer info
-    snd_object = buffer_ref_getobject(x->snd_buf_ptr);
+    // get sound buffer info; values cached when it was linked are read again
+    // only if the buffer~ has been changed since
+    snd_object = buffer_ref_getobject((t_buffer_ref *)x->snd_buf.ref);
     tab_s = buffer_locksamples(snd_object);
     if (!tab_s)		// buffer samples were not accessible
         goto zero;
-    size_s = buffer_getframecount(snd_object);
-    chan_s = buffer_getchannelcount(snd_object);
+    buffer_getinfo(snd_object, &b_info);
+    if (b_info.b_modtime != x->snd_buf.modtime) {
+        nw_bufinfo_set(&x->snd_buf, x->snd_buf.ref, b_info.b_frames, b_info.b_nchans, b_info.b_sr, b_info.b_modtime);
+        grainstream_soundChanged(x);
+    }
+    size_s = x->snd_buf.frames;
+    chan_s = x->snd_buf.chans;
     
-    // get window buffer info
-    win_object = buffer_ref_getobject(x->win_buf_ptr);
-    tab_w = buffer_locksamples(win_object);
-    if (!tab_w)		// buffer samples were not accessible
-        goto zero;
-    size_w = buffer_getframecount(win_object);
+    // a changed sound retires the pyramid, so sounding grains go back to the buffer~
+    if (x->snd_pyramid.check(x->pyramid ? x->snd_buf.ref : NULL, size_s, chan_s, x->snd_buf.modtime)) {
+        grainstream_dropLevels(x);
+        qelem_set(x->pyramid_qelem);
+    }
+    
+    // get window buffer info, unless an analytic window is playing
+    if (x->window.type == NW_WINDOW_BUFFER) {
+        win_object = buffer_ref_getobject((t_buffer_ref *)x->win_buf.ref);
+        tab_w = buffer_locksamples(win_object);
+        if (!tab_w) {		// buffer samples were not accessible
+            buffer_unlocksamples(snd_object);
+            goto zero;
+        }
+        buffer_getinfo(win_object, &b_info);
+        if (b_info.b_modtime != x->win_buf.modtime)
+            nw_bufinfo_set(&x->win_buf, x->win_buf.ref, b_info.b_frames, b_info.b_nchans, b_info.b_sr, b_info.b_modtime);
+        size_w = x->win_buf.frames;
+    } else {
+        win_object = NULL;
+        tab_w = NULL;
+        size_w = NW_WINDOW_FRAMES;
+    }
+    
+    // cache window length used by grainstream_initGrain
+    x->win_buf_frames = size_w;
+    
+    for (c = 0; c < out_chans; c++) {
+        // outlets are in order, each with every channel
+        for (i = 0; i < NUM_OUTLETS; i++)
+            chan_outs[i] = outs[i * out_chans + c];
+        
+        if (c >= chan_alloc) {		// no stream for this channel
+            for (n = 0; n < vectorsize; n++) {
+                chan_outs[0][n] = chan_outs[1][n] = 0.;
+                chan_outs[2][n] = -1.;
+            }
+            continue;
+        }
+        
+        // inlets with fewer channels repeat them
+        for (i = 0; i < NUM_INLETS; i++)
+            chan_ins[i] = ins[x->perf_in_offset[i] + c % x->perf_in_chans[i]];
+        
+        grainstream_renderChannel<ModGain, ModPitch>(x, x->chans[c], chan_ins, chan_outs, vectorsize,
+            tab_s, size_s, chan_s, tab_w, size_w, kernels);
+    }
+
+    buffer_unlocksamples(snd_object);
+    if (win_object)
+        buffer_unlocksamples(win_object);
+    return;
+
+    // alternate blank output
+zero:
+    for (c = 0; c < out_chans; c++) {
+        for (i = 0; i < NUM_OUTLETS; i++)
+            chan_outs[i] = outs[i * out_chans + c];
+        
+        n = vectorsize;
+        while(n--)
+        {
+            *chan_outs[0]++ = 0.;
+            *chan_outs[1]++ = 0.;
+            *chan_outs[2]++ = -1.;
+        }
+    }
+
+out:
+    return;
+}
+
+/********************************************************************************
+void grainstream_renderChannel(t_grainstream *x, t_grainstream_chan *ch, double **ins,
+		double **outs, long vectorsize, const float *tab_s, long size_s,
+		long chan_s, const float *tab_w, long size_w, const t_grainstream_kernels *kernels)
+
+inputs:			x			-- pointer to this object
+				ch			-- channel to render
+				ins			-- frequency, offset, increment and gain inputs
+				outs		-- ch1, ch2 and sample count outputs
+				vectorsize	-- number of samples
+				tab_s		-- locked sound buffer and its frames and channels
+				tab_w		-- locked window buffer and its frames
+				kernels		-- scalar kernels for the interpolation modes
+description:	renders the grains of one stream; ModGain and ModPitch read gain
+		and pitch every sample, see the modulate attribute, so that each run
+		is one sample long and the vector kernels are left out
+returns:		nothing
+********************************************************************************/
+template <bool ModGain, bool ModPitch>
+void grainstream_renderChannel(t_grainstream *x, t_grainstream_chan *ch, double **ins, double **outs,
+		long vectorsize, const float *tab_s, long size_s, long chan_s, const float *tab_w, long size_w,
+		const t_grainstream_kernels *kernels)
+{
+    // local vars outlets and inlets
+    double *in_freq = ins[0];
+    double *in_sound_start = ins[1];
+    double *in_sample_increment = ins[2];
+    double *in_gain = ins[3];
+    double *out_signal = outs[0];
+    double *out_signal2 = outs[1];
+    double *out_sample_count = outs[2];
+    
+    // local vars for object vars and while loop
+    t_grainstream_run run;
+    t_grainstream_kernel scalar_kernel, simd_kernel;
+    double index_s, index_w;
+    long n, len, head, count_samp;
+    double s_step_size, w_step_size, w_last_index, g_gain;
+    short g_direction, wraps_s;
     
     // get snd and win index info
-    index_s = x->curr_snd_pos;
-    s_step_size = x->snd_step_size;
-    index_w = x->curr_win_pos;
-    w_step_size = x->win_step_size;
+    index_s = ch->curr_snd_pos;
+    s_step_size = ch->snd_step_size;
+    index_w = ch->curr_win_pos;
+    w_step_size = ch->win_step_size;
     
-    // get grain options
-    interp_s = x->snd_interp;
-    interp_w = x->win_interp;
-    g_gain = x->grain_gain;
-    g_direction = x->grain_direction;
+    // get grain options; vector kernels take linear interpolation in both buffers
+    g_gain = ch->grain_gain;
+    g_direction = ch->grain_direction;
+    wraps_s = ch->snd_wraps;
+    scalar_kernel = kernels->scalar[chan_s == 2];
+    simd_kernel = (x->simd && !ModGain && !ModPitch && kernels->interp_s == INTERP_ON
+        && kernels->interp_w == INTERP_ON) ? grainstream_simd_kernel : NULL;
     
     // get history from last vector
-    count_samp = x->curr_count_samp;
-    w_last_index = x->win_last_index;
+    count_samp = ch->curr_count_samp;
+    w_last_index = ch->win_last_index;
     
-    n = vectorsize;
-    while(n--) {
+    // the vector is rendered in runs that end where the window wraps, since
+    // every step size is constant between those points
+    n = 0;
+    while (n < vectorsize) {
         
         // advance window index
         index_w += w_step_size;
@@ -363,281 +820,702 @@ void grainstream_perform64(t_grainstream *x, t_object *dsp64, double **ins, long
         
         if (index_w < w_last_index) {   // if window has wrapped...
             if (index_w < 10.0) {       // and it is beginning...
-                buffer_unlocksamples(snd_object);
-                buffer_unlocksamples(win_object);
-                
-                grainstream_initGrain(x, *in_freq, *in_sound_start, *in_sample_increment, *in_gain);
-                
-                // get snd buffer info
-                snd_object = buffer_ref_getobject(x->snd_buf_ptr);
-                tab_s = buffer_locksamples(snd_object);
-                if (!tab_s)	{	// buffer samples were not accessible
-                    *out_signal = 0.0;
-                    *out_signal2 = 0.0;
-                    *out_sample_count = (double)count_samp;
-                    w_last_index = index_w;
-                    goto advance_pointers;
-                }
-                size_s = buffer_getframecount(snd_object);
-                
-                // get win buffer info
-                win_object = buffer_ref_getobject(x->win_buf_ptr);
-                tab_w = buffer_locksamples(win_object);
-                if (!tab_w)	{	// buffer samples were not accessible
-                    *out_signal = 0.0;
-                    *out_signal2 = 0.0;
-                    *out_sample_count = (double)count_samp;
-                    w_last_index = index_w;
-                    goto advance_pointers;
-                }
-                size_w = buffer_getframecount(win_object);
+                grainstream_initGrain(x, ch, in_freq[n], in_sound_start[n], in_sample_increment[n], in_gain[n]);
                 
                 // get snd and win index info
-                index_s = x->curr_snd_pos;
-                s_step_size = x->snd_step_size;
-                index_w = x->curr_win_pos;
-                w_step_size = x->win_step_size;
+                index_s = ch->curr_snd_pos;
+                s_step_size = ch->snd_step_size;
+                index_w = ch->curr_win_pos;
+                w_step_size = ch->win_step_size;
                 
                 // get grain options
-                interp_s = x->snd_interp;
-                interp_w = x->win_interp;
-                g_gain = x->grain_gain;
-                g_direction = x->grain_direction;
+                g_gain = ch->grain_gain;
+                g_direction = ch->grain_direction;
+                wraps_s = ch->snd_wraps;
                 
                 // get history
-                count_samp = x->curr_count_samp;
+                count_samp = ch->curr_count_samp;
+            } else {
+                // window wrapped without a new grain, so the sound is read
+                // past the span checked by initGrain
+                wraps_s = ch->snd_wraps = true;
             }
         }
         
-        // if we made it here, then we actually start counting
-        ++count_samp;
+        // gain and pitch read every sample end the run at each sample
+        if (ModGain)
+            g_gain = in_gain[n];
+        if (ModPitch)
+            s_step_size = in_sample_increment[n] * ch->snd_step_unit;
         
-        // advance sound index
-        if (g_direction == FORWARD_GRAINS) {
-            index_s += s_step_size;     // addition
-        } else {
-            index_s -= s_step_size;     // subtract
+        // samples left before the window wraps again
+        len = grainstream_runLength(index_w, w_step_size, (double)size_w,
+            (ModGain || ModPitch) ? 1 : vectorsize - n);
+        
+        run.tab_s = ch->snd_tab ? ch->snd_tab : tab_s;
+        run.tab_w = tab_w;
+        run.size_s = ch->snd_tab ? ch->snd_tab_frames : size_s;
+        run.chan_s = chan_s;
+        run.size_w = size_w;
+        run.window = (x->window.type != NW_WINDOW_BUFFER) ? &x->window : NULL;
+        run.index_w = index_w;
+        run.w_step = w_step_size;
+        run.index_s = index_s;
+        run.s_step = (g_direction == FORWARD_GRAINS) ? s_step_size : -s_step_size;
+        run.gain = g_gain;
+        run.count = count_samp;
+        run.wraps_s = wraps_s;
+        run.sinc_s = ch->snd_sinc;
+        
+        // vector kernels read inside both buffers, which leaves out the last
+        // window frame
+        head = 0;
+        if (simd_kernel && !run.window && !wraps_s) {
+            head = grainstream_runLength(index_w, w_step_size, (double)(size_w - 1), len);
+            if (head > 0)
+                simd_kernel(&run, out_signal + n, out_signal2 + n, out_sample_count + n, head);
         }
+        if (head < len)
+            scalar_kernel(&run, out_signal + n + head, out_signal2 + n + head,
+                out_sample_count + n + head, len - head);
+        
+        // update vars for last output
+        index_s = run.index_s;
+        count_samp = run.count;
+        index_w += (len - 1) * w_step_size;
+        w_last_index = index_w;
+        
+        n += len;
+    }
+
+    // update channel history for next vector
+    ch->curr_snd_pos = index_s;
+    ch->curr_win_pos = index_w;
+    ch->curr_count_samp = count_samp;
+    ch->win_last_index = w_last_index;
+}
+
+/********************************************************************************
+long grainstream_runLength(double pos, double step, double limit, long max)
+
+inputs:			pos		-- window position of the first sample
+				step	-- window step size per sample
+				limit	-- first position that ends the run
+				max		-- samples available
+description:	counts the samples from pos, moving by step, that stay below 
+		limit
+returns:		length of the run, 0 to max
+********************************************************************************/
+long grainstream_runLength(double pos, double step, double limit, long max)
+{
+    long k;
+    
+    if (pos >= limit)
+        return 0;
+    if (step <= 0.)
+        return max;
+    
+    k = ((limit - pos) / step < (double)max) ? (long)((limit - pos) / step) : max;
+    
+    // correct rounding so that k is the first sample at or past limit
+    while (k > 0 && pos + (k - 1) * step >= limit)
+        k--;
+    while (k < max && pos + k * step < limit)
+        k++;
+    
+    return k;
+}
+
+/********************************************************************************
+void grainstream_kernelScalar<InterpS, InterpW, Chans>(t_grainstream_run *r,
+		double *out1, double *out2, double *out_count, long len)
+
+inputs:			InterpS		-- NW_INTERP_* mode for the sound buffer
+				InterpW		-- NW_INTERP_* mode for the window buffer
+				Chans		-- 2 for a stereo sound, otherwise 1
+				r			-- run to render, advanced past the rendered samples
+				out1		-- signal ch1 output
+				out2		-- signal ch2 output
+				out_count	-- sample count output
+				len			-- number of samples to render
+description:	renders one grain between window wraps a sample at a time; 
+		instantiated for every interpolation mode, and the reference for the
+		vector kernels; picks the loop for the window source and the wrapping
+		of sound reads once for the run
+returns:		nothing
+********************************************************************************/
+template <int InterpS, int InterpW, int Chans>
+void grainstream_kernelScalar(t_grainstream_run *r, double *out1, double *out2, double *out_count, long len)
+{
+    if (!r->window) {
+        grainstream_wrapScalar<InterpS, InterpW, Chans, 0>(r, out1, out2, out_count, len);
+        return;
+    }
+    switch (r->window->family) {
+        case NW_WINDOW_FAMILY_COSINE:
+            grainstream_wrapScalar<InterpS, INTERP_OFF, Chans, NW_WINDOW_FAMILY_COSINE>(r, out1, out2, out_count, len);
+            break;
+        case NW_WINDOW_FAMILY_GAUSS:
+            grainstream_wrapScalar<InterpS, INTERP_OFF, Chans, NW_WINDOW_FAMILY_GAUSS>(r, out1, out2, out_count, len);
+            break;
+        default:	// NW_WINDOW_FAMILY_RAMP
+            grainstream_wrapScalar<InterpS, INTERP_OFF, Chans, NW_WINDOW_FAMILY_RAMP>(r, out1, out2, out_count, len);
+            break;
+    }
+}
+
+/********************************************************************************
+void grainstream_wrapScalar<InterpS, InterpW, Chans, Family>(
+		t_grainstream_run *r, double *out1, double *out2, double *out_count,
+		long len)
+
+inputs:			Family		-- NW_WINDOW_FAMILY_* of r->window, or 0 to read r->tab_w
+				(remaining inputs as grainstream_kernelScalar)
+description:	picks the loop of grainstream_kernelScalar() for the wrapping
+		of sound reads
+returns:		nothing
+********************************************************************************/
+template <int InterpS, int InterpW, int Chans, short Family>
+void grainstream_wrapScalar(t_grainstream_run *r, double *out1, double *out2, double *out_count, long len)
+{
+    if (r->wraps_s)
+        grainstream_runScalar<InterpS, InterpW, Chans, nw_wrap_loop, Family>(r, out1, out2, out_count, len);
+    else
+        grainstream_runScalar<InterpS, InterpW, Chans, nw_wrap_none, Family>(r, out1, out2, out_count, len);
+}
+
+/********************************************************************************
+void grainstream_runScalar<InterpS, InterpW, Chans, Wrap, Family>(
+		t_grainstream_run *r, double *out1, double *out2, double *out_count,
+		long len)
+
+inputs:			Wrap		-- nw_wrap_loop if r->wraps_s, otherwise nw_wrap_none
+				Family		-- NW_WINDOW_FAMILY_* of r->window, or 0 to read r->tab_w
+				(remaining inputs as grainstream_kernelScalar)
+description:	the loop of grainstream_kernelScalar() for one window source
+		and wrap policy; an analytic window is started afresh for every run, at
+		the place in the grain the run begins
+returns:		nothing
+********************************************************************************/
+template <int InterpS, int InterpW, int Chans, class Wrap, short Family>
+void grainstream_runScalar(t_grainstream_run *r, double *out1, double *out2, double *out_count, long len)
+{
+    double snd_out[2], win_out;
+    double index_s = r->index_s;
+    NwWindowGen gen;
+    long k;
+    
+    if (Family)
+        gen.start(r->window, r->size_w / r->w_step, r->index_w / r->size_w);
+    
+    for (k = 0; k < len; k++) {
+        // advance sound index
+        index_s += r->s_step;
         
         // wrap to make index in bounds
         while (index_s < 0.)
-            index_s += size_s;
-        while (index_s >= size_s)
-            index_s -= size_s;
+            index_s += r->size_s;
+        while (index_s >= r->size_s)
+            index_s -= r->size_s;
         
         // WINDOW OUT
         
-        // compute temporary vars for interpolation
-        temp_index_int = (long)(index_w); // integer portion of index
-        temp_index_frac = index_w - (double)temp_index_int; // fractional portion of index
-        
-        // get value from win buffer samples
-        if (interp_w == INTERP_ON) {
-            win_out = mcLinearInterp(tab_w, temp_index_int, temp_index_frac, size_w, 1);
-        } else {
-            win_out = tab_w[temp_index_int];
-        }
+        // get value from win buffer samples, or the analytic window
+        if (Family)
+            win_out = gen.next<Family>();
+        else
+            nw_interp<1, nw_wrap_loop>(InterpW, r->tab_w, r->size_w, 1, r->index_w + k * r->w_step, &win_out);
         
         // SOUND OUT
         
-        // compute temporary vars for interpolation
-        temp_index_int = (long)(index_s); // integer portion of index
-        temp_index_frac = index_s - (double)temp_index_int; // fractional portion of index
-        temp_index_int_times_chan = temp_index_int * chan_s;
-        
         // get value from snd buffer samples
-        if (interp_s == INTERP_ON) {
-            snd_out = mcLinearInterp(tab_s, temp_index_int_times_chan, temp_index_frac, size_s, chan_s);
-            snd_out2 = (chan_s == 2) ?
-                mcLinearInterp(tab_s, temp_index_int_times_chan + 1, temp_index_frac, size_s, chan_s) :
-                snd_out;
+        if (Chans == 2) {
+            nw_interp<2, Wrap>(InterpS, r->tab_s, r->size_s, r->chan_s, index_s, snd_out, r->sinc_s);
         } else {
-            snd_out = tab_s[temp_index_int_times_chan];
-            snd_out2 = (chan_s == 2) ?
-                tab_s[temp_index_int_times_chan + 1] :
-                snd_out;
+            nw_interp<1, Wrap>(InterpS, r->tab_s, r->size_s, r->chan_s, index_s, snd_out, r->sinc_s);
+            snd_out[1] = snd_out[0];
         }
         
         // OUTLETS
         
-        *out_signal = snd_out * win_out * g_gain;
-        *out_signal2 = snd_out2 * win_out * g_gain;
-        *out_sample_count = (double)count_samp;
+        win_out *= r->gain;
+        out1[k] = snd_out[0] * win_out;
+        out2[k] = snd_out[1] * win_out;
+        out_count[k] = r->count + 1 + k;
+    }
+    
+    r->index_w += len * r->w_step;
+    r->index_s = index_s;
+    r->count += len;
+}
+
+#if NW_SIMD_X86
+
+/********************************************************************************
+void grainstream_kernelSSE2(t_grainstream_run *r, double *out1, double *out2, 
+		double *out_count, long len)
+
+inputs:			(as grainstream_kernelScalar)
+description:	renders two samples at a time with linear interpolation; the 
+		run must not wrap in either buffer
+returns:		nothing
+********************************************************************************/
+void grainstream_kernelSSE2(t_grainstream_run *r, double *out1, double *out2, double *out_count, long len)
+{
+    const float *tab_w = r->tab_w;
+    const float *tab_s = r->tab_s;
+    const long chan_s = r->chan_s;
+    const long off2 = (chan_s == 2) ? 1 : 0;		// mono is copied to both outputs
+    
+    __m128d k = _mm_set_pd(1.0, 0.0);
+    const __m128d k_inc = _mm_set1_pd(2.0);
+    const __m128d w_pos = _mm_set1_pd(r->index_w);
+    const __m128d w_step = _mm_set1_pd(r->w_step);
+    const __m128d s_pos = _mm_set1_pd(r->index_s + r->s_step);
+    const __m128d s_step = _mm_set1_pd(r->s_step);
+    const __m128d gain = _mm_set1_pd(r->gain);
+    const __m128d count = _mm_set1_pd((double)(r->count + 1));
+    __m128d pw, ps, fw, fs, y1, y2, win_out, snd_out;
+    __m128i iw, is;
+    long i, w0, w1, s0, s1;
+    
+    for (i = 0; i + 2 <= len; i += 2) {
+        pw = _mm_add_pd(w_pos, _mm_mul_pd(k, w_step));
+        ps = _mm_add_pd(s_pos, _mm_mul_pd(k, s_step));
+        iw = _mm_cvttpd_epi32(pw);
+        is = _mm_cvttpd_epi32(ps);
+        fw = _mm_sub_pd(pw, _mm_cvtepi32_pd(iw));
+        fs = _mm_sub_pd(ps, _mm_cvtepi32_pd(is));
+        
+        // WINDOW OUT
+        w0 = _mm_cvtsi128_si32(iw);
+        w1 = _mm_cvtsi128_si32(_mm_srli_si128(iw, 4));
+        y1 = _mm_set_pd(tab_w[w1], tab_w[w0]);
+        y2 = _mm_set_pd(tab_w[w1 + 1], tab_w[w0 + 1]);
+        win_out = _mm_mul_pd(_mm_add_pd(y1, _mm_mul_pd(fw, _mm_sub_pd(y2, y1))), gain);
         
-        // update vars for last output
-        w_last_index = index_w;
+        // SOUND OUT
+        s0 = _mm_cvtsi128_si32(is) * chan_s;
+        s1 = _mm_cvtsi128_si32(_mm_srli_si128(is, 4)) * chan_s;
+        y1 = _mm_set_pd(tab_s[s1], tab_s[s0]);
+        y2 = _mm_set_pd(tab_s[s1 + chan_s], tab_s[s0 + chan_s]);
+        snd_out = _mm_add_pd(y1, _mm_mul_pd(fs, _mm_sub_pd(y2, y1)));
+        _mm_storeu_pd(out1 + i, _mm_mul_pd(snd_out, win_out));
+        
+        y1 = _mm_set_pd(tab_s[s1 + off2], tab_s[s0 + off2]);
+        y2 = _mm_set_pd(tab_s[s1 + off2 + chan_s], tab_s[s0 + off2 + chan_s]);
+        snd_out = _mm_add_pd(y1, _mm_mul_pd(fs, _mm_sub_pd(y2, y1)));
+        _mm_storeu_pd(out2 + i, _mm_mul_pd(snd_out, win_out));
+        
+        _mm_storeu_pd(out_count + i, _mm_add_pd(count, k));
+        k = _mm_add_pd(k, k_inc);
+    }
     
-advance_pointers:
-        // advance all pointers
-        ++in_freq, ++in_sound_start, ++in_sample_increment, ++in_gain;
-        ++out_signal, ++out_signal2, ++out_sample_count;
+    grainstream_kernelTail(r, out1, out2, out_count, i, len);
+}
+
+/********************************************************************************
+void grainstream_kernelAVX2(t_grainstream_run *r, double *out1, double *out2, 
+		double *out_count, long len)
+
+inputs:			(as grainstream_kernelScalar)
+description:	renders four samples at a time with linear interpolation; the 
+		run must not wrap in either buffer; buffer reads are scalar loads, as 
+		gather instructions are microcoded and slower on many processors
+returns:		nothing
+********************************************************************************/
+NW_TARGET_AVX2 void grainstream_kernelAVX2(t_grainstream_run *r, double *out1, double *out2, double *out_count, long len)
+{
+    const float *tab_w = r->tab_w;
+    const float *tab_s = r->tab_s;
+    const long chan_s = r->chan_s;
+    const long off2 = (chan_s == 2) ? 1 : 0;		// mono is copied to both outputs
+    
+    __m256d k = _mm256_set_pd(3.0, 2.0, 1.0, 0.0);
+    const __m256d k_inc = _mm256_set1_pd(4.0);
+    const __m256d w_pos = _mm256_set1_pd(r->index_w);
+    const __m256d w_step = _mm256_set1_pd(r->w_step);
+    const __m256d s_pos = _mm256_set1_pd(r->index_s + r->s_step);
+    const __m256d s_step = _mm256_set1_pd(r->s_step);
+    const __m256d gain = _mm256_set1_pd(r->gain);
+    const __m256d count = _mm256_set1_pd((double)(r->count + 1));
+    __m256d pw, ps, fw, fs, y1, y2, win_out, snd_out;
+    __m128i iw, is;
+    int w[4], s[4];
+    long i;
+    
+    for (i = 0; i + 4 <= len; i += 4) {
+        pw = _mm256_add_pd(w_pos, _mm256_mul_pd(k, w_step));
+        ps = _mm256_add_pd(s_pos, _mm256_mul_pd(k, s_step));
+        iw = _mm256_cvttpd_epi32(pw);
+        is = _mm256_cvttpd_epi32(ps);
+        fw = _mm256_sub_pd(pw, _mm256_cvtepi32_pd(iw));
+        fs = _mm256_sub_pd(ps, _mm256_cvtepi32_pd(is));
+        _mm_storeu_si128((__m128i *)w, iw);
+        _mm_storeu_si128((__m128i *)s, _mm_mullo_epi32(is, _mm_set1_epi32((int)chan_s)));
+        
+        // WINDOW OUT
+        y1 = _mm256_set_pd(tab_w[w[3]], tab_w[w[2]], tab_w[w[1]], tab_w[w[0]]);
+        y2 = _mm256_set_pd(tab_w[w[3] + 1], tab_w[w[2] + 1], tab_w[w[1] + 1], tab_w[w[0] + 1]);
+        win_out = _mm256_mul_pd(_mm256_add_pd(y1, _mm256_mul_pd(fw, _mm256_sub_pd(y2, y1))), gain);
+        
+        // SOUND OUT
+        y1 = _mm256_set_pd(tab_s[s[3]], tab_s[s[2]], tab_s[s[1]], tab_s[s[0]]);
+        y2 = _mm256_set_pd(tab_s[s[3] + chan_s], tab_s[s[2] + chan_s], tab_s[s[1] + chan_s], tab_s[s[0] + chan_s]);
+        snd_out = _mm256_add_pd(y1, _mm256_mul_pd(fs, _mm256_sub_pd(y2, y1)));
+        _mm256_storeu_pd(out1 + i, _mm256_mul_pd(snd_out, win_out));
+        
+        y1 = _mm256_set_pd(tab_s[s[3] + off2], tab_s[s[2] + off2], tab_s[s[1] + off2], tab_s[s[0] + off2]);
+        y2 = _mm256_set_pd(tab_s[s[3] + off2 + chan_s], tab_s[s[2] + off2 + chan_s],
+            tab_s[s[1] + off2 + chan_s], tab_s[s[0] + off2 + chan_s]);
+        snd_out = _mm256_add_pd(y1, _mm256_mul_pd(fs, _mm256_sub_pd(y2, y1)));
+        _mm256_storeu_pd(out2 + i, _mm256_mul_pd(snd_out, win_out));
+        
+        _mm256_storeu_pd(out_count + i, _mm256_add_pd(count, k));
+        k = _mm256_add_pd(k, k_inc);
     }
+    
+    // avoid the penalty for mixing avx and sse code in the rest of the chain
+    _mm256_zeroupper();
+    
+    grainstream_kernelTail(r, out1, out2, out_count, i, len);
+}
 
-    // update object history for next vector
-    x->curr_snd_pos = index_s;
-    x->curr_win_pos = index_w;
-    x->curr_count_samp = count_samp;
-    x->win_last_index = w_last_index;
+#endif /* NW_SIMD_X86 */
 
-    buffer_unlocksamples(snd_object);
-    buffer_unlocksamples(win_object);
-    return;
+/********************************************************************************
+void grainstream_kernelTail(t_grainstream_run *r, double *out1, double *out2, 
+		double *out_count, long from, long len)
 
-    // alternate blank output
-zero:
-    n = vectorsize;
-    while(n--)
-    {
-        *out_signal = 0.;
-        *out_signal2 = 0.;
-        *out_sample_count = -1.;
+inputs:			(as grainstream_kernelScalar)
+				from		-- first sample not rendered by the vector kernel
+description:	finishes a run for the vector kernels with the same arithmetic, 
+		then advances the run
+returns:		nothing
+********************************************************************************/
+void grainstream_kernelTail(t_grainstream_run *r, double *out1, double *out2, double *out_count, long from, long len)
+{
+    const long chan_s = r->chan_s;
+    const long off2 = (chan_s == 2) ? 1 : 0;
+    double pw, ps, fw, fs, y1, y2, win_out;
+    const float *y;
+    long k, i;
+    
+    for (k = from; k < len; k++) {
+        pw = r->index_w + k * r->w_step;
+        ps = (r->index_s + r->s_step) + k * r->s_step;
+        i = (long)pw;
+        fw = pw - (double)i;
+        y1 = r->tab_w[i];
+        y2 = r->tab_w[i + 1];
+        win_out = (y1 + fw * (y2 - y1)) * r->gain;
+        
+        i = (long)ps;
+        fs = ps - (double)i;
+        y = r->tab_s + i * chan_s;
+        y1 = y[0];
+        y2 = y[chan_s];
+        out1[k] = (y1 + fs * (y2 - y1)) * win_out;
+        y1 = y[off2];
+        y2 = y[off2 + chan_s];
+        out2[k] = (y1 + fs * (y2 - y1)) * win_out;
+        out_count[k] = r->count + 1 + k;
     }
-
-out:
-    return;
+    
+    r->index_w += len * r->w_step;
+    r->index_s += len * r->s_step;
+    r->count += len;
 }
 
 /********************************************************************************
- void grainstream_initGrain()
+ void grainstream_initGrain(t_grainstream *x, t_grainstream_chan *ch, float in_freq,
+ 		float in_pos_start, float in_pitch_mult, float in_gain_mult)
  
  inputs:			x					-- pointer to this object
+ ch				-- stream starting the grain
  in_freq			-- frequency of grain production
  in_pos_start		-- offset within sampled buffer
  in_pitch_mult		-- sample playback speed, 1 = normal
  in_gain_mult		-- scales gain output, 1 = no change
- description:	initializes grain vars; called from perform method when pulse is
- received
+ description:	initializes grain vars; called from perform method when the
+ window wraps; uses buffer info cached at the start of the vector
  returns:		nothing
  ********************************************************************************/
-void grainstream_initGrain(t_grainstream *x, float in_freq, float in_pos_start, float in_pitch_mult, float in_gain_mult)
+void grainstream_initGrain(t_grainstream *x, t_grainstream_chan *ch, float in_freq, float in_pos_start,
+		float in_pitch_mult, float in_gain_mult)
 {
+    double snd_msr = x->snd_buf.msr;
+    const t_nw_pyramid_level *level;
+    double scale;
+    long k;
+    
     #ifdef DEBUG
         object_post((t_object*)x, "initializing grain");
     #endif /* DEBUG */
     
-    /* should the buffers be updated ? */
-    
-    t_buffer_obj	*snd_object;
-    t_buffer_obj	*win_object;
-    
-    if (x->next_snd_buf_ptr != NULL) {
-        x->snd_buf_ptr = x->next_snd_buf_ptr;
-        x->next_snd_buf_ptr = NULL;
-        
-        #ifdef DEBUG
-            object_post((t_object*)x, "sound buffer pointer updated");
-        #endif /* DEBUG */
-    }
-    if (x->next_win_buf_ptr != NULL) {
-        x->win_buf_ptr = x->next_win_buf_ptr;
-        x->next_win_buf_ptr = NULL;
-        
-        #ifdef DEBUG
-            object_post((t_object*)x, "window buffer pointer updated");
-        #endif /* DEBUG */
-    }
-    
-    snd_object = buffer_ref_getobject(x->snd_buf_ptr);
-    win_object = buffer_ref_getobject(x->win_buf_ptr);
-    
     /* should input variables be at audio or control rate ? */
     
-    x->grain_freq = x->grain_freq_connected ? in_freq : x->next_grain_freq;
+    ch->grain_freq = x->grain_freq_connected ? in_freq : x->next_grain_freq;
     
     // temporarily stash here as milliseconds
-    x->grain_pos_start = x->grain_pos_start_connected ? in_pos_start : x->next_grain_pos_start;
+    ch->grain_pos_start = x->grain_pos_start_connected ? in_pos_start : x->next_grain_pos_start;
     
-    x->grain_pitch = x->grain_pitch_connected ? in_pitch_mult : x->next_grain_pitch;
+    ch->grain_pitch = x->grain_pitch_connected ? in_pitch_mult : x->next_grain_pitch;
     
-    x->grain_gain = x->grain_gain_connected ? in_gain_mult : x->next_grain_gain;
+    ch->grain_gain = x->grain_gain_connected ? in_gain_mult : x->next_grain_gain;
     
     /* compute dependent variables */
     
     // grain_freq must be positive and above 0.01 Hz or 1.66 min duration
-    if (x->grain_freq < 0.) x->grain_freq *= -1;
-    if (x->grain_freq < 0.01) x->grain_freq = 0.01;
-    x->grain_length = 1000. / x->grain_freq;
+    if (ch->grain_freq < 0.) ch->grain_freq *= -1;
+    if (ch->grain_freq < 0.01) ch->grain_freq = 0.01;
+    ch->grain_length = 1000. / ch->grain_freq;
     
     // compute window buffer step size per vector sample
-    x->win_step_size = (double)(buffer_getframecount(win_object)) * x->grain_freq * x->output_1oversr;
-    if (x->win_step_size < 0.) x->win_step_size *= -1.; // needs to be positive to prevent buffer overruns
+    ch->win_step_size = (double)(x->win_buf_frames) * ch->grain_freq * x->output_1oversr;
+    if (ch->win_step_size < 0.) ch->win_step_size *= -1.; // needs to be positive to prevent buffer overruns
     
     // compute sound buffer step size per vector sample
-    x->snd_step_size = x->grain_pitch * buffer_getsamplerate(snd_object) * x->output_1oversr;
-    //if (x->snd_step_size < 0.) x->snd_step_size *= -1.; // needs to be positive to prevent buffer overruns
+    ch->snd_step_size = ch->grain_pitch * x->snd_buf.sr * x->output_1oversr;
+    ch->snd_step_unit = x->snd_buf.sr * x->output_1oversr;
+    //if (ch->snd_step_size < 0.) ch->snd_step_size *= -1.; // needs to be positive to prevent buffer overruns
     
     // compute amount of sound file for grain
-    x->grain_sound_length = x->grain_length * x->grain_pitch;
-    if (x->grain_sound_length < 0.) x->grain_sound_length *= -1.; // needs to be positive to prevent buffer overruns
+    ch->grain_sound_length = ch->grain_length * ch->grain_pitch;
+    if (ch->grain_sound_length < 0.) ch->grain_sound_length *= -1.; // needs to be positive to prevent buffer overruns
     
     // update direction option
-    x->grain_direction = x->next_grain_direction;
+    ch->grain_direction = x->next_grain_direction;
     
-    if (x->grain_direction == FORWARD_GRAINS) {	// if forward...
-        x->grain_pos_start = x->grain_pos_start * buffer_getmillisamplerate(snd_object);
-        x->curr_snd_pos = x->grain_pos_start - x->snd_step_size;
+    if (ch->grain_direction == FORWARD_GRAINS) {	// if forward...
+        ch->grain_pos_start = ch->grain_pos_start * snd_msr;
+        ch->curr_snd_pos = ch->grain_pos_start - ch->snd_step_size;
     } else {	// if reverse...
-        x->grain_pos_start = (x->grain_pos_start + x->grain_sound_length) * buffer_getmillisamplerate(snd_object);
-        x->curr_snd_pos = x->grain_pos_start + x->snd_step_size;
+        ch->grain_pos_start = (ch->grain_pos_start + ch->grain_sound_length) * snd_msr;
+        ch->curr_snd_pos = ch->grain_pos_start + ch->snd_step_size;
+    }
+    
+    // grains that stay clear of the buffer ends can skip wrapping in the interpolator
+    ch->snd_wraps = nw_interp_wraps(ch->curr_snd_pos - ch->grain_sound_length * snd_msr,
+        ch->curr_snd_pos + ch->grain_sound_length * snd_msr, x->snd_buf.frames);
+    
+    // grains pitched far up read the level of the pyramid that brings their
+    // step down, so the sinc filter is picked afterwards
+    ch->snd_tab = NULL;
+    ch->snd_level = 0;
+    k = x->pyramid ? x->snd_pyramid.choose(ch->snd_step_size) : 0;
+    if (k) {
+        level = x->snd_pyramid.level(k);
+        scale = 1.0 / (double)(1L << k);
+        ch->curr_snd_pos *= scale;
+        ch->snd_step_size *= scale;
+        ch->snd_step_unit *= scale;
+        ch->snd_tab = level->samples;
+        ch->snd_tab_frames = level->frames;
+        ch->snd_level = k;
+        ch->snd_wraps = nw_interp_wraps(ch->curr_snd_pos - ch->grain_sound_length * snd_msr * scale,
+            ch->curr_snd_pos + ch->grain_sound_length * snd_msr * scale, level->frames);
     }
+    ch->snd_sinc = nw_sinc_filter(x->snd_sinc, ch->snd_step_size);
+    
+    // once the pitch moves, the span checked above no longer holds
+    if (x->modulate_pitch)
+        ch->snd_wraps = true;
     
-    x->curr_win_pos = 0.0;
+    ch->curr_win_pos = 0.0;
     
     // reset history
-    x->curr_count_samp = -1;
+    ch->curr_count_samp = -1;
     
     #ifdef DEBUG
         object_post((t_object*)x, "beginning of grain");
-        object_post((t_object*)x, "win step size = %f samps", x->win_step_size);
-        object_post((t_object*)x, "snd step size = %f samps", x->snd_step_size);
+        object_post((t_object*)x, "win step size = %f samps", ch->win_step_size);
+        object_post((t_object*)x, "snd step size = %f samps", ch->snd_step_size);
     #endif /* DEBUG */
     
     return;
     
 }
 
+/********************************************************************************
+void grainstream_soundChanged(t_grainstream *x)
+
+inputs:			x					-- pointer to this object
+description:	called from perform method when a new sound buffer is taken or
+		the buffer~ itself is changed; sounding grains checked their span 
+		against the old sound, so they go back to wrapping every read
+returns:		nothing 
+********************************************************************************/
+void grainstream_soundChanged(t_grainstream *x)
+{
+	long chan_alloc = x->chan_alloc.load(std::memory_order_acquire);
+	long c;
+	
+	for (c = 0; c < chan_alloc; c++)
+		x->chans[c]->snd_wraps = true;
+}
+
+/********************************************************************************
+void grainstream_dropLevels(t_grainstream *x)
+
+inputs:			x					-- pointer to this object
+description:	called from perform method when the pyramid is retired; grains
+		reading a level of it move back onto the sound buffer itself, at the
+		same place
+returns:		nothing 
+********************************************************************************/
+void grainstream_dropLevels(t_grainstream *x)
+{
+	t_grainstream_chan *ch;
+	double scale;
+	long chan_alloc = x->chan_alloc.load(std::memory_order_acquire);
+	long c;
+	
+	for (c = 0; c < chan_alloc; c++) {
+		ch = x->chans[c];
+		if (!ch->snd_tab)
+			continue;
+		scale = (double)(1L << ch->snd_level);
+		ch->curr_snd_pos *= scale;
+		ch->snd_step_size *= scale;
+		ch->snd_step_unit *= scale;
+		ch->snd_tab = NULL;
+		ch->snd_level = 0;
+		ch->snd_wraps = true;
+	}
+}
+
+/********************************************************************************
+void grainstream_buildPyramid(t_grainstream *x)
+
+inputs:			x					-- pointer to this object
+description:	builds the levels of the pyramid asked for by the perform
+		routine, a piece at a time; called from a qelem so that filtering
+		stays off the audio thread, and sets the qelem again until done
+returns:		nothing 
+********************************************************************************/
+void grainstream_buildPyramid(t_grainstream *x)
+{
+	t_buffer_ref *snd_ref = (t_buffer_ref *)x->snd_pyramid.wanted();
+	t_buffer_obj *snd_object;
+	t_buffer_info b_info;
+	float *tab_s;
+	bool more;
+	
+	// with no sound wanted, the levels of the last one are only freed
+	snd_object = snd_ref ? buffer_ref_getobject(snd_ref) : NULL;
+	tab_s = snd_object ? buffer_locksamples(snd_object) : NULL;
+	if (!tab_s) {
+		x->snd_pyramid.update(NULL, 0, 0, 0);
+		return;
+	}
+	
+	buffer_getinfo(snd_object, &b_info);
+	more = x->snd_pyramid.update(tab_s, b_info.b_frames, b_info.b_nchans, b_info.b_modtime);
+	buffer_unlocksamples(snd_object);
+	
+	if (more)
+		qelem_set(x->pyramid_qelem);
+	
+	#ifdef DEBUG
+		object_post((t_object*)x, more ? "pyramid level building" : "pyramid built");
+	#endif /* DEBUG */
+}
+
+/********************************************************************************
+void grainstream_updateBuffers(t_grainstream *x)
+
+inputs:			x					-- pointer to this object
+description:	takes buffers posted by setSound and setWin, and the shape
+		deferred by window; called from perform method at the start of each 
+		vector so that every stream reads the same locked buffers; grains 
+		already sounding are rescaled to the length of a new window; channels
+		past the outlets keep their streams, so every allocated channel is
+		updated
+returns:		nothing 
+********************************************************************************/
+void grainstream_updateBuffers(t_grainstream *x)
+{
+	t_grainstream_chan *ch;
+	double win_scale;
+	long chan_alloc = x->chan_alloc.load(std::memory_order_acquire);
+	long new_frames, c;
+	bool win_swapped = false;
+	
+	if (x->snd_swap.take(&x->snd_buf)) {
+		grainstream_soundChanged(x);
+		
+		#ifdef DEBUG
+			object_post((t_object*)x, "sound buffer pointer updated");
+		#endif /* DEBUG */
+	}
+	if (x->win_swap.take(&x->win_buf)) {
+		win_swapped = true;
+		
+		#ifdef DEBUG
+			object_post((t_object*)x, "window buffer pointer updated");
+		#endif /* DEBUG */
+	}
+	if (x->window_swap.take(&x->window)) {
+		win_swapped = true;
+	}
+	
+	if (win_swapped) {
+		// keep sounding grains at the same relative place in the new window
+		if (x->window.type != NW_WINDOW_BUFFER)
+			new_frames = NW_WINDOW_FRAMES;
+		else if (x->win_buf.ref != NULL)
+			new_frames = x->win_buf.frames;
+		else
+			new_frames = 0;
+		if (x->win_buf_frames > 0 && new_frames > 0 && new_frames != x->win_buf_frames) {
+			win_scale = (double)new_frames / (double)(x->win_buf_frames);
+			for (c = 0; c < chan_alloc; c++) {
+				ch = x->chans[c];
+				ch->curr_win_pos *= win_scale;
+				ch->win_step_size *= win_scale;
+				ch->win_last_index *= win_scale;
+			}
+		}
+		x->win_buf_frames = new_frames;
+	}
+}
+
 
 /********************************************************************************
 void grainstream_setsnd(t_index *x, t_symbol *s)
 
 inputs:			x		-- pointer to this object
 				s		-- name of buffer to link
-description:	links buffer holding the grain sound source 
+description:	links buffer holding the grain sound source; the perform
+		routine takes it, with its frame count, channel count and sample rate,
+		at the start of its next vector
 returns:		nothing
 ********************************************************************************/
 void grainstream_setsnd(t_grainstream *x, t_symbol *s)
 {
     t_buffer_ref *b = buffer_ref_new((t_object*)x, s);
+    t_buffer_info b_info;
+    t_nw_bufinfo info;
     
     if (buffer_ref_exists(b)) {
         t_buffer_obj	*b_object = buffer_ref_getobject(b);
         
-        if (buffer_getchannelcount(b_object) > 2) {
+        buffer_getinfo(b_object, &b_info);
+        if (b_info.b_nchans > 2) {
 			object_error((t_object*)x, "buffer~ > %s < must be mono or stereo", s->s_name);
-			x->next_snd_buf_ptr = NULL;		//added 2002.07.15
 		} else {
-			if (x->snd_buf_ptr == NULL) { // if first buffer make current buffer
-				x->snd_sym = s;
-				x->snd_buf_ptr = b;
-				//x->snd_last_out = 0.0;	//removed 2005.02.03
-				
-				#ifdef DEBUG
-					object_post((t_object*)x, "current sound set to buffer~ > %s <", s->s_name);
-				#endif /* DEBUG */
-			} else { // else defer to next buffer
-				x->snd_sym = s;
-				x->next_snd_buf_ptr = b;
-				//x->snd_buf_length = b->b_frames;	//removed 2002.07.11
-				//x->snd_last_out = 0.0;		//removed 2002.07.24
-				
-				#ifdef DEBUG
-					object_post((t_object*)x, "next sound set to buffer~ > %s <", s->s_name);
-				#endif /* DEBUG */
-			}
+			x->snd_sym = s;
+			x->snd_ref = b;
+			nw_bufinfo_set(&info, b, b_info.b_frames, b_info.b_nchans, b_info.b_sr, b_info.b_modtime);
+			x->snd_swap.post(info);
+			
+			#ifdef DEBUG
+				object_post((t_object*)x, "next sound set to buffer~ > %s <", s->s_name);
+			#endif /* DEBUG */
 		}
 	} else {
 		object_error((t_object*)x, "no buffer~ * %s * found", s->s_name);
-		x->next_snd_buf_ptr = NULL;
 	}
 }
 
@@ -646,46 +1524,74 @@ void grainstream_setwin(t_grainstream *x, t_symbol *s)
 
 inputs:			x		-- pointer to this object
 				s		-- name of buffer to link
-description:	links buffer holding the grain window 
+description:	links buffer holding the grain window; the perform routine
+		takes it at the start of its next vector
 returns:		nothing
 ********************************************************************************/
 void grainstream_setwin(t_grainstream *x, t_symbol *s)
 {
     t_buffer_ref *b = buffer_ref_new((t_object*)x, s);
+    t_buffer_info b_info;
+    t_nw_bufinfo info;
     
     if (buffer_ref_exists(b)) {
         t_buffer_obj	*b_object = buffer_ref_getobject(b);
         
-        if (buffer_getchannelcount(b_object) != 1) {
+        buffer_getinfo(b_object, &b_info);
+        if (b_info.b_nchans != 1) {
 			object_error((t_object*)x, "buffer~ > %s < must be mono", s->s_name);
-			x->next_win_buf_ptr = NULL;		//added 2002.07.15
 		} else {
-			if (x->win_buf_ptr == NULL) { // if first buffer make current buffer
-				x->win_sym = s;
-				x->win_buf_ptr = b;
-				//x->win_last_out = 0.0;	//removed 2005.02.03
-				x->win_last_index = buffer_getframecount(b_object);
-				
-				#ifdef DEBUG
-					object_post((t_object*)x, "current window set to buffer~ > %s <", s->s_name);
-				#endif /* DEBUG */
-			} else { // else defer to next buffer
-				x->win_sym = s;
-				x->next_win_buf_ptr = b;
-				//x->win_buf_length = b->b_frames;	//removed 2002.07.11
-				//x->win_last_out = 0.0;		//removed 2002.07.24
-				
-				#ifdef DEBUG
-					object_post((t_object*)x, "next window set to buffer~ > %s <", s->s_name);
-				#endif /* DEBUG */
-			}
+			x->win_sym = s;
+			x->win_ref = b;
+			nw_bufinfo_set(&info, b, b_info.b_frames, b_info.b_nchans, b_info.b_sr, b_info.b_modtime);
+			x->win_swap.post(info);
+			
+			#ifdef DEBUG
+				object_post((t_object*)x, "next window set to buffer~ > %s <", s->s_name);
+			#endif /* DEBUG */
 		}
 	} else {
 		object_error((t_object*)x, "no buffer~ > %s < found", s->s_name);
-		x->next_win_buf_ptr = NULL;
 	}
 }
 
+/********************************************************************************
+void grainstream_window(t_grainstream *x, t_symbol *s, long argc, t_atom *argv)
+
+inputs:			x		-- pointer to this object
+				s		-- message selector
+				argc	-- number of arguments
+				argv	-- shape name, then an optional parameter
+description:	method called when "window" message is received; picks one of the
+		analytic window shapes, or "buffer" to go back to the window buffer~;
+		takes effect at the start of the next vector
+returns:		nothing
+********************************************************************************/
+void grainstream_window(t_grainstream *x, t_symbol *s, long argc, t_atom *argv)
+{
+	t_nw_window w;
+	
+	if (argc < 1 || atom_gettype(argv) != A_SYM) {
+		object_error((t_object*)x, "window needs the name of a shape");
+		return;
+	}
+	if (!nw_window_set(&w, atom_getsym(argv)->s_name, argc > 1, argc > 1 ? atom_getfloat(argv + 1) : 0.)) {
+		object_error((t_object*)x, "window %s was not understood", atom_getsym(argv)->s_name);
+		return;
+	}
+	
+	// the window buffer~ is only linked when the dsp starts with it in use
+	if (w.type == NW_WINDOW_BUFFER && x->win_ref == NULL)
+		grainstream_setwin(x, x->win_sym);
+	
+	x->next_window = w;
+	x->window_swap.post(w);
+	
+	#ifdef DEBUG
+		object_post((t_object*)x, "window is set to %s", atom_getsym(argv)->s_name);
+	#endif /* DEBUG */
+}
+
 /********************************************************************************
 void grainstream_float(t_grainstream *x, double f)
 
@@ -750,30 +1656,104 @@ void grainstream_int(t_grainstream *x, long l)
     }
 }
 
+/********************************************************************************
+void grainstream_publishKernels(t_grainstream *x)
+
+inputs:			x		-- pointer to this object
+description:	hands the kernels for the current sndInterp and winInterp modes
+		to the perform routine, which takes them at its next vector; one
+		pointer is swapped, so the two modes always arrive together
+returns:		nothing
+********************************************************************************/
+void grainstream_publishKernels(t_grainstream *x)
+{
+	x->next_kernels.store(&grainstream_kernels[x->snd_interp][x->win_interp], std::memory_order_release);
+}
+
 /********************************************************************************
 void grainstream_sndInterp(t_grainstream *x, long l)
 
 inputs:			x		-- pointer to our object
 				l		-- flag value
 description:	method called when "sndInterp" message is received; allows user 
-		to define whether interpolation is used in pulling values from the sound
-		buffer; default is on
+		to choose the interpolation used in pulling values from the sound
+		buffer; 0 = off, 1 = linear, 2 = hermite, 3 = lagrange, 4 = windowed
+		sinc; default is linear
 returns:		nothing
 ********************************************************************************/
 void grainstream_sndInterp(t_grainstream *x, long l)
 {
-	if (l == INTERP_OFF) {
-		x->snd_interp = INTERP_OFF;
+	if (l == INTERP_SINC && !x->snd_sinc) {
+		x->snd_sinc = nw_sinc_get(NW_SINC_PHASES);
+		if (!x->snd_sinc) {
+			object_error((t_object*)x, "out of memory for the sinc table");
+			return;
+		}
+	}
+	
+	if (l >= INTERP_OFF && l <= INTERP_SINC) {
+		x->snd_interp = (short)l;
+		grainstream_publishKernels(x);
 		#ifdef DEBUG
-			object_post((t_object*)x, "sndInterp is set to off");
+			object_post((t_object*)x, "sndInterp is set to %ld", l);
 		#endif // DEBUG //
-	} else if (l == INTERP_ON) {
-		x->snd_interp = INTERP_ON;
+	} else {
+		object_error((t_object*)x, "sndInterp message was not understood");
+	}
+}
+
+/********************************************************************************
+void grainstream_sincTable(t_grainstream *x, long l)
+
+inputs:			x		-- pointer to our object
+				l		-- phases per frame
+description:	method called when "sincTable" message is received; sets the
+		size of the table read by sndInterp 4, rounded to a power of two
+		between 16 and 4096; larger tables read between frames more finely;
+		default is 256; grains begun afterwards use it
+returns:		nothing
+********************************************************************************/
+void grainstream_sincTable(t_grainstream *x, long l)
+{
+	const t_nw_sinc *sinc;
+	
+	if (l < 1) {
+		object_error((t_object*)x, "sincTable message was not understood");
+		return;
+	}
+	
+	sinc = nw_sinc_get(l);
+	if (!sinc) {
+		object_error((t_object*)x, "out of memory for the sinc table");
+		return;
+	}
+	x->snd_sinc = sinc;
+	#ifdef DEBUG
+		object_post((t_object*)x, "sincTable is set to %ld phases", sinc->phases);
+	#endif // DEBUG //
+}
+
+/********************************************************************************
+void grainstream_pyramid(t_grainstream *x, long l)
+
+inputs:			x		-- pointer to our object
+				l		-- flag value
+description:	method called when "pyramid" message is received; 1 keeps
+		copies of the sound buffer decimated by octaves, built in the
+		background each time the buffer~ changes, and grains pitched up by
+		more than 2 read the copy that brings their step to 2 or below, which
+		reads less memory and aliases less; 0 = off; default is off
+returns:		nothing
+********************************************************************************/
+void grainstream_pyramid(t_grainstream *x, long l)
+{
+	if (l == 0 || l == 1) {
+		x->pyramid = (short)l;
 		#ifdef DEBUG
-			object_post((t_object*)x, "sndInterp is set to on");
+			object_post((t_object*)x, "pyramid is set to %ld", l);
 		#endif // DEBUG //
 	} else {
-		object_error((t_object*)x, "sndInterp message was not understood");
+		object_error((t_object*)x, "pyramid message was not understood");
 	}
 }
 
@@ -783,21 +1763,17 @@ void grainstream_winInterp(t_grainstream *x, long l)
 inputs:			x		-- pointer to our object
 				l		-- flag value
 description:	method called when "winInterp" message is received; allows user 
-		to define whether interpolation is used in pulling values from the window
-		buffer; default is off
+		to choose the interpolation used in pulling values from the window
+		buffer; 0 = off, 1 = linear, 2 = hermite, 3 = lagrange; default is linear
 returns:		nothing
 ********************************************************************************/
 void grainstream_winInterp(t_grainstream *x, long l)
 {
-	if (l == INTERP_OFF) {
-		x->win_interp = INTERP_OFF;
+	if (l >= INTERP_OFF && l <= INTERP_LAGRANGE) {
+		x->win_interp = (short)l;
+		grainstream_publishKernels(x);
 		#ifdef DEBUG
-			object_post((t_object*)x, "winInterp is set to off");
-		#endif // DEBUG //
-	} else if (l == INTERP_ON) {
-		x->win_interp = INTERP_ON;
-		#ifdef DEBUG
-			object_post((t_object*)x, "winInterp is set to on");
+			object_post((t_object*)x, "winInterp is set to %ld", l);
 		#endif // DEBUG //
 	} else {
 		object_error((t_object*)x, "winInterp was not understood");
@@ -831,6 +1807,28 @@ void grainstream_reverse(t_grainstream *x, long l)
 	
 }
 
+/********************************************************************************
+void grainstream_simd(t_grainstream *x, long l)
+
+inputs:			x		-- pointer to our object
+				l		-- flag value
+description:	method called when "simd" message is received; allows user 
+		to turn off the vector kernels and render with the scalar reference; 
+		default is on
+returns:		nothing
+********************************************************************************/
+void grainstream_simd(t_grainstream *x, long l)
+{
+	if (l == 0 || l == 1) {
+		x->simd = (short)l;
+		#ifdef DEBUG
+			object_post((t_object*)x, "simd is set to %ld", l);
+		#endif // DEBUG //
+	} else {
+		object_error((t_object*)x, "simd was not understood");
+	}
+}
+
 
 /********************************************************************************
 void grainstream_assist(t_grainstream *x, t_object *b, long msg, long arg, char *s)
@@ -894,35 +1892,3 @@ void grainstream_getinfo(t_grainstream *x)
 	object_post((t_object*)x, "%s object by Nathan Wolek", OBJECT_NAME);
 	object_post((t_object*)x, "Last updated on %s - www.nathanwolek.com", __DATE__);
 }
-
-
-/********************************************************************************
-double mcLinearInterp(float *in_array, long index_i, double index_frac, 
-		long in_size, short in_chans)
-
-inputs:			*in_array -- name of array of input values
-				index_i -- index value of sample, specific channel within interleaved frame
-				index_frac -- fractional portion of index value for interp
-				in_size -- size of input buffer to perform wrapping
-				in_chans -- number of channels in input buffer
-description:	performs linear interpolation on an input array and to return 
-	value of a fractional sample location
-returns:		interpolated output
-********************************************************************************/
-double mcLinearInterp(float *in_array, long index_i, double index_frac, long in_size, short in_chans)
-{
-	double out, sample1, sample2;
-	long index_iP1 = index_i + in_chans;		// corresponding sample in next frame
-	
-	// make sure that index_iP1 is not out of range
-	while (index_iP1 >= in_size * in_chans) index_iP1 -= in_size;
-	
-	// get samples
-	sample1 = (double)in_array[index_i];
-	sample2 = (double)in_array[index_iP1];
-	
-	//linear interp formula
-	out = sample1 + index_frac * (sample2 - sample1);
-	
-	return out;
-}
\ No newline at end of file
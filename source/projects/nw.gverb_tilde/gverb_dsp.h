@@ -0,0 +1,466 @@
+/*
+** gverb_dsp.h
+**
+** header file
+** Griesinger reverb network for nw.gverb~, free of any Max API calls so that
+** it can also be driven by the nw_bench profiling target; the building
+** blocks themselves live in reverb_bb.h and reverb_bb.cpp
+**
+** Max allocates objects without running constructors, so a GverbEngine held
+** in an object struct is set up by init() and torn down by free() rather
+** than by a constructor and destructor
+**
+** Copyright © 2002,2014 by Nathan Wolek
+** License: http://opensource.org/licenses/BSD-3-Clause
+**
+*/
+
+#ifndef __GVERB_DSP
+#define __GVERB_DSP
+
+#include "reverb_bb.h"
+
+// constant settings for the reverb algorithm
+#define MODRATE_MAX 1.0f			// max modulation rate
+#define EXCUR_MAX 20				// max depth of mod delay
+
+// delay settings below are in samples at GVERB_TUNING_SR; the engine keeps
+// them in seconds and converts them whenever the sample rate changes
+#define GVERB_TUNING_SR 44100.0		// rate the delay settings were tuned at
+#define GVERB_SR_MAX 192000.0		// buffers are sized for this rate
+#define ALLPASS_SHORT_DELAY_VALUES {142, 107, 379, 277}	// delay settings
+#define ALLPASS_LONG_DELAY_VALUES {1800, 2656}	// delay settings
+#define ALLPASS_MOD_DELAY_INIT_VALUES {672, 908}	// initial delay settings
+#define DELAY_SMALL_VALUES {4453, 4217, 3720, 3163}	// short delay values
+#define DECAY_TANK_MS (16416.0 / (GVERB_TUNING_SR * 0.001))	// decay coeff is based on this
+
+#define LOWPASS_NUM 3			// number of lowpass filters
+#define ALLPASS_SHORT_NUM 4		// number of short buffered allpass filters
+#define ALLPASS_LONG_NUM 2		// number of long buffered allpass filters
+#define ALLPASS_MOD_NUM 2		// number of modulating buffered allpass filters
+#define DELAYBUFF_SMALL_NUM 4	// number of short delay lines
+
+// the feedforward stages run over blocks of at most this many samples
+#define GVERB_BLOCK_SIZE 64
+
+// coefficients for reverb components
+#define IN_DIFF_1		0.750
+#define IN_DIFF_2		0.625
+#define DEC_DIFF_1		0.700
+#define DEC_DIFF_2		0.500
+#define DAMPING			0.0005
+#define BANDWIDTH		0.9995
+#define AP_MODRATE_1	1.13671
+#define AP_MODRATE_2	1.11718
+#define AP_MODDEPTH_1	16.11
+#define AP_MODDEPTH_2	15.87
+
+// fix for denormal through square injection of dc offset
+#define TINY_DC		0.0000000000000000000000001
+
+class GverbEngine
+{
+public:
+	// arrays to hold delay lengths, in seconds
+	double apShort_times[ALLPASS_SHORT_NUM];
+	double apLong_times[ALLPASS_LONG_NUM];
+	double smallDelay_times[DELAYBUFF_SMALL_NUM];
+	double apMod_init_times[ALLPASS_MOD_NUM];
+	double apMod_depth_times[ALLPASS_MOD_NUM];
+
+	// every buffer of the network, from a single allocation
+	rbb_arena arena;
+
+	// structs for reverb building blocks
+	rbb_sintable oscTable;
+	rbb_lowpass lpFilters[LOWPASS_NUM];
+	rbb_allpass_short apFilters_short[ALLPASS_SHORT_NUM];
+	rbb_allpass_long apFilters_long[ALLPASS_LONG_NUM];
+	rbb_allpass_mod apFilters_mod[ALLPASS_MOD_NUM];
+	rbb_delaybuff_short delayBuffs_small[DELAYBUFF_SMALL_NUM];
+
+	double verb_decay;					// in milliseconds
+	double verb_decay_1over;			// in milliseconds
+	double verb_decay_coeff;
+
+	double lastout_L;					// last output
+	double lastout_R;
+
+	// true if the decay is read from the in_decay signal
+	short verb_decay_connected;
+
+	// sample rate info
+	double output_sr;
+	double output_msr;
+	double output_1overmsr;
+
+	// maintain dc_offset for square injection
+	double sqinject_val;
+
+	bool init(double decay, double sr);
+	void free(void);
+	void setSampleRate(double sr);
+	void setDecay(double decay);
+	void process(const double *in_dry, const double *in_decay, double *out_wet1,
+		double *out_wet2, long n);
+};
+
+/********************************************************************************
+long gverb_bufferLength(double seconds)
+
+inputs:			seconds	-- longest delay the buffer must hold
+description:	buffer length for a delay at the highest supported sample rate,
+		with room for the sample after the read position, rounded up to a
+		power of two
+returns:		length in samples
+********************************************************************************/
+inline long gverb_bufferLength(double seconds)
+{
+	long length = (long)ceil(seconds * GVERB_SR_MAX) + 2;
+	long pow2 = 1;
+
+	// the delay lines wrap with a mask
+	while (pow2 < length) pow2 <<= 1;
+	return pow2;
+}
+
+/********************************************************************************
+long gverb_delaySamples(double seconds, double sr)
+
+inputs:			seconds	-- delay length
+				sr		-- sample rate
+description:	converts a delay length to the nearest whole sample
+returns:		length in samples
+********************************************************************************/
+inline long gverb_delaySamples(double seconds, double sr)
+{
+	return (long)(seconds * sr + 0.5);
+}
+
+/********************************************************************************
+bool GverbEngine::init(double decay, double sr)
+
+inputs:			decay	-- decay time in ms, 1000 ms if not greater than zero
+				sr		-- sample rate
+description:	allocates and initializes building blocks for the reverb
+		algorithm; the buffers are sized for GVERB_SR_MAX so that a later
+		sample rate change never allocates
+returns:		false if the buffers could not be allocated
+********************************************************************************/
+inline bool GverbEngine::init(double decay, double sr)
+{
+	int curr_num;
+	long aps_length[ALLPASS_SHORT_NUM], apl_length[ALLPASS_LONG_NUM];
+	long apm_length[ALLPASS_MOD_NUM], sd_length[DELAYBUFF_SMALL_NUM];
+	// local arrays for delay values
+	long temp_apsv[] = ALLPASS_SHORT_DELAY_VALUES;
+	long temp_aplv[] = ALLPASS_LONG_DELAY_VALUES;
+	long temp_sdv[] = DELAY_SMALL_VALUES;
+	long temp_apmv[] = ALLPASS_MOD_DELAY_INIT_VALUES;
+
+	// local pointers to building blocks
+	rbb_sintable *ot_ptr = &oscTable;
+	rbb_lowpass *lpf_ptr = lpFilters;
+	rbb_allpass_short *aps_ptr = apFilters_short;
+	rbb_allpass_long *apl_ptr = apFilters_long;
+	rbb_allpass_mod *apm_ptr = apFilters_mod;
+	rbb_delaybuff_short *sd_ptr = delayBuffs_small;
+
+	/* setup variables */
+	verb_decay = decay > 0.0 ? decay : 1000.0;
+	verb_decay_1over = decay > 0.0 ? 1.0 / decay : 0.001;
+	verb_decay_connected = 0;
+
+	// the tank is the same length in seconds at any rate, so the decay coeff
+	// does not depend on the sample rate
+	verb_decay_coeff = pow(10.0, (-DECAY_TANK_MS * verb_decay_1over));
+
+	// initialize square injection value
+	sqinject_val = TINY_DC;
+
+	// convert delay settings to seconds
+	curr_num = ALLPASS_SHORT_NUM;
+	while (--curr_num >= 0) {
+		apShort_times[curr_num] = temp_apsv[curr_num] / GVERB_TUNING_SR;
+	}
+
+	curr_num = ALLPASS_LONG_NUM;
+	while (--curr_num >= 0) {
+		apLong_times[curr_num] = temp_aplv[curr_num] / GVERB_TUNING_SR;
+	}
+
+	curr_num = DELAYBUFF_SMALL_NUM;
+	while (--curr_num >= 0) {
+		smallDelay_times[curr_num] = temp_sdv[curr_num] / GVERB_TUNING_SR;
+	}
+
+	curr_num = ALLPASS_MOD_NUM;
+	while (--curr_num >= 0) {
+		apMod_init_times[curr_num] = temp_apmv[curr_num] / GVERB_TUNING_SR;
+	}
+
+	apMod_depth_times[0] = AP_MODDEPTH_1 / GVERB_TUNING_SR;
+	apMod_depth_times[1] = AP_MODDEPTH_2 / GVERB_TUNING_SR;
+
+	// buffer lengths at the highest supported rate
+	for (curr_num = 0; curr_num < ALLPASS_SHORT_NUM; curr_num++)
+		aps_length[curr_num] = gverb_bufferLength(apShort_times[curr_num]);
+	for (curr_num = 0; curr_num < ALLPASS_LONG_NUM; curr_num++)
+		apl_length[curr_num] = gverb_bufferLength(apLong_times[curr_num]);
+	for (curr_num = 0; curr_num < ALLPASS_MOD_NUM; curr_num++)
+		apm_length[curr_num] = gverb_bufferLength(apMod_init_times[curr_num] + apMod_depth_times[curr_num]);
+	for (curr_num = 0; curr_num < DELAYBUFF_SMALL_NUM; curr_num++)
+		sd_length[curr_num] = gverb_bufferLength(smallDelay_times[curr_num]);
+
+	// one allocation for the osc table and every delay line
+	arena.init();
+	arena.reserve(OSC_TABLE_SIZE);
+	for (curr_num = 0; curr_num < ALLPASS_SHORT_NUM; curr_num++)
+		arena.reserve(aps_length[curr_num]);
+	for (curr_num = 0; curr_num < ALLPASS_LONG_NUM; curr_num++)
+		arena.reserve(apl_length[curr_num]);
+	for (curr_num = 0; curr_num < ALLPASS_MOD_NUM; curr_num++)
+		arena.reserve(apm_length[curr_num]);
+	for (curr_num = 0; curr_num < DELAYBUFF_SMALL_NUM; curr_num++)
+		arena.reserve(sd_length[curr_num]);
+
+	if (!arena.allocate())
+		return false;
+
+	// buffers are taken in the order a sample passes through them, so that
+	// each walk through the network moves forward through memory
+	for (curr_num = 0; curr_num < ALLPASS_SHORT_NUM; curr_num++)
+		aps_ptr[curr_num].init(arena.take(aps_length[curr_num]), aps_length[curr_num]);
+
+	ot_ptr->init(arena.take(OSC_TABLE_SIZE));		// read by the allpass mods
+	apm_ptr[0].init(arena.take(apm_length[0]), apm_length[0], ot_ptr);
+	apm_ptr[1].init(arena.take(apm_length[1]), apm_length[1], ot_ptr);
+	sd_ptr[0].init(arena.take(sd_length[0]), sd_length[0]);
+	sd_ptr[1].init(arena.take(sd_length[1]), sd_length[1]);
+	apl_ptr[0].init(arena.take(apl_length[0]), apl_length[0]);
+	apl_ptr[1].init(arena.take(apl_length[1]), apl_length[1]);
+	sd_ptr[2].init(arena.take(sd_length[2]), sd_length[2]);
+	sd_ptr[3].init(arena.take(sd_length[3]), sd_length[3]);
+
+	// lowpass filters
+	curr_num = LOWPASS_NUM;
+	while (--curr_num >= 0) {
+		lpf_ptr[curr_num].init();
+	}
+
+	lpf_ptr[0].setCoeff(BANDWIDTH);
+	lpf_ptr[1].setCoeff(DAMPING);
+	lpf_ptr[2].setCoeff(DAMPING);
+
+	aps_ptr[0].setCoeff(IN_DIFF_1);
+	aps_ptr[1].setCoeff(IN_DIFF_1);
+	aps_ptr[2].setCoeff(IN_DIFF_2);
+	aps_ptr[3].setCoeff(IN_DIFF_2);
+
+	apm_ptr[0].setCoeff(DEC_DIFF_1);
+	apm_ptr[1].setCoeff(DEC_DIFF_1);
+
+	apl_ptr[0].setCoeff(DEC_DIFF_2);
+	apl_ptr[1].setCoeff(DEC_DIFF_2);
+
+	lastout_L = 0.0;
+	lastout_R = 0.0;
+
+	// delay lengths, mod depths and rates
+	setSampleRate(sr);
+
+	return true;
+}
+
+/********************************************************************************
+void GverbEngine::free(void)
+
+inputs:			nothing
+description:	frees memory used by the reverb algorithm
+returns:		nothing
+********************************************************************************/
+inline void GverbEngine::free(void)
+{
+	arena.free();
+}
+
+/********************************************************************************
+void GverbEngine::setSampleRate(double sr)
+
+inputs:			sr		-- sample rate
+description:	converts the delay lengths and mod depths to samples at the new
+		rate and updates the allpass mod rates; delays longer than their
+		buffers, above GVERB_SR_MAX, are clipped to the buffer length
+returns:		nothing
+********************************************************************************/
+inline void GverbEngine::setSampleRate(double sr)
+{
+	int curr_num;
+
+	output_sr = sr;
+	output_msr = output_sr * 0.001;
+	output_1overmsr = 1.0 / output_msr;
+
+	for (curr_num = 0; curr_num < ALLPASS_SHORT_NUM; curr_num++) {
+		apFilters_short[curr_num].setDelay(gverb_delaySamples(apShort_times[curr_num], sr));
+	}
+
+	for (curr_num = 0; curr_num < ALLPASS_LONG_NUM; curr_num++) {
+		apFilters_long[curr_num].setDelay(gverb_delaySamples(apLong_times[curr_num], sr));
+	}
+
+	// depth first, the mod delay is clipped against it
+	for (curr_num = 0; curr_num < ALLPASS_MOD_NUM; curr_num++) {
+		apFilters_mod[curr_num].oscDepth = apMod_depth_times[curr_num] * sr;
+		apFilters_mod[curr_num].setDelay(gverb_delaySamples(apMod_init_times[curr_num], sr));
+	}
+
+	for (curr_num = 0; curr_num < DELAYBUFF_SMALL_NUM; curr_num++) {
+		delayBuffs_small[curr_num].setDelay(gverb_delaySamples(smallDelay_times[curr_num], sr));
+	}
+
+	// update allpass mod with sampling rate
+	apFilters_mod[0].setFreq(AP_MODRATE_1, output_sr);
+	apFilters_mod[1].setFreq(AP_MODRATE_2, output_sr);
+}
+
+/********************************************************************************
+void GverbEngine::setDecay(double decay)
+
+inputs:			decay	-- decay time in ms, must be greater than zero
+description:	sets the decay time used when in_decay is not connected
+returns:		nothing
+********************************************************************************/
+inline void GverbEngine::setDecay(double decay)
+{
+	verb_decay = decay;
+	verb_decay_1over = 1.0 / verb_decay;
+	verb_decay_coeff = pow(10.0, (-DECAY_TANK_MS * verb_decay_1over));
+}
+
+/********************************************************************************
+void GverbEngine::process(const double *in_dry, const double *in_decay,
+		double *out_wet1, double *out_wet2, long n)
+
+inputs:			in_dry		-- input signal
+				in_decay	-- decay time in ms, read only if verb_decay_connected
+				out_wet1	-- left channel output
+				out_wet2	-- right channel output
+				n			-- number of samples
+description:	runs the reverb network; the input lowpass and diffusers have no
+		feedback from the tank, so they run over up to GVERB_BLOCK_SIZE samples
+		at a time before the tank runs through the same samples one by one
+returns:		nothing
+********************************************************************************/
+inline void GverbEngine::process(const double *in_dry, const double *in_decay, double *out_wet1,
+	double *out_wet2, long n)
+{
+    // local vars for object vars
+    double fDecay = verb_decay_coeff;
+    double lastout_l = lastout_L;
+    double lastout_r = lastout_R;
+    double sqinject = sqinject_val * -1.0; // flip sign each time
+    short decay_connected = verb_decay_connected;
+
+    // output of the feedforward stages and the decay of each sample, per block
+    double diffused[GVERB_BLOCK_SIZE];
+    double decay[GVERB_BLOCK_SIZE];
+
+    // local vars used for while loop
+    double x6, x7L, x8L, x9L, x10L, x11L, x12L, x13L;
+    double x7R, x8R, x9R, x10R, x11R, x12R, x13R;
+    long block, i;
+
+    while (n > 0)
+    {
+        block = n < GVERB_BLOCK_SIZE ? n : GVERB_BLOCK_SIZE;
+
+        /***** feedforward stages, a whole block at a time *****/
+
+        // add small dc offset to protect against denormal
+        for (i = 0; i < block; i++)
+            diffused[i] = in_dry[i] + sqinject;
+
+        // lowpass 0
+        lpFilters[0].computeBlock1(diffused, diffused, block);
+        // allpass_short 0 - 3
+        apFilters_short[0].computeBlock(diffused, diffused, block);
+        apFilters_short[1].computeBlock(diffused, diffused, block);
+        apFilters_short[2].computeBlock(diffused, diffused, block);
+        apFilters_short[3].computeBlock(diffused, diffused, block);
+
+        if (decay_connected)	// if decay inlet has signal input..
+        {	// recompute decay coeff each sample
+            for (i = 0; i < block; i++)
+                decay[i] = pow(10.0, (-DECAY_TANK_MS / in_decay[i]));
+            fDecay = decay[block - 1];
+        }
+        else
+        {
+            for (i = 0; i < block; i++)
+                decay[i] = fDecay;
+        }
+
+        /***** tank, one sample at a time *****/
+        {
+            // local copies keep the state of the recursive blocks in registers
+            rbb_allpass_mod apm0 = apFilters_mod[0], apm1 = apFilters_mod[1];
+            rbb_delaybuff_short sd0 = delayBuffs_small[0], sd1 = delayBuffs_small[1];
+            rbb_delaybuff_short sd2 = delayBuffs_small[2], sd3 = delayBuffs_small[3];
+            rbb_lowpass lp1 = lpFilters[1], lp2 = lpFilters[2];
+            rbb_allpass_long apl0 = apFilters_long[0], apl1 = apFilters_long[1];
+
+            for (i = 0; i < block; i++)
+            {
+                x6 = diffused[i];
+
+                /* split*/
+
+                // add recursion
+                x7L = x6 + lastout_r;
+                x7R = x6 + lastout_l;
+                // allpass_mod 0 & 1
+                x8L = apm0.compute(x7L);
+                x8R = apm1.compute(x7R);
+                // delaybuff_small 0 & 1
+                x9L = sd0.compute(x8L);
+                x9R = sd1.compute(x8R);
+                // lowpass 1 & 2
+                x10L = lp1.compute2(x9L);
+                x10R = lp2.compute2(x9R);
+                // * decay
+                x11L = decay[i] * x10L;
+                x11R = decay[i] * x10R;
+                // allpass_long 0 & 1
+                x12L = apl0.compute(x11L);
+                x12R = apl1.compute(x11R);
+                // delaybuff_small 2 & 3
+                x13L = sd2.compute(x12L);
+                x13R = sd3.compute(x12R);
+                // * decay
+                lastout_l = decay[i] * x13L;
+                lastout_r = decay[i] * x13R;
+
+                out_wet1[i] = 1.2 * x9R - 0.6 * x12R + 0.6 * x13R - 0.6 * x9L - 0.6 * x12L - 0.6 * x13L;
+                out_wet2[i] = 1.2 * x9L - 0.6 * x12L + 0.6 * x13L - 0.6 * x9R - 0.6 * x12R - 0.6 * x13R;
+            }
+
+            apFilters_mod[0] = apm0, apFilters_mod[1] = apm1;
+            delayBuffs_small[0] = sd0, delayBuffs_small[1] = sd1;
+            delayBuffs_small[2] = sd2, delayBuffs_small[3] = sd3;
+            lpFilters[1] = lp1, lpFilters[2] = lp2;
+            apFilters_long[0] = apl0, apFilters_long[1] = apl1;
+        }
+
+        in_dry += block, in_decay += block, out_wet1 += block, out_wet2 += block;
+        n -= block;
+    }
+
+    // update object variables
+    verb_decay_coeff = fDecay;
+    lastout_L = lastout_l;
+    lastout_R = lastout_r;
+    sqinject_val = sqinject;
+}
+
+#endif /* __GVERB_DSP */
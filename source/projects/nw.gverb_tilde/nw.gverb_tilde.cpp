@@ -12,7 +12,7 @@
 
 #include "c74_msp.h"
 using namespace c74::max;
-#include "reverb_bb.h"
+#include "gverb_dsp.h"
 
 //#define DEBUG			//enable debugging messages
 
@@ -22,74 +22,13 @@ using namespace c74::max;
 #define ASSIST_INLET	1
 #define ASSIST_OUTLET	2
 
-// constant settings for the reverb algorithm
-#define MODRATE_MAX 1.0f			// max modulation rate
-#define EXCUR_MAX 20				// max depth of mod delay
-#define ALLPASS_SHORT_DELAY_VALUES {142, 107, 379, 277}	// delay settings
-#define ALLPASS_LONG_DELAY_VALUES {1800, 2656}	// delay settings
-#define ALLPASS_MOD_DELAY_INIT_VALUES {672, 908}	// initial delay settings
-#define DELAY_SMALL_VALUES {4453, 4217, 3720, 3163}	// short delay values
-
-#define LOWPASS_NUM 3			// number of lowpass filters
-#define ALLPASS_SHORT_NUM 4		// number of short buffered allpass filters
-#define ALLPASS_LONG_NUM 2		// number of long buffered allpass filters
-#define ALLPASS_MOD_NUM 2		// number of modulating buffered allpass filters
-#define DELAYBUFF_SMALL_NUM 4	// number of short delay lines
-
-// coefficients for reverb components
-#define IN_DIFF_1		0.750
-#define IN_DIFF_2		0.625
-#define DEC_DIFF_1		0.700
-#define DEC_DIFF_2		0.500
-#define DAMPING			0.0005
-#define BANDWIDTH		0.9995
-#define AP_MODRATE_1	1.13671
-#define AP_MODRATE_2	1.11718
-#define AP_MODDEPTH_1	16.11
-#define AP_MODDEPTH_2	15.87
-
-// fix for denormal through square injection of dc offset
-#define TINY_DC		0.0000000000000000000000001f
-
 static t_class *gverb_class;		// required global pointer to this class
 
 /* structure definition for this object */
 typedef struct _gverb
 {
 	t_pxobject x_obj;
-	
-	// arrays to hold exact buffer lengths
-	long apShort_values[ALLPASS_SHORT_NUM];
-	long apLong_values[ALLPASS_LONG_NUM];
-	long smallDelay_values[DELAYBUFF_SMALL_NUM];
-	long apMod_init_values[ALLPASS_MOD_NUM];
-	
-	// structs for reverb building blocks
-	rbb_sintable oscTable;
-	rbb_lowpass lpFilters[LOWPASS_NUM];
-	rbb_allpass_short apFilters_short[ALLPASS_SHORT_NUM];
-	rbb_allpass_long apFilters_long[ALLPASS_LONG_NUM];
-	rbb_allpass_mod apFilters_mod[ALLPASS_MOD_NUM];
-	rbb_delaybuff_short delayBuffs_small[DELAYBUFF_SMALL_NUM];
-	
-	double verb_decay;					// in milliseconds
-	double verb_decay_1over;			// in milliseconds
-	double verb_decay_coeff;
-	
-	double lastout_L;					// last output
-	double lastout_R;
-	
-	// inlet connections
-	short verb_decay_connected;
-	
-	// sample rate info
-	double output_sr;
-	double output_msr;
-	double output_1overmsr;
-	
-	// maintain dc_offset for square injection
-	double sqinject_val;
-	
+	GverbEngine verb;					// reverb network and its state
 } t_gverb;
 
 /* method definitions for this object */
@@ -101,7 +40,6 @@ void gverb_float(t_gverb *x, double f);
 void gverb_int(t_gverb *x, long l);
 void gverb_assist(t_gverb *x, t_object *b, long msg, long arg, char *s);
 void gverb_getinfo(t_gverb *x);
-void gverb_init(t_gverb *x);
 void gverb_free(t_gverb *x);
 /* method definitions for debugging this object */
 #ifdef DEBUG
@@ -165,22 +103,11 @@ void *gverb_new(double d)
 	outlet_new((t_pxobject *)x, "signal");			// left outlet
 	outlet_new((t_pxobject *)x, "signal");			// right outlet
 	
-	/* setup variables */
-	x->verb_decay = d > 0.0 ? d : 1000.0;
-	x->verb_decay_1over = d > 0.0 ? 1.0 / d : 0.001;
-	
-	// get sample rate info
-	x->output_sr = sys_getsr();
-	x->output_msr = x->output_sr * 0.001;
-	x->output_1overmsr = 1.0 / x->output_msr;
-	
-	// initialize square injection value
-	x->sqinject_val = TINY_DC;
-	
-	x->verb_decay_coeff = 
-			pow(10.0, (-16416.0 * x->verb_decay_1over * x->output_1overmsr));
-	
-	gverb_init(x);
+	if (!x->verb.init(d, sys_getsr())) {
+		object_error((t_object*)x, "could not allocate delay lines");
+		object_free(x);
+		return NULL;
+	}
 	
 	x->x_obj.z_misc = Z_NO_INPLACE;
     
@@ -214,19 +141,10 @@ void gverb_dsp64(t_gverb *x, t_object *dsp64, short *count, double samplerate,
     #endif /* DEBUG */
     
     // check inlet connection
-    x->verb_decay_connected = count[1];
-    
-    // get sample rate info
-    x->output_sr = samplerate;
-    x->output_msr = x->output_sr * 0.001;
-    x->output_1overmsr = 1.0 / x->output_msr;
-    
-    x->verb_decay_coeff =
-    pow(10.0, (-16416.0 * x->verb_decay_1over * x->output_1overmsr));
+    x->verb.verb_decay_connected = count[1];
     
-    // update allpass mod with sampling rate
-    rbb_set_allpassMod_freq(x->apFilters_mod, AP_MODRATE_1, x->output_sr);
-    rbb_set_allpassMod_freq(((x->apFilters_mod) + 1), AP_MODRATE_2, x->output_sr);
+    // update decay coeff and allpass mod with sampling rate
+    x->verb.setSampleRate(samplerate);
     
     dsp_add64(dsp64, (t_object*)x, (t_perfroutine64)gverb_perform64, 0, NULL);
     
@@ -252,104 +170,7 @@ void gverb_dsp64(t_gverb *x, t_object *dsp64, short *count, double samplerate,
 void gverb_perform64(t_gverb *x, t_object *dsp64, double **ins, long numins, double **outs,
                           long numouts, long vectorsize, long flags, void *userparam)
 {
-    // local vars for inlets/outlets
-    double *in_dry = ins[0];
-    double *in_decay = ins[1];
-    double *out_wet1 = outs[0];
-    double *out_wet2 = outs[1];
-    
-    // local vars for object vars
-    double fDecay = x->verb_decay_coeff;
-    double lastout_L = x->lastout_L;
-    double lastout_R = x->lastout_R;
-    double sqinject_val = x->sqinject_val * -1.0; // flip sign each time
-    
-    // local vars used for while loop, TODO: upgrade to doubles
-    double val_dry, val_decay, val_wet1, val_wet2;
-    float val_dry_float, x2, x3, x4, x5, x6;
-    float x7L, x8L, x9L, x10L, x11L, x12L, x13L, x14L;
-    float x7R, x8R, x9R, x10R, x11R, x12R, x13R, x14R;
-    long n;
-    
-    // check constraints
-    
-    n = vectorsize;
-    while(n--)
-    {
-        val_dry = *in_dry;				// grab input values
-        val_dry += sqinject_val;//TINY_DC;		// add small dc offset to protect against denormal
-        val_dry_float = (float)val_dry; // TODO: needed before double upgrade
-        val_decay = *in_decay;
-        
-        val_wet1 = val_wet2 = 0.0;		// zero output before each cycle
-        
-        // zero computation points before each cycle
-        x2 = x3 = x4 = x5 = x6 = 0.0;
-        x7L = x8L = x9L = x10L = x11L = x12L = x13L = x14L = 0.0;
-        x7R = x8R = x9R = x10R = x11R = x12R = x13R = x14R = 0.0;
-        
-        if (x->verb_decay_connected)	// if decay inlet has signal input..
-        {	// recompute decay coeff each sample
-            fDecay = pow(10.0, (-16416.0 * x->output_1overmsr / val_decay));
-        }
-        
-        /***** begin processing of samples here *****/
-        
-        // lowpass 0
-        rbb_compute_lowPass1(&val_dry_float, x->lpFilters, &x2);
-        // allpass_short 0
-        rbb_compute_allpassShort(&x2, x->apFilters_short, &x3);
-        // allpass_short 1
-        rbb_compute_allpassShort(&x3, x->apFilters_short + 1, &x4);
-        // allpass_short 2
-        rbb_compute_allpassShort(&x4, x->apFilters_short + 2, &x5);
-        // allpass_short 3
-        rbb_compute_allpassShort(&x5, x->apFilters_short + 3, &x6);
-        
-        /* split*/
-        
-        // add recursion
-        x7L = x6 + lastout_R;
-        x7R = x6 + lastout_L;
-        // allpass_mod 0 & 1
-        rbb_compute_allpassMod(&x7L, x->apFilters_mod, &x8L);
-        rbb_compute_allpassMod(&x7R, x->apFilters_mod + 1, &x8R);
-        // delaybuff_small 0 & 1
-        rbb_compute_shortDelay(&x8L, x->delayBuffs_small, &x9L);
-        rbb_compute_shortDelay(&x8R, x->delayBuffs_small + 1, &x9R);
-        // lowpass 1 & 2
-        rbb_compute_lowPass2(&x9L, x->lpFilters + 1, &x10L);
-        rbb_compute_lowPass2(&x9R, x->lpFilters + 2, &x10R);
-        // * decay
-        x11L = fDecay * x10L;
-        x11R = fDecay * x10R;
-        // allpass_long 0 & 1
-        rbb_compute_allpassLong(&x11L, x->apFilters_long, &x12L);
-        rbb_compute_allpassLong(&x11R, x->apFilters_long + 1, &x12R);
-        // delaybuff_small 2 & 3
-        rbb_compute_shortDelay(&x12L, x->delayBuffs_small + 2, &x13L);
-        rbb_compute_shortDelay(&x12R, x->delayBuffs_small + 3, &x13R);
-        // * decay
-        val_wet1 = fDecay * x13L;
-        val_wet2 = fDecay * x13R;
-        
-        /***** end processing of samples here *****/
-        
-        lastout_L = val_wet1;
-        lastout_R = val_wet2;
-        
-        *out_wet1 = 1.2 * x9R - 0.6 * x12R + 0.6 * x13R - 0.6 * x9L - 0.6 * x12L - 0.6 * x13L;
-        *out_wet2 = 1.2 * x9L - 0.6 * x12L + 0.6 * x13L - 0.6 * x9R - 0.6 * x12R - 0.6 * x13R;
-        
-        ++in_dry, ++in_decay, ++out_wet1, ++out_wet2;		// advance the pointers
-    }
-    
-    // update object variables
-    x->verb_decay_coeff = fDecay;
-    x->lastout_L = lastout_L;
-    x->lastout_R = lastout_R;
-    x->sqinject_val = sqinject_val;
-    
+    x->verb.process(ins[0], ins[1], outs[0], outs[1], vectorsize);
 }
 
 /********************************************************************************
@@ -366,13 +187,10 @@ void gverb_float(t_gverb *x, double f)
 	if (x->x_obj.z_in == 1) // if inlet 2
 	{
 		if (f > 0) {
-			x->verb_decay = f;
-			x->verb_decay_1over = 1.0 / x->verb_decay;
-			x->verb_decay_coeff = 
-				pow(10.0, (-16416.0 * x->verb_decay_1over * x->output_1overmsr));
+			x->verb.setDecay(f);
 			#ifdef DEBUG
-				object_post((t_object*)x, "decay time is %f", x->verb_decay);
-				object_post((t_object*)x, "decay coeff is %f", x->verb_decay_coeff);
+				object_post((t_object*)x, "decay time is %f", x->verb.verb_decay);
+				object_post((t_object*)x, "decay coeff is %f", x->verb.verb_decay_coeff);
 			#endif /* DEBUG */
 		}
 		else
@@ -400,13 +218,10 @@ void gverb_int(t_gverb *x, long l)
 	if (x->x_obj.z_in == 1) // if inlet 2
 	{
 		if (l > 0) {
-			x->verb_decay = (double) l;
-			x->verb_decay_1over = 1.0 / x->verb_decay;
-			x->verb_decay_coeff = 
-				pow(10.0, (-16416.0 * x->verb_decay_1over * x->output_1overmsr));
+			x->verb.setDecay((double) l);
 			#ifdef DEBUG
-				object_post((t_object*)x, "decay time is %f", x->verb_decay);
-				object_post((t_object*)x, "decay coeff is %f", x->verb_decay_coeff);
+				object_post((t_object*)x, "decay time is %f", x->verb.verb_decay);
+				object_post((t_object*)x, "decay coeff is %f", x->verb.verb_decay_coeff);
 			#endif /* DEBUG */
 		}
 		else
@@ -474,115 +289,6 @@ void gverb_getinfo(t_gverb *x)
 	object_post((t_object*)x, "Last updated on %s - www.nathanwolek.com", __DATE__);
 }
 
-/********************************************************************************
-void gverb_init(t_gverb *x)
-
-inputs:			x		-- pointer to our object
-				
-description:	initializes building blocks for the reverb algorithm
-returns:		nothing
-********************************************************************************/
-void gverb_init(t_gverb *x)
-{
-	int curr_num;
-	// local arrays for delay values
-	long temp_apsv[] = ALLPASS_SHORT_DELAY_VALUES;
-	long temp_aplv[] = ALLPASS_LONG_DELAY_VALUES;
-	long temp_sdv[] = DELAY_SMALL_VALUES;
-	long temp_apmv[] = ALLPASS_MOD_DELAY_INIT_VALUES;
-	
-	// local pointers to building blocks
-	rbb_sintable *ot_ptr = &(x->oscTable);
-	rbb_lowpass *lpf_ptr = x->lpFilters;
-	rbb_allpass_short *aps_ptr = x->apFilters_short;
-	rbb_allpass_long *apl_ptr = x->apFilters_long;
-	rbb_allpass_mod *apm_ptr = x->apFilters_mod;
-	rbb_delaybuff_short *sd_ptr = x->delayBuffs_small;
-	
-	// fill arrays with buffer lengths
-	curr_num = ALLPASS_SHORT_NUM;
-	while (--curr_num >= 0) {
-		x->apShort_values[curr_num] = temp_apsv[curr_num];
-	}
-	
-	curr_num = ALLPASS_LONG_NUM;
-	while (--curr_num >= 0) {
-		x->apLong_values[curr_num] = temp_aplv[curr_num];
-	}
-	
-	curr_num = DELAYBUFF_SMALL_NUM;
-	while (--curr_num >= 0) {
-		x->smallDelay_values[curr_num] = temp_sdv[curr_num];
-	}
-	
-	curr_num = ALLPASS_MOD_NUM;
-	while (--curr_num >= 0) {
-		x->apMod_init_values[curr_num] = temp_apmv[curr_num];
-	}
-	
-	// osc table
-	rbb_init_sinTable(ot_ptr);
-	
-	// lowpass filters
-	curr_num = LOWPASS_NUM;
-	while (--curr_num >= 0) {
-		rbb_init_lowPass(lpf_ptr + curr_num);
-	}
-	
-	// allpass short filters
-	curr_num = ALLPASS_SHORT_NUM;
-	while (--curr_num >= 0) {
-		rbb_init_allpassShort(aps_ptr + curr_num);
-		rbb_set_allpassShort_delay(aps_ptr + curr_num, x->apShort_values[curr_num]);
-	}
-	
-	// allpass long filters
-	curr_num = ALLPASS_LONG_NUM;
-	while (--curr_num >= 0) {
-		rbb_init_allpassLong(apl_ptr + curr_num);
-		rbb_set_allpassLong_delay(apl_ptr + curr_num, x->apLong_values[curr_num]);
-	}
-	
-	// allpass mod filters
-	curr_num = ALLPASS_MOD_NUM;
-	while (--curr_num >= 0) {
-		rbb_init_allpassMod(apm_ptr + curr_num, ot_ptr);
-		rbb_set_allpassMod_delay(apm_ptr + curr_num, x->apMod_init_values[curr_num]);
-	}
-	
-	// short delay buffers
-	curr_num = DELAYBUFF_SMALL_NUM;
-	while (--curr_num >= 0) {
-		rbb_init_shortDelay(sd_ptr + curr_num);
-		rbb_set_shortDelay_delay(sd_ptr + curr_num, x->smallDelay_values[curr_num]);
-	}
-	
-	rbb_set_lowPass_coeff(lpf_ptr, BANDWIDTH);
-	rbb_set_lowPass_coeff(lpf_ptr + 1, DAMPING);
-	rbb_set_lowPass_coeff(lpf_ptr + 2, DAMPING);
-	
-	rbb_set_allpassShort_coeff(aps_ptr, IN_DIFF_1);
-	rbb_set_allpassShort_coeff(aps_ptr + 1, IN_DIFF_1);
-	rbb_set_allpassShort_coeff(aps_ptr + 2, IN_DIFF_2);
-	rbb_set_allpassShort_coeff(aps_ptr + 3, IN_DIFF_2);
-	
-	rbb_set_allpassMod_coeff(apm_ptr, DEC_DIFF_1);
-	rbb_set_allpassMod_coeff(apm_ptr + 1, DEC_DIFF_1);
-	
-	apm_ptr->oscDepth = AP_MODDEPTH_1;
-	(apm_ptr + 1)->oscDepth = AP_MODDEPTH_2;
-	
-	rbb_set_allpassLong_coeff(apl_ptr, DEC_DIFF_2);
-	rbb_set_allpassLong_coeff(apl_ptr + 1, DEC_DIFF_2);
-	
-	#ifdef DEBUG
-		object_post((t_object*)x, "lowpass coeff is %f", (x->lpFilters)->coeff);
-	#endif /* DEBUG */
-	
-	x->lastout_L = 0.0;
-	x->lastout_R = 0.0;
-}
-
 /********************************************************************************
 void gverb_free(t_gverb *x)
 
@@ -593,45 +299,10 @@ returns:		nothing
 ********************************************************************************/
 void gverb_free(t_gverb *x)
 {
-	int curr_num;
-	// local pointers to building blocks
-	rbb_sintable *ot_ptr = &(x->oscTable);
-	rbb_allpass_short *aps_ptr = x->apFilters_short;
-	rbb_allpass_long *apl_ptr = x->apFilters_long;
-	rbb_allpass_mod *apm_ptr = x->apFilters_mod;
-	rbb_delaybuff_short *sd_ptr = x->delayBuffs_small;
-	
 	// must be first
 	dsp_free((t_pxobject *)x);
 	
-	// osc table
-	rbb_free_sinTable(ot_ptr);
-	
-	// allpass short filters
-	curr_num = ALLPASS_SHORT_NUM;
-	while (--curr_num >= 0) {
-		rbb_free_allpassShort(aps_ptr + curr_num);
-	}
-	
-	// allpass long filters
-	curr_num = ALLPASS_LONG_NUM;
-	while (--curr_num >= 0) {
-		rbb_free_allpassLong(apl_ptr + curr_num);
-	}
-	
-	// allpass mod filters
-	curr_num = ALLPASS_MOD_NUM;
-	while (--curr_num >= 0) {
-		rbb_free_allpassMod(apm_ptr + curr_num);
-	}
-	
-	// short delay buffers
-	curr_num = DELAYBUFF_SMALL_NUM;
-	while (--curr_num >= 0) {
-		rbb_free_shortDelay(sd_ptr + curr_num);
-	}
-	
-	
+	x->verb.free();
 }
 
 /* the following methods are only compiled into the code during debugging*/
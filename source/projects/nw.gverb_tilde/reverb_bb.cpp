@@ -6,750 +6,480 @@
 ** 
 ** 2002.05.20 started by Nathan Wolek
 ** 2002.08.19 added new local vars in compute functions
+** 2026.10.17 removed Max API calls so the blocks also build into nw_bench
+** 2026.10.17 compute functions moved into reverb_bb.h as inline methods
+** 2026.10.17 buffers are handed to init by the caller, who sizes and frees them
+** 2026.10.17 added rbb_arena to carve every buffer out of one allocation
 ** 
 */
 
 #include "reverb_bb.h"	// defines structs for reverb network
 
-using namespace c74::max;
-
 /********************************************************************************
-void rbb_init_sinTable(rbb_sintable *info_ptr)
+long rbb_arena_bytes(long length)
 
-inputs:			*info_ptr -- pointer to information needed for the delay buffer
-				
-description:	initializes a sine function table
-returns:		nothing
+inputs:			length	-- number of values in a buffer
+description:	space a buffer takes in an arena, so that the next one starts
+	on an RBB_ARENA_ALIGN boundary too
+returns:		size in bytes
 ********************************************************************************/
-void rbb_init_sinTable(rbb_sintable *info_ptr)
+static long rbb_arena_bytes(long length)
 {
-	int curr_value;
-	float x;
-	
-	// setup sine function table
-	info_ptr->tableLength = OSC_TABLE_SIZE;
-	info_ptr->table_alloc = (float*)sysmem_newptr((info_ptr->tableLength) * sizeof(float));
-	info_ptr->table_mem = info_ptr->table_alloc;
-	
-	// fill sine function table
-	curr_value = info_ptr->tableLength;
-	while (--curr_value >= 0)
-	{
-		x = curr_value/(float)info_ptr->tableLength;
-		info_ptr->table_alloc[curr_value] = (float) sin(x * 2.0f * PI_10);
-	}
-	
+	long bytes = length * (long)sizeof(double);
+
+	return (bytes + RBB_ARENA_ALIGN - 1) & ~(long)(RBB_ARENA_ALIGN - 1);
 }
 
 /********************************************************************************
-void rbb_free_sinTable(rbb_sintable *info_ptr)
+void rbb_arena::init(void)
 
-inputs:			*info_ptr -- pointer to information needed for the delay buffer
-				
-description:	frees memory of a sine table
+inputs:			nothing
+description:	empties an arena; call reserve for every buffer, then allocate,
+	then take the buffers back in the order they were reserved
 returns:		nothing
 ********************************************************************************/
-void rbb_free_sinTable(rbb_sintable *info_ptr)
+void rbb_arena::init(void)
 {
-	if (info_ptr->table_alloc)
-		sysmem_freeptr(info_ptr->table_alloc);
-	info_ptr->table_alloc = 0;
+	alloc = 0;
+	mem = 0;
+	size = 0;
+	used = 0;
 }
 
 /********************************************************************************
-void rbb_init_lowPass(rbb_lowpass *info_ptr)
+void rbb_arena::reserve(long length)
 
-inputs:			*info_ptr -- pointer to information needed for the lowpass filter
-				
-description:	initializes a lowpass filter
+inputs:			length	-- number of values in the buffer
+description:	counts a buffer toward the size of the allocation
 returns:		nothing
 ********************************************************************************/
-void rbb_init_lowPass(rbb_lowpass *info_ptr)
+void rbb_arena::reserve(long length)
 {
-	// setup lowpass filter
-	info_ptr->coeff = 0.0;
-	info_ptr->oneMcoeff = 1.0;
-	info_ptr->last_out = 0.0;
+	size += rbb_arena_bytes(length);
 }
 
 /********************************************************************************
-void rbb_set_lowPass_coeff(rbb_lowpass *info_ptr, float c)
+bool rbb_arena::allocate(void)
 
-inputs:			*info_ptr -- pointer to information needed for the lowpass filter
-				c		  -- coefficient
-description:	sets lowpass filter coefficient
-returns:		nothing
+inputs:			nothing
+description:	makes the single allocation for every reserved buffer
+returns:		false if the memory could not be allocated
 ********************************************************************************/
-void rbb_set_lowPass_coeff(rbb_lowpass *info_ptr, float c)
+bool rbb_arena::allocate(void)
 {
-	// set lowpass filter coefficient
-	info_ptr->coeff = c;
-	info_ptr->oneMcoeff = 1.0 - c;
+	alloc = (char *)malloc(size + RBB_ARENA_ALIGN - 1);
+	if (!alloc)
+		return false;
+
+	mem = (char *)(((size_t)alloc + RBB_ARENA_ALIGN - 1) & ~(size_t)(RBB_ARENA_ALIGN - 1));
+	used = 0;
+	return true;
 }
 
 /********************************************************************************
-void rbb_compute_lowPass1(float *in_ptr, rbb_lowpass *info_ptr, float *out_ptr)
+double *rbb_arena::take(long length)
 
-inputs:			*in_ptr -- pointer to input value
-				*info_ptr -- pointer to information needed for the lowpass filter
-				*out_ptr -- pointer to output value
-description:	computes the lowpass filter using coeff to multiply the input 
-	and oneMcoeff to multiply the recursive element
-returns:		nothing
+inputs:			length	-- number of values in the buffer, as reserved
+description:	hands out the next buffer, aligned to RBB_ARENA_ALIGN; buffers
+	sit in memory in the order they are taken
+returns:		the buffer, or 0 if the arena has no room left
 ********************************************************************************/
-void rbb_compute_lowPass1(float *in_ptr, rbb_lowpass *info_ptr, float *out_ptr)
+double *rbb_arena::take(long length)
 {
-	// compute output
-	*out_ptr = 		( *in_ptr 				* 	info_ptr->coeff) 
-				+	( info_ptr->last_out 	* 	info_ptr->oneMcoeff);
-				
-	// save output for sample delay
-	info_ptr->last_out = *out_ptr;
+	long bytes = rbb_arena_bytes(length);
+	double *buff;
+
+	if (!mem || used + bytes > size)
+		return 0;
+
+	buff = (double *)(mem + used);
+	used += bytes;
+	return buff;
 }
 
 /********************************************************************************
-void rbb_compute_lowPass2(float *in_ptr, rbb_lowpass *info_ptr, float *out_ptr)
+void rbb_arena::free(void)
 
-inputs:			*in_ptr -- pointer to input value
-				*info_ptr -- pointer to information needed for the lowpass filter
-				*out_ptr -- pointer to output value
-description:	computes the lowpass filter using oneMcoeff to multiply the input 
-	and coeff to multiply the recursive element
+inputs:			nothing
+description:	frees every buffer of the arena at once
 returns:		nothing
 ********************************************************************************/
-void rbb_compute_lowPass2(float *in_ptr, rbb_lowpass *info_ptr, float *out_ptr)
+void rbb_arena::free(void)
 {
-	// compute output
-	*out_ptr = 		( *in_ptr 				* 	info_ptr->oneMcoeff) 
-				+	( info_ptr->last_out 	* 	info_ptr->coeff);
-				
-	// save output for sample delay
-	info_ptr->last_out = *out_ptr;
+	if (alloc)
+		::free(alloc);
+	init();
 }
 
 /********************************************************************************
-void rbb_init_shortDelay(rbb_delaybuff_small *info_ptr)
+void rbb_sintable::init(double *mem)
 
-inputs:			*info_ptr -- pointer to information needed for the delay buffer
-				
-description:	initializes a short delay
+inputs:			mem		-- OSC_TABLE_SIZE values for the table
+description:	initializes a sine function table
 returns:		nothing
 ********************************************************************************/
-void rbb_init_shortDelay(rbb_delaybuff_short *info_ptr)
+void rbb_sintable::init(double *mem)
 {
 	int curr_value;
+	double x;
 	
-	// setup short delay buffer
-	info_ptr->buff_length = DELAY_SHORT_MAX;
-	info_ptr->buff_alloc = (float*)sysmem_newptr((info_ptr->buff_length) * sizeof(float));
-	info_ptr->buff_mem = info_ptr->buff_alloc;
-	info_ptr->buff_start = info_ptr->buff_alloc;	//added 2002.08.19
-	info_ptr->buff_end = info_ptr->buff_start + info_ptr->buff_length;	//added 2002.08.19
+	// setup sine function table
+	tableLength = OSC_TABLE_SIZE;
+	table_alloc = mem;
+	table_mem = table_alloc;
 	
-	// fill short delay buffer
-	curr_value = info_ptr->buff_length;
+	// fill sine function table
+	curr_value = tableLength;
 	while (--curr_value >= 0)
 	{
-		info_ptr->buff_alloc[curr_value] = 0.0f;
+		x = curr_value / (double)tableLength;
+		table_alloc[curr_value] = sin(x * 2.0 * PI_10);
 	}
-	
-	// remaining variables
-	info_ptr->delayLength = 0.;
 }
 
+
 /********************************************************************************
-void rbb_free_shortDelay(rbb_delaybuff_short *info_ptr)
+void rbb_lowpass::init(void)
 
-inputs:			*info_ptr -- pointer to information needed for the delay buffer
-				
-description:	frees memory of a short delay
+inputs:			nothing
+description:	initializes a lowpass filter
 returns:		nothing
 ********************************************************************************/
-void rbb_free_shortDelay(rbb_delaybuff_short *info_ptr)
+void rbb_lowpass::init(void)
 {
-	if (info_ptr->buff_alloc)
-		sysmem_freeptr(info_ptr->buff_alloc);
-	info_ptr->buff_alloc = 0;
+	// setup lowpass filter
+	coeff = 0.0;
+	oneMcoeff = 1.0;
+	last_out = 0.0;
 }
 
 /********************************************************************************
-void rbb_set_shortDelay_delay(rbb_delaybuff_short *info_ptr, long d)
+void rbb_lowpass::setCoeff(double c)
 
-inputs:			*info_ptr -- pointer to information needed for the delay buffer
-				d		  -- delay length
-description:	sets short delay length
+inputs:			c		  -- coefficient
+description:	sets lowpass filter coefficient
 returns:		nothing
 ********************************************************************************/
-void rbb_set_shortDelay_delay(rbb_delaybuff_short *info_ptr, long d)
+void rbb_lowpass::setCoeff(double c)
 {
-	if (0 < d && d <= info_ptr->buff_length)
-	{
-		info_ptr->delayLength = d;
-	}
-	else
-	{
-		info_ptr->delayLength = info_ptr->buff_length;
-		object_post(nullptr, "short delay: length %ld invalid, set to max %ld", d, info_ptr->delayLength);
-	}
+	coeff = c;
+	oneMcoeff = 1.0 - c;
 }
 
 /********************************************************************************
-void rbb_compute_shortDelay(float *in_ptr, rbb_delaybuff_small *info_ptr, float *out_ptr)
+void rbb_delaybuff_short::init(double *mem, long length)
 
-inputs:			*in_ptr -- pointer to input value
-				*info_ptr -- pointer to information needed for the delay buffer
-				*out_ptr -- pointer to output value
-description:	computes the short delays based on the info in the struct that is 
-	passed to the method
+inputs:			mem		-- buffer memory
+				length	-- buffer length, a power of two; the longest delay it
+						can hold
+description:	initializes a short delay
 returns:		nothing
 ********************************************************************************/
-void rbb_compute_shortDelay(float *in_ptr, rbb_delaybuff_short *info_ptr, float *out_ptr)
+void rbb_delaybuff_short::init(double *mem, long length)
 {
-	// compute read position
-	long b_length = info_ptr->buff_length;
-	float *b_write = info_ptr->buff_mem;
-	float *b_read = b_write - info_ptr->delayLength;
-	float *b_start = info_ptr->buff_start;
-	float *b_end = info_ptr->buff_end;
-	
-	// check bounds of read position
-	while (b_read < b_start) b_read += b_length;
-	while (b_read >= b_end) b_read -= b_length;
+	int curr_value;
 	
-	// pull output from buffer
-	*out_ptr = *b_read;
+	// setup short delay buffer
+	buff_length = length;
+	buff_mask = length - 1;
+	buff_alloc = mem;
+	buff_write = 0;
 	
-	// put input into buffer
-	*b_write = *in_ptr;
+	// fill short delay buffer
+	curr_value = buff_length;
+	while (--curr_value >= 0)
+	{
+		buff_alloc[curr_value] = 0.0;
+	}
 	
-	// advance write position and check bounds
-	info_ptr->buff_mem += 1;
-	if (info_ptr->buff_mem == b_end) info_ptr->buff_mem = b_start;
+	// remaining variables
+	delayLength = 0;
+}
+
+
+/********************************************************************************
+void rbb_delaybuff_short::setDelay(long d)
+
+inputs:			d		  -- delay length
+description:	sets short delay length, clipped to the buffer length
+returns:		nothing
+********************************************************************************/
+void rbb_delaybuff_short::setDelay(long d)
+{
+	if (0 < d && d <= buff_length)
+	{
+		delayLength = d;
+	}
+	else
+	{
+		delayLength = buff_length;
+	}
 }
 
 /********************************************************************************
-void rbb_init_longDelay(rbb_delaybuff_long *info_ptr)
+void rbb_delaybuff_long::init(double *mem, long length)
 
-inputs:			*info_ptr -- pointer to information needed for the delay buffer
-				
+inputs:			mem		-- buffer memory
+				length	-- buffer length, a power of two; the longest delay it
+						can hold
 description:	initializes a long delay
 returns:		nothing
 ********************************************************************************/
-void rbb_init_longDelay(rbb_delaybuff_long *info_ptr)
+void rbb_delaybuff_long::init(double *mem, long length)
 {
 	int curr_value;
 	
 	// setup long delay buffer
-	info_ptr->buff_length = DELAY_LONG_MAX;
-	info_ptr->buff_alloc = (float*)sysmem_newptr((info_ptr->buff_length) * sizeof(float));
-	info_ptr->buff_mem = info_ptr->buff_alloc;
-	info_ptr->buff_start = info_ptr->buff_alloc;	//added 2002.08.19
-	info_ptr->buff_end = info_ptr->buff_start + info_ptr->buff_length;	//added 2002.08.19
+	buff_length = length;
+	buff_mask = length - 1;
+	buff_alloc = mem;
+	buff_write = 0;
 	
 	// fill long delay buffer
-	curr_value = info_ptr->buff_length;
+	curr_value = buff_length;
 	while (--curr_value >= 0)
 	{
-		info_ptr->buff_alloc[curr_value] = 0.0f;
+		buff_alloc[curr_value] = 0.0;
 	}
 	
 	// remaining variables
-	info_ptr->delayLength = 0.;
+	delayLength = 0;
 }
 
-/********************************************************************************
-void rbb_free_longDelay(rbb_delaybuff_long *info_ptr)
-
-inputs:			*info_ptr -- pointer to information needed for the delay buffer
-				
-description:	frees memory of a long delay
-returns:		nothing
-********************************************************************************/
-void rbb_free_longDelay(rbb_delaybuff_long *info_ptr)
-{
-	if (info_ptr->buff_alloc)
-		sysmem_freeptr(info_ptr->buff_alloc);
-	info_ptr->buff_alloc = 0;
-}
 
 /********************************************************************************
-void rbb_set_longDelay_delay(rbb_delaybuff_long *info_ptr, long d)
+void rbb_delaybuff_long::setDelay(long d)
 
-inputs:			*info_ptr -- pointer to information needed for the delay buffer
-				d		  -- delay length
-description:	sets long delay length
+inputs:			d		  -- delay length
+description:	sets long delay length, clipped to the buffer length
 returns:		nothing
 ********************************************************************************/
-void rbb_set_longDelay_delay(rbb_delaybuff_long *info_ptr, long d)
+void rbb_delaybuff_long::setDelay(long d)
 {
-	if (0 < d && d <= info_ptr->buff_length)
+	if (0 < d && d <= buff_length)
 	{
-		info_ptr->delayLength = d;
+		delayLength = d;
 	}
 	else
 	{
-		info_ptr->delayLength = info_ptr->buff_length;
-		object_post(nullptr, "long delay: length %ld invalid, set to max %ld", d, info_ptr->delayLength);
+		delayLength = buff_length;
 	}
 }
 
 /********************************************************************************
-void rbb_compute_longDelay(float *in_ptr, rbb_delaybuff_long *info_ptr, float *out_ptr)
-
-inputs:			*in_ptr -- pointer to input value
-				*info_ptr -- pointer to information needed for the delay buffer
-				*out_ptr -- pointer to output value
-description:	computes a long delay based on the info in the struct that is 
-	passed to the method
-returns:		nothing
-********************************************************************************/
-void rbb_compute_longDelay(float *in_ptr, rbb_delaybuff_long *info_ptr, float *out_ptr)
-{
-	// compute read position
-	long b_length = info_ptr->buff_length;
-	float *b_write = info_ptr->buff_mem;
-	float *b_read = b_write - info_ptr->delayLength;
-	float *b_start = info_ptr->buff_start;
-	float *b_end = info_ptr->buff_end;
-	
-	// check bounds of read position
-	while (b_read < b_start) b_read += b_length;
-	while (b_read >= b_end) b_read -= b_length;
-	
-	// pull output from buffer
-	*out_ptr = *b_read;
-	
-	// put input into buffer
-	*b_write = *in_ptr;
-	
-	// advance write position and check bounds
-	info_ptr->buff_mem += 1;
-	if (info_ptr->buff_mem == b_end) info_ptr->buff_mem = b_start;
-}
-
-/********************************************************************************
-void rbb_init_allpassShort(rbb_allpass_short *info_ptr)
+void rbb_allpass_short::init(double *mem, long length)
 
-inputs:			*info_ptr -- pointer to information needed for the allpass
-				
-description:	initializes a short allpass filter
+inputs:			mem		-- buffer memory
+				length	-- buffer length, a power of two; the longest delay it
+						can hold
+description:	initializes a short delay buffer allpass filter
 returns:		nothing
 ********************************************************************************/
-void rbb_init_allpassShort(rbb_allpass_short *info_ptr)
+void rbb_allpass_short::init(double *mem, long length)
 {
 	int curr_value;
 	
 	// setup allpass short delay buffer
-	info_ptr->buff_length = ALLPASS_SHORT_DELAY_MAX;
-	info_ptr->buff_alloc = (float*)sysmem_newptr((info_ptr->buff_length) * sizeof(float));
-	info_ptr->buff_mem = info_ptr->buff_alloc;
-	info_ptr->buff_start = info_ptr->buff_alloc;	//added 2002.08.19
-	info_ptr->buff_end = info_ptr->buff_start + info_ptr->buff_length;	//added 2002.08.19
+	buff_length = length;
+	buff_mask = length - 1;
+	buff_alloc = mem;
+	buff_write = 0;
 	
 	// fill allpass short delay buffer
-	curr_value = info_ptr->buff_length;
+	curr_value = buff_length;
 	while (--curr_value >= 0)
 	{
-		info_ptr->buff_alloc[curr_value] = 0.0f;
+		buff_alloc[curr_value] = 0.0;
 	}
 	
 	// remaining variables
-	info_ptr->delayLength = 0.;
-	info_ptr->coeff = 0.0;
-	info_ptr->coeff_neg = 0.0;
+	delayLength = 0;
+	coeff = 0.0;
+	coeff_neg = 0.0;
 }
 
-/********************************************************************************
-void rbb_free_allpassShort(rbb_allpass_short *info_ptr)
-
-inputs:			*info_ptr -- pointer to information needed for the delay buffer
-				
-description:	frees memory of a short allpass delay
-returns:		nothing
-********************************************************************************/
-void rbb_free_allpassShort(rbb_allpass_short *info_ptr)
-{
-	if (info_ptr->buff_alloc)
-		sysmem_freeptr(info_ptr->buff_alloc);
-	info_ptr->buff_alloc = 0;
-}
 
 /********************************************************************************
-void rbb_set_allpassShort_coeff(rbb_allpass_short *info_ptr, float c)
+void rbb_allpass_short::setCoeff(double c)
 
-inputs:			*info_ptr -- pointer to information needed for the allpass filter
-				c		  -- coefficient
+inputs:			c		  -- coefficient
 description:	sets allpass filter coefficient
 returns:		nothing
 ********************************************************************************/
-void rbb_set_allpassShort_coeff(rbb_allpass_short *info_ptr, float c)
+void rbb_allpass_short::setCoeff(double c)
 {
-	// set lowpass filter coefficient
-	info_ptr->coeff = c;
-	info_ptr->coeff_neg = -1.0 * c;
+	coeff = c;
+	coeff_neg = -1.0 * c;
 }
 
 /********************************************************************************
-void rbb_set_allpassShort_delay(rbb_allpass_short *info_ptr, long d)
+void rbb_allpass_short::setDelay(long d)
 
-inputs:			*info_ptr -- pointer to information needed for the delay buffer
-				d		  -- delay length
-description:	sets short allpass delay length
+inputs:			d		  -- delay length
+description:	sets allpass delay length, clipped to the buffer length
 returns:		nothing
 ********************************************************************************/
-void rbb_set_allpassShort_delay(rbb_allpass_short *info_ptr, long d)
+void rbb_allpass_short::setDelay(long d)
 {
-	if (0 < d && d <= info_ptr->buff_length)
+	if (0 < d && d <= buff_length)
 	{
-		info_ptr->delayLength = d;
+		delayLength = d;
 	}
 	else
 	{
-		info_ptr->delayLength = info_ptr->buff_length;
-		object_post(nullptr, "allpass short: length %ld invalid, set to max %ld", d, info_ptr->delayLength);
+		delayLength = buff_length;
 	}
 }
 
 /********************************************************************************
-void rbb_compute_allpassShort(float *in_ptr, rbb_allpass_short *info_ptr, float *out_ptr)
-
-inputs:			*in_ptr -- pointer to input value
-				*info_ptr -- pointer to information needed for the allpass
-				*out_ptr -- pointer to output value
-description:	computes the shorter delay buffer allpass filters
-returns:		nothing
-********************************************************************************/
-void rbb_compute_allpassShort(float *in_ptr, rbb_allpass_short *info_ptr, float *out_ptr)
-{
-	// compute read position
-	long b_length = info_ptr->buff_length;
-	float *b_write = info_ptr->buff_mem;
-	float *b_read = b_write - info_ptr->delayLength;
-	float *b_start = info_ptr->buff_start;
-	float *b_end = info_ptr->buff_end;
-	
-	// check bounds of read position
-	while (b_read < b_start) b_read += b_length;
-	while (b_read >= b_end) b_read -= b_length;
-	
-	// compute output
-	*out_ptr = ( *in_ptr * info_ptr->coeff ) + *b_read;
-	
-	// compute feedback
-	*b_write = *in_ptr + ( *out_ptr * info_ptr->coeff_neg );
-	
-	// advance write position and check bounds
-	info_ptr->buff_mem += 1;
-	if (info_ptr->buff_mem == b_end) info_ptr->buff_mem = b_start;
-}
-
-/********************************************************************************
-void rbb_init_allpassLong(rbb_allpass_long *info_ptr)
+void rbb_allpass_long::init(double *mem, long length)
 
-inputs:			*info_ptr -- pointer to information needed for the allpass
-				
-description:	initializes long delay buffer allpass filters
+inputs:			mem		-- buffer memory
+				length	-- buffer length, a power of two; the longest delay it
+						can hold
+description:	initializes a long delay buffer allpass filter
 returns:		nothing
 ********************************************************************************/
-void rbb_init_allpassLong(rbb_allpass_long *info_ptr)
+void rbb_allpass_long::init(double *mem, long length)
 {
 	int curr_value;
 	
 	// setup allpass long delay buffer
-	info_ptr->buff_length = ALLPASS_LONG_DELAY_MAX;
-	info_ptr->buff_alloc = (float*)sysmem_newptr((info_ptr->buff_length) * sizeof(float));
-	info_ptr->buff_mem = info_ptr->buff_alloc;
-	info_ptr->buff_start = info_ptr->buff_alloc;	//added 2002.08.19
-	info_ptr->buff_end = info_ptr->buff_start + info_ptr->buff_length;	//added 2002.08.19
+	buff_length = length;
+	buff_mask = length - 1;
+	buff_alloc = mem;
+	buff_write = 0;
 	
 	// fill allpass long delay buffer
-	curr_value = info_ptr->buff_length;
+	curr_value = buff_length;
 	while (--curr_value >= 0)
 	{
-		info_ptr->buff_alloc[curr_value] = 0.0f;
+		buff_alloc[curr_value] = 0.0;
 	}
 	
 	// remaining variables
-	info_ptr->delayLength = 0.;
-	info_ptr->coeff = 0.0;
-	info_ptr->coeff_neg = 0.0;
+	delayLength = 0;
+	coeff = 0.0;
+	coeff_neg = 0.0;
 }
 
-/********************************************************************************
-void rbb_free_allpassLong(rbb_allpass_long *info_ptr)
-
-inputs:			*info_ptr -- pointer to information needed for the delay buffer
-				
-description:	frees memory of a long allpass delay
-returns:		nothing
-********************************************************************************/
-void rbb_free_allpassLong(rbb_allpass_long *info_ptr)
-{
-	if (info_ptr->buff_alloc)
-		sysmem_freeptr(info_ptr->buff_alloc);
-	info_ptr->buff_alloc = 0;
-}
 
 /********************************************************************************
-void rbb_set_allpassLong_coeff(rbb_allpass_long *info_ptr, float c)
+void rbb_allpass_long::setCoeff(double c)
 
-inputs:			*info_ptr -- pointer to information needed for the allpass filter
-				c		  -- coefficient
+inputs:			c		  -- coefficient
 description:	sets allpass filter coefficient
 returns:		nothing
 ********************************************************************************/
-void rbb_set_allpassLong_coeff(rbb_allpass_long *info_ptr, float c)
+void rbb_allpass_long::setCoeff(double c)
 {
-	// set lowpass filter coefficient
-	info_ptr->coeff = c;
-	info_ptr->coeff_neg = -1.0 * c;
+	coeff = c;
+	coeff_neg = -1.0 * c;
 }
 
 /********************************************************************************
-void rbb_set_allpassLong_delay(rbb_allpass_long *info_ptr, long d)
+void rbb_allpass_long::setDelay(long d)
 
-inputs:			*info_ptr -- pointer to information needed for the delay buffer
-				d		  -- delay length
-description:	sets long allpass delay length
+inputs:			d		  -- delay length
+description:	sets allpass delay length, clipped to the buffer length
 returns:		nothing
 ********************************************************************************/
-void rbb_set_allpassLong_delay(rbb_allpass_long *info_ptr, long d)
+void rbb_allpass_long::setDelay(long d)
 {
-	if (0 < d && d <= info_ptr->buff_length)
+	if (0 < d && d <= buff_length)
 	{
-		info_ptr->delayLength = d;
+		delayLength = d;
 	}
 	else
 	{
-		info_ptr->delayLength = info_ptr->buff_length;
-		object_post(nullptr, "allpass long: length %ld invalid, set to max %ld", d, info_ptr->delayLength);
+		delayLength = buff_length;
 	}
 }
 
 /********************************************************************************
-void rbb_compute_allpassLong(float *in_ptr, rbb_allpass_long *info_ptr, float *out_ptr)
-
-inputs:			*in_ptr -- pointer to input value
-				*info_ptr -- pointer to information needed for the allpass
-				*out_ptr -- pointer to output value
-description:	computes the longer delay buffer allpass filters
-returns:		nothing
-********************************************************************************/
-void rbb_compute_allpassLong(float *in_ptr, rbb_allpass_long *info_ptr, float *out_ptr)
-{
-	// compute read position
-	long b_length = info_ptr->buff_length;
-	float *b_write = info_ptr->buff_mem;
-	float *b_read = b_write - info_ptr->delayLength;
-	float *b_start = info_ptr->buff_start;
-	float *b_end = info_ptr->buff_end;
-	
-	// check bounds of read position
-	while (b_read < b_start) b_read += b_length;
-	while (b_read >= b_end) b_read -= b_length;
-	
-	// compute output
-	*out_ptr = ( *in_ptr * info_ptr->coeff ) + *b_read;
-	
-	// compute feedback
-	*b_write = *in_ptr + ( *out_ptr * info_ptr->coeff_neg );
-	
-	// advance write position and check bounds
-	info_ptr->buff_mem += 1;
-	if (info_ptr->buff_mem == b_end) info_ptr->buff_mem = b_start;
-}
-
-/********************************************************************************
-void rbb_init_allpassMod(rbb_allpass_mod *info_ptr, rbb_sintable *osc_ptr)
+void rbb_allpass_mod::init(double *mem, long length, rbb_sintable *osc_ptr)
 
-inputs:			*info_ptr -- pointer to information needed for the allpass
+inputs:			mem		-- buffer memory
+				length	-- buffer length, a power of two; the longest delay it
+						can hold
 				*osc_ptr  -- pointer to oscilation table
 description:	initializes a modulating delay buffer allpass filter
 returns:		nothing
 ********************************************************************************/
-void rbb_init_allpassMod(rbb_allpass_mod *info_ptr, rbb_sintable *osc_ptr)
+void rbb_allpass_mod::init(double *mem, long length, rbb_sintable *osc_ptr)
 {
 	int curr_value;
 	
-	// setup allpass long delay buffer
-	info_ptr->buff_length = ALLPASS_MOD_DELAY_MAX;
-	info_ptr->buff_alloc = (float*)sysmem_newptr((info_ptr->buff_length) * sizeof(float));
-	info_ptr->buff_mem = info_ptr->buff_alloc;
-	info_ptr->buff_start = info_ptr->buff_alloc;	//added 2002.08.19
-	info_ptr->buff_end = info_ptr->buff_start + info_ptr->buff_length;	//added 2002.08.19
-	info_ptr->buff_write = 0;
+	// setup allpass mod delay buffer
+	buff_length = length;
+	buff_mask = length - 1;
+	buff_alloc = mem;
+	buff_write = 0;
 	
-	// fill allpass long delay buffer
-	curr_value = info_ptr->buff_length;
+	// fill allpass mod delay buffer
+	curr_value = buff_length;
 	while (--curr_value >= 0)
 	{
-		info_ptr->buff_alloc[curr_value] = 0.0f;
+		buff_alloc[curr_value] = 0.0;
 	}
 	
 	// remaining variables
-	info_ptr->coeff = 0.0;
-	info_ptr->coeff_neg = 0.0;
-	info_ptr->initDelayLength = 0.;
-	info_ptr->oscTable = osc_ptr;
-	info_ptr->oscPhase = 0.0;
-	info_ptr->oscFreq = 0.0;
-	info_ptr->oscSamplingInc = 0.0;
-	info_ptr->oscDepth = 0.0;
-	info_ptr->last_out = 0.0;
-	info_ptr->last_lfo = 0.0;
+	coeff = 0.0;
+	coeff_neg = 0.0;
+	initDelayLength = 0;
+	oscTable = osc_ptr;
+	oscPhase = 0.0;
+	oscFreq = 0.0;
+	oscSamplingInc = 0.0;
+	oscDepth = 0.0;
+	last_out = 0.0;
+	last_lfo = 0.0;
 }
 
-/********************************************************************************
-void rbb_free_allpassMod(rbb_allpass_mod *info_ptr)
-
-inputs:			*info_ptr -- pointer to information needed for the delay buffer
-				
-description:	frees memory of a modulating allpass delay
-returns:		nothing
-********************************************************************************/
-void rbb_free_allpassMod(rbb_allpass_mod *info_ptr)
-{
-	if (info_ptr->buff_alloc)
-		sysmem_freeptr(info_ptr->buff_alloc);
-	info_ptr->buff_alloc = 0;
-}
 
 /********************************************************************************
-void rbb_set_allpassMod_coeff(rbb_allpass_mod *info_ptr, float c)
+void rbb_allpass_mod::setCoeff(double c)
 
-inputs:			*info_ptr -- pointer to information needed for the allpass filter
-				c		  -- coefficient
+inputs:			c		  -- coefficient
 description:	sets allpass filter coefficient
 returns:		nothing
 ********************************************************************************/
-void rbb_set_allpassMod_coeff(rbb_allpass_mod *info_ptr, float c)
+void rbb_allpass_mod::setCoeff(double c)
 {
-	// set lowpass filter coefficient
-	info_ptr->coeff = c;
-	info_ptr->coeff_neg = -1.0 * c;
+	coeff = c;
+	coeff_neg = -1.0 * c;
 }
 
 /********************************************************************************
-void rbb_set_allpassMod_freq(rbb_allpass_mod *info_ptr, float f, float sr)
+void rbb_allpass_mod::setFreq(double f, double sr)
 
-inputs:			*info_ptr -- pointer to information needed for the allpass filter
-				f		  -- frequency
+inputs:			f		  -- frequency
 				sr		  -- sampling rate
 description:	sets allpass filter modulation frequency
 returns:		nothing
 ********************************************************************************/
-void rbb_set_allpassMod_freq(rbb_allpass_mod *info_ptr, float f, float sr)
+void rbb_allpass_mod::setFreq(double f, double sr)
 {
-	// set lowpass filter coefficient
-	info_ptr->oscFreq = f;
-	info_ptr->oscSamplingInc = (info_ptr->oscTable)->tableLength * f / sr;
+	oscFreq = f;
+	oscSamplingInc = oscTable->tableLength * f / sr;
 }
 
 /********************************************************************************
-void rbb_set_allpassMod_delay(rbb_allpass_mod *info_ptr, long d)
+void rbb_allpass_mod::setDelay(long d)
 
-inputs:			*info_ptr -- pointer to information needed for the delay buffer
-				d		  -- delay length
-description:	sets modulating allpass delay length
+inputs:			d		  -- delay length
+description:	sets modulating allpass delay length, clipped so that the read
+	position stays in the buffer at full modulation depth; set oscDepth first
 returns:		nothing
 ********************************************************************************/
-void rbb_set_allpassMod_delay(rbb_allpass_mod *info_ptr, long d)
+void rbb_allpass_mod::setDelay(long d)
 {
-	if (0 < d && d <= info_ptr->buff_length)
+	if (0 < d && d + (long)oscDepth + 2 <= buff_length)
 	{
-		info_ptr->initDelayLength = d;
+		initDelayLength = d;
 	}
 	else
 	{
-		info_ptr->initDelayLength = info_ptr->buff_length - (long)info_ptr->oscDepth + 1;
-		object_post(nullptr, "allpass long: length %ld invalid, set to max %ld", d, info_ptr->initDelayLength);
-	}
-}
-
-/********************************************************************************
-void rbb_compute_allpassMod(float *in_ptr, rbb_allpass_mod *info_ptr, float *out_ptr)
-
-inputs:			*in_ptr -- pointer to input value
-				*info_ptr -- pointer to information needed for the allpass
-				*out_ptr -- pointer to output value
-description:	computes the modulating delay buffer allpass filters
-returns:		nothing
-********************************************************************************/
-void rbb_compute_allpassMod(float *in_ptr, rbb_allpass_mod *info_ptr, float *out_ptr)
-{
-	float lfo_out, buffRead, buffer_output;
-	
-	long b_length = info_ptr->buff_length;
-	float *b_start = info_ptr->buff_start;
-	float *b_end = info_ptr->buff_end;
-	float *b_write = info_ptr->buff_mem;
-	long ot_length = (info_ptr->oscTable)->tableLength;
-	
-	// compute phase
-	info_ptr->oscPhase += info_ptr->oscSamplingInc;
-	
-	// check bounds of phase
-	while (info_ptr->oscPhase >= (float)ot_length) 
-			info_ptr->oscPhase -= (float)ot_length;
-	
-	rbb_allpassInterp((info_ptr->oscTable)->table_alloc, info_ptr->oscPhase, 
-			ot_length, info_ptr->last_lfo, &lfo_out);
-	info_ptr->last_lfo = lfo_out;
-	
-	// compute read position
-	buffRead = (float)(info_ptr->buff_write) - info_ptr->initDelayLength + 
-			(lfo_out * info_ptr->oscDepth);
-	
-	// check bounds of read position
-	while (buffRead < 0.0) buffRead += (float)b_length;
-	while (buffRead >= (float)b_length) buffRead -= (float)b_length;
-	
-	// all pass interpolate the buffer output
-	rbb_allpassInterp(info_ptr->buff_alloc, buffRead, b_length, 
-			info_ptr->last_out, &buffer_output);
-	info_ptr->last_out = buffer_output;				// update last_out
-	
-	// compute output
-	*out_ptr = ( *in_ptr * info_ptr->coeff_neg ) + buffer_output;
-	
-	// compute feedback
-	*b_write = *in_ptr + ( *out_ptr * info_ptr->coeff );
-	
-	// advance write position and check bounds
-	info_ptr->buff_write += 1;
-	info_ptr->buff_mem += 1;
-	if (info_ptr->buff_mem == b_end)
-	{
-		info_ptr->buff_write = 0;
-		info_ptr->buff_mem = b_start;
+		initDelayLength = buff_length - (long)oscDepth - 2;
 	}
 }
-
-/********************************************************************************
-float rbb_allpassInterp(float *in_array, float index, long bufferLength, 
-		float last_out, float *out_ptr)
-
-inputs:			in_array -- name of array of input values
-				index -- floating point index value to interpolate
-				bufferLength -- length of in_array
-				last_out -- value of last output from buffer
-				out_ptr -- pointer to output location
-description:	performs allpass interpolation on an input array and returns the
-	results to a location specified by a pointer; implements filter as specified
-	in Dattorro 2: J. Audio Eng. Soc., Vol 45, No 10, 1997 October
-returns:		interpolated output
-********************************************************************************/
-void rbb_allpassInterp(float *in_array, float index, long bufferLength, 
-		float last_out, float *out_ptr)
-{
-	// index = i.frac
-	long index_i = (long)index;					// i
-	long index_iP1 = index_i + 1;				// i + 1
-	float index_frac = index - (float)index_i;	// frac
-	
-	// make sure that index_iP1 is not out of range
-	while (index_iP1 >= bufferLength) index_iP1 -= bufferLength;
-	
-	// formula as on bottom of page 765 of above Dattorro article
-	*out_ptr = in_array[index_i] + index_frac * (in_array[index_iP1] - last_out);
-}
\ No newline at end of file
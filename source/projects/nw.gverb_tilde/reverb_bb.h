@@ -3,11 +3,16 @@
 **
 ** header file
 ** defines building blocks for reverb algorithms
-** 
+**
 ** 2002/05/20 started by Nathan Wolek
 ** 2002/07/18 first working version
 ** 2002.08.19 added new local vars in compute functions
-** 
+** 2026.10.17 removed Max API calls so the blocks also build into nw_bench
+** 2026.10.17 blocks are structs with inline compute methods, in double precision
+** 2026.10.17 buffers are handed to init by the caller, who sizes and frees them
+** 2026.10.17 added rbb_arena to carve every buffer out of one allocation
+** 2026.10.17 delay lines are power of two rings indexed through a mask
+**
 */
 
 #ifndef __REVERB_BB
@@ -18,140 +23,343 @@
 #include <math.h>
 #endif /* __MATH_H */
 
-#ifndef __MAXMSP_EXTLIB
-	#define __MAXMSP_EXTLIB
-	#include "c74_msp.h"
-#endif /* __MAXMSP_EXTLIB */
+#include <stdlib.h>
+
+#include "nw_interp.h"	// for NW_FORCEINLINE
 
 #define PI_10 3.141592654
 #define OSC_TABLE_SIZE 1024			// size of oscillation table
-#define DELAY_SHORT_MAX 5000			// size of short delay line buffer
-#define DELAY_LONG_MAX 44100			// size of long delay line buffer
-#define COMB_LONG_DELAY_MAX 2000		// size of comb long delay line
-#define ALLPASS_SHORT_DELAY_MAX 500		// size of allpass short delay line
-#define ALLPASS_LONG_DELAY_MAX 3000		// size of allpass long delay line
-#define ALLPASS_MOD_DELAY_MAX 1000		// size of modulating allpass delay line
-
-typedef struct _sintable {			// sinTable info
+#define RBB_ARENA_ALIGN 64			// alignment of each buffer in an arena, in bytes
+
+/*
+** the compute methods are inlined so that a network calling them per sample
+** keeps the state of each block in registers; copy a block into a local,
+** run it, and copy it back to get the same effect across a whole loop.  the
+** computeBlock methods do exactly that for a stage with no feedback from
+** later in the network, and may be called in place (in == out)
+**
+** every delay line holds a power of two number of values, so the write
+** position is a single index and the read position is (write - delay) & mask
+*/
+
+struct rbb_arena {					// single allocation shared by many buffers
+	char *alloc;			// as returned by malloc
+	char *mem;				// alloc rounded up to RBB_ARENA_ALIGN
+	long size;				// bytes reserved
+	long used;				// bytes handed out
+
+	void init(void);
+	void reserve(long length);
+	bool allocate(void);
+	double *take(long length);
+	void free(void);
+};
+
+struct rbb_sintable {				// sinTable info
 	long tableLength;
-	float *table_alloc;
-	float *table_mem;
-} rbb_sintable;
-
-typedef struct _lowpass {			// lowpass filter info
-	float coeff;
-	float oneMcoeff;
-	float last_out;
-} rbb_lowpass;
-
-typedef struct _delaybuff_short {			// short delay buffer info
-	long buff_length;
-	float *buff_alloc;
-	float *buff_mem;
-	float *buff_start;		//added 2002.08.19
-	float *buff_end;		//added 2002.08.19
-	long delayLength;
-} rbb_delaybuff_short;
-
-typedef struct _delaybuff_long {			// long delay buffer info
-	long buff_length;
-	float *buff_alloc;
-	float *buff_mem;
-	float *buff_start;		//added 2002.08.19
-	float *buff_end;		//added 2002.08.19
+	double *table_alloc;
+	double *table_mem;
+
+	void init(double *mem);
+};
+
+struct rbb_lowpass {				// lowpass filter info
+	double coeff;
+	double oneMcoeff;
+	double last_out;
+
+	void init(void);
+	void setCoeff(double c);
+	double compute1(double in);
+	double compute2(double in);
+	void computeBlock1(const double *in, double *out, long n);
+};
+
+struct rbb_delaybuff_short {		// short delay buffer info
+	long buff_length;		// a power of two
+	long buff_mask;			// buff_length - 1
+	double *buff_alloc;
+	long buff_write;		// index of the next value to write
 	long delayLength;
-} rbb_delaybuff_long;
-
-typedef struct _comb_long {		// comb_long filter info
-	float coeff;
-	long buff_length;
-	float *buff_alloc;
-	float *buff_mem;
-	float *buff_start;		//added 2002.08.19
-	float *buff_end;		//added 2002.08.19
+
+	void init(double *mem, long length);
+	void setDelay(long d);
+	double compute(double in);
+};
+
+struct rbb_delaybuff_long {			// long delay buffer info
+	long buff_length;		// a power of two
+	long buff_mask;			// buff_length - 1
+	double *buff_alloc;
+	long buff_write;		// index of the next value to write
 	long delayLength;
-} rbb_comb_long;
-
-typedef struct _allpass_short {		// allpass_short filter info
-	float coeff;
-	float coeff_neg;
-	long buff_length;
-	float *buff_alloc;
-	float *buff_mem;
-	float *buff_start;		//added 2002.08.19
-	float *buff_end;		//added 2002.08.19
+
+	void init(double *mem, long length);
+	void setDelay(long d);
+	double compute(double in);
+};
+
+struct rbb_allpass_short {			// allpass_short filter info
+	double coeff;
+	double coeff_neg;
+	long buff_length;		// a power of two
+	long buff_mask;			// buff_length - 1
+	double *buff_alloc;
+	long buff_write;		// index of the next value to write
 	long delayLength;
-} rbb_allpass_short;
-
-typedef struct _allpass_long {		// allpass_long filter info
-	float coeff;
-	float coeff_neg;
-	long buff_length;
-	float *buff_alloc;
-	float *buff_mem;
-	float *buff_start;		//added 2002.08.19
-	float *buff_end;		//added 2002.08.19
+
+	void init(double *mem, long length);
+	void setCoeff(double c);
+	void setDelay(long d);
+	double compute(double in);
+	void computeBlock(const double *in, double *out, long n);
+};
+
+struct rbb_allpass_long {			// allpass_long filter info
+	double coeff;
+	double coeff_neg;
+	long buff_length;		// a power of two
+	long buff_mask;			// buff_length - 1
+	double *buff_alloc;
+	long buff_write;		// index of the next value to write
 	long delayLength;
-} rbb_allpass_long;
-
-typedef struct _allpass_mod {		// allpass_mod filter info
-	float coeff;
-	float coeff_neg;
-	long buff_length;
-	float *buff_alloc;
-	float *buff_mem;
-	float *buff_start;		//added 2002.08.19
-	float *buff_end;		//added 2002.08.19
-	long buff_write;
+
+	void init(double *mem, long length);
+	void setCoeff(double c);
+	void setDelay(long d);
+	double compute(double in);
+};
+
+struct rbb_allpass_mod {			// allpass_mod filter info
+	double coeff;
+	double coeff_neg;
+	long buff_length;		// a power of two
+	long buff_mask;			// buff_length - 1
+	double *buff_alloc;
+	long buff_write;		// index of the next value to write
 	long initDelayLength;
 	rbb_sintable *oscTable;
-	float oscPhase;
-	float oscFreq;
-	float oscSamplingInc;
-	float oscDepth;
-	float last_out;
-	float last_lfo;
-} rbb_allpass_mod;
-
-void rbb_init_sinTable(rbb_sintable *info_ptr);
-void rbb_free_sinTable(rbb_sintable *info_ptr);
-
-void rbb_init_lowPass(rbb_lowpass *info_ptr);
-void rbb_set_lowPass_coeff(rbb_lowpass *info_ptr, float c);
-void rbb_compute_lowPass1(float *in_ptr, rbb_lowpass *info_ptr, float *out_ptr);
-void rbb_compute_lowPass2(float *in_ptr, rbb_lowpass *info_ptr, float *out_ptr);
-
-void rbb_init_shortDelay(rbb_delaybuff_short *info_ptr);
-void rbb_free_shortDelay(rbb_delaybuff_short *info_ptr);
-void rbb_set_shortDelay_delay(rbb_delaybuff_short *info_ptr, long d);
-void rbb_compute_shortDelay(float *in_ptr, rbb_delaybuff_short *info_ptr, float *out_ptr);
-
-void rbb_init_longDelay(rbb_delaybuff_long *info_ptr);
-void rbb_free_longDelay(rbb_delaybuff_long *info_ptr);
-void rbb_set_longDelay_delay(rbb_delaybuff_long *info_ptr, long d);
-void rbb_compute_longDelay(float *in_ptr, rbb_delaybuff_long *info_ptr, float *out_ptr);
-
-void rbb_init_allpassShort(rbb_allpass_short *info_ptr);
-void rbb_free_allpassShort(rbb_allpass_short *info_ptr);
-void rbb_set_allpassShort_coeff(rbb_allpass_short *info_ptr, float c);
-void rbb_set_allpassShort_delay(rbb_allpass_short *info_ptr, long d);
-void rbb_compute_allpassShort(float *in_ptr, rbb_allpass_short *info_ptr, float *out_ptr);
-
-void rbb_init_allpassLong(rbb_allpass_long *info_ptr);
-void rbb_free_allpassLong(rbb_allpass_long *info_ptr);
-void rbb_set_allpassLong_coeff(rbb_allpass_long *info_ptr, float c);
-void rbb_set_allpassLong_delay(rbb_allpass_long *info_ptr, long d);
-void rbb_compute_allpassLong(float *in_ptr, rbb_allpass_long *info_ptr, float *out_ptr);
-
-void rbb_init_allpassMod(rbb_allpass_mod *info_ptr, rbb_sintable *osc_ptr);
-void rbb_free_allpassMod(rbb_allpass_mod *info_ptr);
-void rbb_set_allpassMod_coeff(rbb_allpass_mod *info_ptr, float c);
-void rbb_set_allpassMod_freq(rbb_allpass_mod *info_ptr, float f, float sr);
-void rbb_set_allpassMod_delay(rbb_allpass_mod *info_ptr, long d);
-void rbb_compute_allpassMod(float *in_ptr, rbb_allpass_mod *info_ptr, float *out_ptr);
-
-void rbb_allpassInterp(float *in_array, float index, long bufferLength, 
-	float last_out, float *out_ptr);
-	
-	
-#endif /* __REVERB_BB */
\ No newline at end of file
+	double oscPhase;
+	double oscFreq;
+	double oscSamplingInc;
+	double oscDepth;
+	double last_out;
+	double last_lfo;
+
+	void init(double *mem, long length, rbb_sintable *osc_ptr);
+	void setCoeff(double c);
+	void setFreq(double f, double sr);
+	void setDelay(long d);
+	double compute(double in);
+};
+
+/********************************************************************************
+double rbb_allpassInterp(const double *in_array, long index_i, double index_frac,
+		long mask, double last_out)
+
+inputs:			in_array -- name of array of input values
+				index_i -- whole part of the index to interpolate, within in_array
+				index_frac -- fractional part of the index
+				mask -- length of in_array - 1, the length being a power of two
+				last_out -- value of last output from buffer
+description:	performs allpass interpolation on an input array; implements
+	filter as specified in Dattorro 2: J. Audio Eng. Soc., Vol 45, No 10,
+	1997 October
+returns:		interpolated output
+********************************************************************************/
+NW_FORCEINLINE double rbb_allpassInterp(const double *in_array, long index_i,
+		double index_frac, long mask, double last_out)
+{
+	// formula as on bottom of page 765 of above Dattorro article
+	return in_array[index_i] + index_frac * (in_array[(index_i + 1) & mask] - last_out);
+}
+
+/********************************************************************************
+double rbb_lowpass::compute1(double in)
+
+inputs:			in -- input value
+description:	computes the lowpass filter using coeff to multiply the input
+	and oneMcoeff to multiply the recursive element
+returns:		output value
+********************************************************************************/
+NW_FORCEINLINE double rbb_lowpass::compute1(double in)
+{
+	// compute output and save it for sample delay
+	last_out = (in * coeff) + (last_out * oneMcoeff);
+	return last_out;
+}
+
+/********************************************************************************
+double rbb_lowpass::compute2(double in)
+
+inputs:			in -- input value
+description:	computes the lowpass filter using oneMcoeff to multiply the input
+	and coeff to multiply the recursive element
+returns:		output value
+********************************************************************************/
+NW_FORCEINLINE double rbb_lowpass::compute2(double in)
+{
+	// compute output and save it for sample delay
+	last_out = (in * oneMcoeff) + (last_out * coeff);
+	return last_out;
+}
+
+/********************************************************************************
+void rbb_lowpass::computeBlock1(const double *in, double *out, long n)
+
+inputs:			in -- input values
+				out -- output values, may be the same as in
+				n -- number of samples
+description:	runs compute1 over a block of samples
+returns:		nothing
+********************************************************************************/
+inline void rbb_lowpass::computeBlock1(const double *in, double *out, long n)
+{
+	rbb_lowpass lp = *this;
+
+	while (n--) *out++ = lp.compute1(*in++);
+
+	last_out = lp.last_out;
+}
+
+/********************************************************************************
+double rbb_delaybuff_short::compute(double in)
+
+inputs:			in -- input value
+description:	computes the short delay
+returns:		output value
+********************************************************************************/
+NW_FORCEINLINE double rbb_delaybuff_short::compute(double in)
+{
+	// pull output from buffer, then put input into buffer
+	double out = buff_alloc[(buff_write - delayLength) & buff_mask];
+	buff_alloc[buff_write] = in;
+
+	// advance write position
+	buff_write = (buff_write + 1) & buff_mask;
+
+	return out;
+}
+
+/********************************************************************************
+double rbb_delaybuff_long::compute(double in)
+
+inputs:			in -- input value
+description:	computes the long delay
+returns:		output value
+********************************************************************************/
+NW_FORCEINLINE double rbb_delaybuff_long::compute(double in)
+{
+	// pull output from buffer, then put input into buffer
+	double out = buff_alloc[(buff_write - delayLength) & buff_mask];
+	buff_alloc[buff_write] = in;
+
+	// advance write position
+	buff_write = (buff_write + 1) & buff_mask;
+
+	return out;
+}
+
+/********************************************************************************
+double rbb_allpass_short::compute(double in)
+
+inputs:			in -- input value
+description:	computes the shorter delay buffer allpass filters
+returns:		output value
+********************************************************************************/
+NW_FORCEINLINE double rbb_allpass_short::compute(double in)
+{
+	// compute output
+	double out = (in * coeff) + buff_alloc[(buff_write - delayLength) & buff_mask];
+
+	// compute feedback
+	buff_alloc[buff_write] = in + (out * coeff_neg);
+
+	// advance write position
+	buff_write = (buff_write + 1) & buff_mask;
+
+	return out;
+}
+
+/********************************************************************************
+void rbb_allpass_short::computeBlock(const double *in, double *out, long n)
+
+inputs:			in -- input values
+				out -- output values, may be the same as in
+				n -- number of samples
+description:	runs compute over a block of samples
+returns:		nothing
+********************************************************************************/
+inline void rbb_allpass_short::computeBlock(const double *in, double *out, long n)
+{
+	rbb_allpass_short ap = *this;
+
+	while (n--) *out++ = ap.compute(*in++);
+
+	buff_write = ap.buff_write;
+}
+
+/********************************************************************************
+double rbb_allpass_long::compute(double in)
+
+inputs:			in -- input value
+description:	computes the longer delay buffer allpass filters
+returns:		output value
+********************************************************************************/
+NW_FORCEINLINE double rbb_allpass_long::compute(double in)
+{
+	// compute output
+	double out = (in * coeff) + buff_alloc[(buff_write - delayLength) & buff_mask];
+
+	// compute feedback
+	buff_alloc[buff_write] = in + (out * coeff_neg);
+
+	// advance write position
+	buff_write = (buff_write + 1) & buff_mask;
+
+	return out;
+}
+
+/********************************************************************************
+double rbb_allpass_mod::compute(double in)
+
+inputs:			in -- input value
+description:	computes the modulating delay buffer allpass filters
+returns:		output value
+********************************************************************************/
+NW_FORCEINLINE double rbb_allpass_mod::compute(double in)
+{
+	double lfo_out, buffRead, out;
+	long read_i;
+
+	// compute phase, the increment is always less than a table length
+	oscPhase += oscSamplingInc;
+	if (oscPhase >= (double)OSC_TABLE_SIZE) oscPhase -= (double)OSC_TABLE_SIZE;
+
+	read_i = (long)oscPhase;
+	lfo_out = rbb_allpassInterp(oscTable->table_alloc, read_i, oscPhase - (double)read_i,
+			OSC_TABLE_SIZE - 1, last_lfo);
+	last_lfo = lfo_out;
+
+	// compute read position, relative to the write position and offset by a
+	// whole buffer so that it is never negative
+	buffRead = (double)buff_length - initDelayLength + (lfo_out * oscDepth);
+	read_i = (long)buffRead;
+
+	// all pass interpolate the buffer output
+	last_out = rbb_allpassInterp(buff_alloc, (buff_write + read_i) & buff_mask,
+			buffRead - (double)read_i, buff_mask, last_out);
+
+	// compute output
+	out = (in * coeff_neg) + last_out;
+
+	// compute feedback
+	buff_alloc[buff_write] = in + (out * coeff);
+
+	// advance write position
+	buff_write = (buff_write + 1) & buff_mask;
+
+	return out;
+}
+
+#endif /* __REVERB_BB */
@@ -4,6 +4,8 @@
 ** MSP object
 ** generates evenly shifted phase signals
 ** 2001/08/09 started by Nathan Wolek
+** 2026/10/17 heap phases and a multichannel outlet
+** 2026/10/17 follows a shared clock
 **
 ** Copyright © 2001,2014 by Nathan Wolek
 ** License: http://opensource.org/licenses/BSD-3-Clause
@@ -12,6 +14,8 @@
 
 
 #include "c74_msp.h"
+#include "phasorshift_dsp.h"
+#include "nw_clockreg.h"
 
 using namespace c74::max;
 
@@ -27,8 +31,6 @@ using namespace c74::max;
 #define INTERP_OFF			0
 #define INTERP_ON			1
 
-#define OUTLET_MAX		64					// maximum number of outlets specifiable
-#define OUTLET_MIN		2					// minimum number of outlets specifiable
 #define VEC_SIZE		OUTLET_MAX + 4		// size of vector array passed to perform method
 
 static t_class *phasorshift_class;		// required global pointer to this class
@@ -37,24 +39,26 @@ static t_class *phasorshift_class;		// required global pointer to this class
 typedef struct _phasorShift
 {
 	t_pxobject 	ps_obj;
-	long 		ps_outletcount;
-	float 		ps_currIndex[OUTLET_MAX];
-	float 		ps_freq;
-	float		ps_stepsize;
-	short		ps_inlet_connected;
-    double      ps_samp_rate;
+	PhasorShift	ps_phasors;				// phases, frequency and sample rate
+	long		ps_multichannel;		// "multichannel" attribute
+	short		ps_created;				// outlets are made, multichannel is fixed
 	
 } t_phasorShift;	
 
 /* method definitions for this object */
-void phasorShift_setIndexArray(t_phasorShift *x);
-void *phasorShift_new(long outlets);
+void *phasorShift_new(t_symbol *s, long argc, t_atom *argv);
+void phasorShift_free(t_phasorShift *x);
+long phasorShift_multichanneloutputs(t_phasorShift *x, long index);
+t_max_err phasorShift_multichannel_set(t_phasorShift *x, void *attr, long argc, t_atom *argv);
 void phasorShift_dsp64(t_phasorShift *x, t_object *dsp64, short *count, double samplerate,
                        long maxvectorsize, long flags);
-void phasorShift_perform64(t_phasorShift *x, t_object *dsp64, double **ins, long numins, double **outs,
+void phasorShift_perform64c(t_phasorShift *x, t_object *dsp64, double **ins, long numins, double **outs,
+                            long numouts, long vectorsize, long flags, void *userparam);
+void phasorShift_perform64a(t_phasorShift *x, t_object *dsp64, double **ins, long numins, double **outs,
                             long numouts, long vectorsize, long flags, void *userparam);
 void phasorShift_float(t_phasorShift *x, double f);
 void phasorShift_int(t_phasorShift *x, long l);
+void phasorShift_clock(t_phasorShift *x, t_symbol *s);
 void phasorShift_assist(t_phasorShift *x, t_object *b, long msg, long arg, char *s);
 void phasorShift_getinfo(t_phasorShift *x);
 float allpassInterp(float *in_array, float index, float last_out, long buf_length);
@@ -71,16 +75,25 @@ int C74_EXPORT main(void)
 {
     t_class *c;
     
-    c = class_new(OBJECT_NAME, (method)phasorShift_new, (method)dsp_free, (short)sizeof(t_phasorShift), 0L,
-				A_DEFLONG, 0);
+    c = class_new(OBJECT_NAME, (method)phasorShift_new, (method)phasorShift_free, (short)sizeof(t_phasorShift), 0L,
+				A_GIMME, 0);
     class_dspinit(c); // add standard functions to class
 	
+	/* one multichannel outlet instead of an outlet per phasor */
+	CLASS_ATTR_LONG(c, "multichannel", 0, t_phasorShift, ps_multichannel);
+	CLASS_ATTR_ACCESSORS(c, "multichannel", NULL, phasorShift_multichannel_set);
+	CLASS_ATTR_FILTER_CLIP(c, "multichannel", 0, 1);
+	CLASS_ATTR_LABEL(c, "multichannel", 0, "Multichannel Output");
+	
 	/* bind method "phasorShift_float" to the float message */
 	class_addmethod(c, (method)phasorShift_float, "float", A_FLOAT, 0);
 	
 	/* bind method "phasorShift_int" to the int message */
 	class_addmethod(c, (method)phasorShift_int, "int", A_LONG, 0);
 	
+	/* bind method "phasorShift_clock" to the clock message */
+	class_addmethod(c, (method)phasorShift_clock, "clock", A_DEFSYM, 0);
+	
 	/* bind method "phasorShift_assist" to the assistance message */
 	class_addmethod(c, (method)phasorShift_assist, "assist", A_CANT, 0);
 	
@@ -89,6 +102,9 @@ int C74_EXPORT main(void)
     
     /* bind method "phasorShift_dsp64" to the dsp64 message */
     class_addmethod(c, (method)phasorShift_dsp64, "dsp64", A_CANT, 0);
+    
+    /* bind method for multichannel patch cords */
+    class_addmethod(c, (method)phasorShift_multichanneloutputs, "multichanneloutputs", A_CANT, 0);
 	
     class_register(CLASS_BOX, c); // register the class w max
     phasorshift_class = c;
@@ -102,62 +118,48 @@ int C74_EXPORT main(void)
 }
 
 /********************************************************************************
-void phasorShift_setIndexArray(t_phasorShift *x)
-
-inputs:			x		-- pointer to this object
-description:	fills array with indexs for phasor output to outlets
-returns:		nothing
-********************************************************************************/
-void phasorShift_setIndexArray(t_phasorShift *x)
-{
-	float *tab = (float *)(x->ps_currIndex);		// get pointer to ps_table
-	float num_out = (float)(x->ps_outletcount);		// local var for number of outlets
-	long n = OUTLET_MAX;				// set counter equal to ps_outletcount
-	
-	n += 1;
-	while (--n) {	// fill indexs with zero first, to be safe
-		tab[n] = 0.0;
-	}
-	
-	n = x->ps_outletcount;			// set counter equal to ps_outletcount
-	while (--n >= 0) {
-		/* fill ps_table with pointer values */
-		tab[n] = (float)n / num_out;
-	}
-	
-	#ifdef DEBUG
-		object_post((t_object*)x, "pointers set");
-	#endif /* DEBUG */
-}
-
-/********************************************************************************
-void *phasorShift_new(double initial_pos)
+void *phasorShift_new(t_symbol *s, long argc, t_atom *argv)
 
-inputs:			initial_pos		-- object argument 1; initial position of pan
+inputs:			s			-- name of object
+				argc		-- number of arguments
+				argv		-- number of phasors, then attributes (@multichannel)
 description:	called for each new instance of object in the MAX environment;
 		defines inlets and outlets; fills ps_table; sets pointers
 returns:		nothing
 ********************************************************************************/
-void *phasorShift_new(long outlets)
+void *phasorShift_new(t_symbol *s, long argc, t_atom *argv)
 {
 	long i;
 	
 	t_phasorShift *x = (t_phasorShift *) object_alloc((t_class*) phasorshift_class);
+	long attrstart = attr_args_offset((short)argc, argv);
+	long outlets = attrstart > 0 ? (long)atom_getlong(argv) : 0;
 	
-	// set outlets within limits
-	x->ps_outletcount = 
-		outlets>OUTLET_MAX?OUTLET_MAX:outlets<OUTLET_MIN?OUTLET_MIN:outlets;
+	// the outlets depend on the attributes, so they are read first
+	x->ps_multichannel = false;
+	x->ps_created = false;
+	attr_args_process(x, (short)argc, argv);
 	
+	// set up before anything can fail, as the free method calls dsp_free
 	dsp_setup((t_pxobject *)x, 1);					// one inlet
-	for (i = 0; i < x->ps_outletcount; i++) {
-		outlet_new((t_pxobject *)x, "signal");		// create outlets
-	}
 	
-	phasorShift_setIndexArray(x);					// set the indexs
+	// set outlets within limits, the indexs and default freq
+	if (!x->ps_phasors.init(outlets)) {
+		object_error((t_object*)x, "could not allocate phases");
+		object_free(x);
+		return NULL;
+	}
 	
-	x->ps_freq = 20.0;								// default freq to 20.0
+	if (x->ps_multichannel) {
+		outlet_new((t_pxobject *)x, "multichannelsignal");	// every phasor in one
+	} else {
+		for (i = 0; i < x->ps_phasors.ps_outletcount; i++) {
+			outlet_new((t_pxobject *)x, "signal");		// create outlets
+		}
+	}
 	
 	x->ps_obj.z_misc = Z_NO_INPLACE;
+	x->ps_created = true;
     
     #ifdef DEBUG
         object_post((t_object*)x, "new function was called");
@@ -168,6 +170,33 @@ void *phasorShift_new(long outlets)
 }
 
 
+/********************************************************************************
+void phasorShift_free(t_phasorShift *x)
+
+inputs:			x		-- pointer to this object
+description:	called when the object is deleted; frees the phases
+returns:		nothing
+********************************************************************************/
+void phasorShift_free(t_phasorShift *x)
+{
+	dsp_free((t_pxobject *)x);
+	
+	x->ps_phasors.free();
+}
+
+/********************************************************************************
+long phasorShift_multichanneloutputs(t_phasorShift *x, long index)
+
+inputs:			x		-- pointer to this object
+				index	-- outlet
+description:	reports the channels of the multichannel outlet, one per phasor
+returns:		number of channels
+********************************************************************************/
+long phasorShift_multichanneloutputs(t_phasorShift *x, long index)
+{
+	return x->ps_multichannel ? x->ps_phasors.ps_outletcount : 1;
+}
+
 /********************************************************************************
  void phasorShift_dsp64()
  
@@ -188,20 +217,33 @@ void phasorShift_dsp64(t_phasorShift *x, t_object *dsp64, short *count, double s
         object_post((t_object*)x, "adding 64 bit perform method");
     #endif /* DEBUG */
     
-    // check if inlets are connected at audio rate
-    x->ps_inlet_connected = count[0];
-    
     // save other info to object vars
-    x->ps_samp_rate = samplerate;
+    x->ps_phasors.ps_samp_rate = samplerate;
+    
+    // members of a clock start from its origin together
+    x->ps_phasors.ps_clock.reset(dsp64);
     
     // add the perform routine to the signal chain
-    dsp_add64(dsp64, (t_object*)x, (t_perfroutine64)phasorShift_perform64, 0, NULL);
+    if (count[0])
+    {
+        dsp_add64(dsp64, (t_object*)x, (t_perfroutine64)phasorShift_perform64a, 0, NULL);
+        #ifdef DEBUG
+            object_post((t_object*)x, "frequency is being updated at audio rate");
+        #endif /* DEBUG */
+    }
+    else
+    {
+        dsp_add64(dsp64, (t_object*)x, (t_perfroutine64)phasorShift_perform64c, 0, NULL);
+        #ifdef DEBUG
+            object_post((t_object*)x, "frequency is being updated at control rate");
+        #endif /* DEBUG */
+    }
     
 }
 
 
 /********************************************************************************
- void *phasorShift_perform64(t_phasorShift *x, t_object *dsp64, double **ins, long numins, double **outs,
+ void *phasorShift_perform64c(t_phasorShift *x, t_object *dsp64, double **ins, long numins, double **outs,
  long numouts, long vectorsize, long flags, void *userparam)
  
  inputs:			x		--
@@ -216,55 +258,33 @@ void phasorShift_dsp64(t_phasorShift *x, t_object *dsp64, short *count, double s
  description:	called at interrupt level to compute object's output at 64-bit
  returns:		nothing
  ********************************************************************************/
-void phasorShift_perform64(t_phasorShift *x, t_object *dsp64, double **ins, long numins, double **outs,
+void phasorShift_perform64c(t_phasorShift *x, t_object *dsp64, double **ins, long numins, double **outs,
                             long numouts, long vectorsize, long flags, void *userparam)
 {
-    // local vars for outlets, interval, width, step size and index
-    double *curr_out[OUTLET_MAX];
-    double curr_freq = x->ps_inlet_connected ?  *ins[0] : x->ps_freq;
-    double curr_step_size;
-    float *currIndex = x->ps_currIndex; // TODO: upgrade to double later
-    
-    // local vars used for while loop
-    double temp;
-    long n, m;
-    
-    // fill local pointer array for outlets
-    m = numouts;
-    while(m--)
-    {
-        curr_out[m] = outs[m];
-    }
-    
-    // check constraints
-    // NOT NECESSARY
-    
-    // then compute step size
-    curr_step_size = curr_freq / x->ps_samp_rate;
-    
-    // update object variables
-    x->ps_freq = curr_freq;
-    x->ps_stepsize = curr_step_size;
-    
-    n = vectorsize;
-    while (n--) {
-        m = numouts;
-        while (m--) {
-            temp = (double)(currIndex[m]);
-            
-            // check bounds //
-            while (temp < 0.0)
-                temp += 1.0;
-            while (temp >= 1.0)
-                temp -= 1.0;
-            
-            *(curr_out[m]) = temp;		// save to output
-            
-            temp += curr_step_size;		// advance index
-            currIndex[m] = (float)temp;	// save next index
-            (curr_out[m])++;			// advance the outlet pointer
-        }
-    }
+    x->ps_phasors.process(x->ps_phasors.ps_freq, outs, numouts, vectorsize);
+}
+
+/********************************************************************************
+ void *phasorShift_perform64a(t_phasorShift *x, t_object *dsp64, double **ins, long numins, double **outs,
+ long numouts, long vectorsize, long flags, void *userparam)
+ 
+ inputs:			x		--
+                    dsp64   --
+                    ins     --
+                    numins  --
+                    outs    --
+                    numouts --
+                    vectorsize --
+                    flags   --
+                    userparam  --
+ description:	called at interrupt level to compute object's output at 64-bit,
+        reading the frequency from the signal in the inlet every sample
+ returns:		nothing
+ ********************************************************************************/
+void phasorShift_perform64a(t_phasorShift *x, t_object *dsp64, double **ins, long numins, double **outs,
+                            long numouts, long vectorsize, long flags, void *userparam)
+{
+    x->ps_phasors.processAudio(ins[0], outs, numouts, vectorsize);
 }
 
 
@@ -281,7 +301,7 @@ void phasorShift_float(t_phasorShift *x, double f)
 {
 	if (x->ps_obj.z_in == 0) // if right inlet
 	{
-		x->ps_freq = f;				// save frequency input
+		x->ps_phasors.ps_freq = f;				// save frequency input
 	}
 	else
 	{
@@ -302,7 +322,7 @@ void phasorShift_int(t_phasorShift *x, long l)
 {
 	if (x->ps_obj.z_in == 0) // if right inlet
 	{
-		x->ps_freq = (double) l;			// save frequency input
+		x->ps_phasors.ps_freq = (double) l;			// save frequency input
 	}
 	else
 	{
@@ -310,6 +330,37 @@ void phasorShift_int(t_phasorShift *x, long l)
 	}
 }
 
+/********************************************************************************
+void phasorShift_clock(t_phasorShift *x, t_symbol *s)
+
+inputs:			x		-- pointer to our object
+				s		-- name of the clock, or empty to run free
+description:	method called when "clock" message is received; the phasors
+		follow the named clock from the next signal vector, taking their
+		phases from its count of samples so that every object following it
+		stays in step; naming the same clock again brings them back in step
+		with its origin
+returns:		nothing
+********************************************************************************/
+void phasorShift_clock(t_phasorShift *x, t_symbol *s)
+{
+	t_nw_clock *clock = NULL;
+	
+	if (s && s != gensym("")) {
+		clock = nw_clockreg_find(s);
+		if (!clock) {
+			object_error((t_object*)x, "could not find or make clock %s", s->s_name);
+			return;
+		}
+	}
+	
+	x->ps_phasors.ps_clock.ask(clock);
+	
+	#ifdef DEBUG
+		object_post((t_object*)x, "following clock %s", clock ? s->s_name : "(none)");
+	#endif // DEBUG //
+}
+
 /********************************************************************************
 void phasorShift_assist(t_phasorShift *x, t_object *b, long msg, long arg, char *s)
 
@@ -324,9 +375,9 @@ returns:		nothing
 ********************************************************************************/
 void phasorShift_assist(t_phasorShift *x, t_object *b, long msg, long arg, char *s)
 {
-	char out_mess[30];
-	short which_outlet;
-	short num_out = x->ps_outletcount;
+	char out_mess[64];
+	long which_outlet;
+	long num_out = x->ps_phasors.ps_outletcount;
 	
 	if (msg==ASSIST_INLET) {
 		switch (arg) {
@@ -336,7 +387,10 @@ void phasorShift_assist(t_phasorShift *x, t_object *b, long msg, long arg, char
 		}
 	} else if (msg==ASSIST_OUTLET) {
 		which_outlet = arg + 1;
-		sprintf(out_mess, "(signal) phasor output %hd of %hd", which_outlet, num_out);
+		if (x->ps_multichannel)
+			sprintf(out_mess, "(multichannel signal) %ld phasor outputs", num_out);
+		else
+			sprintf(out_mess, "(signal) phasor output %ld of %ld", which_outlet, num_out);
 		strcpy(s, out_mess);
 	}
 	
@@ -360,4 +414,25 @@ void phasorShift_getinfo(t_phasorShift *x)
 	object_post((t_object*)x, "Last updated on %s - www.nathanwolek.com", __DATE__);
 }
 
+/********************************************************************************
+t_max_err phasorShift_multichannel_set(t_phasorShift *x, void *attr, long argc, t_atom *argv)
 
+inputs:			x		-- pointer to our object
+				attr	-- the attribute being set
+				argc	-- number of values
+				argv	-- 1 for one multichannel outlet, 0 for an outlet per phasor
+description:	setter for the "multichannel" attribute; the outlets are made
+		with the object, so it can only be given as an argument
+returns:		MAX_ERR_NONE
+********************************************************************************/
+t_max_err phasorShift_multichannel_set(t_phasorShift *x, void *attr, long argc, t_atom *argv)
+{
+	if (argc && argv) {
+		if (x->ps_created) {
+			object_error((t_object*)x, "multichannel can only be set when the object is created");
+		} else {
+			x->ps_multichannel = atom_getlong(argv) ? true : false;
+		}
+	}
+	return MAX_ERR_NONE;
+}
@@ -0,0 +1,460 @@
+/*
+** phasorshift_dsp.h
+**
+** header file
+** phase shifted phasors for nw.phasorshift~, free of any Max API calls so
+** that they can also be driven by the nw_bench profiling target
+**
+** each phasor is written a whole vector at a time, sample k of the vector
+** being the fraction of phase + k * step, so that every outlet is one run of
+** contiguous stores and no phase error builds up within a vector
+**
+** with a signal in the inlet, processAudio() sums the per-sample steps of a
+** block once into a ramp shared by every outlet, so each outlet is again one
+** run of stores, of the fraction of its phase + ramp[k]
+**
+** the phases are held in one heap array sized for the phasors asked for and
+** aligned to a cache line, so that a bank of hundreds of phasors feeding a
+** multichannel cord costs only the memory it uses
+**
+** a phasor following a shared clock (nw_clock.h) takes its phases from the
+** clock's count of samples at the start of every block instead of carrying
+** them over, so several objects following one clock stay exactly together
+**
+** Max allocates objects without running constructors, so a PhasorShift held
+** in an object struct is set up by init() and torn down by free() rather
+** than by a constructor and destructor
+**
+** Copyright © 2002,2015 by Nathan Wolek
+** License: http://opensource.org/licenses/BSD-3-Clause
+**
+*/
+
+#ifndef __PHASORSHIFT_DSP
+#define __PHASORSHIFT_DSP
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "nw_interp.h"		// for NW_FORCEINLINE
+#include "nw_simd.h"
+#include "nw_clock.h"
+
+#define OUTLET_MAX		1024				// maximum number of phasors, as many as a multichannel cord carries
+#define OUTLET_MIN		2					// minimum number of outlets specifiable
+
+#define PHASORSHIFT_ALIGN	64				// alignment of the phase array, in bytes
+
+/* largest phase + k * step the sse2 kernel takes, as it rounds through int32 */
+#define PHASORSHIFT_SSE2_SPAN	1073741824.0
+
+#define PHASORSHIFT_BLOCK	256				// samples summed at a time by processAudio()
+
+typedef void (*t_phasorshift_kernel)(double phase, double step, double *out, long n);
+typedef void (*t_phasorshift_offset)(double phase, const double *ramp, double *out, long n);
+
+class PhasorShift
+{
+public:
+	long 		ps_outletcount;
+	double 		*ps_currIndex;				// phase of each outlet, 0 to 1
+	void		*ps_alloc;					// ps_currIndex before it was aligned
+	double 		ps_freq;
+	double		ps_stepsize;
+	double		ps_samp_rate;
+	t_phasorshift_kernel ps_kernel;			// fastest kernel for this processor
+	t_phasorshift_offset ps_offset_kernel;	// and its counterpart for processAudio()
+	NwClockMember ps_clock;					// shared clock followed, if any
+
+	bool init(long outlets);
+	void free(void);
+	void setIndexArray(void);
+	void setClockPhases(double travelled);
+	void process(double freq, double **outs, long numouts, long n);
+	void processAudio(const double *freq, double **outs, long numouts, long n);
+};
+
+/********************************************************************************
+double phasorshift_frac(double x)
+
+inputs:			x		-- phase
+description:	wraps a phase into 0 to 1; a tiny negative phase whose fraction
+		rounds up to 1 is taken as 0
+returns:		the wrapped phase
+********************************************************************************/
+NW_FORCEINLINE double phasorshift_frac(double x)
+{
+	x -= floor(x);
+	return (x < 1.0) ? x : 0.0;
+}
+
+/********************************************************************************
+void phasorshift_rampScalar(double phase, double step, double *out, long n)
+
+inputs:			phase	-- phase of the first sample
+				step	-- phase change per sample
+				out		-- output vector
+				n		-- number of samples
+description:	writes one phasor; the vector kernels finish their blocks here
+returns:		nothing
+********************************************************************************/
+inline void phasorshift_rampScalar(double phase, double step, double *out, long n)
+{
+    long k;
+
+    for (k = 0; k < n; k++)
+        out[k] = phasorshift_frac(phase + (double)k * step);
+}
+
+/********************************************************************************
+void phasorshift_offsetScalar(double phase, const double *ramp, double *out, long n)
+
+inputs:			phase	-- phase of the first sample
+				ramp	-- phase travelled before each sample
+				out		-- output vector
+				n		-- number of samples
+description:	writes one phasor under a frequency signal
+returns:		nothing
+********************************************************************************/
+inline void phasorshift_offsetScalar(double phase, const double *ramp, double *out, long n)
+{
+    long k;
+
+    for (k = 0; k < n; k++)
+        out[k] = phasorshift_frac(phase + ramp[k]);
+}
+
+#if NW_SIMD_X86
+
+/********************************************************************************
+void phasorshift_rampSSE2(double phase, double step, double *out, long n)
+
+inputs:			(as phasorshift_rampScalar)
+description:	writes two samples at a time; sse2 has no floor, so phases are
+		rounded through int32 and pulled down where that rounded up; a vector
+		that would leave the int32 range is left to the scalar kernel
+returns:		nothing
+********************************************************************************/
+inline void phasorshift_rampSSE2(double phase, double step, double *out, long n)
+{
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d k_inc = _mm_set1_pd(2.0);
+    const __m128d p0 = _mm_set1_pd(phase);
+    const __m128d dp = _mm_set1_pd(step);
+    __m128d k = _mm_set_pd(1.0, 0.0);
+    __m128d x, t;
+    long i = 0;
+
+    if (fabs(phase) + fabs(step) * (double)n < PHASORSHIFT_SSE2_SPAN) {
+        for (; i + 2 <= n; i += 2) {
+            x = _mm_add_pd(p0, _mm_mul_pd(k, dp));
+            t = _mm_cvtepi32_pd(_mm_cvtpd_epi32(x));
+            t = _mm_sub_pd(t, _mm_and_pd(_mm_cmpgt_pd(t, x), one));		// floor
+            x = _mm_sub_pd(x, t);
+            x = _mm_and_pd(x, _mm_cmplt_pd(x, one));						// 1 becomes 0
+            _mm_storeu_pd(out + i, x);
+            k = _mm_add_pd(k, k_inc);
+        }
+    }
+
+    phasorshift_rampScalar(phase + (double)i * step, step, out + i, n - i);
+}
+
+/********************************************************************************
+void phasorshift_offsetSSE2(double phase, const double *ramp, double *out, long n)
+
+inputs:			(as phasorshift_offsetScalar)
+description:	writes two samples at a time, rounding as phasorshift_rampSSE2;
+		the caller keeps phase + ramp within PHASORSHIFT_SSE2_SPAN
+returns:		nothing
+********************************************************************************/
+inline void phasorshift_offsetSSE2(double phase, const double *ramp, double *out, long n)
+{
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d p0 = _mm_set1_pd(phase);
+    __m128d x, t;
+    long i;
+
+    for (i = 0; i + 2 <= n; i += 2) {
+        x = _mm_add_pd(p0, _mm_loadu_pd(ramp + i));
+        t = _mm_cvtepi32_pd(_mm_cvtpd_epi32(x));
+        t = _mm_sub_pd(t, _mm_and_pd(_mm_cmpgt_pd(t, x), one));		// floor
+        x = _mm_sub_pd(x, t);
+        x = _mm_and_pd(x, _mm_cmplt_pd(x, one));						// 1 becomes 0
+        _mm_storeu_pd(out + i, x);
+    }
+
+    phasorshift_offsetScalar(phase, ramp + i, out + i, n - i);
+}
+
+/********************************************************************************
+void phasorshift_rampAVX2(double phase, double step, double *out, long n)
+
+inputs:			(as phasorshift_rampScalar)
+description:	writes four samples at a time
+returns:		nothing
+********************************************************************************/
+NW_TARGET_AVX2 inline void phasorshift_rampAVX2(double phase, double step, double *out, long n)
+{
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d k_inc = _mm256_set1_pd(4.0);
+    const __m256d p0 = _mm256_set1_pd(phase);
+    const __m256d dp = _mm256_set1_pd(step);
+    __m256d k = _mm256_set_pd(3.0, 2.0, 1.0, 0.0);
+    __m256d x;
+    long i;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        x = _mm256_add_pd(p0, _mm256_mul_pd(k, dp));
+        x = _mm256_sub_pd(x, _mm256_floor_pd(x));
+        x = _mm256_and_pd(x, _mm256_cmp_pd(x, one, _CMP_LT_OQ));		// 1 becomes 0
+        _mm256_storeu_pd(out + i, x);
+        k = _mm256_add_pd(k, k_inc);
+    }
+
+    // avoid the penalty for mixing avx and sse code in the rest of the chain
+    _mm256_zeroupper();
+
+    phasorshift_rampScalar(phase + (double)i * step, step, out + i, n - i);
+}
+
+/********************************************************************************
+void phasorshift_offsetAVX2(double phase, const double *ramp, double *out, long n)
+
+inputs:			(as phasorshift_offsetScalar)
+description:	writes four samples at a time
+returns:		nothing
+********************************************************************************/
+NW_TARGET_AVX2 inline void phasorshift_offsetAVX2(double phase, const double *ramp, double *out, long n)
+{
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d p0 = _mm256_set1_pd(phase);
+    __m256d x;
+    long i;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        x = _mm256_add_pd(p0, _mm256_loadu_pd(ramp + i));
+        x = _mm256_sub_pd(x, _mm256_floor_pd(x));
+        x = _mm256_and_pd(x, _mm256_cmp_pd(x, one, _CMP_LT_OQ));		// 1 becomes 0
+        _mm256_storeu_pd(out + i, x);
+    }
+
+    // avoid the penalty for mixing avx and sse code in the rest of the chain
+    _mm256_zeroupper();
+
+    phasorshift_offsetScalar(phase, ramp + i, out + i, n - i);
+}
+
+#endif /* NW_SIMD_X86 */
+
+/********************************************************************************
+bool PhasorShift::init(long outlets)
+
+inputs:			outlets		-- number of phasors, clipped to OUTLET_MIN..OUTLET_MAX
+description:	sets the phasor count, allocates and spreads their phases and
+		sets defaults
+returns:		false if the phases could not be allocated
+********************************************************************************/
+inline bool PhasorShift::init(long outlets)
+{
+	ps_kernel = phasorshift_rampScalar;
+	ps_offset_kernel = phasorshift_offsetScalar;
+#if NW_SIMD_X86
+	if (nw_cpu_has_avx2()) {
+		ps_kernel = phasorshift_rampAVX2;
+		ps_offset_kernel = phasorshift_offsetAVX2;
+	} else if (nw_cpu_has_sse2()) {
+		ps_kernel = phasorshift_rampSSE2;
+		ps_offset_kernel = phasorshift_offsetSSE2;
+	}
+#endif
+
+	// set outlets within limits
+	ps_outletcount =
+		outlets>OUTLET_MAX?OUTLET_MAX:outlets<OUTLET_MIN?OUTLET_MIN:outlets;
+
+	ps_freq = 20.0;						// default freq to 20.0
+	ps_stepsize = 0.0;
+	ps_clock.init();					// free running
+
+	// one phase per outlet, starting on a cache line
+	ps_alloc = malloc(ps_outletcount * sizeof(double) + PHASORSHIFT_ALIGN - 1);
+	if (!ps_alloc) {
+		ps_currIndex = 0;
+		return false;
+	}
+	ps_currIndex = (double *)(((size_t)ps_alloc + PHASORSHIFT_ALIGN - 1)
+		& ~(size_t)(PHASORSHIFT_ALIGN - 1));
+
+	setIndexArray();					// set the indexs
+	return true;
+}
+
+/********************************************************************************
+void PhasorShift::free(void)
+
+inputs:			nothing
+description:	frees the phases
+returns:		nothing
+********************************************************************************/
+inline void PhasorShift::free(void)
+{
+	if (ps_alloc)
+		::free(ps_alloc);
+	ps_alloc = 0;
+	ps_currIndex = 0;
+}
+
+/********************************************************************************
+void PhasorShift::setIndexArray(void)
+
+inputs:			nothing
+description:	fills array with indexs for phasor output to outlets
+returns:		nothing
+********************************************************************************/
+inline void PhasorShift::setIndexArray(void)
+{
+	double *tab = ps_currIndex;
+	double num_out = (double)ps_outletcount;	// local var for number of outlets
+	long n;
+
+	n = ps_outletcount;			// set counter equal to ps_outletcount
+	while (--n >= 0) {
+		/* fill ps_table with pointer values */
+		tab[n] = (double)n / num_out;
+	}
+}
+
+/********************************************************************************
+void PhasorShift::setClockPhases(double travelled)
+
+inputs:			travelled	-- phase travelled since the clock's origin, 0 to 1
+description:	sets every phase from the clock, each offset by 1/outletcount of
+		a cycle as setIndexArray() spreads them
+returns:		nothing
+********************************************************************************/
+inline void PhasorShift::setClockPhases(double travelled)
+{
+	double *tab = ps_currIndex;
+	double num_out = (double)ps_outletcount;	// local var for number of outlets
+	long n;
+
+	for (n = 0; n < ps_outletcount; n++)
+		tab[n] = phasorshift_frac((double)n / num_out + travelled);
+}
+
+/********************************************************************************
+void PhasorShift::process(double freq, double **outs, long numouts, long n)
+
+inputs:			freq		-- phasor frequency for this vector
+				outs		-- one output vector per phasor
+				numouts		-- number of output vectors
+				n			-- number of samples
+description:	writes the phasors, each offset by 1/numouts of a cycle, one
+		outlet after another; following a clock, the phases are first taken
+		from its count
+returns:		nothing
+********************************************************************************/
+inline void PhasorShift::process(double freq, double **outs, long numouts, long n)
+{
+    // local vars for step size and index
+    double *currIndex = ps_currIndex;
+    double curr_step_size;
+    long long t;
+    long m;
+
+    // there is a phase for each of ps_outletcount outlets only
+    if (numouts > ps_outletcount) numouts = ps_outletcount;
+
+    // compute step size
+    curr_step_size = freq / ps_samp_rate;
+
+    // update object variables
+    ps_freq = freq;
+    ps_stepsize = curr_step_size;
+
+    if (ps_clock.start(n, &t))
+        setClockPhases(ps_clock.phase(curr_step_size, t));
+
+    for (m = 0; m < numouts; m++) {
+        ps_kernel(currIndex[m], curr_step_size, outs[m], n);
+
+        // the phase the next vector starts from
+        currIndex[m] = phasorshift_frac(currIndex[m] + (double)n * curr_step_size);
+    }
+}
+
+/********************************************************************************
+void PhasorShift::processAudio(const double *freq, double **outs, long numouts, long n)
+
+inputs:			freq		-- phasor frequency for each sample
+				outs		-- one output vector per phasor
+				numouts		-- number of output vectors
+				n			-- number of samples
+description:	writes the phasors under a frequency signal; each block of
+		PHASORSHIFT_BLOCK samples takes the running sum of its steps once, then
+		writes every outlet from that ramp; following a clock, each block takes
+		its phases from the count, anchored again after a block whose steps
+		change
+returns:		nothing
+********************************************************************************/
+inline void PhasorShift::processAudio(const double *freq, double **outs, long numouts, long n)
+{
+    // local vars for the ramp, step size and index
+    double ramp[PHASORSHIFT_BLOCK];
+    double *currIndex = ps_currIndex;
+    double sr = ps_samp_rate;
+    double curr_step_size = ps_stepsize;
+    double sum, reach, first, travelled;
+    t_phasorshift_offset offset;
+    long long t;
+    bool clocked, steady;
+    long done, len, k, m;
+
+    // there is a phase for each of ps_outletcount outlets only
+    if (numouts > ps_outletcount) numouts = ps_outletcount;
+
+    clocked = ps_clock.start(n, &t);
+
+    for (done = 0; done < n; done += len) {
+        len = (n - done < PHASORSHIFT_BLOCK) ? n - done : PHASORSHIFT_BLOCK;
+
+        // ramp[k] is the phase travelled before sample k of the block
+        sum = reach = 0.0;
+        first = freq[done] / sr;
+        steady = true;
+        for (k = 0; k < len; k++) {
+            ramp[k] = sum;
+            curr_step_size = freq[done + k] / sr;
+            sum += curr_step_size;
+            reach += fabs(curr_step_size);
+            steady &= (curr_step_size == first);
+        }
+
+        // a block at one step is where the clock puts it; one whose steps
+        // change anchors the clock again where it ends
+        if (clocked) {
+            travelled = ps_clock.phase(first, t + done);
+            setClockPhases(travelled);
+            if (!steady)
+                ps_clock.move(t + done + len, travelled + sum, curr_step_size);
+        }
+
+        // a ramp beyond the int32 rounding of the sse2 kernel, or one that
+        // is not a number, is written by the scalar kernel
+        offset = (reach < PHASORSHIFT_SSE2_SPAN) ? ps_offset_kernel : phasorshift_offsetScalar;
+
+        for (m = 0; m < numouts; m++) {
+            offset(currIndex[m], ramp, outs[m] + done, len);
+
+            // the phase the next block starts from
+            currIndex[m] = phasorshift_frac(currIndex[m] + sum);
+        }
+    }
+
+    // update object variables
+    if (n > 0) ps_freq = freq[n - 1];
+    ps_stepsize = curr_step_size;
+}
+
+#endif /* __PHASORSHIFT_DSP */
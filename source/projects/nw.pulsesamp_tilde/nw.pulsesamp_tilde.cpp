@@ -11,6 +11,9 @@
 */
 
 #include "c74_msp.h"
+#include <atomic>
+#include "nw_bufswap.h"
+#include "nw_interp.h"
 
 using namespace c74::max;
 
@@ -32,8 +35,11 @@ using namespace c74::max;
 #define REVERSE_GRAINS		1
 
 /* for interpolation flag */
-#define INTERP_OFF			0
-#define INTERP_ON			1
+#define INTERP_OFF			NW_INTERP_NONE
+#define INTERP_ON			NW_INTERP_LINEAR
+#define INTERP_HERMITE		NW_INTERP_HERMITE
+#define INTERP_LAGRANGE		NW_INTERP_LAGRANGE
+#define INTERP_SINC			NW_INTERP_SINC
 
 /* for overflow flag, added 2002.10.28 */
 #define OVERFLOW_OFF		0
@@ -41,23 +47,41 @@ using namespace c74::max;
 
 static t_class *pulsesamp_class;		// required global pointing to this class
 
+/* the perform loop for one set of options, see nw_pulsesamp_run() */
+struct _nw_pulsesamp;
+typedef long (*t_nw_pulsesamp_kernel)(struct _nw_pulsesamp *x, const float *tab_s, long size_s, long chan_s,
+	double **ins, double **outs, long i, long vectorsize);
+
+/* the kernels for one interpolation mode */
+typedef struct _nw_pulsesamp_kernels
+{
+	t_nw_pulsesamp_kernel kernel[2][2][2];	// by grain direction, mono or stereo, then wrapping
+} t_nw_pulsesamp_kernels;
+
 typedef struct _nw_pulsesamp
 {
 	t_pxobject x_obj;
 	// sound buffer info
 	t_symbol *snd_sym;
-	t_buffer_ref *snd_buf_ptr;
-	t_buffer_ref *next_snd_buf_ptr;
+	t_buffer_ref *snd_ref;		// last buffer~ linked, main thread only
+	NwBufSwap snd_swap;			// hands snd_ref to the perform routine
+	t_nw_bufinfo snd_buf;		// buffer~ being played, perform only
 	double snd_last_out;
 	//long snd_buf_length;	//removed 2002.07.11
 	short snd_interp;
+	const t_nw_sinc *snd_sinc;			// sinc tables, once interpolation 4 or sincTable asks
+	// perform kernels
+	std::atomic<const t_nw_pulsesamp_kernels *> next_kernels;	// for snd_interp
+	t_nw_pulsesamp_kernel grain_kernel;	// kernel playing, perform only
 	// current grain info
 	double grain_samp_inc;		// in buffer_samples/playback_sample
 	double grain_gain;	// as coef
 	double grain_start;	// in samples; add 2005.10.10
 	double grain_end;	// in samples; add 2005.10.10
 	short grain_direction;	// forward or reverse
+	short snd_wraps;		// grain reads near the ends of the sound buffer
 	double snd_step_size;	// in samples
+	const t_nw_sinc_filter *grain_sinc;	// filter for the sinc kernel, see nw_sinc.h
 	double curr_snd_pos;	// in samples
 	short overflow_status;	//only used while grain is sounding
 			//will produce false positives otherwise
@@ -88,10 +112,28 @@ void nw_pulsesamp_float(t_nw_pulsesamp *x, double f);
 void nw_pulsesamp_int(t_nw_pulsesamp *x, long l);
 void nw_pulsesamp_initGrain(t_nw_pulsesamp *x, float in_samp_inc, float in_gain, float in_start, float in_end);
 void nw_pulsesamp_sndInterp(t_nw_pulsesamp *x, long l);
+void nw_pulsesamp_sincTable(t_nw_pulsesamp *x, long l);
 void nw_pulsesamp_reverse(t_nw_pulsesamp *x, long l);
 void nw_pulsesamp_assist(t_nw_pulsesamp *x, t_object *b, long msg, long arg, char *s);
 void nw_pulsesamp_getinfo(t_nw_pulsesamp *x);
-double mcLinearInterp(float *in_array, long index_i, double index_frac, long in_size, short in_chans);
+void nw_pulsesamp_publishKernels(t_nw_pulsesamp *x);
+t_nw_pulsesamp_kernel nw_pulsesamp_kernel(t_nw_pulsesamp *x);
+template <int InterpS, short Direction, int Chans, bool Wraps>
+long nw_pulsesamp_run(t_nw_pulsesamp *x, const float *tab_s, long size_s, long chan_s,
+	double **ins, double **outs, long i, long vectorsize);
+
+/* every kernel, by interpolation mode */
+#define PULSESAMP_KERNELS_C(s, d, c)	{ nw_pulsesamp_run<s, d, c, false>, nw_pulsesamp_run<s, d, c, true> }
+#define PULSESAMP_KERNELS_D(s, d)		{ PULSESAMP_KERNELS_C(s, d, 1), PULSESAMP_KERNELS_C(s, d, 2) }
+#define PULSESAMP_KERNELS(s)			{ { PULSESAMP_KERNELS_D(s, FORWARD_GRAINS), PULSESAMP_KERNELS_D(s, REVERSE_GRAINS) } }
+
+static const t_nw_pulsesamp_kernels nw_pulsesamp_kernels[INTERP_SINC + 1] = {
+	PULSESAMP_KERNELS(INTERP_OFF),
+	PULSESAMP_KERNELS(INTERP_ON),
+	PULSESAMP_KERNELS(INTERP_HERMITE),
+	PULSESAMP_KERNELS(INTERP_LAGRANGE),
+	PULSESAMP_KERNELS(INTERP_SINC)
+};
 
 
 t_symbol *ps_buffer;
@@ -127,6 +169,9 @@ int C74_EXPORT main(void)
 	/* bind method "nw_pulsesamp_sndInterp" to the interpolation message */
 	class_addmethod(c, (method)nw_pulsesamp_sndInterp, "interpolation", A_LONG, 0);
 	
+	/* bind method "nw_pulsesamp_sincTable" to the sincTable message */
+	class_addmethod(c, (method)nw_pulsesamp_sincTable, "sincTable", A_LONG, 0);
+	
 	/* bind method "nw_pulsesamp_assist" to the assistance message */
 	class_addmethod(c, (method)nw_pulsesamp_assist, "assist", A_CANT, 0);
 	
@@ -170,7 +215,9 @@ void *nw_pulsesamp_new(t_symbol *snd)
 	x->snd_sym = snd;
 	
 	/* zero pointers */
-	x->snd_buf_ptr = x->next_snd_buf_ptr = NULL;
+	x->snd_ref = NULL;
+	x->snd_swap.init();
+	nw_bufinfo_set(&x->snd_buf, NULL, 0, 0, 0.0, 0);
 	
 	/* setup variables */
 	x->grain_samp_inc = x->next_grain_samp_inc = 1.0;
@@ -178,13 +225,18 @@ void *nw_pulsesamp_new(t_symbol *snd)
 	x->grain_start = x->next_grain_start = 0.0;  // add 2005.10.10
 	x->grain_end = x->next_grain_end = -1.0;	//add 2005.10.10
 	x->snd_step_size = 1.0;
+	x->grain_sinc = NULL;
 	x->curr_snd_pos = 0.0;
 	x->last_pulse_in = 0.0;
 	x->curr_count_samp = -1;
 	
 	/* set flags to defaults */
 	x->snd_interp = INTERP_ON;
+	x->snd_sinc = NULL;
+	x->snd_wraps = true;
 	x->grain_direction = x->next_grain_direction = FORWARD_GRAINS;
+	nw_pulsesamp_publishKernels(x);
+	x->grain_kernel = NULL;
 	
 	x->x_obj.z_misc = Z_NO_INPLACE;
 	
@@ -298,33 +350,137 @@ void nw_pulsesamp_perform64(t_nw_pulsesamp *x, t_object *dsp64, double **ins, lo
     
     // local vars for snd buffer
     t_buffer_obj *snd_object;
+    t_buffer_info b_info;
     float *tab_s;
-    float snd_out;
-    float snd_out2;
     long size_s, chan_s;
     
     // local vars for object vars and while loop
-    double index_s, index_s_start, index_s_end;
-    double s_step_size, g_gain;
-    float last_s, last_pulse;
-    long count_samp;
-    short interp_s, g_direction, of_status;
-    long n, temp_index_int, temp_index_int_times_chan;
-    double temp_index_frac;
+    float last_pulse;
+    long n;
     
     /* check to make sure buffers are loaded with proper file types*/
     if (x->x_obj.z_disabled)		// object is enabled
         goto out;
-    if (x->snd_buf_ptr == NULL)     // buffer pointer is defined
+    if (x->curr_count_samp == -1 && x->snd_swap.take(&x->snd_buf)) {	// a new buffer waits for the grain playing
+        #ifdef DEBUG
+            object_post((t_object*)x, "buffer pointer updated");
+        #endif /* DEBUG */
+    }
+    if (x->snd_buf.ref == NULL)     // buffer pointer is defined
         goto zero;
     
-    // get snd buffer info
-    snd_object = buffer_ref_getobject(x->snd_buf_ptr);
+    // get snd buffer info; values cached when it was linked are read again
+    // only if the buffer~ has been changed since
+    snd_object = buffer_ref_getobject((t_buffer_ref *)x->snd_buf.ref);
     tab_s = buffer_locksamples(snd_object);
     if (!tab_s)		// buffer samples were not accessible
         goto zero;
-    size_s = buffer_getframecount(snd_object);
-    chan_s = buffer_getchannelcount(snd_object);
+    buffer_getinfo(snd_object, &b_info);
+    if (b_info.b_modtime != x->snd_buf.modtime) {
+        nw_bufinfo_set(&x->snd_buf, x->snd_buf.ref, b_info.b_frames, b_info.b_nchans, b_info.b_sr, b_info.b_modtime);
+        x->snd_wraps = true;	// the grain checked its span against the old sound
+        if (x->grain_end > (double)(x->snd_buf.frames - 1))
+            x->curr_count_samp = -1;	// and no longer fits in it
+    }
+    size_s = x->snd_buf.frames;
+    chan_s = x->snd_buf.chans;
+    
+    // the kernel for the mode interpolation last set, the grain playing, and
+    // the sound as it is now; each grain begun picks another
+    x->grain_kernel = nw_pulsesamp_kernel(x);
+    
+    // get history from last vector
+    last_pulse = x->last_pulse_in;
+    
+    n = 0;
+    while (n < vectorsize)
+    {
+        // should we start reading sample segment ?
+        if (x->curr_count_samp == -1) { // if sample count is -1...
+            if (last_pulse == 0.0 && in_pulse[n] == 1.0) { // if pulse begins...
+                // the buffer stays locked, as initGrain only works from
+                // the values cached with it
+                nw_pulsesamp_initGrain(x, in_sample_increment[n], in_gain[n], in_start[n], in_end[n]);
+                
+                // BUT this stays off until duty cycle ends
+                x->overflow_status = OVERFLOW_OFF;
+                
+            } else { // if not...
+                out_signal[n] = 0.0;
+                out_signal2[n] = 0.0;
+                out_overflow[n] = 0.0;
+                out_sample_count[n] = -1.0;
+                last_pulse = in_pulse[n];
+                ++n;
+                continue;
+            }
+        }
+        
+        // play the grain until it ends or the vector does
+        x->last_pulse_in = last_pulse;
+        n = x->grain_kernel(x, tab_s, size_s, chan_s, ins, outs, n, vectorsize);
+        last_pulse = x->last_pulse_in;
+    }
+    
+    // update object history for next vector
+    x->last_pulse_in = last_pulse;
+    
+    buffer_unlocksamples(snd_object);
+    return;
+
+// alternate blank output
+zero:
+    n = vectorsize;
+    while(n--)
+    {
+        *out_signal++ = 0.;
+        *out_signal2++ = 0.;
+        *out_overflow++ = -1.;
+        *out_sample_count++ = -1.;
+    }
+
+out:
+    return;
+    
+}
+
+/********************************************************************************
+long nw_pulsesamp_run<InterpS, Direction, Chans, Wraps>(t_nw_pulsesamp *x,
+		const float *tab_s, long size_s, long chan_s, double **ins,
+		double **outs, long i, long vectorsize)
+
+inputs:			x			-- pointer to this object
+				tab_s		-- sound buffer samples, locked
+				size_s		-- frames in the sound buffer
+				chan_s		-- channels in the sound buffer
+				ins, outs	-- signal vectors of the perform routine
+				i			-- first sample to compute, a grain playing
+				vectorsize	-- samples in the vector
+description:	the perform loop of a sounding grain for one set of options;
+		interpolation mode, grain direction, sound channels and wrapping are
+		template arguments, so none of them is tested per sample; runs until
+		the grain ends or the vector does
+returns:		the sample after the one the grain ended on, or vectorsize
+********************************************************************************/
+template <int InterpS, short Direction, int Chans, bool Wraps>
+long nw_pulsesamp_run(t_nw_pulsesamp *x, const float *tab_s, long size_s, long chan_s,
+	double **ins, double **outs, long i, long vectorsize)
+{
+    // local vars outlets and inlets
+    double *in_pulse = ins[0];
+    double *out_signal = outs[0];
+    double *out_signal2 = outs[1];
+    double *out_sample_count = outs[2];
+    double *out_overflow = outs[3];
+    
+    // local vars for object vars and while loop
+    double snd_out[2];
+    double index_s, index_s_start, index_s_end;
+    double s_step_size, g_gain;
+    float last_s, last_pulse;
+    long count_samp;
+    short of_status;
+    const t_nw_sinc_filter *sinc_s;
     
     // get snd index info
     index_s_start = x->grain_start;
@@ -333,184 +489,86 @@ void nw_pulsesamp_perform64(t_nw_pulsesamp *x, t_object *dsp64, double **ins, lo
     
     // get grain options
     g_gain = x->grain_gain;
-    interp_s = x->snd_interp;
-    g_direction = x->grain_direction;
+    sinc_s = x->grain_sinc;
     
-    // get history from last vector
+    // get history
     last_s = x->snd_last_out;
     index_s = x->curr_snd_pos;
     last_pulse = x->last_pulse_in;
     of_status = x->overflow_status;
     count_samp = x->curr_count_samp;
     
-    n = vectorsize;
-    while(n--)
-    {
-        // should we start reading sample segment ?
-        if (count_samp == -1) { // if sample count is -1...
-            if (last_pulse == 0.0 && *in_pulse == 1.0) { // if pulse begins...
-                buffer_unlocksamples(snd_object);
-                
-                nw_pulsesamp_initGrain(x, *in_sample_increment, *in_gain, *in_start, *in_end);
-                
-                /* update local vars again */
-                
-                // get snd buffer info
-                snd_object = buffer_ref_getobject(x->snd_buf_ptr);
-                tab_s = buffer_locksamples(snd_object);
-                if (!tab_s)	{	// buffer samples were not accessible
-                    *out_signal = 0.0;
-                    *out_signal2 = 0.0;
-                    *out_overflow = 0.0;
-                    *out_sample_count = (double)count_samp;
-                    last_pulse = *in_pulse;
-                    goto advance_pointers;
-                }
-                size_s = buffer_getframecount(snd_object);
-                
-                // get snd index info
-                index_s_start = x->grain_start;
-                index_s_end = x->grain_end;
-                s_step_size = x->snd_step_size;
-                
-                // get grain options
-                g_gain = x->grain_gain;
-                interp_s = x->snd_interp;
-                g_direction = x->grain_direction;
-                
-                // other history
-                last_s = x->snd_last_out;
-                index_s = x->curr_snd_pos;
-                last_pulse = x->last_pulse_in;
-                /*** of_status = x->overflow_status; ***/
-                count_samp = x->curr_count_samp;
-                
-                // BUT this stays off until duty cycle ends
-                of_status = OVERFLOW_OFF;
-                
-            } else { // if not...
-                *out_signal = 0.0;
-                *out_signal2 = 0.0;
-                *out_overflow = 0.0;
-                *out_sample_count = (double)count_samp;
-                last_pulse = *in_pulse;
-                goto advance_pointers;
-            }
-        }
+    for (; i < vectorsize; i++) {
         
         //pulse tracking for overflow
         if (!of_status) {
-            if (last_pulse == 1.0 && *in_pulse == 0.0) { // if grain on & pulse ends...
+            if (last_pulse == 1.0 && in_pulse[i] == 0.0) { // if grain on & pulse ends...
                 of_status = OVERFLOW_ON;	//start overflowing
             }
         }
         
-        // advance snd index
-        if (g_direction == FORWARD_GRAINS) {	// if forward...
+        // advance snd index, and check bounds of buffer index
+        if (Direction == FORWARD_GRAINS) {	// if forward...
             index_s += s_step_size;		// add to sound index
-            
-            /* check bounds of buffer index */
-            if (index_s > index_s_end) {
-                count_samp = -1;
-                *out_signal = 0.0;
-                *out_signal2 = 0.0;
-                *out_overflow = 0.0;
-                *out_sample_count = (double)count_samp;
-                last_pulse = *in_pulse;
-                #ifdef DEBUG
-                    object_post((t_object*)x, "end of grain");
-                #endif /* DEBUG */
-                goto advance_pointers;
-            }
-            
+            if (index_s > index_s_end)
+                break;
         } else {	// if reverse...
             index_s -= s_step_size;		// subtract from sound index
-            
-            /* check bounds of buffer index */
-            if (index_s < index_s_start) {
-                count_samp = -1;
-                *out_signal = 0.0;
-                *out_signal2 = 0.0;
-                *out_overflow = 0.0;
-                *out_sample_count = (double)count_samp;
-                last_pulse = *in_pulse;
-                #ifdef DEBUG
-                    object_post((t_object*)x, "end of grain");
-                #endif /* DEBUG */
-                goto advance_pointers;
-            }
-            
+            if (index_s < index_s_start)
+                break;
         }
         
         // if we made it here, then we will actually start counting
         count_samp++;
         
-        // compute temporary vars for interpolation
-        temp_index_int = (long)(index_s); // integer portion of index
-        temp_index_frac = index_s - (double)temp_index_int; // fractional portion of index
-        temp_index_int_times_chan = temp_index_int * chan_s;
-        
         // get value from the snd buffer samples
         // if stereo, get values from each channel
         // if mono, get one value and copy to both outputs
-        if (interp_s == INTERP_OFF) {
-            snd_out = tab_s[temp_index_int_times_chan];
-            snd_out2 = (chan_s == 2) ?
-                tab_s[temp_index_int_times_chan + 1] :
-                snd_out;
+        if (Chans == 2) {
+            nw_interp<2>(InterpS, Wraps, tab_s, size_s, 2, index_s, snd_out, sinc_s);
         } else {
-            snd_out = mcLinearInterp(tab_s, temp_index_int_times_chan, temp_index_frac, size_s, chan_s);
-            snd_out2 = (chan_s == 2) ?
-                mcLinearInterp(tab_s, temp_index_int_times_chan + 1, temp_index_frac, size_s, chan_s) :
-                snd_out;
+            nw_interp<1>(InterpS, Wraps, tab_s, size_s, chan_s, index_s, snd_out, sinc_s);
+            snd_out[1] = snd_out[0];
         }
         
         // multiply snd_out by gain value
-        *out_signal = snd_out * g_gain;
-        *out_signal2 = snd_out2 * g_gain;
+        out_signal[i] = snd_out[0] * g_gain;
+        out_signal2[i] = snd_out[1] * g_gain;
         
         if (of_status) {
-            *out_overflow = *in_pulse;
+            out_overflow[i] = in_pulse[i];
         } else {
-            *out_overflow = 0.0;
+            out_overflow[i] = 0.0;
         }
         
-        *out_sample_count = (double)count_samp;
+        out_sample_count[i] = (double)count_samp;
         
         // update vars for last output
-        last_pulse = *in_pulse;
-        last_s = snd_out;
-        
-advance_pointers:
-        // advance all pointers
-        ++in_pulse, ++in_sample_increment, ++in_gain, ++in_start, ++in_end;
-        ++out_signal, ++out_signal2, ++out_overflow, ++out_sample_count;
+        last_pulse = in_pulse[i];
+        last_s = snd_out[0];
     }
     
-    // update object history for next vector
+    if (i < vectorsize) {	// the grain ended on this sample
+        count_samp = -1;
+        out_signal[i] = 0.0;
+        out_signal2[i] = 0.0;
+        out_overflow[i] = 0.0;
+        out_sample_count[i] = (double)count_samp;
+        last_pulse = in_pulse[i];
+        ++i;
+        #ifdef DEBUG
+            object_post((t_object*)x, "end of grain");
+        #endif /* DEBUG */
+    }
+    
+    // update object history
     x->snd_last_out = last_s;
     x->curr_snd_pos = index_s;
     x->last_pulse_in = last_pulse;
     x->overflow_status = of_status;
     x->curr_count_samp = count_samp;
     
-    buffer_unlocksamples(snd_object);
-    return;
-
-// alternate blank output
-zero:
-    n = vectorsize;
-    while(n--)
-    {
-        *out_signal++ = 0.;
-        *out_signal2++ = 0.;
-        *out_overflow++ = -1.;
-        *out_sample_count++ = -1.;
-    }
-
-out:
-    return;
-    
+    return i;
 }
 
 /********************************************************************************
@@ -522,7 +580,8 @@ inputs:			x					-- pointer to this object
 				in_start			-- where to start reading buffer, in ms
 				in_end				-- where to stop reading buffer, in ms
 description:	initializes grain vars; called from perform method when bang is 
-		received
+		received; makes no buffer~ calls, working only from the values cached
+		with the sound buffer, so the perform routine can keep it locked
 returns:		nothing 
 ********************************************************************************/
 void nw_pulsesamp_initGrain(t_nw_pulsesamp *x, float in_samp_inc, float in_gain, 
@@ -532,19 +591,6 @@ void nw_pulsesamp_initGrain(t_nw_pulsesamp *x, float in_samp_inc, float in_gain,
 		object_post((t_object*)x, "initializing grain");
 	#endif /* DEBUG */
     
-    t_buffer_obj	*snd_object;
-	
-	if (x->next_snd_buf_ptr != NULL) {
-		x->snd_buf_ptr = x->next_snd_buf_ptr;
-		x->next_snd_buf_ptr = NULL;
-		
-		#ifdef DEBUG
-			object_post((t_object*)x, "buffer pointer updated");
-		#endif /* DEBUG */
-	}
-	
-	snd_object = buffer_ref_getobject(x->snd_buf_ptr);
-	
 	/* should input variables be at audio or control rate ? */
 	
     x->grain_samp_inc = x->grain_samp_inc_connected ? in_samp_inc : x->next_grain_samp_inc;
@@ -558,21 +604,22 @@ void nw_pulsesamp_initGrain(t_nw_pulsesamp *x, float in_samp_inc, float in_gain,
     /* compute dependent variables */
     
 	// compute sound buffer step size per vector sample
-	x->snd_step_size = x->grain_samp_inc * buffer_getsamplerate(snd_object) * x->output_1oversr;
+	x->snd_step_size = x->grain_samp_inc * x->snd_buf.sr * x->output_1oversr;
     if (x->snd_step_size < 0.) x->snd_step_size *= -1.; // needs to be positive to prevent buffer overruns
+    x->grain_sinc = nw_sinc_filter(x->snd_sinc, x->snd_step_size);
 	
     // update grain direction
     x->grain_direction = x->next_grain_direction;
 	
 	// convert start to samples
-	x->grain_start = (long)((x->grain_start * buffer_getmillisamplerate(snd_object)) + 0.5);
+	x->grain_start = (long)((x->grain_start * x->snd_buf.msr) + 0.5);
 	
 	// convert end to samples
-	x->grain_end = (long)((x->grain_end * buffer_getmillisamplerate(snd_object)) + 0.5);
+	x->grain_end = (long)((x->grain_end * x->snd_buf.msr) + 0.5);
 	
 	// test if end within bounds
-	if (x->grain_end < 0. || x->grain_end > (double)(buffer_getframecount(snd_object))) x->grain_end =
-        (double)(buffer_getframecount(snd_object));
+	if (x->grain_end < 0. || x->grain_end > (double)(x->snd_buf.frames - 1)) x->grain_end =
+        (double)(x->snd_buf.frames - 1);
 	
     // test if start within bounds
 	if (x->grain_start < 0. || x->grain_start > x->grain_end) x->grain_start = 0.;
@@ -584,6 +631,13 @@ void nw_pulsesamp_initGrain(t_nw_pulsesamp *x, float in_samp_inc, float in_gain,
 		x->curr_snd_pos = x->grain_end + x->snd_step_size;
 	}
 	
+	// grains that stay clear of the buffer ends can skip wrapping in the interpolator
+	x->snd_wraps = nw_interp_wraps(x->grain_start - x->snd_step_size, x->grain_end + x->snd_step_size,
+		x->snd_buf.frames);
+	
+	// pick the kernel for the grain's direction and wrapping
+	x->grain_kernel = nw_pulsesamp_kernel(x);
+	
 	// reset history
 	x->snd_last_out = 0.0;
 	x->curr_count_samp = -1;
@@ -594,48 +648,69 @@ void nw_pulsesamp_initGrain(t_nw_pulsesamp *x, float in_samp_inc, float in_gain,
 	#endif /* DEBUG */
 }
 
+/********************************************************************************
+void nw_pulsesamp_publishKernels(t_nw_pulsesamp *x)
+
+inputs:			x		-- pointer to this object
+description:	hands the kernels for the current interpolation mode to the
+		perform routine, which takes them at its next vector or grain
+returns:		nothing
+********************************************************************************/
+void nw_pulsesamp_publishKernels(t_nw_pulsesamp *x)
+{
+	x->next_kernels.store(&nw_pulsesamp_kernels[x->snd_interp], std::memory_order_release);
+}
+
+/********************************************************************************
+t_nw_pulsesamp_kernel nw_pulsesamp_kernel(t_nw_pulsesamp *x)
+
+inputs:			x		-- pointer to this object
+description:	perform routine side; picks the kernel for the published mode,
+		the direction and wrapping of the grain playing and the channels of
+		the sound
+returns:		the kernel
+********************************************************************************/
+t_nw_pulsesamp_kernel nw_pulsesamp_kernel(t_nw_pulsesamp *x)
+{
+	const t_nw_pulsesamp_kernels *kernels = x->next_kernels.load(std::memory_order_acquire);
+	
+	return kernels->kernel[x->grain_direction][x->snd_buf.chans == 2][x->snd_wraps != 0];
+}
+
 /********************************************************************************
 void nw_pulsesamp_setsnd(t_index *x, t_symbol *s)
 
 inputs:			x		-- pointer to this object
 				s		-- name of buffer to link
-description:	links buffer holding the grain sound source 
+description:	links buffer holding the grain sound source; the perform
+		routine takes it, with its frame count, channel count and sample rate,
+		at the start of the first vector with no grain playing
 returns:		nothing
 ********************************************************************************/
 void nw_pulsesamp_setsnd(t_nw_pulsesamp *x, t_symbol *s)
 {
-	t_buffer_ref *b = buffer_ref_new((t_object*)x, s);;
-	
-	if (buffer_ref_exists(b)) {
+    t_buffer_ref *b = buffer_ref_new((t_object*)x, s);
+    t_buffer_info b_info;
+    t_nw_bufinfo info;
+    
+    if (buffer_ref_exists(b)) {
         t_buffer_obj	*b_object = buffer_ref_getobject(b);
         
-		if (buffer_getchannelcount(b_object) > 2) {
+        buffer_getinfo(b_object, &b_info);
+        if (b_info.b_nchans > 2) {
 			object_error((t_object*)x, "buffer~ > %s < must be mono or stereo", s->s_name);
-			x->next_snd_buf_ptr = NULL;		//added 2002.07.15
 		} else {
-			if (x->snd_buf_ptr == NULL) { // make current buffer
-				x->snd_sym = s;
-				x->snd_buf_ptr = b;
-				x->snd_last_out = 0.0;
-				
-				#ifdef DEBUG
-					object_post((t_object*)x, "current sound set to buffer~ > %s <", s->s_name);
-				#endif /* DEBUG */
-			} else { // defer to next buffer
-				x->snd_sym = s;
-				x->next_snd_buf_ptr = b;
-				//x->snd_buf_length = b->b_frames;	//removed 2002.07.11
-				//x->snd_last_out = 0.0;		//removed 2002.07.24
-				
-				#ifdef DEBUG
-					object_post((t_object*)x, "next sound set to buffer~ > %s <", s->s_name);
-				#endif /* DEBUG */
-			}
+			x->snd_sym = s;
+			x->snd_ref = b;
+			nw_bufinfo_set(&info, b, b_info.b_frames, b_info.b_nchans, b_info.b_sr, b_info.b_modtime);
+			x->snd_swap.post(info);
+			
+			#ifdef DEBUG
+				object_post((t_object*)x, "next sound set to buffer~ > %s <", s->s_name);
+			#endif /* DEBUG */
 		}
-        
 	} else {
 		object_error((t_object*)x, "no buffer~ * %s * found", s->s_name);
-		x->next_snd_buf_ptr = NULL;
 	}
 }
 
@@ -716,27 +791,63 @@ void nw_pulsesamp_sndInterp(t_nw_pulsesamp *x, long l)
 inputs:			x		-- pointer to our object
 				l		-- flag value
 description:	method called when "interpolation" message is received; allows user
-		to define whether interpolation is used in pulling values from the sound
-		buffer; default is on
+		to choose the interpolation used in pulling values from the sound
+		buffer; 0 = off, 1 = linear, 2 = hermite, 3 = lagrange, 4 = windowed
+		sinc; default is linear
 returns:		nothing
 ********************************************************************************/
 void nw_pulsesamp_sndInterp(t_nw_pulsesamp *x, long l)
 {
-	if (l == INTERP_OFF) {
-		x->snd_interp = INTERP_OFF;
-		#ifdef DEBUG
-			object_post((t_object*)x, "interpolation is set to off");
-		#endif // DEBUG //
-	} else if (l == INTERP_ON) {
-		x->snd_interp = INTERP_ON;
+	if (l == INTERP_SINC && !x->snd_sinc) {
+		x->snd_sinc = nw_sinc_get(NW_SINC_PHASES);
+		if (!x->snd_sinc) {
+			object_error((t_object*)x, "out of memory for the sinc table");
+			return;
+		}
+	}
+	
+	if (l >= INTERP_OFF && l <= INTERP_SINC) {
+		x->snd_interp = (short)l;
+		nw_pulsesamp_publishKernels(x);
 		#ifdef DEBUG
-			object_post((t_object*)x, "interpolation is set to on");
+			object_post((t_object*)x, "interpolation is set to %ld", l);
 		#endif // DEBUG //
 	} else {
 		object_error((t_object*)x, "interpolation message was not understood");
 	}
 }
 
+/********************************************************************************
+void nw_pulsesamp_sincTable(t_nw_pulsesamp *x, long l)
+
+inputs:			x		-- pointer to our object
+				l		-- phases per frame
+description:	method called when "sincTable" message is received; sets the
+		size of the table read by interpolation 4, rounded to a power of two
+		between 16 and 4096; larger tables read between frames more finely;
+		default is 256; grains begun afterwards use it
+returns:		nothing
+********************************************************************************/
+void nw_pulsesamp_sincTable(t_nw_pulsesamp *x, long l)
+{
+	const t_nw_sinc *sinc;
+	
+	if (l < 1) {
+		object_error((t_object*)x, "sincTable message was not understood");
+		return;
+	}
+	
+	sinc = nw_sinc_get(l);
+	if (!sinc) {
+		object_error((t_object*)x, "out of memory for the sinc table");
+		return;
+	}
+	x->snd_sinc = sinc;
+	#ifdef DEBUG
+		object_post((t_object*)x, "sincTable is set to %ld phases", sinc->phases);
+	#endif // DEBUG //
+}
+
 /********************************************************************************
 void nw_pulsesamp_reverse(t_nw_pulsesamp *x, long l)
 
@@ -831,35 +942,4 @@ void nw_pulsesamp_getinfo(t_nw_pulsesamp *x)
 {
 	object_post((t_object*)x, "%s object by Nathan Wolek", OBJECT_NAME);
 	object_post((t_object*)x, "Last updated on %s - www.nathanwolek.com", __DATE__);
-}
-
-/********************************************************************************
-double mcLinearInterp(float *in_array, long index_i, double index_frac, 
-		long in_size, short in_chans)
-
-inputs:			*in_array -- name of array of input values
-				index_i -- index value of sample, specific channel within interleaved frame
-				index_frac -- fractional portion of index value for interp
-				in_size -- size of input buffer to perform wrapping
-				in_chans -- number of channels in input buffer
-description:	performs linear interpolation on an input array and to return 
-	value of a fractional sample location
-returns:		interpolated output
-********************************************************************************/
-double mcLinearInterp(float *in_array, long index_i, double index_frac, long in_size, short in_chans)
-{
-	double out, sample1, sample2;
-    long index_iP1 = index_i + in_chans;		// corresponding sample in next frame
-	
-	// make sure that index_iP1 is not out of range
-	while (index_iP1 >= in_size * in_chans) index_iP1 -= in_size;
-	
-	// get samples
-	sample1 = (double)in_array[index_i];
-	sample2 = (double)in_array[index_iP1];
-	
-	//linear interp formula
-	out = sample1 + index_frac * (sample2 - sample1);
-	
-	return out;
 }
\ No newline at end of file
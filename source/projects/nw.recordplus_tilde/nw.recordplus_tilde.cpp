@@ -12,6 +12,7 @@
 */
 
 #include "c74_msp.h"
+#include "recordplus_dsp.h"
 
 using namespace c74::max;
 
@@ -27,12 +28,6 @@ using namespace c74::max;
 #define INTERP_OFF			0
 #define INTERP_ON			1
 
-/* for record stage flag */
-#define REC_OFF			0
-#define MONITOR_ON		1
-#define REC_ON			2
-#define MONITOR_OFF		3
-
 static t_class *recordplus_class;		// required global pointing to this class
 
 typedef struct _recordplus
@@ -45,19 +40,10 @@ typedef struct _recordplus
 	t_symbol *next_snd_sym;
 	t_buffer_ref *next_snd_buf_ref;
 	
-	// current recording info
-	long rec_position;	// in samples
-	short rec_stage; 	// see flags in header
-	
-	// sync output info
-	double sync_val;	// output from sync outlet
-	double sync_step;	// amount to add each time a sample is recorded
+	// recording stage, position, sync output and history
+	RecordPlus rec;
 	double next_sync_step;	// changes when new buffer is set
 	
-	// history
-	double last_ctrl_in;
-	double last_sig_in;
-	
 	double input_sr;					// <--
 	double input_1oversr;				// <--
 	double input_msr;					// <--
@@ -115,6 +101,8 @@ int C74_EXPORT main(void)
 	#ifndef DEBUG
 		
 	#endif /* DEBUG */
+	
+	return 0;
 }
 
 /********************************************************************************
@@ -137,15 +125,8 @@ void *recordplus_new(t_symbol *snd)
 	/* zero pointers */
 	x->snd_buf_ref = x->next_snd_buf_ref = NULL;
 	
-	/* setup variables */
-	x->rec_position = 0;
-	x->sync_val = 0.0;
-	x->sync_step = 0.0;
-	x->last_ctrl_in = 0.0;
-	x->last_sig_in = 0.0;
-	
-	/* set flags to defaults */
-	x->rec_stage = REC_OFF;
+	/* setup variables and set flags to defaults */
+	x->rec.init();
 	
 	x->x_obj.z_misc = Z_NO_INPLACE;
 	
@@ -220,16 +201,16 @@ void recordplus_perform64(t_recordplus *x, t_object *dsp64, double **ins, long n
     // local vars for snd buffer
     t_buffer_obj *snd_object;
     float *s_tab;
-    long s_size, r_pos;
+    long s_size;
     
-    // local vars for object vars and while loop
-    long n, saverpos;
-    short r_stage;
-    double lc_in, ls_in, sync_v, sync_s;
+    // local vars for while loop
+    long n, done;
     
     // check to make sure buffers are loaded with proper file types
     if (x->x_obj.z_disabled)		// and object is enabled
         goto out;
+    
+    done = 0;
     if (x->snd_buf_ref == NULL)
         goto zero;
     
@@ -240,117 +221,35 @@ void recordplus_perform64(t_recordplus *x, t_object *dsp64, double **ins, long n
         goto zero;
     s_size = buffer_getframecount(snd_object);
     
-    // assign values to local vars
-    r_stage = x->rec_stage;
-    lc_in = x->last_ctrl_in;
-    ls_in = x->last_sig_in;
-    sync_v = x->sync_val;
-    sync_s = x->sync_step;
-    r_pos = x->rec_position;
-    
-    // track r_pos to see if we wrote anything
-    saverpos = r_pos;
+    x->rec.rec_dirty = false;
     
-    n = vectorsize;
-    while (n--) {
-        
-        // test ctrl input
-        if ((lc_in == 0.) != (*in_ctrl == 0.)) {
-            
-            // what we do depends on the recording stage
-            switch (r_stage)
-            {
-                case REC_OFF:
-                    ++r_stage; // MONITOR_ON
-                    if (recordplus_updatebuff(x))
-                    {
-                        // unlock the current samples
-                        buffer_unlocksamples(snd_object);
-                        
-                        // get new sound buffer info
-                        snd_object = buffer_ref_getobject(x->snd_buf_ref);
-                        s_tab = buffer_locksamples(snd_object);
-                        if (!s_tab)		// buffer samples were not accessible
-                            goto zero;
-                        s_size = buffer_getframecount(snd_object);
-                        
-                        // update local vars
-                        sync_v = x->sync_val;
-                        sync_s = x->sync_step;
-                        r_pos = x->rec_position;
-                    }
-                    break;
-                case MONITOR_ON:
-                    --r_stage; // REC_OFF
-                    break;
-                case REC_ON:
-                    ++r_stage; // MONITOR_OFF
-                    break;
-                case MONITOR_OFF:
-                    --r_stage; // REC_ON
-                    break;
-            }
-            
-        }
+    while (done < vectorsize) {
+        done += x->rec.process(in_ctrl + done, in_signal + done, out_sync + done, vectorsize - done,
+                               s_tab, s_size, x->next_snd_buf_ref != NULL);
         
-        // test for positive zero-crossing
-        if (r_stage % 2) // if MONITOR_ON or MONITOR_OFF
-        {
-            if (ls_in < 0. && *in_signal >= 0.)
-            {
-                switch (r_stage)
-                {
-                    case MONITOR_ON:
-                        ++r_stage; // REC_ON
-                        break;
-                    case MONITOR_OFF:
-                        r_stage = REC_OFF;
-                        break;
-                }
-            }
-        }
-        
-        // record under right conditions
-        if (r_stage > MONITOR_ON) // if REC_ON or MONITOR_OFF
-        {
-            s_tab[r_pos] = (float)*in_signal;
+        // stopped early, so recording is being armed with a new buffer waiting
+        if (done < vectorsize) {
+            // update modtime and unlock the current samples
+            if (x->rec.rec_dirty)
+                buffer_setdirty(snd_object);
+            x->rec.rec_dirty = false;
+            buffer_unlocksamples(snd_object);
             
-            ++r_pos;
-            if (r_pos > s_size)
-            {
-                r_pos = 0;
-            }
+            recordplus_updatebuff(x);
             
-            sync_v += sync_s;
-            if (sync_v > 1.0)
-            {
-                sync_v = 0.;
-            }
+            // get new sound buffer info
+            snd_object = buffer_ref_getobject(x->snd_buf_ref);
+            s_tab = buffer_locksamples(snd_object);
+            if (!s_tab)		// buffer samples were not accessible
+                goto zero;
+            s_size = buffer_getframecount(snd_object);
         }
-        
-        // output sync
-        *out_sync = sync_v;
-        
-        // update history
-        lc_in = *in_ctrl;
-        ls_in = *in_signal;
-        
-        // advance pointers
-        ++in_ctrl, ++in_signal, ++out_sync;
-        
     }
     
     // update modtime
-    if (r_pos > saverpos)
+    if (x->rec.rec_dirty)
         buffer_setdirty(snd_object);
     
-    // update global vars
-    x->rec_stage = r_stage;
-    x->last_ctrl_in = lc_in;
-    x->last_sig_in = ls_in;
-    x->sync_val = sync_v;
-    x->rec_position = r_pos;
-    
     // unlock samples
     buffer_unlocksamples(snd_object);
     
@@ -358,7 +257,8 @@ void recordplus_perform64(t_recordplus *x, t_object *dsp64, double **ins, long n
     
     // alternate blank output
 zero:
-    n = vectorsize;
+    n = vectorsize - done;
+    out_sync += done;
     while(n--)
     {
         *out_sync++ = 0.;
@@ -390,9 +290,7 @@ void recordplus_setbuff(t_recordplus *x, t_symbol *s)
 		} else {
 			if (x->snd_buf_ref == NULL) { // if first buffer make current buffer
 				x->snd_sym = s;
-				x->sync_val = 0.0;
-				x->sync_step = 1.0 / buffer_getframecount(b_object);
-				x->rec_position = 0;
+				x->rec.reset(1.0 / buffer_getframecount(b_object));
 				x->snd_buf_ref = b;			// last so that all is ready
 				
 				#ifdef DEBUG
@@ -429,9 +327,7 @@ short recordplus_updatebuff(t_recordplus *x)
 	if (x->next_snd_buf_ref != NULL)
 	{
 		x->snd_sym = x->next_snd_sym;
-		x->sync_val = 0.0;
-		x->sync_step = x->next_sync_step;
-		x->rec_position = 0;
+		x->rec.reset(x->next_sync_step);
 		x->snd_buf_ref = x->next_snd_buf_ref;
 		x->next_snd_buf_ref = NULL;
 		
@@ -457,7 +353,7 @@ short recordplus_updatebuff(t_recordplus *x)
 void recordplus_resetcurrentbuff(t_recordplus *x)
 {
     
-    if (x->rec_stage == REC_OFF)
+    if (x->rec.rec_stage == REC_OFF)
     {
         // clear out the buffer
         t_buffer_obj	*b_object = buffer_ref_getobject(x->snd_buf_ref);
@@ -0,0 +1,192 @@
+/*
+** recordplus_dsp.h
+**
+** header file
+** zero-crossing record control for nw.recordplus~, free of any Max API calls
+** so that it can also be driven by the nw_bench profiling target
+**
+** Max allocates objects without running constructors, so a RecordPlus held
+** in an object struct is set up by init() rather than by a constructor
+**
+** Copyright © 2004,2015 by Nathan Wolek
+** License: http://opensource.org/licenses/BSD-3-Clause
+**
+*/
+
+#ifndef __RECORDPLUS_DSP
+#define __RECORDPLUS_DSP
+
+/* for record stage flag */
+#define REC_OFF			0
+#define MONITOR_ON		1
+#define REC_ON			2
+#define MONITOR_OFF		3
+
+class RecordPlus
+{
+public:
+	// current recording info
+	long rec_position;	// in samples
+	short rec_stage; 	// see flags above
+	bool rec_dirty;		// samples were written since the flag was last cleared
+
+	// sync output info
+	double sync_val;	// output from sync outlet
+	double sync_step;	// amount to add each time a sample is recorded
+
+	// history
+	double last_ctrl_in;
+	double last_sig_in;
+
+	void init(void);
+	void reset(double step);
+	long process(const double *in_ctrl, const double *in_signal, double *out_sync, long n,
+		float *tab, long frames, bool swap_pending);
+};
+
+/********************************************************************************
+void RecordPlus::init(void)
+
+inputs:			nothing
+description:	turns recording off and clears the history
+returns:		nothing
+********************************************************************************/
+inline void RecordPlus::init(void)
+{
+	rec_position = 0;
+	rec_stage = REC_OFF;
+	rec_dirty = false;
+	sync_val = 0.0;
+	sync_step = 0.0;
+	last_ctrl_in = 0.0;
+	last_sig_in = 0.0;
+}
+
+/********************************************************************************
+void RecordPlus::reset(double step)
+
+inputs:			step		-- sync increment per recorded sample, 1 / frames
+description:	starts recording again from the top of a buffer
+returns:		nothing
+********************************************************************************/
+inline void RecordPlus::reset(double step)
+{
+	sync_val = 0.0;
+	sync_step = step;
+	rec_position = 0;
+}
+
+/********************************************************************************
+long RecordPlus::process(const double *in_ctrl, const double *in_signal,
+		double *out_sync, long n, float *tab, long frames, bool swap_pending)
+
+inputs:			in_ctrl			-- control signal, non-zero to record
+				in_signal		-- signal to be recorded
+				out_sync		-- sync output, 0 to 1 through the buffer
+				n				-- number of samples
+				tab				-- mono buffer samples to record into
+				frames			-- frames in tab
+				swap_pending	-- true if a deferred buffer is waiting
+description:	starts and stops recording, but only at positive zero-crossings
+		of the input signal; a deferred buffer may only be swapped in when
+		recording is armed, so while swap_pending is true processing stops
+		just before a control change that would arm it, letting the caller
+		swap buffers and call again
+returns:		number of samples processed
+********************************************************************************/
+inline long RecordPlus::process(const double *in_ctrl, const double *in_signal, double *out_sync, long n,
+	float *tab, long frames, bool swap_pending)
+{
+	// local vars for object vars and while loop
+	short r_stage = rec_stage;
+	double lc_in = last_ctrl_in;
+	double ls_in = last_sig_in;
+	double sync_v = sync_val;
+	double sync_s = sync_step;
+	long r_pos = rec_position;
+	bool dirty = rec_dirty;
+	long i;
+
+	for (i = 0; i < n; i++) {
+
+		// test ctrl input
+		if ((lc_in == 0.) != (in_ctrl[i] == 0.)) {
+
+			// what we do depends on the recording stage
+			switch (r_stage)
+			{
+				case REC_OFF:
+					if (swap_pending)
+						goto done; // caller swaps buffers first
+					++r_stage; // MONITOR_ON
+					break;
+				case MONITOR_ON:
+					--r_stage; // REC_OFF
+					break;
+				case REC_ON:
+					++r_stage; // MONITOR_OFF
+					break;
+				case MONITOR_OFF:
+					--r_stage; // REC_ON
+					break;
+			}
+
+		}
+
+		// test for positive zero-crossing
+		if (r_stage % 2) // if MONITOR_ON or MONITOR_OFF
+		{
+			if (ls_in < 0. && in_signal[i] >= 0.)
+			{
+				switch (r_stage)
+				{
+					case MONITOR_ON:
+						++r_stage; // REC_ON
+						break;
+					case MONITOR_OFF:
+						r_stage = REC_OFF;
+						break;
+				}
+			}
+		}
+
+		// record under right conditions
+		if (r_stage > MONITOR_ON) // if REC_ON or MONITOR_OFF
+		{
+			tab[r_pos] = (float)in_signal[i];
+			dirty = true;
+
+			++r_pos;
+			if (r_pos >= frames)
+			{
+				r_pos = 0;
+			}
+
+			sync_v += sync_s;
+			if (sync_v > 1.0)
+			{
+				sync_v = 0.;
+			}
+		}
+
+		// output sync
+		out_sync[i] = sync_v;
+
+		// update history
+		lc_in = in_ctrl[i];
+		ls_in = in_signal[i];
+	}
+
+done:
+	// update object vars
+	rec_stage = r_stage;
+	last_ctrl_in = lc_in;
+	last_sig_in = ls_in;
+	sync_val = sync_v;
+	rec_position = r_pos;
+	rec_dirty = dirty;
+
+	return i;
+}
+
+#endif /* __RECORDPLUS_DSP */
@@ -4,6 +4,8 @@
 ** MSP object
 ** generates evenly shifted train signals
 ** 2001/08/29 started by Nathan Wolek
+** 2026/10/17 heap phases and a multichannel outlet
+** 2026/10/17 follows a shared clock
 ** 
 ** Copyright © 2001,2014 by Nathan Wolek
 ** License: http://opensource.org/licenses/BSD-3-Clause
@@ -12,6 +14,8 @@
 
 
 #include "c74_msp.h"
+#include "trainshift_dsp.h"
+#include "nw_clockreg.h"
 
 using namespace c74::max;
 
@@ -23,8 +27,6 @@ using namespace c74::max;
 #define ASSIST_INLET	1
 #define ASSIST_OUTLET	2
 
-#define OUTLET_MAX		64					// maximum number of outlets specifiable
-#define OUTLET_MIN		2					// minimum number of outlets specifiable
 #define VEC_SIZE		OUTLET_MAX + 5		// size of vector array passed to perform method
 
 static t_class *trainshift_class;		// required global pointer to this class
@@ -33,26 +35,27 @@ static t_class *trainshift_class;		// required global pointer to this class
 typedef struct _trainShift
 {
 	t_pxobject 	ts_obj;
-	long 		ts_outletcount;
-	float 		ts_currIndex[OUTLET_MAX];
-	float 		ts_interval_ms;
-	float		ts_width_ratio;
-	float		ts_step_size;
+	TrainShift	ts_trains;				// phases, interval, width and sample rate
 	short		ts_interval_connected;
 	short		ts_width_connected;
-	float		ts_shortest_pulse;
-    double      ts_samp_rate;
+	long		ts_multichannel;		// "multichannel" attribute
+	short		ts_created;				// outlets are made, multichannel is fixed
 	
 } t_trainShift;	
 
 /* method definitions for this object */
-void trainShift_setIndexArray(t_trainShift *x);
-void *trainShift_new(long outlets);
+void *trainShift_new(t_symbol *s, long argc, t_atom *argv);
+void trainShift_free(t_trainShift *x);
+long trainShift_multichanneloutputs(t_trainShift *x, long index);
+t_max_err trainShift_multichannel_set(t_trainShift *x, void *attr, long argc, t_atom *argv);
 void trainShift_dsp64(t_trainShift *x, t_object *dsp64, short *count, double samplerate,
                       long maxvectorsize, long flags);
-void trainShift_perform64(t_trainShift *x, t_object *dsp64, double **ins, long numins, double **outs,long numouts, long vectorsize, long flags, void *userparam);
+void trainShift_perform64c(t_trainShift *x, t_object *dsp64, double **ins, long numins, double **outs,long numouts, long vectorsize, long flags, void *userparam);
+void trainShift_perform64a(t_trainShift *x, t_object *dsp64, double **ins, long numins, double **outs,long numouts, long vectorsize, long flags, void *userparam);
 void trainShift_float(t_trainShift *x, double f);
 void trainShift_int(t_trainShift *x, long l);
+void trainShift_clock(t_trainShift *x, t_symbol *s);
+void trainShift_blep(t_trainShift *x, long l);
 void trainShift_assist(t_trainShift *x, t_object *b, long msg, long arg, char *s);
 void trainShift_getinfo(t_trainShift *x);
 
@@ -69,16 +72,28 @@ int C74_EXPORT main(void)
 {
 	t_class *c;
     
-    c = class_new(OBJECT_NAME, (method)trainShift_new, (method)dsp_free, (short)sizeof(t_trainShift), 0L,
-				A_DEFLONG, 0);
+    c = class_new(OBJECT_NAME, (method)trainShift_new, (method)trainShift_free, (short)sizeof(t_trainShift), 0L,
+				A_GIMME, 0);
     class_dspinit(c); // add standard functions to class
 	
+	/* one multichannel outlet instead of an outlet per train */
+	CLASS_ATTR_LONG(c, "multichannel", 0, t_trainShift, ts_multichannel);
+	CLASS_ATTR_ACCESSORS(c, "multichannel", NULL, trainShift_multichannel_set);
+	CLASS_ATTR_FILTER_CLIP(c, "multichannel", 0, 1);
+	CLASS_ATTR_LABEL(c, "multichannel", 0, "Multichannel Output");
+	
 	/* bind method "trainShift_float" to the float message */
 	class_addmethod(c, (method)trainShift_float, "float", A_FLOAT, 0);
 	
 	/* bind method "trainShift_int" to the int message */
 	class_addmethod(c, (method)trainShift_int, "int", A_LONG, 0);
 	
+	/* bind method "trainShift_clock" to the clock message */
+	class_addmethod(c, (method)trainShift_clock, "clock", A_DEFSYM, 0);
+	
+	/* bind method "trainShift_blep" to the blep message */
+	class_addmethod(c, (method)trainShift_blep, "blep", A_LONG, 0);
+	
 	/* bind method "trainShift_assist" to the assistance message */
 	class_addmethod(c, (method)trainShift_assist, "assist", A_CANT, 0);
 	
@@ -87,6 +102,9 @@ int C74_EXPORT main(void)
     
     /* bind method "trainShift_dsp64" to the dsp64 message */
     class_addmethod(c, (method)trainShift_dsp64, "dsp64", A_CANT, 0);
+    
+    /* bind method for multichannel patch cords */
+    class_addmethod(c, (method)trainShift_multichanneloutputs, "multichanneloutputs", A_CANT, 0);
 	
     class_register(CLASS_BOX, c); // register the class w max
     trainshift_class = c;
@@ -99,64 +117,48 @@ int C74_EXPORT main(void)
 }
 
 /********************************************************************************
-void trainShift_setIndexArray(t_trainShift *x)
+void *trainShift_new(t_symbol *s, long argc, t_atom *argv)
 
-inputs:			x		-- pointer to this object
-description:	fills array with indexs for train output to outlets
-returns:		nothing
-********************************************************************************/
-void trainShift_setIndexArray(t_trainShift *x)
-{
-	float *tab = (float *)(x->ts_currIndex);		// get pointer to ps_table
-	float num_out = (float)(x->ts_outletcount);		// local var for number of outlets
-	long n = OUTLET_MAX;				// set counter equal to ts_outletcount
-	
-	n += 1;
-	while (--n) {	// fill indexs with zero first, to be safe
-		tab[n] = 0.0;
-	}
-	
-	n = x->ts_outletcount;			// set counter equal to ts_outletcount
-	while (--n >= 0) {
-		/* fill ps_table with pointer values */
-		tab[n] = ((float)n / num_out) + 1.0;
-	}
-	
-	#ifdef DEBUG
-		object_post((t_object*)x, "pointers set");
-	#endif /* DEBUG */
-}
-
-/********************************************************************************
-void *trainShift_new(long outlets)
-
-inputs:			initial_pos		-- object argument 1; number of outlets
+inputs:			s			-- name of object
+				argc		-- number of arguments
+				argv		-- number of trains, then attributes (@multichannel)
 description:	called for each new instance of object in the MAX environment;
 		defines inlets and outlets; defines default var values
 returns:		nothing
 ********************************************************************************/
-void *trainShift_new(long outlets)
+void *trainShift_new(t_symbol *s, long argc, t_atom *argv)
 {
 	long i;
 	
 	t_trainShift *x = (t_trainShift *) object_alloc((t_class*) trainshift_class);
+	long attrstart = attr_args_offset((short)argc, argv);
+	long outlets = attrstart > 0 ? (long)atom_getlong(argv) : 0;
 	
-	// set outlets within limits
-	x->ts_outletcount = 
-		outlets>OUTLET_MAX?OUTLET_MAX:outlets<OUTLET_MIN?OUTLET_MIN:outlets;
+	// the outlets depend on the attributes, so they are read first
+	x->ts_multichannel = false;
+	x->ts_created = false;
+	attr_args_process(x, (short)argc, argv);
 	
+	// set up before anything can fail, as the free method calls dsp_free
 	dsp_setup((t_pxobject *)x, 2);					// two inlets
-	for (i = 0; i < x->ts_outletcount; i++) {
-		outlet_new((t_pxobject *)x, "signal");		// create outlets
-	}
 	
-	trainShift_setIndexArray(x);					// set the indexs
+	// set outlets within limits, the indexs and default interval and width
+	if (!x->ts_trains.init(outlets, sys_getsr())) {
+		object_error((t_object*)x, "could not allocate phases");
+		object_free(x);
+		return NULL;
+	}
 	
-	x->ts_interval_ms = 1000.0;						// default interval to 1000.0
-	x->ts_width_ratio = 0.5;						// default width to 0.5
-	x->ts_shortest_pulse = 2000.0 / sys_getsr();
+	if (x->ts_multichannel) {
+		outlet_new((t_pxobject *)x, "multichannelsignal");	// every train in one
+	} else {
+		for (i = 0; i < x->ts_trains.ts_outletcount; i++) {
+			outlet_new((t_pxobject *)x, "signal");		// create outlets
+		}
+	}
 	
 	x->ts_obj.z_misc = Z_NO_INPLACE;
+	x->ts_created = true;
     
     #ifdef DEBUG
         object_post((t_object*)x, "new function was called");
@@ -167,6 +169,33 @@ void *trainShift_new(long outlets)
 }
 
 
+/********************************************************************************
+void trainShift_free(t_trainShift *x)
+
+inputs:			x		-- pointer to this object
+description:	called when the object is deleted; frees the phases
+returns:		nothing
+********************************************************************************/
+void trainShift_free(t_trainShift *x)
+{
+	dsp_free((t_pxobject *)x);
+	
+	x->ts_trains.free();
+}
+
+/********************************************************************************
+long trainShift_multichanneloutputs(t_trainShift *x, long index)
+
+inputs:			x		-- pointer to this object
+				index	-- outlet
+description:	reports the channels of the multichannel outlet, one per train
+returns:		number of channels
+********************************************************************************/
+long trainShift_multichanneloutputs(t_trainShift *x, long index)
+{
+	return x->ts_multichannel ? x->ts_trains.ts_outletcount : 1;
+}
+
 /********************************************************************************
  void trainShift_dsp64()
  
@@ -192,17 +221,32 @@ void trainShift_dsp64(t_trainShift *x, t_object *dsp64, short *count, double sam
     x->ts_width_connected = count[1];
     
     // save other info to object vars
-    x->ts_samp_rate = samplerate;
-    x->ts_shortest_pulse = 2000.0 / x->ts_samp_rate;
+    x->ts_trains.setSampleRate(samplerate);
+    
+    // members of a clock start from its origin together
+    x->ts_trains.ts_clock.reset(dsp64);
     
     // add the perform routine to the signal chain
-    dsp_add64(dsp64, (t_object*)x, (t_perfroutine64)trainShift_perform64, 0, NULL);
+    if (count[0] || count[1])
+    {
+        dsp_add64(dsp64, (t_object*)x, (t_perfroutine64)trainShift_perform64a, 0, NULL);
+        #ifdef DEBUG
+            object_post((t_object*)x, "interval or width is being updated at audio rate");
+        #endif /* DEBUG */
+    }
+    else
+    {
+        dsp_add64(dsp64, (t_object*)x, (t_perfroutine64)trainShift_perform64c, 0, NULL);
+        #ifdef DEBUG
+            object_post((t_object*)x, "interval and width are being updated at control rate");
+        #endif /* DEBUG */
+    }
 
 }
 
 
 /********************************************************************************
- void *trainShift_perform64(t_trainShift *x, t_object *dsp64, double **ins, long numins, double **outs,
+ void *trainShift_perform64c(t_trainShift *x, t_object *dsp64, double **ins, long numins, double **outs,
  long numouts, long vectorsize, long flags, void *userparam)
  
  inputs:			x		--
@@ -217,68 +261,36 @@ void trainShift_dsp64(t_trainShift *x, t_object *dsp64, short *count, double sam
  description:	called at interrupt level to compute object's output at 64-bit
  returns:		nothing
  ********************************************************************************/
-void trainShift_perform64(t_trainShift *x, t_object *dsp64, double **ins, long numins, double **outs,
+void trainShift_perform64c(t_trainShift *x, t_object *dsp64, double **ins, long numins, double **outs,
                             long numouts, long vectorsize, long flags, void *userparam)
 {
-    // local vars for outlets, interval, width, step size and index
-    double *curr_out[OUTLET_MAX];
-    double curr_length = x->ts_interval_connected ? *ins[0] : x->ts_interval_ms;
-    double curr_width = x->ts_width_connected ? *ins[1] : x->ts_width_ratio;
-    double curr_step_size;
-    float *currIndex = x->ts_currIndex; // TODO: upgrade to double later
-    
-    // local vars used for while loop
-    double temp;
-    long n, m;
-    
-    // fill local pointer array for outlets
-    m = numouts;
-    while(m--)
-    {
-        curr_out[m] = outs[m];
-    }
-    
-    // check constraints
-    if (curr_length < x->ts_shortest_pulse) curr_length = x->ts_shortest_pulse;
-    if (curr_width < 0.) curr_width = 1 / x->ts_samp_rate;
-    if (curr_width > 1.) curr_width = 1.;
-    
-    // then compute step size
-    curr_step_size = 1000.0 / (curr_length * x->ts_samp_rate);
-    
-    // update object variables
-    x->ts_interval_ms = curr_length;
-    x->ts_step_size = curr_step_size;
-    
-    
-    n = vectorsize;
-    while(n--)
-    {
-        m = numouts;
-        while(m--)
-        {
-            
-            temp = (double)(currIndex[m]);
-            
-            // check bounds //
-            while (temp < 0.0)
-                temp += 1.0;
-            
-            if (temp <= curr_width) {
-                *(curr_out[m]) = 1.0;		// save to output
-            } else {
-                *(curr_out[m]) = 0.0;		// save to output
-            }
-            
-            temp -= curr_step_size;		// advance index
-            currIndex[m] = (float)temp;	// save next index
-            (curr_out[m])++;			// advance the outlet pointer
-            
-        }
-        
-    }
-    
-    
+    x->ts_trains.process(x->ts_trains.ts_interval_ms, x->ts_trains.ts_width_ratio,
+                         outs, numouts, vectorsize);
+}
+
+/********************************************************************************
+ void *trainShift_perform64a(t_trainShift *x, t_object *dsp64, double **ins, long numins, double **outs,
+ long numouts, long vectorsize, long flags, void *userparam)
+ 
+ inputs:			x		--
+ dsp64   --
+ ins     --
+ numins  --
+ outs    --
+ numouts --
+ vectorsize --
+ flags   --
+ userparam  --
+ description:	called at interrupt level to compute object's output at 64-bit,
+ reading the interval and width every sample from whichever inlets have signals
+ returns:		nothing
+ ********************************************************************************/
+void trainShift_perform64a(t_trainShift *x, t_object *dsp64, double **ins, long numins, double **outs,
+                            long numouts, long vectorsize, long flags, void *userparam)
+{
+    x->ts_trains.processAudio(x->ts_interval_connected ? ins[0] : NULL,
+                              x->ts_width_connected ? ins[1] : NULL,
+                              outs, numouts, vectorsize);
 }
 
 /********************************************************************************
@@ -294,18 +306,18 @@ void trainShift_float(t_trainShift *x, double f)
 {
 	if (x->ts_obj.z_in == 0) // if first inlet
 	{
-		if (f > x->ts_shortest_pulse) { // if greater than two samples...
-			x->ts_interval_ms = f;				// save interval input
+		if (f > x->ts_trains.ts_shortest_pulse) { // if greater than two samples...
+			x->ts_trains.ts_interval_ms = f;				// save interval input
 		} else { // if not...
 			object_post((t_object*)x, "pulse interval must be greater than %f",
-				x->ts_shortest_pulse);
-			x->ts_interval_ms = x->ts_shortest_pulse;
+				x->ts_trains.ts_shortest_pulse);
+			x->ts_trains.ts_interval_ms = x->ts_trains.ts_shortest_pulse;
 		}
 	}
 	else if (x->ts_obj.z_in == 1) // if second inlet
 	{
 		if (f >= 0.0 && f <= 1.0) { // if within 0 and 1 bounds...
-			x->ts_width_ratio = f;				// save width input
+			x->ts_trains.ts_width_ratio = f;				// save width input
 		} else { // if not..
 			object_post((t_object*)x, "pulse width must be between 0 and 1");
 		}
@@ -329,12 +341,12 @@ void trainShift_int(t_trainShift *x, long l)
 {
 	if (x->ts_obj.z_in == 0) // if first inlet
 	{
-		if (l > x->ts_shortest_pulse) { // if greater than two samples...
-			x->ts_interval_ms = (double) l;			// save interval input
+		if (l > x->ts_trains.ts_shortest_pulse) { // if greater than two samples...
+			x->ts_trains.ts_interval_ms = (double) l;			// save interval input
 		} else { // if not...
 			object_post((t_object*)x, "pulse interval must be greater than %f",
-				x->ts_shortest_pulse);
-			x->ts_interval_ms = x->ts_shortest_pulse;
+				x->ts_trains.ts_shortest_pulse);
+			x->ts_trains.ts_interval_ms = x->ts_trains.ts_shortest_pulse;
 		}
 	}
 	else if (x->ts_obj.z_in == 1) // if second inlet
@@ -347,6 +359,59 @@ void trainShift_int(t_trainShift *x, long l)
 	}
 }
 
+/********************************************************************************
+void trainShift_blep(t_trainShift *x, long l)
+
+inputs:			x		-- pointer to our object
+				l		-- flag value
+description:	method called when "blep" message is received; 1 smooths the
+		edges of the pulses so that fast trains do not alias, 0 outputs plain
+		pulses of 0 and 1; default is 0
+returns:		nothing
+********************************************************************************/
+void trainShift_blep(t_trainShift *x, long l)
+{
+	if (l == 0 || l == 1) {
+		x->ts_trains.ts_blep = (short)l;
+		#ifdef DEBUG
+			object_post((t_object*)x, "blep is set to %ld", l);
+		#endif // DEBUG //
+	} else {
+		object_error((t_object*)x, "blep message was not understood");
+	}
+}
+
+/********************************************************************************
+void trainShift_clock(t_trainShift *x, t_symbol *s)
+
+inputs:			x		-- pointer to our object
+				s		-- name of the clock, or empty to run free
+description:	method called when "clock" message is received; the trains
+		follow the named clock from the next signal vector, taking their
+		phases from its count of samples so that every object following it
+		stays in step; naming the same clock again brings them back in step
+		with its origin
+returns:		nothing
+********************************************************************************/
+void trainShift_clock(t_trainShift *x, t_symbol *s)
+{
+	t_nw_clock *clock = NULL;
+	
+	if (s && s != gensym("")) {
+		clock = nw_clockreg_find(s);
+		if (!clock) {
+			object_error((t_object*)x, "could not find or make clock %s", s->s_name);
+			return;
+		}
+	}
+	
+	x->ts_trains.ts_clock.ask(clock);
+	
+	#ifdef DEBUG
+		object_post((t_object*)x, "following clock %s", clock ? s->s_name : "(none)");
+	#endif // DEBUG //
+}
+
 /********************************************************************************
 void trainShift_assist(t_trainShift *x, t_object *b, long msg, long arg, char *s)
 
@@ -361,9 +426,9 @@ returns:		nothing
 ********************************************************************************/
 void trainShift_assist(t_trainShift *x, t_object *b, long msg, long arg, char *s)
 {
-	char out_mess[30];
-	short which_outlet;
-	short num_out = x->ts_outletcount;
+	char out_mess[64];
+	long which_outlet;
+	long num_out = x->ts_trains.ts_outletcount;
 	
 	if (msg==ASSIST_INLET) {
 		switch (arg) {
@@ -376,7 +441,10 @@ void trainShift_assist(t_trainShift *x, t_object *b, long msg, long arg, char *s
 		}
 	} else if (msg==ASSIST_OUTLET) {
 		which_outlet = arg + 1;
-		sprintf(out_mess, "(signal) pulse output %hd of %hd", which_outlet, num_out);
+		if (x->ts_multichannel)
+			sprintf(out_mess, "(multichannel signal) %ld pulse outputs", num_out);
+		else
+			sprintf(out_mess, "(signal) pulse output %ld of %ld", which_outlet, num_out);
 		strcpy(s, out_mess);
 	}
 	
@@ -399,3 +467,26 @@ void trainShift_getinfo(t_trainShift *x)
 	object_post((t_object*)x, "%s object by Nathan Wolek", OBJECT_NAME);
 	object_post((t_object*)x, "Last updated on %s - www.nathanwolek.com", __DATE__);
 }
+
+/********************************************************************************
+t_max_err trainShift_multichannel_set(t_trainShift *x, void *attr, long argc, t_atom *argv)
+
+inputs:			x		-- pointer to our object
+				attr	-- the attribute being set
+				argc	-- number of values
+				argv	-- 1 for one multichannel outlet, 0 for an outlet per train
+description:	setter for the "multichannel" attribute; the outlets are made
+		with the object, so it can only be given as an argument
+returns:		MAX_ERR_NONE
+********************************************************************************/
+t_max_err trainShift_multichannel_set(t_trainShift *x, void *attr, long argc, t_atom *argv)
+{
+	if (argc && argv) {
+		if (x->ts_created) {
+			object_error((t_object*)x, "multichannel can only be set when the object is created");
+		} else {
+			x->ts_multichannel = atom_getlong(argv) ? true : false;
+		}
+	}
+	return MAX_ERR_NONE;
+}
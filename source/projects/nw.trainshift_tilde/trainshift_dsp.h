@@ -0,0 +1,667 @@
+/*
+** trainshift_dsp.h
+**
+** header file
+** phase shifted pulse trains for nw.trainshift~, free of any Max API calls so
+** that they can also be driven by the nw_bench profiling target
+**
+** each train counts its phase down and is on while the phase, wrapped into
+** 0 to 1, is at or below the width; the trains are written a block at a time,
+** the phase travelled before each sample of the block being summed once into
+** a ramp shared by every train, so each outlet is one run of compares and
+** contiguous stores with no branches
+**
+** with a signal in either inlet, processAudio() reads the interval and width
+** every sample rather than every vector
+**
+** the optional band-limited mode smooths each edge with a polynomial step
+** (PolyBLEP) spread over the samples either side of it
+**
+** the phases are held in one heap array sized for the trains asked for and
+** aligned to a cache line, so that a bank of hundreds of trains feeding a
+** multichannel cord costs only the memory it uses
+**
+** a train following a shared clock (nw_clock.h) takes its phases from the
+** clock's count of samples at the start of every block instead of carrying
+** them over, so several objects following one clock stay exactly together;
+** its trains are then on from the clock's origin rather than waiting for
+** their first wrap
+**
+** Max allocates objects without running constructors, so a TrainShift held
+** in an object struct is set up by init() and torn down by free() rather
+** than by a constructor and destructor
+**
+** Copyright © 2002,2015 by Nathan Wolek
+** License: http://opensource.org/licenses/BSD-3-Clause
+**
+*/
+
+#ifndef __TRAINSHIFT_DSP
+#define __TRAINSHIFT_DSP
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "nw_interp.h"		// for NW_FORCEINLINE
+#include "nw_simd.h"
+#include "nw_clock.h"
+
+#define OUTLET_MAX		1024				// maximum number of trains, as many as a multichannel cord carries
+#define OUTLET_MIN		2					// minimum number of outlets specifiable
+
+#define TRAINSHIFT_ALIGN	64				// alignment of the phase array, in bytes
+
+#define TRAINSHIFT_BLOCK	256				// samples written at a time
+
+/* the interval is at least two samples, so steps are 0 to 0.5 and a block
+** travels at most 128; phases stay well inside the int32 rounding of sse2 */
+
+typedef void (*t_trainshift_kernel)(double phase, const double *ramp, const double *wide,
+	const double *rate, double *out, long n);
+
+/* what every train reads for one block */
+typedef struct _trainshift_block
+{
+	double		ramp[TRAINSHIFT_BLOCK];		// phase travelled before each sample
+	double		wide[TRAINSHIFT_BLOCK];		// pulse width at each sample
+	double		rate[TRAINSHIFT_BLOCK];		// samples per cycle at each sample
+} t_trainshift_block;
+
+class TrainShift
+{
+public:
+	long 		ts_outletcount;
+	double 		*ts_currIndex;				// phase of each train, counting down
+	void		*ts_alloc;					// ts_currIndex before it was aligned
+	double 		ts_interval_ms;
+	double		ts_width_ratio;
+	double		ts_step_size;
+	double		ts_shortest_pulse;
+	double		ts_samp_rate;
+	short		ts_blep;					// band-limited edges when true
+	t_trainshift_kernel ts_kernel;			// fastest kernel for this processor
+	t_trainshift_kernel ts_blep_kernel;		// and its band-limited counterpart
+	t_trainshift_block ts_block;
+	double		ts_block_step;				// step and width ts_block holds for
+	double		ts_block_width;				// process(), or -1 when it needs filling
+	NwClockMember ts_clock;					// shared clock followed, if any
+
+	bool init(long outlets, double sr);
+	void free(void);
+	void setIndexArray(void);
+	void setClockPhases(double travelled);
+	void setSampleRate(double sr);
+	void process(double length, double width, double **outs, long numouts, long n);
+	void processAudio(const double *length, const double *width, double **outs,
+		long numouts, long n);
+	void writeBlock(double **outs, long numouts, long offset, long len, double sum);
+};
+
+/********************************************************************************
+double trainshift_phase(double p)
+
+inputs:			p		-- phase after counting down
+description:	wraps a phase that has gone below zero back into 0 to 1; the
+		phases every train starts with are above 1, so that none is on before
+		it first counts down to its width, and those are left as they are
+returns:		the wrapped phase
+********************************************************************************/
+NW_FORCEINLINE double trainshift_phase(double p)
+{
+	double f = floor(p);
+
+	return (f < 0.0) ? p - f : p;
+}
+
+/********************************************************************************
+double trainshift_edge(double t, double rate)
+
+inputs:			t		-- wrapped phase, measured from an edge
+				rate	-- samples per cycle, the inverse of the phase step
+description:	the correction for a unit step falling at phase 0, for the sample
+		before it (t just above 0) and the sample after it (t just below 1)
+returns:		the correction, -1 to 1
+********************************************************************************/
+NW_FORCEINLINE double trainshift_edge(double t, double rate)
+{
+	double x = t * rate;						// samples since the edge
+	double y = (t - 1.0) * rate;				// samples until the edge
+
+	if (x < 1.0) {
+		x = 1.0 - x;
+		return -x * x;
+	}
+	if (y > -1.0 && t < 1.0) {
+		y = 1.0 + y;
+		return y * y;
+	}
+	return 0.0;
+}
+
+/********************************************************************************
+void trainshift_pulseScalar(double phase, const double *ramp, const double *wide,
+		const double *rate, double *out, long n)
+
+inputs:			phase	-- phase of the train at the first sample
+				ramp	-- phase travelled before each sample
+				wide	-- pulse width at each sample
+				rate	-- samples per cycle at each sample, unused here
+				out		-- output vector
+				n		-- number of samples
+description:	writes one train; the vector kernels finish their blocks here
+returns:		nothing
+********************************************************************************/
+inline void trainshift_pulseScalar(double phase, const double *ramp, const double *wide,
+	const double * /* rate */, double *out, long n)
+{
+    long k;
+
+    for (k = 0; k < n; k++)
+        out[k] = (trainshift_phase(phase - ramp[k]) <= wide[k]) ? 1.0 : 0.0;
+}
+
+/********************************************************************************
+void trainshift_blepScalar(double phase, const double *ramp, const double *wide,
+		const double *rate, double *out, long n)
+
+inputs:			(as trainshift_pulseScalar)
+description:	writes one band-limited train; the falling edge is where the
+		phase wraps and the rising edge where it passes the width, which is
+		not an edge before the train first wraps
+returns:		nothing
+********************************************************************************/
+inline void trainshift_blepScalar(double phase, const double *ramp, const double *wide,
+	const double *rate, double *out, long n)
+{
+    double t, r;
+    long k;
+
+    for (k = 0; k < n; k++) {
+        t = trainshift_phase(phase - ramp[k]);
+        r = t - wide[k];
+        r = (t < 1.0) ? r - floor(r) : 0.5;
+        out[k] = ((t <= wide[k]) ? 1.0 : 0.0)
+            + 0.5 * (trainshift_edge(t, rate[k]) - trainshift_edge(r, rate[k]));
+    }
+}
+
+#if NW_SIMD_X86
+
+/********************************************************************************
+__m128d trainshift_floorSSE2(__m128d x)
+
+inputs:			x		-- two values within the int32 range
+description:	sse2 has no floor, so values are rounded through int32 and pulled
+		down where that rounded up
+returns:		the floors
+********************************************************************************/
+NW_FORCEINLINE __m128d trainshift_floorSSE2(__m128d x)
+{
+    __m128d t = _mm_cvtepi32_pd(_mm_cvtpd_epi32(x));
+
+    return _mm_sub_pd(t, _mm_and_pd(_mm_cmpgt_pd(t, x), _mm_set1_pd(1.0)));
+}
+
+/********************************************************************************
+__m128d trainshift_edgeSSE2(__m128d t, __m128d rate)
+
+inputs:			(as trainshift_edge, two at a time)
+description:	works out both sides of the edge and keeps the one that applies
+returns:		the corrections
+********************************************************************************/
+NW_FORCEINLINE __m128d trainshift_edgeSSE2(__m128d t, __m128d rate)
+{
+    const __m128d one = _mm_set1_pd(1.0);
+    __m128d x, y, before, after, in_after;
+
+    x = _mm_mul_pd(t, rate);
+    y = _mm_mul_pd(_mm_sub_pd(t, one), rate);
+    before = _mm_sub_pd(one, x);
+    before = _mm_sub_pd(_mm_setzero_pd(), _mm_mul_pd(before, before));
+    after = _mm_add_pd(one, y);
+    after = _mm_mul_pd(after, after);
+    in_after = _mm_and_pd(_mm_cmpgt_pd(y, _mm_set1_pd(-1.0)), _mm_cmplt_pd(t, one));
+
+    return _mm_or_pd(_mm_and_pd(_mm_cmplt_pd(x, one), before), _mm_and_pd(in_after, after));
+}
+
+/********************************************************************************
+void trainshift_pulseSSE2(double phase, const double *ramp, const double *wide,
+		const double *rate, double *out, long n)
+
+inputs:			(as trainshift_pulseScalar)
+description:	writes two samples at a time
+returns:		nothing
+********************************************************************************/
+inline void trainshift_pulseSSE2(double phase, const double *ramp, const double *wide,
+	const double *rate, double *out, long n)
+{
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d p0 = _mm_set1_pd(phase);
+    __m128d t;
+    long i;
+
+    for (i = 0; i + 2 <= n; i += 2) {
+        t = _mm_sub_pd(p0, _mm_loadu_pd(ramp + i));
+        t = _mm_sub_pd(t, _mm_min_pd(trainshift_floorSSE2(t), zero));
+        _mm_storeu_pd(out + i, _mm_and_pd(_mm_cmple_pd(t, _mm_loadu_pd(wide + i)), one));
+    }
+
+    trainshift_pulseScalar(phase, ramp + i, wide + i, rate + i, out + i, n - i);
+}
+
+/********************************************************************************
+void trainshift_blepSSE2(double phase, const double *ramp, const double *wide,
+		const double *rate, double *out, long n)
+
+inputs:			(as trainshift_pulseScalar)
+description:	writes two band-limited samples at a time
+returns:		nothing
+********************************************************************************/
+inline void trainshift_blepSSE2(double phase, const double *ramp, const double *wide,
+	const double *rate, double *out, long n)
+{
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d half = _mm_set1_pd(0.5);
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d p0 = _mm_set1_pd(phase);
+    __m128d t, r, w, spc, wrapped, y;
+    long i;
+
+    for (i = 0; i + 2 <= n; i += 2) {
+        w = _mm_loadu_pd(wide + i);
+        spc = _mm_loadu_pd(rate + i);
+        t = _mm_sub_pd(p0, _mm_loadu_pd(ramp + i));
+        t = _mm_sub_pd(t, _mm_min_pd(trainshift_floorSSE2(t), zero));
+        r = _mm_sub_pd(t, w);
+        r = _mm_sub_pd(r, trainshift_floorSSE2(r));
+        wrapped = _mm_cmplt_pd(t, one);
+        r = _mm_or_pd(_mm_and_pd(wrapped, r), _mm_andnot_pd(wrapped, half));
+        y = _mm_sub_pd(trainshift_edgeSSE2(t, spc), trainshift_edgeSSE2(r, spc));
+        y = _mm_add_pd(_mm_and_pd(_mm_cmple_pd(t, w), one), _mm_mul_pd(half, y));
+        _mm_storeu_pd(out + i, y);
+    }
+
+    trainshift_blepScalar(phase, ramp + i, wide + i, rate + i, out + i, n - i);
+}
+
+/********************************************************************************
+__m256d trainshift_edgeAVX2(__m256d t, __m256d rate)
+
+inputs:			(as trainshift_edge, four at a time)
+description:	works out both sides of the edge and keeps the one that applies
+returns:		the corrections
+********************************************************************************/
+NW_TARGET_AVX2 NW_FORCEINLINE __m256d trainshift_edgeAVX2(__m256d t, __m256d rate)
+{
+    const __m256d one = _mm256_set1_pd(1.0);
+    __m256d x, y, before, after, in_after;
+
+    x = _mm256_mul_pd(t, rate);
+    y = _mm256_mul_pd(_mm256_sub_pd(t, one), rate);
+    before = _mm256_sub_pd(one, x);
+    before = _mm256_sub_pd(_mm256_setzero_pd(), _mm256_mul_pd(before, before));
+    after = _mm256_add_pd(one, y);
+    after = _mm256_mul_pd(after, after);
+    in_after = _mm256_and_pd(_mm256_cmp_pd(y, _mm256_set1_pd(-1.0), _CMP_GT_OQ),
+                             _mm256_cmp_pd(t, one, _CMP_LT_OQ));
+
+    return _mm256_or_pd(_mm256_and_pd(_mm256_cmp_pd(x, one, _CMP_LT_OQ), before),
+                        _mm256_and_pd(in_after, after));
+}
+
+/********************************************************************************
+void trainshift_pulseAVX2(double phase, const double *ramp, const double *wide,
+		const double *rate, double *out, long n)
+
+inputs:			(as trainshift_pulseScalar)
+description:	writes four samples at a time
+returns:		nothing
+********************************************************************************/
+NW_TARGET_AVX2 inline void trainshift_pulseAVX2(double phase, const double *ramp, const double *wide,
+	const double *rate, double *out, long n)
+{
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d p0 = _mm256_set1_pd(phase);
+    __m256d t;
+    long i;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        t = _mm256_sub_pd(p0, _mm256_loadu_pd(ramp + i));
+        t = _mm256_sub_pd(t, _mm256_min_pd(_mm256_floor_pd(t), zero));
+        t = _mm256_cmp_pd(t, _mm256_loadu_pd(wide + i), _CMP_LE_OQ);
+        _mm256_storeu_pd(out + i, _mm256_and_pd(t, one));
+    }
+
+    // avoid the penalty for mixing avx and sse code in the rest of the chain
+    _mm256_zeroupper();
+
+    trainshift_pulseScalar(phase, ramp + i, wide + i, rate + i, out + i, n - i);
+}
+
+/********************************************************************************
+void trainshift_blepAVX2(double phase, const double *ramp, const double *wide,
+		const double *rate, double *out, long n)
+
+inputs:			(as trainshift_pulseScalar)
+description:	writes four band-limited samples at a time
+returns:		nothing
+********************************************************************************/
+NW_TARGET_AVX2 inline void trainshift_blepAVX2(double phase, const double *ramp, const double *wide,
+	const double *rate, double *out, long n)
+{
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d half = _mm256_set1_pd(0.5);
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d p0 = _mm256_set1_pd(phase);
+    __m256d t, r, w, spc, y;
+    long i;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        w = _mm256_loadu_pd(wide + i);
+        spc = _mm256_loadu_pd(rate + i);
+        t = _mm256_sub_pd(p0, _mm256_loadu_pd(ramp + i));
+        t = _mm256_sub_pd(t, _mm256_min_pd(_mm256_floor_pd(t), zero));
+        r = _mm256_sub_pd(t, w);
+        r = _mm256_sub_pd(r, _mm256_floor_pd(r));
+        r = _mm256_blendv_pd(half, r, _mm256_cmp_pd(t, one, _CMP_LT_OQ));
+        y = _mm256_sub_pd(trainshift_edgeAVX2(t, spc), trainshift_edgeAVX2(r, spc));
+        y = _mm256_add_pd(_mm256_and_pd(_mm256_cmp_pd(t, w, _CMP_LE_OQ), one), _mm256_mul_pd(half, y));
+        _mm256_storeu_pd(out + i, y);
+    }
+
+    // avoid the penalty for mixing avx and sse code in the rest of the chain
+    _mm256_zeroupper();
+
+    trainshift_blepScalar(phase, ramp + i, wide + i, rate + i, out + i, n - i);
+}
+
+#endif /* NW_SIMD_X86 */
+
+/********************************************************************************
+bool TrainShift::init(long outlets, double sr)
+
+inputs:			outlets		-- number of trains, clipped to OUTLET_MIN..OUTLET_MAX
+				sr			-- sample rate
+description:	sets the train count, allocates and spreads their phases and
+		sets defaults
+returns:		false if the phases could not be allocated
+********************************************************************************/
+inline bool TrainShift::init(long outlets, double sr)
+{
+	ts_kernel = trainshift_pulseScalar;
+	ts_blep_kernel = trainshift_blepScalar;
+#if NW_SIMD_X86
+	if (nw_cpu_has_avx2()) {
+		ts_kernel = trainshift_pulseAVX2;
+		ts_blep_kernel = trainshift_blepAVX2;
+	} else if (nw_cpu_has_sse2()) {
+		ts_kernel = trainshift_pulseSSE2;
+		ts_blep_kernel = trainshift_blepSSE2;
+	}
+#endif
+
+	// set outlets within limits
+	ts_outletcount =
+		outlets>OUTLET_MAX?OUTLET_MAX:outlets<OUTLET_MIN?OUTLET_MIN:outlets;
+
+	ts_interval_ms = 1000.0;			// default interval to 1000.0
+	ts_width_ratio = 0.5;				// default width to 0.5
+	ts_step_size = 0.0;
+	ts_blep = false;
+	ts_block_step = ts_block_width = -1.0;
+	ts_clock.init();					// free running
+	setSampleRate(sr);
+
+	// one phase per train, starting on a cache line
+	ts_alloc = malloc(ts_outletcount * sizeof(double) + TRAINSHIFT_ALIGN - 1);
+	if (!ts_alloc) {
+		ts_currIndex = 0;
+		return false;
+	}
+	ts_currIndex = (double *)(((size_t)ts_alloc + TRAINSHIFT_ALIGN - 1)
+		& ~(size_t)(TRAINSHIFT_ALIGN - 1));
+
+	setIndexArray();					// set the indexs
+	return true;
+}
+
+/********************************************************************************
+void TrainShift::free(void)
+
+inputs:			nothing
+description:	frees the phases
+returns:		nothing
+********************************************************************************/
+inline void TrainShift::free(void)
+{
+	if (ts_alloc)
+		::free(ts_alloc);
+	ts_alloc = 0;
+	ts_currIndex = 0;
+}
+
+/********************************************************************************
+void TrainShift::setIndexArray(void)
+
+inputs:			nothing
+description:	fills array with indexs for train output to outlets
+returns:		nothing
+********************************************************************************/
+inline void TrainShift::setIndexArray(void)
+{
+	double *tab = ts_currIndex;
+	double num_out = (double)ts_outletcount;	// local var for number of outlets
+	long n;
+
+	n = ts_outletcount;			// set counter equal to ts_outletcount
+	while (--n >= 0) {
+		/* fill ts_table with pointer values */
+		tab[n] = ((double)n / num_out) + 1.0;
+	}
+}
+
+/********************************************************************************
+void TrainShift::setClockPhases(double travelled)
+
+inputs:			travelled	-- phase travelled since the clock's origin, 0 to 1
+description:	sets every phase from the clock, counted down from the spread
+		setIndexArray() gives them, but already wrapped into 0 to 1
+returns:		nothing
+********************************************************************************/
+inline void TrainShift::setClockPhases(double travelled)
+{
+	double *tab = ts_currIndex;
+	double num_out = (double)ts_outletcount;	// local var for number of outlets
+	long n;
+
+	for (n = 0; n < ts_outletcount; n++)
+		tab[n] = nw_clock_frac((double)n / num_out - travelled);
+}
+
+/********************************************************************************
+void TrainShift::setSampleRate(double sr)
+
+inputs:			sr		-- sample rate
+description:	stores the sample rate and the shortest interval it allows,
+		two samples in milliseconds
+returns:		nothing
+********************************************************************************/
+inline void TrainShift::setSampleRate(double sr)
+{
+	ts_samp_rate = sr;
+	ts_shortest_pulse = 2000.0 / ts_samp_rate;
+	ts_block_step = -1.0;
+}
+
+/********************************************************************************
+void TrainShift::writeBlock(double **outs, long numouts, long offset, long len,
+		double sum)
+
+inputs:			outs		-- one output vector per train
+				numouts		-- number of output vectors
+				offset		-- first sample of the block within the vector
+				len			-- number of samples in the block
+				sum			-- phase travelled by the whole block
+description:	writes every train for one block from ts_block, then counts
+		their phases down by the block
+returns:		nothing
+********************************************************************************/
+inline void TrainShift::writeBlock(double **outs, long numouts, long offset, long len, double sum)
+{
+    t_trainshift_kernel kernel = ts_blep ? ts_blep_kernel : ts_kernel;
+    t_trainshift_block *b = &ts_block;
+    double *currIndex = ts_currIndex;
+    long m;
+
+    // there is a phase for each of ts_outletcount trains only
+    if (numouts > ts_outletcount) numouts = ts_outletcount;
+
+    for (m = 0; m < numouts; m++) {
+        kernel(currIndex[m], b->ramp, b->wide, b->rate, outs[m] + offset, len);
+
+        // the phase the next block starts from
+        currIndex[m] = trainshift_phase(currIndex[m] - sum);
+    }
+}
+
+/********************************************************************************
+void TrainShift::process(double length, double width, double **outs,
+		long numouts, long n)
+
+inputs:			length		-- interval between pulses in milliseconds
+				width		-- pulse width as a ratio of the interval
+				outs		-- one output vector per train
+				numouts		-- number of output vectors
+				n			-- number of samples
+description:	writes the pulse trains, each offset by 1/numouts of an interval;
+		ts_block is only filled again when the step or width changes; following
+		a clock, the phases are first taken from its count
+returns:		nothing
+********************************************************************************/
+inline void TrainShift::process(double length, double width, double **outs, long numouts, long n)
+{
+    t_trainshift_block *b = &ts_block;
+    double curr_step_size;
+    long long t;
+    long done, len, k;
+
+    // check constraints, written so that NaN fails them too
+    if (!(length >= ts_shortest_pulse)) length = ts_shortest_pulse;
+    if (!(width >= 0.)) width = 1 / ts_samp_rate;
+    if (width > 1.) width = 1.;
+
+    // then compute step size
+    curr_step_size = 1000.0 / (length * ts_samp_rate);
+
+    // update object variables
+    ts_interval_ms = length;
+    ts_step_size = curr_step_size;
+
+    if (curr_step_size != ts_block_step || width != ts_block_width) {
+        for (k = 0; k < TRAINSHIFT_BLOCK; k++) {
+            b->ramp[k] = (double)k * curr_step_size;
+            b->wide[k] = width;
+            b->rate[k] = 1.0 / curr_step_size;
+        }
+        ts_block_step = curr_step_size;
+        ts_block_width = width;
+    }
+
+    if (ts_clock.start(n, &t))
+        setClockPhases(ts_clock.phase(curr_step_size, t));
+
+    for (done = 0; done < n; done += len) {
+        len = (n - done < TRAINSHIFT_BLOCK) ? n - done : TRAINSHIFT_BLOCK;
+        writeBlock(outs, numouts, done, len, (double)len * curr_step_size);
+    }
+}
+
+/********************************************************************************
+void TrainShift::processAudio(const double *length, const double *width,
+		double **outs, long numouts, long n)
+
+inputs:			length		-- interval for each sample in milliseconds, or NULL
+						to hold ts_interval_ms
+				width		-- pulse width for each sample, or NULL to hold
+						ts_width_ratio
+				outs		-- one output vector per train
+				numouts		-- number of output vectors
+				n			-- number of samples
+description:	writes the pulse trains under an interval or width signal; each
+		block takes the running sum of its steps once for every train;
+		following a clock, each block takes its phases from the count, anchored
+		again after a block whose steps change
+returns:		nothing
+********************************************************************************/
+inline void TrainShift::processAudio(const double *length, const double *width, double **outs,
+		long numouts, long n)
+{
+    // local vars for the block, step size and widths
+    t_trainshift_block *b = &ts_block;
+    double sr = ts_samp_rate;
+    double curr_length = ts_interval_ms;
+    double curr_width = ts_width_ratio;
+    double curr_step_size;
+    double sum, first, travelled;
+    long long t;
+    bool clocked, steady;
+    long done, len, k;
+
+    // check constraints on the held values
+    if (!(curr_length >= ts_shortest_pulse)) curr_length = ts_shortest_pulse;
+    if (!(curr_width >= 0.)) curr_width = 1 / sr;
+    if (curr_width > 1.) curr_width = 1.;
+    curr_step_size = 1000.0 / (curr_length * sr);
+
+    // the block no longer holds what process() filled it with
+    ts_block_step = -1.0;
+
+    clocked = ts_clock.start(n, &t);
+
+    for (done = 0; done < n; done += len) {
+        len = (n - done < TRAINSHIFT_BLOCK) ? n - done : TRAINSHIFT_BLOCK;
+
+        // ramp[k] is the phase travelled before sample k of the block
+        sum = 0.0;
+        first = -1.0;
+        steady = true;
+        for (k = 0; k < len; k++) {
+            if (length) {
+                curr_length = length[done + k];
+                if (!(curr_length >= ts_shortest_pulse)) curr_length = ts_shortest_pulse;
+                curr_step_size = 1000.0 / (curr_length * sr);
+            }
+            if (width) {
+                curr_width = width[done + k];
+                if (!(curr_width >= 0.)) curr_width = 1 / sr;
+                if (curr_width > 1.) curr_width = 1.;
+            }
+            b->ramp[k] = sum;
+            b->wide[k] = curr_width;
+            b->rate[k] = 1.0 / curr_step_size;
+            sum += curr_step_size;
+            if (k == 0) first = curr_step_size;
+            steady &= (curr_step_size == first);
+        }
+
+        // a block at one step is where the clock puts it; one whose steps
+        // change anchors the clock again where it ends
+        if (clocked) {
+            travelled = ts_clock.phase(first, t + done);
+            setClockPhases(travelled);
+            if (!steady)
+                ts_clock.move(t + done + len, travelled + sum, curr_step_size);
+        }
+
+        writeBlock(outs, numouts, done, len, sum);
+    }
+
+    // update object variables
+    ts_interval_ms = curr_length;
+    ts_step_size = curr_step_size;
+}
+
+#endif /* __TRAINSHIFT_DSP */